@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * ur_addr_map benchmark: insert, hit lookup, miss lookup and delete cost of
+ * a map with many remote addresses (one UDP socket per remote endpoint).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ns_turn_ioaddr.h"
+#include "ns_turn_maps.h"
+
+#define LOOKUPS_NUM (2000000)
+
+static uint64_t rnd_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rnd(void) {
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+/* Every fourth address is IPv6 */
+static void make_addr(ioa_addr *addr, size_t i) {
+  uint64_t r = rnd();
+  memset(addr, 0, sizeof(ioa_addr));
+  if (i & 3) {
+    addr->s4.sin_family = AF_INET;
+    addr->s4.sin_addr.s_addr = (uint32_t)r;
+    addr->s4.sin_port = (uint16_t)(r >> 32);
+  } else {
+    addr->s6.sin6_family = AF_INET6;
+    memcpy(&(addr->s6.sin6_addr), &r, sizeof(r));
+    r = rnd();
+    memcpy(((uint8_t *)&(addr->s6.sin6_addr)) + 8, &r, sizeof(r));
+    addr->s6.sin6_port = (uint16_t)(r >> 32);
+  }
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void run(size_t n) {
+  ioa_addr *keys = (ioa_addr *)malloc(sizeof(ioa_addr) * n);
+  ioa_addr *misses = (ioa_addr *)malloc(sizeof(ioa_addr) * n);
+  size_t *order = (size_t *)malloc(sizeof(size_t) * LOOKUPS_NUM);
+  ur_addr_map *map = (ur_addr_map *)malloc(sizeof(ur_addr_map));
+
+  if (!keys || !misses || !order || !map) {
+    fprintf(stderr, "Cannot allocate memory\n");
+    exit(1);
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    make_addr(&(keys[i]), i);
+    make_addr(&(misses[i]), i);
+  }
+  for (size_t i = 0; i < LOOKUPS_NUM; ++i) {
+    order[i] = (size_t)(rnd() % n);
+  }
+
+  ur_addr_map_init(map);
+
+  double t0 = now_ns();
+  for (size_t i = 0; i < n; ++i) {
+    ur_addr_map_put(map, &(keys[i]), (ur_addr_map_value_type)(i + 1));
+  }
+  double t1 = now_ns();
+
+  size_t found = 0;
+  for (size_t i = 0; i < LOOKUPS_NUM; ++i) {
+    ur_addr_map_value_type value = 0;
+    if (ur_addr_map_get(map, &(keys[order[i]]), &value) && (value == order[i] + 1)) {
+      ++found;
+    }
+  }
+  double t2 = now_ns();
+
+  size_t false_hits = 0;
+  for (size_t i = 0; i < LOOKUPS_NUM; ++i) {
+    if (ur_addr_map_get(map, &(misses[order[i]]), NULL)) {
+      ++false_hits;
+    }
+  }
+  double t3 = now_ns();
+
+  size_t elements = ur_addr_map_num_elements(map);
+
+  for (size_t i = 0; i < n; ++i) {
+    ur_addr_map_del(map, &(keys[i]), NULL);
+  }
+  double t4 = now_ns();
+
+  printf("%8lu %10.1f %10.1f %10.1f %10.1f  %s\n", (unsigned long)n, (t1 - t0) / n, (t2 - t1) / LOOKUPS_NUM,
+         (t3 - t2) / LOOKUPS_NUM, (t4 - t3) / n,
+         ((found == LOOKUPS_NUM) && !false_hits && (elements == n) && !ur_addr_map_num_elements(map)) ? "ok"
+                                                                                                   : "FAILED");
+
+  ur_addr_map_clean(map);
+  free(map);
+  free(order);
+  free(misses);
+  free(keys);
+}
+
+int main(int argc, char **argv) {
+  static const size_t sizes[] = {10000, 100000, 1000000};
+
+  printf("%8s %10s %10s %10s %10s   (ns per operation)\n", "entries", "insert", "hit", "miss", "delete");
+
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      run((size_t)strtoul(argv[i], NULL, 10));
+    }
+  } else {
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+      run(sizes[i]);
+    }
+  }
+
+  return 0;
+}
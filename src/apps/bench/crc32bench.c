@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * CRC-32 (STUN FINGERPRINT) benchmark: every implementation available on
+ * this CPU is cross-checked against the byte-at-a-time table version on
+ * random lengths and alignments, then timed on typical STUN message sizes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ns_turn_crc32.h"
+
+#define CHECKS_NUM (200000)
+#define CHECK_MAX_LEN (2048)
+#define BYTES_PER_RUN (256 * 1024 * 1024)
+
+static uint64_t rnd_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t rnd(void) {
+  rnd_state ^= rnd_state << 13;
+  rnd_state ^= rnd_state >> 7;
+  rnd_state ^= rnd_state << 17;
+  return rnd_state;
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int cross_check(const uint8_t *data) {
+  static const uint8_t check_str[] = "123456789";
+  int errors = 0;
+
+  for (int impl = 0; impl < NS_CRC32_IMPL_NUMBER; ++impl) {
+    if (!ns_crc32_impl_available((ns_crc32_impl)impl)) {
+      printf("%-8s not available\n", ns_crc32_impl_name((ns_crc32_impl)impl));
+      continue;
+    }
+
+    int failed = 0;
+    if (ns_crc32_with((ns_crc32_impl)impl, check_str, 9) != 0xCBF43926) {
+      ++failed;
+    }
+
+    uint64_t saved_state = rnd_state;
+    for (size_t i = 0; i < CHECKS_NUM; ++i) {
+      size_t offset = (size_t)(rnd() % 16);
+      size_t len = (size_t)(rnd() % CHECK_MAX_LEN);
+      if (ns_crc32_with((ns_crc32_impl)impl, data + offset, len) !=
+          ns_crc32_with(NS_CRC32_TABLE, data + offset, len)) {
+        ++failed;
+      }
+    }
+    rnd_state = saved_state;
+
+    printf("%-8s %s\n", ns_crc32_impl_name((ns_crc32_impl)impl), failed ? "FAILED" : "ok");
+    errors += failed;
+  }
+
+  return errors;
+}
+
+static void run(const uint8_t *data, size_t len) {
+  size_t loops = BYTES_PER_RUN / (len + 64);
+  volatile uint32_t sink = 0;
+
+  printf("%6lu", (unsigned long)len);
+
+  for (int impl = 0; impl < NS_CRC32_IMPL_NUMBER; ++impl) {
+    if (!ns_crc32_impl_available((ns_crc32_impl)impl)) {
+      printf(" %10s", "-");
+      continue;
+    }
+    double t0 = now_ns();
+    for (size_t i = 0; i < loops; ++i) {
+      sink ^= ns_crc32_with((ns_crc32_impl)impl, data + (i & 7), len);
+    }
+    double t1 = now_ns();
+    printf(" %10.1f", (t1 - t0) / loops);
+  }
+
+  double t0 = now_ns();
+  for (size_t i = 0; i < loops; ++i) {
+    sink ^= ns_crc32(data + (i & 7), len);
+  }
+  double t1 = now_ns();
+  printf(" %10.1f\n", (t1 - t0) / loops);
+}
+
+int main(int argc, char **argv) {
+  static const size_t sizes[] = {20, 64, 100, 200, 548, 1200, 1500};
+
+  uint8_t *data = (uint8_t *)malloc(CHECK_MAX_LEN + 16);
+  if (!data) {
+    fprintf(stderr, "Cannot allocate memory\n");
+    return 1;
+  }
+  for (size_t i = 0; i < CHECK_MAX_LEN + 16; ++i) {
+    data[i] = (uint8_t)rnd();
+  }
+
+  int errors = cross_check(data);
+
+  printf("\n%6s", "bytes");
+  for (int impl = 0; impl < NS_CRC32_IMPL_NUMBER; ++impl) {
+    printf(" %10s", ns_crc32_impl_name((ns_crc32_impl)impl));
+  }
+  printf(" %10s   (ns per message; ns_crc32 uses %s)\n", "ns_crc32", ns_crc32_impl_name(ns_crc32_get_impl()));
+
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      size_t len = (size_t)strtoul(argv[i], NULL, 10);
+      run(data, (len > CHECK_MAX_LEN) ? CHECK_MAX_LEN : len);
+    }
+  } else {
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+      run(data, sizes[i]);
+    }
+  }
+
+  free(data);
+
+  return errors ? 1 : 0;
+}
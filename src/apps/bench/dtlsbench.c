@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * DTLS read benchmark: records of a DTLS 1.2 connection established in
+ * memory are decrypted by the server side one datagram at a time, as the
+ * relay does, with a new memory BIO per datagram, and with the read BIO
+ * that stays with the SSL.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "apputils.h"
+
+#include <openssl/err.h>
+#include <openssl/x509.h>
+
+#define RECORDS_NUM (200000)
+#define RECORDS_BATCH (10000)
+
+typedef enum { READ_MEM_BIO, READ_DTLS_BIO } read_mode;
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static SSL_CTX *new_server_ctx(void) {
+  EVP_PKEY *pkey = NULL;
+  EVP_PKEY_CTX *kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+  if (!kctx || (EVP_PKEY_keygen_init(kctx) != 1) ||
+      (EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1) != 1) ||
+      (EVP_PKEY_keygen(kctx, &pkey) != 1)) {
+    EVP_PKEY_CTX_free(kctx);
+    return NULL;
+  }
+  EVP_PKEY_CTX_free(kctx);
+
+  X509 *cert = X509_new();
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, pkey);
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"dtlsbench", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_sign(cert, pkey, EVP_sha256());
+
+  SSL_CTX *ctx = SSL_CTX_new(DTLS_server_method());
+  if (ctx && ((SSL_CTX_use_certificate(ctx, cert) != 1) || (SSL_CTX_use_PrivateKey(ctx, pkey) != 1))) {
+    SSL_CTX_free(ctx);
+    ctx = NULL;
+  }
+
+  X509_free(cert);
+  EVP_PKEY_free(pkey);
+
+  return ctx;
+}
+
+static SSL *new_ssl(SSL_CTX *ctx, BIO *rbio) {
+  SSL *ssl = SSL_new(ctx);
+  SSL_set_options(ssl, SSL_OP_NO_QUERY_MTU);
+  DTLS_set_link_mtu(ssl, 1500);
+  BIO *wbio = BIO_new(BIO_s_mem());
+  SSL_set_bio(ssl, rbio, wbio);
+  return ssl;
+}
+
+/* The datagram as read by the relay: ssl_read() before and after the reusable BIO */
+static int server_read(SSL *ssl, read_mode mode, const uint8_t *data, int len, uint8_t *out, int out_size) {
+  int ret = 0;
+  if (mode == READ_MEM_BIO) {
+    BIO *rbio = BIO_new_mem_buf(data, len);
+    BIO_set_mem_eof_return(rbio, -1);
+    SSL_set0_rbio(ssl, rbio);
+    ret = SSL_read(ssl, out, out_size);
+    SSL_set0_rbio(ssl, NULL);
+  } else {
+    BIO *rbio = get_dtls_read_bio(ssl);
+    dtls_read_bio_set(rbio, data, (size_t)len);
+    ret = SSL_read(ssl, out, out_size);
+    dtls_read_bio_set(rbio, NULL, 0);
+  }
+  return ret;
+}
+
+/* Move the pending output of a memory BIO into buf; return its length */
+static int take_output(SSL *ssl, uint8_t *buf, int size) {
+  BIO *wbio = SSL_get_wbio(ssl);
+  int pending = (int)BIO_ctrl_pending(wbio);
+  if (pending <= 0) {
+    return 0;
+  }
+  if (pending > size) {
+    return -1;
+  }
+  return BIO_read(wbio, buf, pending);
+}
+
+static int handshake(SSL *client, SSL *server, read_mode mode) {
+  static uint8_t buf[65536];
+  static uint8_t out[65536];
+
+  SSL_set_connect_state(client);
+  SSL_set_accept_state(server);
+
+  for (int i = 0; i < 100; ++i) {
+    SSL_do_handshake(client);
+    int len = take_output(client, buf, (int)sizeof(buf));
+    if (len > 0) {
+      server_read(server, mode, buf, len, out, (int)sizeof(out));
+    }
+    len = take_output(server, buf, (int)sizeof(buf));
+    if (len > 0) {
+      BIO_write(SSL_get_rbio(client), buf, len);
+    }
+    if (SSL_is_init_finished(client) && SSL_is_init_finished(server)) {
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+static int run(SSL_CTX *cctx, SSL_CTX *sctx, read_mode mode, int payload, double *ns_per_record) {
+  BIO *crbio = BIO_new(BIO_s_mem());
+  BIO_set_mem_eof_return(crbio, -1);
+  SSL *client = new_ssl(cctx, crbio);
+  SSL *server = new_ssl(sctx, NULL);
+
+  int errors = 0;
+  if (handshake(client, server, mode) < 0) {
+    fprintf(stderr, "DTLS handshake failed\n");
+    errors = 1;
+  }
+
+  uint8_t *records = (uint8_t *)malloc((size_t)RECORDS_BATCH * 2048);
+  int *lens = (int *)malloc(RECORDS_BATCH * sizeof(int));
+  uint8_t data[1500];
+  uint8_t out[65536];
+  memset(data, 0x5a, sizeof(data));
+
+  double total = 0;
+  for (int done = 0; !errors && (done < RECORDS_NUM); done += RECORDS_BATCH) {
+    for (int i = 0; i < RECORDS_BATCH; ++i) {
+      if (SSL_write(client, data, payload) != payload) {
+        errors = 1;
+        break;
+      }
+      lens[i] = take_output(client, records + (size_t)i * 2048, 2048);
+    }
+
+    double t0 = now_ns();
+    for (int i = 0; !errors && (i < RECORDS_BATCH); ++i) {
+      errors += (server_read(server, mode, records + (size_t)i * 2048, lens[i], out, (int)sizeof(out)) != payload);
+    }
+    total += now_ns() - t0;
+  }
+
+  *ns_per_record = total / RECORDS_NUM;
+
+  free(lens);
+  free(records);
+  SSL_free(server);
+  SSL_free(client);
+
+  return errors;
+}
+
+int main(int argc, char **argv) {
+  UNUSED_ARG(argc);
+  UNUSED_ARG(argv);
+
+  SSL_CTX *sctx = new_server_ctx();
+  SSL_CTX *cctx = SSL_CTX_new(DTLS_client_method());
+  if (!sctx || !cctx) {
+    fprintf(stderr, "Cannot create the DTLS contexts\n");
+    ERR_print_errors_fp(stderr);
+    return 1;
+  }
+  SSL_CTX_set_verify(cctx, SSL_VERIFY_NONE, NULL);
+
+  static const int payloads[] = {100, 200, 1000, 1400};
+  int errors = 0;
+
+  printf("%6s %14s %14s %10s   (records per second)\n", "bytes", "memory BIO", "DTLS read BIO", "speedup");
+  for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); ++i) {
+    double mem_ns = 0;
+    double bio_ns = 0;
+    errors += run(cctx, sctx, READ_MEM_BIO, payloads[i], &mem_ns);
+    errors += run(cctx, sctx, READ_DTLS_BIO, payloads[i], &bio_ns);
+    printf("%6d %14.0f %14.0f %9.2fx  %s\n", payloads[i], 1e9 / mem_ns, 1e9 / bio_ns, mem_ns / bio_ns,
+           errors ? "FAILED" : "ok");
+  }
+
+  SSL_CTX_free(cctx);
+  SSL_CTX_free(sctx);
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * MESSAGE-INTEGRITY benchmark: signing and checking an authenticated
+ * Allocate request with a one-shot HMAC per message, and with a session
+ * stun_hmac_ctx that keeps the keyed state between the messages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ns_turn_msg.h"
+
+#define MESSAGES_NUM (1000000)
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int run(SHATYPE shatype) {
+  static const uint8_t uname[] = "1700000000:user";
+  static const uint8_t realm[] = "north.gov";
+  static const uint8_t upwd[] = "MbJ3bOsCYpVw9Pz4gEMdiyhUjgI=";
+  static const uint8_t nonce[] = "b0c1a4e2d6f8903b";
+
+  static uint8_t tmpl[STUN_BUFFER_SIZE];
+  static uint8_t buf[STUN_BUFFER_SIZE];
+  size_t tmpl_len = 0;
+  hmackey_t key;
+  password_t pwd;
+  stun_hmac_ctx hc;
+  int errors = 0;
+
+  memset(&hc, 0, sizeof(hc));
+  memset(pwd, 0, sizeof(pwd));
+
+  if (!stun_produce_integrity_key_str(uname, realm, upwd, key, shatype) ||
+      !stun_set_allocate_request_str(tmpl, &tmpl_len, 600, true, false, STUN_ATTRIBUTE_TRANSPORT_UDP_VALUE, false,
+                                     NULL, -1) ||
+      !stun_attr_add_str(tmpl, &tmpl_len, STUN_ATTRIBUTE_USERNAME, uname, (int)strlen((const char *)uname)) ||
+      !stun_attr_add_str(tmpl, &tmpl_len, STUN_ATTRIBUTE_NONCE, nonce, (int)strlen((const char *)nonce)) ||
+      !stun_attr_add_str(tmpl, &tmpl_len, STUN_ATTRIBUTE_REALM, realm, (int)strlen((const char *)realm))) {
+    fprintf(stderr, "Cannot build the request\n");
+    return 1;
+  }
+
+  /* Sign */
+  size_t len = 0;
+  double t0 = now_ns();
+  for (size_t i = 0; i < MESSAGES_NUM; ++i) {
+    memcpy(buf, tmpl, tmpl_len);
+    len = tmpl_len;
+    errors += !stun_attr_add_integrity_str(TURN_CREDENTIALS_LONG_TERM, buf, &len, key, pwd, shatype);
+  }
+  double t1 = now_ns();
+  for (size_t i = 0; i < MESSAGES_NUM; ++i) {
+    memcpy(buf, tmpl, tmpl_len);
+    len = tmpl_len;
+    errors += !stun_attr_add_integrity_ctx_str(TURN_CREDENTIALS_LONG_TERM, buf, &len, key, pwd, shatype, &hc);
+  }
+  double t2 = now_ns();
+
+  /* Check */
+  stun_attr_ref sar = stun_attr_get_first_by_type_str(buf, len, STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+  for (size_t i = 0; i < MESSAGES_NUM; ++i) {
+    errors += (stun_check_message_integrity_by_key_attr_str(TURN_CREDENTIALS_LONG_TERM, buf, len, sar, key, pwd,
+                                                            shatype, NULL) != 1);
+  }
+  double t3 = now_ns();
+  for (size_t i = 0; i < MESSAGES_NUM; ++i) {
+    errors += (stun_check_message_integrity_by_key_attr_str(TURN_CREDENTIALS_LONG_TERM, buf, len, sar, key, pwd,
+                                                            shatype, &hc) != 1);
+  }
+  double t4 = now_ns();
+
+  /* A wrong key must still be detected through the cached context */
+  hmackey_t wrong_key;
+  memcpy(wrong_key, key, sizeof(hmackey_t));
+  wrong_key[0] ^= 1;
+  errors += (stun_check_message_integrity_by_key_attr_str(TURN_CREDENTIALS_LONG_TERM, buf, len, sar, wrong_key, pwd,
+                                                          shatype, &hc) != 0);
+
+  printf("%-8s %6lu %10.1f %10.1f %10.1f %10.1f  %s\n", shatype_name(shatype), (unsigned long)len,
+         (t1 - t0) / MESSAGES_NUM, (t2 - t1) / MESSAGES_NUM, (t3 - t2) / MESSAGES_NUM, (t4 - t3) / MESSAGES_NUM,
+         errors ? "FAILED" : "ok");
+
+  stun_hmac_ctx_clean(&hc);
+
+  return errors;
+}
+
+int main(int argc, char **argv) {
+  UNUSED_ARG(argc);
+  UNUSED_ARG(argv);
+
+  printf("%-8s %6s %10s %10s %10s %10s   (ns per message)\n", "", "bytes", "sign", "sign ctx", "check",
+         "check ctx");
+
+  int errors = run(SHATYPE_SHA1);
+  errors += run(SHATYPE_SHA256);
+
+  return errors ? 1 : 0;
+}
@@ -60,6 +60,10 @@
 #include <unistd.h>
 #endif
 
+#if defined(__linux__)
+#include <linux/filter.h>
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -261,6 +265,87 @@ int sock_bind_to_device(evutil_socket_t fd, const unsigned char *ifname) {
   return 0;
 }
 
+int sock_set_reuseport_steering(evutil_socket_t fd, int group_size, int by_port) {
+
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_NET_OFF)
+
+  if (fd < 0 || group_size < 1) {
+    return -1;
+  }
+
+  /*
+   * Classic BPF program: hash the client address and port (the destination
+   * side is the same for the whole group) and return the index of the
+   * socket in the SO_REUSEPORT group. The sockets are indexed in their
+   * bind order, so the hash selects the thread that has bound that socket.
+   * Without the port, a client keeps its thread when its NAT binding changes.
+   */
+  struct sock_filter ip6_port = BPF_STMT(BPF_LD | BPF_H | BPF_ABS, SKF_NET_OFF + 40);
+  struct sock_filter ip4_port = BPF_STMT(BPF_LD | BPF_H | BPF_IND, SKF_NET_OFF);
+  if (!by_port) {
+    struct sock_filter zero = BPF_STMT(BPF_LD | BPF_IMM, 0);
+    ip6_port = zero;
+    ip4_port = zero;
+  }
+
+  struct sock_filter code[] = {
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF), /* IP version */
+      BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 4),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 6, 0, 14),
+      /* IPv6: source address words and port */
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 8),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 12),
+      BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 16),
+      BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 20),
+      BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      ip6_port,
+      BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+      BPF_STMT(BPF_JMP | BPF_JA, 9),
+      /* IPv4: source address and port, after the variable size IP header */
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_NET_OFF + 12),
+      BPF_STMT(BPF_ST, 0),
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF),
+      BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0x0f),
+      BPF_STMT(BPF_ALU | BPF_LSH | BPF_K, 2),
+      BPF_STMT(BPF_MISC | BPF_TAX, 0),
+      ip4_port,
+      BPF_STMT(BPF_LDX | BPF_MEM, 0),
+      BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+      /* multiplicative hash, modulo the group size */
+      BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 0x9E3779B1),
+      BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+      BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t)group_size),
+      BPF_STMT(BPF_RET | BPF_A, 0),
+  };
+
+  struct sock_fprog prog;
+  prog.len = (unsigned short)(sizeof(code) / sizeof(code[0]));
+  prog.filter = code;
+
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, (const void *)&prog, (socklen_t)sizeof(prog)) < 0) {
+    perror("Cannot attach SO_REUSEPORT steering program");
+    return -1;
+  }
+
+  return 0;
+
+#else
+
+  UNUSED_ARG(fd);
+  UNUSED_ARG(group_size);
+  UNUSED_ARG(by_port);
+
+  return -1;
+
+#endif
+}
+
 int addr_connect(evutil_socket_t fd, const ioa_addr *addr, int *out_errno) {
   if (!addr || fd < 0) {
     return -1;
@@ -1399,6 +1484,143 @@ const char *turn_get_ssl_method(SSL *ssl, const char *mdefault) {
   return ret;
 }
 
+#if DTLS_READ_BIO_SUPPORTED
+
+typedef struct _dtls_read_bio_data {
+  const uint8_t *data;
+  size_t len;
+} dtls_read_bio_data;
+
+typedef struct _dtls_read_bio_class {
+  BIO_METHOD *method;
+  int type;
+} dtls_read_bio_class;
+
+static dtls_read_bio_class *dtls_read_bio_cls = NULL;
+
+static int dtls_read_bio_create(BIO *b) {
+  dtls_read_bio_data *d = (dtls_read_bio_data *)calloc(1, sizeof(dtls_read_bio_data));
+  if (!d) {
+    return 0;
+  }
+  BIO_set_data(b, d);
+  BIO_set_init(b, 1);
+  return 1;
+}
+
+static int dtls_read_bio_destroy(BIO *b) {
+  free(BIO_get_data(b));
+  BIO_set_data(b, NULL);
+  BIO_set_init(b, 0);
+  return 1;
+}
+
+static int dtls_read_bio_read(BIO *b, char *out, int outl) {
+  dtls_read_bio_data *d = (dtls_read_bio_data *)BIO_get_data(b);
+
+  BIO_clear_retry_flags(b);
+  if (!d->len) {
+    BIO_set_retry_read(b);
+    return -1;
+  }
+  if (outl <= 0) {
+    return 0;
+  }
+
+  size_t n = (d->len < (size_t)outl) ? d->len : (size_t)outl;
+  memcpy(out, d->data, n);
+  d->data += n;
+  d->len -= n;
+
+  return (int)n;
+}
+
+static long dtls_read_bio_ctrl(BIO *b, int cmd, long num, void *ptr) {
+  UNUSED_ARG(num);
+  UNUSED_ARG(ptr);
+
+  dtls_read_bio_data *d = (dtls_read_bio_data *)BIO_get_data(b);
+
+  switch (cmd) {
+  case BIO_CTRL_PENDING:
+    return (long)d->len;
+  case BIO_CTRL_EOF:
+    return d->len == 0;
+  case BIO_CTRL_RESET:
+    d->data = NULL;
+    d->len = 0;
+    return 1;
+  case BIO_CTRL_FLUSH:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static const dtls_read_bio_class *get_dtls_read_bio_class(void) {
+  dtls_read_bio_class *cls = __atomic_load_n(&dtls_read_bio_cls, __ATOMIC_ACQUIRE);
+  if (cls) {
+    return cls;
+  }
+
+  int type = BIO_get_new_index();
+  if (type < 0) {
+    return NULL;
+  }
+
+  cls = (dtls_read_bio_class *)malloc(sizeof(dtls_read_bio_class));
+  if (!cls) {
+    return NULL;
+  }
+  cls->type = type | BIO_TYPE_SOURCE_SINK;
+  cls->method = BIO_meth_new(cls->type, "TURN DTLS read");
+  if (!(cls->method)) {
+    free(cls);
+    return NULL;
+  }
+  BIO_meth_set_read(cls->method, dtls_read_bio_read);
+  BIO_meth_set_ctrl(cls->method, dtls_read_bio_ctrl);
+  BIO_meth_set_create(cls->method, dtls_read_bio_create);
+  BIO_meth_set_destroy(cls->method, dtls_read_bio_destroy);
+
+  /* Two threads may race for the first BIO: only one class is kept */
+  dtls_read_bio_class *expected = NULL;
+  if (!__atomic_compare_exchange_n(&dtls_read_bio_cls, &expected, cls, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    BIO_meth_free(cls->method);
+    free(cls);
+    cls = expected;
+  }
+
+  return cls;
+}
+
+BIO *get_dtls_read_bio(SSL *ssl) {
+  const dtls_read_bio_class *cls = get_dtls_read_bio_class();
+  if (!cls) {
+    return NULL;
+  }
+
+  BIO *b = SSL_get_rbio(ssl);
+  if (b && (BIO_method_type(b) == cls->type)) {
+    return b;
+  }
+
+  b = BIO_new(cls->method);
+  if (b) {
+    SSL_set0_rbio(ssl, b);
+  }
+
+  return b;
+}
+
+void dtls_read_bio_set(BIO *b, const void *data, size_t len) {
+  dtls_read_bio_data *d = (dtls_read_bio_data *)BIO_get_data(b);
+  d->data = (const uint8_t *)data;
+  d->len = data ? len : 0;
+}
+
+#endif
+
 //////////// EVENT BASE ///////////////
 
 struct event_base *turn_event_base_new(void) {
@@ -69,6 +69,12 @@ extern int IS_TURN_SERVER;
 #define DTLS_SUPPORTED 1
 #endif
 
+#if TLS_SUPPORTED && defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define KTLS_SUPPORTED 1
+#else
+#define KTLS_SUPPORTED 0
+#endif
+
 #define SSL_SESSION_ECDH_AUTO_SUPPORTED 1
 
 /////////// SSL //////////////////////////
@@ -132,6 +138,8 @@ int set_sock_buf_size(evutil_socket_t fd, int sz);
 int socket_init(void);
 int socket_set_reusable(evutil_socket_t fd, int reusable, SOCKET_TYPE st);
 int sock_bind_to_device(evutil_socket_t fd, const unsigned char *ifname);
+/* Steer the datagrams of the fd SO_REUSEPORT group by the client address (and port, if by_port) hash */
+int sock_set_reuseport_steering(evutil_socket_t fd, int group_size, int by_port);
 int socket_set_nonblocking(evutil_socket_t fd);
 int socket_tcp_set_keepalive(evutil_socket_t fd, SOCKET_TYPE st);
 
@@ -213,6 +221,24 @@ unsigned char *base64_decode(const char *data, size_t input_length, size_t *outp
 
 const char *turn_get_ssl_method(SSL *ssl, const char *mdefault);
 
+#if !defined(LIBRESSL_VERSION_NUMBER) || LIBRESSL_VERSION_NUMBER >= 0x3040000fL
+#define DTLS_READ_BIO_SUPPORTED 1
+#else
+#define DTLS_READ_BIO_SUPPORTED 0
+#endif
+
+#if DTLS_READ_BIO_SUPPORTED
+/*
+ * Read BIO of a DTLS connection, that stays with the SSL and reads the
+ * datagram set with dtls_read_bio_set(), in place of a new memory BIO for
+ * each datagram. When the datagram is consumed, the reads ask for a retry.
+ * Return: the read BIO of the SSL, created if needed, or NULL on failure.
+ */
+BIO *get_dtls_read_bio(SSL *ssl);
+/* The data must stay valid until the next call; NULL clears the BIO */
+void dtls_read_bio_set(BIO *b, const void *data, size_t len);
+#endif
+
 ////////////// OAUTH UTILS ////////////////
 
 void convert_oauth_key_data_raw(const oauth_key_data_raw *raw, oauth_key_data *oakd);
@@ -42,12 +42,17 @@ extern "C" {
 
 ///////////////////////////////////////////////////////////////
 
+/*
+ * The data is the last member, so that a buffer can be allocated with a
+ * smaller capacity; channel[] is the room for the ChannelData header in
+ * front of the data.
+ */
 typedef struct _stun_buffer {
-  uint8_t channel[STUN_CHANNEL_HEADER_LENGTH];
-  uint8_t buf[STUN_BUFFER_SIZE];
   size_t len;
   uint16_t offset;
   uint8_t coffset;
+  uint8_t channel[STUN_CHANNEL_HEADER_LENGTH];
+  uint8_t buf[STUN_BUFFER_SIZE];
 } stun_buffer;
 
 //////////////////////////////////////////////////////////////
@@ -35,6 +35,10 @@
 #if !defined(TURN_NO_PQ)
 #include <libpq-fe.h>
 
+#include <event2/event.h>
+
+#include <poll.h>
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static int donot_print_connection_success = 0;
@@ -982,6 +986,699 @@ static void pgsql_disconnect(void) {
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "PostgreSQL connection was closed.\n");
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Change notifications: the triggers of turndb/schema.notify.pgsql send the
+ * name of the modified table on the turn_changes channel. The connection
+ * that listens to them is only used by the thread that rereads the DB.
+ */
+
+#define PGSQL_NOTIFY_CHANNEL "turn_changes"
+
+static PGconn *pgsql_listen_connection = NULL;
+static PostgresPollingStatusType pgsql_listen_polling = PGRES_POLLING_WRITING;
+static bool pgsql_listen_subscribed = false;
+static bool pgsql_listen_started = false;
+
+static const struct {
+  const char *table;
+  unsigned int changes;
+} pgsql_notify_tables[] = {{"turn_realm_option", DBD_CHANGE_REALMS},
+                           {"turn_origin_to_realm", DBD_CHANGE_REALMS},
+                           {"allowed_peer_ip", DBD_CHANGE_ALLOWED_PEER_IP},
+                           {"denied_peer_ip", DBD_CHANGE_DENIED_PEER_IP},
+                           {"turn_secret", DBD_CHANGE_SECRETS},
+                           {"turnusers_lt", DBD_CHANGE_USERS}};
+
+static unsigned int pgsql_notify_changes(const char *table) {
+  size_t i;
+  for (i = 0; i < sizeof(pgsql_notify_tables) / sizeof(pgsql_notify_tables[0]); ++i) {
+    if (!strcmp(table, pgsql_notify_tables[i].table)) {
+      return pgsql_notify_tables[i].changes;
+    }
+  }
+  return DBD_CHANGE_CONFIG;
+}
+
+static void pgsql_listen_close(void) {
+  PQfinish(pgsql_listen_connection);
+  pgsql_listen_connection = NULL;
+}
+
+/* Whether the listen connection can be polled without blocking */
+static bool pgsql_listen_ready(PostgresPollingStatusType polling) {
+  struct pollfd pfd;
+  pfd.fd = PQsocket(pgsql_listen_connection);
+  pfd.events = (polling == PGRES_POLLING_READING) ? POLLIN : POLLOUT;
+  pfd.revents = 0;
+  return poll(&pfd, 1, 0) > 0;
+}
+
+/*
+ * The listen connection is opened and subscribed step by step, one step
+ * per call, in the same non-blocking way as the connections of the pools.
+ */
+static int pgsql_get_changes(unsigned int *changes) {
+  if (pgsql_listen_connection && (PQstatus(pgsql_listen_connection) == CONNECTION_BAD)) {
+    pgsql_listen_close();
+  }
+
+  if (!pgsql_listen_connection) {
+    persistent_users_db_t *pud = get_persistent_users_db();
+    pgsql_listen_connection = PQconnectStart(pud->userdb);
+    if (!pgsql_listen_connection || (PQstatus(pgsql_listen_connection) == CONNECTION_BAD) ||
+        PQsetnonblocking(pgsql_listen_connection, 1)) {
+      if (pgsql_listen_connection) {
+        pgsql_listen_close();
+      }
+      return -1;
+    }
+    pgsql_listen_polling = PGRES_POLLING_WRITING;
+    pgsql_listen_subscribed = false;
+    return -1;
+  }
+
+  if (PQstatus(pgsql_listen_connection) != CONNECTION_OK) {
+    do {
+      if (!pgsql_listen_ready(pgsql_listen_polling)) {
+        return -1;
+      }
+      pgsql_listen_polling = PQconnectPoll(pgsql_listen_connection);
+    } while ((pgsql_listen_polling == PGRES_POLLING_READING) || (pgsql_listen_polling == PGRES_POLLING_WRITING));
+    if ((pgsql_listen_polling != PGRES_POLLING_OK) ||
+        !PQsendQuery(pgsql_listen_connection, "LISTEN " PGSQL_NOTIFY_CHANNEL)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot listen to PostgreSQL change notifications: %s\n",
+                    PQerrorMessage(pgsql_listen_connection));
+      pgsql_listen_close();
+      return -1;
+    }
+  }
+
+  if ((PQflush(pgsql_listen_connection) < 0) || !PQconsumeInput(pgsql_listen_connection)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "PostgreSQL change notifications lost: %s\n",
+                  PQerrorMessage(pgsql_listen_connection));
+    pgsql_listen_close();
+    return -1;
+  }
+
+  if (!pgsql_listen_subscribed) {
+    for (;;) {
+      if (PQisBusy(pgsql_listen_connection)) {
+        return -1;
+      }
+      PGresult *res = PQgetResult(pgsql_listen_connection);
+      if (!res) {
+        break;
+      }
+      if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot listen to PostgreSQL change notifications: %s\n",
+                      PQerrorMessage(pgsql_listen_connection));
+        PQclear(res);
+        pgsql_listen_close();
+        return -1;
+      }
+      PQclear(res);
+    }
+
+    pgsql_listen_subscribed = true;
+    if (pgsql_listen_started) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "PostgreSQL change notifications resumed\n");
+    }
+    pgsql_listen_started = true;
+    /* The notifications sent before the subscription are lost */
+    *changes |= DBD_CHANGE_ALL;
+  }
+
+  PGnotify *notify = NULL;
+  while ((notify = PQnotifies(pgsql_listen_connection))) {
+    *changes |= pgsql_notify_changes(notify->extra);
+    PQfreemem(notify);
+  }
+
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Asynchronous lookups of the auth threads. Each auth thread has its own
+ * pool of non-blocking connections, driven by the event base of the thread.
+ * A query is pipelined on the least loaded connection, or waits in the
+ * backlog of the pool while all of them are busy or still connecting. A
+ * query that is not answered in time fails along with its connection,
+ * which is reopened for the next queries.
+ */
+
+#if defined(LIBPQ_HAS_PIPELINING)
+#define PGSQL_POOL_PIPELINE_DEPTH (32)
+#else
+#define PGSQL_POOL_PIPELINE_DEPTH (1)
+#endif
+
+/* Seconds between two attempts to open a connection of the pool */
+#define PGSQL_POOL_RECONNECT_DELAY (1)
+
+typedef enum { PGSQL_QUERY_AUTH_SECRETS = 0, PGSQL_QUERY_USER_KEY, PGSQL_QUERY_OAUTH_KEY } pgsql_query_type;
+
+static const char *pgsql_query_names[] = {"auth_secrets", "user_key", "oauth_key"};
+
+static const char *pgsql_query_statements[] = {
+    "select value from turn_secret where realm=$1", "select hmackey from turnusers_lt where name=$1 and realm=$2",
+    "select ikm_key,timestamp,lifetime,as_rs_alg,realm from oauth_key where kid=$1"};
+
+struct _pgsql_pool;
+struct _pgsql_pool_conn;
+
+typedef struct _pgsql_query {
+  struct _pgsql_query *next;
+  struct _pgsql_pool *pool;
+  struct _pgsql_pool_conn *conn; /* NULL while the query is in the backlog */
+  pgsql_query_type type;
+  char *params[2];
+  int nparams;
+  secrets_list_t *sl;
+  uint8_t *key;
+  oauth_key_data_raw *oauth_key;
+  dbd_async_cb cb;
+  void *arg;
+  struct event *timer;
+  struct timeval start;
+  PGresult *res;
+} pgsql_query;
+
+typedef struct _pgsql_pool_conn {
+  struct _pgsql_pool *pool;
+  PGconn *pqc;
+  int connected;
+  struct event *ev;  /* the connection handshake, then the answers */
+  struct event *wev; /* pending output */
+  struct event *connect_timer; /* the connection handshake deadline */
+  pgsql_query *head; /* sent queries, in the order of their answers */
+  pgsql_query *tail;
+  size_t inflight;
+  turn_time_t next_attempt;
+} pgsql_pool_conn;
+
+typedef struct _pgsql_pool {
+  struct event_base *base;
+  pgsql_pool_conn *conns;
+  size_t size;
+  pgsql_query *backlog_head;
+  pgsql_query *backlog_tail;
+} pgsql_pool;
+
+static pthread_key_t pgsql_pool_key;
+static pthread_once_t pgsql_pool_key_once = PTHREAD_ONCE_INIT;
+
+static void make_pgsql_pool_key(void) { (void)pthread_key_create(&pgsql_pool_key, NULL); }
+
+static void pgsql_pool_dispatch(pgsql_pool *pool);
+
+static pgsql_pool *get_pgsql_pool(struct event_base *base) {
+  (void)pthread_once(&pgsql_pool_key_once, make_pgsql_pool_key);
+
+  pgsql_pool *pool = (pgsql_pool *)pthread_getspecific(pgsql_pool_key);
+  if (!pool && base && (turn_params.db_pool_size > 0)) {
+    pool = (pgsql_pool *)calloc(1, sizeof(pgsql_pool));
+    if (!pool) {
+      return NULL;
+    }
+    pool->conns = (pgsql_pool_conn *)calloc((size_t)turn_params.db_pool_size, sizeof(pgsql_pool_conn));
+    if (!(pool->conns)) {
+      free(pool);
+      return NULL;
+    }
+    pool->base = base;
+    pool->size = (size_t)turn_params.db_pool_size;
+    size_t i;
+    for (i = 0; i < pool->size; ++i) {
+      pool->conns[i].pool = pool;
+    }
+    (void)pthread_setspecific(pgsql_pool_key, pool);
+  }
+
+  return (pool && (pool->base == base)) ? pool : NULL;
+}
+
+static void pgsql_query_finish(pgsql_query *q, bool timed_out) {
+  int ret = -1;
+  PGresult *res = q->res;
+
+  dbd_report_query(pgsql_query_names[q->type], &(q->start), timed_out);
+
+  if (res && (PQresultStatus(res) == PGRES_TUPLES_OK)) {
+    switch (q->type) {
+    case PGSQL_QUERY_AUTH_SECRETS: {
+      int i = 0;
+      for (i = 0; i < PQntuples(res); i++) {
+        char *kval = PQgetvalue(res, i, 0);
+        if (kval) {
+          add_to_secrets_list(q->sl, kval);
+        }
+      }
+      ret = 0;
+    } break;
+    case PGSQL_QUERY_USER_KEY:
+      if (PQntuples(res) != 1) {
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error retrieving PostgreSQL DB information: %d keys of user %s\n",
+                      PQntuples(res), q->params[0]);
+      } else {
+        char *kval = PQgetvalue(res, 0, 0);
+        int len = PQgetlength(res, 0, 0);
+        size_t sz = get_hmackey_size(SHATYPE_DEFAULT);
+        if (!kval || ((size_t)len < sz * 2) || (strlen(kval) < sz * 2)) {
+          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong key format: %s, user %s\n", kval ? kval : "NULL", q->params[0]);
+        } else {
+          convert_string_key_to_binary(kval, q->key, sz);
+          ret = 0;
+        }
+      }
+      break;
+    case PGSQL_QUERY_OAUTH_KEY:
+      if (PQntuples(res) != 1) {
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error retrieving PostgreSQL DB information: %d oAuth keys %s\n",
+                      PQntuples(res), q->params[0]);
+      } else {
+        oauth_key_data_raw *key = q->oauth_key;
+        STRCPY(key->ikm_key, PQgetvalue(res, 0, 0));
+        key->timestamp = (uint64_t)strtoll(PQgetvalue(res, 0, 1), NULL, 10);
+        key->lifetime = (uint32_t)strtol(PQgetvalue(res, 0, 2), NULL, 10);
+        STRCPY(key->as_rs_alg, PQgetvalue(res, 0, 3));
+        STRCPY(key->realm, PQgetvalue(res, 0, 4));
+        STRCPY(key->kid, q->params[0]);
+        ret = 0;
+      }
+      break;
+    default:;
+    }
+  } else if (res) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error retrieving PostgreSQL DB information: %s\n",
+                  PQresultErrorMessage(res));
+  }
+
+  if (res) {
+    PQclear(res);
+  }
+  if (q->timer) {
+    event_free(q->timer);
+  }
+
+  q->cb(ret, q->arg);
+
+  free(q->params[0]);
+  free(q->params[1]);
+  free(q);
+}
+
+static pgsql_query *pgsql_pool_conn_pop(pgsql_pool_conn *c) {
+  pgsql_query *q = c->head;
+  if (q) {
+    c->head = q->next;
+    if (!(c->head)) {
+      c->tail = NULL;
+    }
+    --(c->inflight);
+    q->next = NULL;
+    q->conn = NULL;
+  }
+  return q;
+}
+
+/* Close the connection and fail its queries; timed_out is the query that was not answered in time, if any */
+static void pgsql_pool_conn_close(pgsql_pool_conn *c, pgsql_query *timed_out) {
+  if (c->connect_timer) {
+    event_free(c->connect_timer);
+    c->connect_timer = NULL;
+  }
+  if (c->ev) {
+    event_free(c->ev);
+    c->ev = NULL;
+  }
+  if (c->wev) {
+    event_free(c->wev);
+    c->wev = NULL;
+  }
+  if (c->pqc) {
+    PQfinish(c->pqc);
+    c->pqc = NULL;
+  }
+  c->connected = 0;
+
+  pgsql_query *q = NULL;
+  while ((q = pgsql_pool_conn_pop(c))) {
+    pgsql_query_finish(q, q == timed_out);
+  }
+
+  pgsql_pool_dispatch(c->pool);
+}
+
+static void pgsql_pool_conn_flush(pgsql_pool_conn *c) {
+  int r = PQflush(c->pqc);
+  if (r < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot send PostgreSQL DB query: %s\n", PQerrorMessage(c->pqc));
+    pgsql_pool_conn_close(c, NULL);
+  } else if (r > 0) {
+    event_add(c->wev, NULL);
+  }
+}
+
+static void pgsql_pool_conn_send(pgsql_pool_conn *c, pgsql_query *q) {
+  if (!PQsendQueryParams(c->pqc, pgsql_query_statements[q->type], q->nparams, NULL, (const char *const *)q->params,
+                         NULL, NULL, 0)
+#if defined(LIBPQ_HAS_PIPELINING)
+      || !PQpipelineSync(c->pqc)
+#endif
+  ) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot send PostgreSQL DB query: %s\n", PQerrorMessage(c->pqc));
+    pgsql_query_finish(q, false);
+    pgsql_pool_conn_close(c, NULL);
+    return;
+  }
+
+  q->conn = c;
+  if (c->tail) {
+    c->tail->next = q;
+  } else {
+    c->head = q;
+  }
+  c->tail = q;
+  ++(c->inflight);
+
+  pgsql_pool_conn_flush(c);
+}
+
+static void pgsql_pool_conn_write(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+  pgsql_pool_conn_flush((pgsql_pool_conn *)arg);
+}
+
+static void pgsql_pool_conn_read(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  pgsql_pool_conn *c = (pgsql_pool_conn *)arg;
+
+  if (!PQconsumeInput(c->pqc)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "PostgreSQL DB connection error: %s\n", PQerrorMessage(c->pqc));
+    pgsql_pool_conn_close(c, NULL);
+    return;
+  }
+
+  int last_null = 0;
+  while (c->pqc && !PQisBusy(c->pqc)) {
+    PGresult *res = PQgetResult(c->pqc);
+    if (!res) {
+#if defined(LIBPQ_HAS_PIPELINING)
+      /* the end of the results of a query, which is complete with its sync point */
+      if (!(c->head) || last_null) {
+        break;
+      }
+      last_null = 1;
+#else
+      pgsql_query *q = pgsql_pool_conn_pop(c);
+      if (!q) {
+        break;
+      }
+      pgsql_query_finish(q, false);
+#endif
+      continue;
+    }
+    last_null = 0;
+#if defined(LIBPQ_HAS_PIPELINING)
+    if (PQresultStatus(res) == PGRES_PIPELINE_SYNC) {
+      PQclear(res);
+      pgsql_query *q = pgsql_pool_conn_pop(c);
+      if (q) {
+        pgsql_query_finish(q, false);
+      }
+      continue;
+    }
+#endif
+    if (c->head && !(c->head->res)) {
+      c->head->res = res;
+    } else {
+      PQclear(res);
+    }
+  }
+
+  if (c->pqc) {
+    pgsql_pool_conn_flush(c);
+    pgsql_pool_dispatch(c->pool);
+  }
+}
+
+static void pgsql_pool_conn_connecting(evutil_socket_t fd, short what, void *arg);
+
+static void pgsql_pool_conn_wait(pgsql_pool_conn *c, short what, event_callback_fn fn) {
+  if (c->ev) {
+    event_free(c->ev);
+  }
+  c->ev = event_new(c->pool->base, PQsocket(c->pqc), what, fn, c);
+  event_add(c->ev, NULL);
+}
+
+static void pgsql_pool_conn_connecting(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  pgsql_pool_conn *c = (pgsql_pool_conn *)arg;
+
+  switch (PQconnectPoll(c->pqc)) {
+  case PGRES_POLLING_READING:
+    pgsql_pool_conn_wait(c, EV_READ, pgsql_pool_conn_connecting);
+    break;
+  case PGRES_POLLING_WRITING:
+    pgsql_pool_conn_wait(c, EV_WRITE, pgsql_pool_conn_connecting);
+    break;
+  case PGRES_POLLING_OK:
+#if defined(LIBPQ_HAS_PIPELINING)
+    if (!PQenterPipelineMode(c->pqc)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot enter PostgreSQL pipeline mode: %s\n", PQerrorMessage(c->pqc));
+      pgsql_pool_conn_close(c, NULL);
+      break;
+    }
+#endif
+    c->connected = 1;
+    if (c->connect_timer) {
+      event_free(c->connect_timer);
+      c->connect_timer = NULL;
+    }
+    pgsql_pool_conn_wait(c, EV_READ | EV_PERSIST, pgsql_pool_conn_read);
+    c->wev = event_new(c->pool->base, PQsocket(c->pqc), EV_WRITE, pgsql_pool_conn_write, c);
+    pgsql_pool_dispatch(c->pool);
+    break;
+  default:
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot open PostgreSQL DB connection: <%s>, %s",
+                  get_persistent_users_db()->userdb_sanitized, PQerrorMessage(c->pqc));
+    pgsql_pool_conn_close(c, NULL);
+  }
+}
+
+/* libpq does not apply connect_timeout to a non-blocking connection: an unreachable host would hold the pool */
+static void pgsql_pool_conn_connect_timeout(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  pgsql_pool_conn *c = (pgsql_pool_conn *)arg;
+
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot open PostgreSQL DB connection: <%s>, timed out\n",
+                get_persistent_users_db()->userdb_sanitized);
+
+  c->next_attempt = turn_time() + PGSQL_POOL_RECONNECT_DELAY;
+  pgsql_pool_conn_close(c, NULL);
+}
+
+static int pgsql_pool_conn_open(pgsql_pool_conn *c) {
+  c->next_attempt = turn_time() + PGSQL_POOL_RECONNECT_DELAY;
+
+  persistent_users_db_t *pud = get_persistent_users_db();
+  c->pqc = PQconnectStart(pud->userdb);
+  if (!(c->pqc) || (PQstatus(c->pqc) == CONNECTION_BAD) || PQsetnonblocking(c->pqc, 1)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot open PostgreSQL DB connection: <%s>, runtime error\n",
+                  pud->userdb_sanitized);
+    if (c->pqc) {
+      PQfinish(c->pqc);
+      c->pqc = NULL;
+    }
+    return -1;
+  }
+
+  c->connect_timer = evtimer_new(c->pool->base, pgsql_pool_conn_connect_timeout, c);
+  if (c->connect_timer) {
+    struct timeval tv = {turn_params.db_query_timeout, 0};
+    evtimer_add(c->connect_timer, &tv);
+  }
+
+  pgsql_pool_conn_wait(c, EV_WRITE, pgsql_pool_conn_connecting);
+  return 0;
+}
+
+static void pgsql_pool_dispatch(pgsql_pool *pool) {
+  while (pool->backlog_head) {
+    pgsql_pool_conn *c = NULL;
+    size_t i;
+    for (i = 0; i < pool->size; ++i) {
+      pgsql_pool_conn *cc = &(pool->conns[i]);
+      if (cc->connected && (cc->inflight < PGSQL_POOL_PIPELINE_DEPTH) && (!c || (cc->inflight < c->inflight))) {
+        c = cc;
+      }
+    }
+    if (!c) {
+      break;
+    }
+    pgsql_query *q = pool->backlog_head;
+    pool->backlog_head = q->next;
+    if (!(pool->backlog_head)) {
+      pool->backlog_tail = NULL;
+    }
+    q->next = NULL;
+    pgsql_pool_conn_send(c, q);
+  }
+
+  if (!(pool->backlog_head)) {
+    return;
+  }
+
+  /* every open connection is busy: open one more, one at a time */
+  size_t i;
+  int connected = 0;
+  for (i = 0; i < pool->size; ++i) {
+    pgsql_pool_conn *c = &(pool->conns[i]);
+    if (c->pqc && !(c->connected)) {
+      return;
+    }
+    connected |= c->connected;
+  }
+  for (i = 0; i < pool->size; ++i) {
+    pgsql_pool_conn *c = &(pool->conns[i]);
+    if (!(c->pqc) && !turn_time_before(turn_time(), c->next_attempt) && (pgsql_pool_conn_open(c) >= 0)) {
+      return;
+    }
+  }
+
+  if (!connected) {
+    /* no way to reach the database for now */
+    pgsql_query *q = NULL;
+    while ((q = pool->backlog_head)) {
+      pool->backlog_head = q->next;
+      if (!(pool->backlog_head)) {
+        pool->backlog_tail = NULL;
+      }
+      pgsql_query_finish(q, false);
+    }
+  }
+}
+
+static void pgsql_query_timeout(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  pgsql_query *q = (pgsql_query *)arg;
+
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "PostgreSQL DB query %s timed out\n", pgsql_query_names[q->type]);
+
+  if (q->conn) {
+    /* the queries behind it on the connection would wait as long */
+    pgsql_pool_conn_close(q->conn, q);
+    return;
+  }
+
+  pgsql_pool *pool = q->pool;
+  pgsql_query *prev = NULL;
+  pgsql_query *cur = pool->backlog_head;
+  while (cur && (cur != q)) {
+    prev = cur;
+    cur = cur->next;
+  }
+  if (cur) {
+    if (prev) {
+      prev->next = q->next;
+    } else {
+      pool->backlog_head = q->next;
+    }
+    if (pool->backlog_tail == q) {
+      pool->backlog_tail = prev;
+    }
+  }
+  pgsql_query_finish(q, true);
+}
+
+static int pgsql_query_submit(struct event_base *base, pgsql_query *q) {
+  pgsql_pool *pool = get_pgsql_pool(base);
+  if (!pool) {
+    free(q->params[0]);
+    free(q->params[1]);
+    free(q);
+    return -1;
+  }
+
+  q->pool = pool;
+  gettimeofday(&(q->start), NULL);
+
+  q->timer = evtimer_new(base, pgsql_query_timeout, q);
+  struct timeval tv = {turn_params.db_query_timeout, 0};
+  evtimer_add(q->timer, &tv);
+
+  if (pool->backlog_tail) {
+    pool->backlog_tail->next = q;
+  } else {
+    pool->backlog_head = q;
+  }
+  pool->backlog_tail = q;
+
+  pgsql_pool_dispatch(pool);
+
+  return 0;
+}
+
+static int pgsql_get_auth_secrets_async(struct event_base *base, secrets_list_t *sl, uint8_t *realm, dbd_async_cb cb,
+                                        void *arg) {
+  pgsql_query *q = (pgsql_query *)calloc(1, sizeof(pgsql_query));
+  if (!q) {
+    return -1;
+  }
+  q->type = PGSQL_QUERY_AUTH_SECRETS;
+  q->params[0] = strdup((char *)realm);
+  q->nparams = 1;
+  q->sl = sl;
+  q->cb = cb;
+  q->arg = arg;
+  return pgsql_query_submit(base, q);
+}
+
+static int pgsql_get_user_key_async(struct event_base *base, uint8_t *usname, uint8_t *realm, hmackey_t key,
+                                    dbd_async_cb cb, void *arg) {
+  pgsql_query *q = (pgsql_query *)calloc(1, sizeof(pgsql_query));
+  if (!q) {
+    return -1;
+  }
+  q->type = PGSQL_QUERY_USER_KEY;
+  q->params[0] = strdup((char *)usname);
+  q->params[1] = strdup((char *)realm);
+  q->nparams = 2;
+  q->key = key;
+  q->cb = cb;
+  q->arg = arg;
+  return pgsql_query_submit(base, q);
+}
+
+static int pgsql_get_oauth_key_async(struct event_base *base, const uint8_t *kid, oauth_key_data_raw *key,
+                                     dbd_async_cb cb, void *arg) {
+  pgsql_query *q = (pgsql_query *)calloc(1, sizeof(pgsql_query));
+  if (!q) {
+    return -1;
+  }
+  q->type = PGSQL_QUERY_OAUTH_KEY;
+  q->params[0] = strdup((const char *)kid);
+  q->nparams = 1;
+  q->oauth_key = key;
+  q->cb = cb;
+  q->arg = arg;
+  return pgsql_query_submit(base, q);
+}
+
 /////////////////////////////////////////////////////////////
 
 static const turn_dbdriver_t driver = {
@@ -991,7 +1688,8 @@ static const turn_dbdriver_t driver = {
     &pgsql_list_realm_options, &pgsql_auth_ping,      &pgsql_get_ip_list,    &pgsql_set_permission_ip,
     &pgsql_reread_realms,      &pgsql_set_oauth_key,  &pgsql_get_oauth_key,  &pgsql_del_oauth_key,
     &pgsql_list_oauth_keys,    &pgsql_get_admin_user, &pgsql_set_admin_user, &pgsql_del_admin_user,
-    &pgsql_list_admin_users,   &pgsql_disconnect};
+    &pgsql_list_admin_users,   &pgsql_disconnect,     &pgsql_get_auth_secrets_async,
+    &pgsql_get_user_key_async, &pgsql_get_oauth_key_async, &pgsql_get_changes};
 
 const turn_dbdriver_t *get_pgsql_dbdriver(void) { return &driver; }
 
@@ -435,28 +435,83 @@ static int set_redis_realm_opt(char *realm, const char *key, unsigned long *valu
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static int redis_reply_auth_secrets(redisReply *reply, secrets_list_t *sl) {
+  if (reply->type == REDIS_REPLY_ERROR) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error: %s\n", reply->str);
+  } else if (reply->type != REDIS_REPLY_ARRAY) {
+    if (reply->type != REDIS_REPLY_NIL) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Unexpected type: %d\n", reply->type);
+    }
+  } else {
+    size_t i;
+    for (i = 0; i < reply->elements; ++i) {
+      add_to_secrets_list(sl, reply->element[i]->str);
+    }
+  }
+  return 0;
+}
+
+static int redis_reply_user_key(redisReply *rget, const uint8_t *usname, hmackey_t key) {
+  int ret = -1;
+  if (rget->type == REDIS_REPLY_ERROR) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error: %s\n", rget->str);
+  } else if (rget->type != REDIS_REPLY_STRING) {
+    if (rget->type != REDIS_REPLY_NIL) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Unexpected type: %d\n", rget->type);
+    }
+  } else {
+    size_t sz = get_hmackey_size(SHATYPE_DEFAULT);
+    if (strlen(rget->str) < sz * 2) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong key format: %s, user %s\n", rget->str, usname);
+    } else {
+      convert_string_key_to_binary(rget->str, key, sz);
+      ret = 0;
+    }
+  }
+  return ret;
+}
+
+static int redis_reply_oauth_key(redisReply *reply, const uint8_t *kid, oauth_key_data_raw *key) {
+  int ret = -1;
+  memset(key, 0, sizeof(oauth_key_data_raw));
+  STRCPY(key->kid, kid);
+  if (reply->type == REDIS_REPLY_ERROR) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error: %s\n", reply->str);
+  } else if (reply->type != REDIS_REPLY_ARRAY) {
+    if (reply->type != REDIS_REPLY_NIL) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Unexpected type: %d\n", reply->type);
+    }
+  } else if (reply->elements > 1) {
+    size_t i;
+    for (i = 0; i < (reply->elements) / 2; ++i) {
+      char *kw = reply->element[2 * i]->str;
+      char *val = reply->element[2 * i + 1]->str;
+      if (kw) {
+        if (!strcmp(kw, "as_rs_alg")) {
+          STRCPY(key->as_rs_alg, val);
+        } else if (!strcmp(kw, "realm")) {
+          STRCPY(key->realm, val);
+        } else if (!strcmp(kw, "ikm_key")) {
+          STRCPY(key->ikm_key, val);
+        } else if (!strcmp(kw, "timestamp")) {
+          key->timestamp = (uint64_t)strtoull(val, NULL, 10);
+        } else if (!strcmp(kw, "lifetime")) {
+          key->lifetime = (uint32_t)strtoul(val, NULL, 10);
+        }
+      }
+    }
+    ret = 0;
+  }
+  return ret;
+}
+
 static int redis_get_auth_secrets(secrets_list_t *sl, uint8_t *realm) {
   int ret = -1;
   redisContext *rc = get_redis_connection();
   if (rc) {
     redisReply *reply = (redisReply *)redisCommand(rc, "smembers turn/realm/%s/secret", (char *)realm);
     if (reply) {
-
-      if (reply->type == REDIS_REPLY_ERROR) {
-        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error: %s\n", reply->str);
-      } else if (reply->type != REDIS_REPLY_ARRAY) {
-        if (reply->type != REDIS_REPLY_NIL) {
-          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Unexpected type: %d\n", reply->type);
-        }
-      } else {
-        size_t i;
-        for (i = 0; i < reply->elements; ++i) {
-          add_to_secrets_list(sl, reply->element[i]->str);
-        }
-      }
-
-      ret = 0;
-
+      ret = redis_reply_auth_secrets(reply, sl);
       turnFreeRedisReply(reply);
     }
   }
@@ -471,21 +526,7 @@ static int redis_get_user_key(uint8_t *usname, uint8_t *realm, hmackey_t key) {
     snprintf(s, sizeof(s), "get turn/realm/%s/user/%s/key", (char *)realm, usname);
     redisReply *rget = (redisReply *)redisCommand(rc, s);
     if (rget) {
-      if (rget->type == REDIS_REPLY_ERROR) {
-        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error: %s\n", rget->str);
-      } else if (rget->type != REDIS_REPLY_STRING) {
-        if (rget->type != REDIS_REPLY_NIL) {
-          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Unexpected type: %d\n", rget->type);
-        }
-      } else {
-        size_t sz = get_hmackey_size(SHATYPE_DEFAULT);
-        if (strlen(rget->str) < sz * 2) {
-          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong key format: %s, user %s\n", rget->str, usname);
-        } else {
-          convert_string_key_to_binary(rget->str, key, sz);
-          ret = 0;
-        }
-      }
+      ret = redis_reply_user_key(rget, usname, key);
       turnFreeRedisReply(rget);
     }
   }
@@ -502,33 +543,7 @@ static int redis_get_oauth_key(const uint8_t *kid, oauth_key_data_raw *key) {
     snprintf(s, sizeof(s), "hgetall turn/oauth/kid/%s", (const char *)kid);
     redisReply *reply = (redisReply *)redisCommand(rc, s);
     if (reply) {
-      if (reply->type == REDIS_REPLY_ERROR) {
-        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error: %s\n", reply->str);
-      } else if (reply->type != REDIS_REPLY_ARRAY) {
-        if (reply->type != REDIS_REPLY_NIL) {
-          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Unexpected type: %d\n", reply->type);
-        }
-      } else if (reply->elements > 1) {
-        size_t i;
-        for (i = 0; i < (reply->elements) / 2; ++i) {
-          char *kw = reply->element[2 * i]->str;
-          char *val = reply->element[2 * i + 1]->str;
-          if (kw) {
-            if (!strcmp(kw, "as_rs_alg")) {
-              STRCPY(key->as_rs_alg, val);
-            } else if (!strcmp(kw, "realm")) {
-              STRCPY(key->realm, val);
-            } else if (!strcmp(kw, "ikm_key")) {
-              STRCPY(key->ikm_key, val);
-            } else if (!strcmp(kw, "timestamp")) {
-              key->timestamp = (uint64_t)strtoull(val, NULL, 10);
-            } else if (!strcmp(kw, "lifetime")) {
-              key->lifetime = (uint32_t)strtoul(val, NULL, 10);
-            }
-          }
-        }
-        ret = 0;
-      }
+      ret = redis_reply_oauth_key(reply, kid, key);
       turnFreeRedisReply(reply);
     }
   }
@@ -1413,6 +1428,248 @@ static void redis_disconnect(void) {
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "Redis connection was closed.\n");
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Asynchronous lookups of the auth threads. Each auth thread has its own
+ * pool of connections, driven by the event base of the thread: a query is
+ * pipelined on the least loaded one. A query that is not answered in time
+ * fails, and its connection is reopened, failing the queries behind it.
+ */
+
+/* Seconds between two attempts to open a connection of the pool */
+#define REDIS_POOL_RECONNECT_DELAY (1)
+
+typedef enum { REDIS_QUERY_AUTH_SECRETS = 0, REDIS_QUERY_USER_KEY, REDIS_QUERY_OAUTH_KEY } redis_query_type;
+
+static const char *redis_query_names[] = {"auth_secrets", "user_key", "oauth_key"};
+
+typedef struct _redis_pool_conn {
+  redis_context_handle rch;
+  size_t inflight;
+  turn_time_t next_attempt;
+} redis_pool_conn;
+
+typedef struct _redis_pool {
+  struct event_base *base;
+  redis_pool_conn *conns;
+  size_t size;
+} redis_pool;
+
+typedef struct _redis_query {
+  redis_pool *pool;
+  redis_pool_conn *conn;
+  redis_query_type type;
+  uint8_t name[STUN_MAX_USERNAME_SIZE + 1]; /* user name or kid */
+  secrets_list_t *sl;
+  uint8_t *key;
+  oauth_key_data_raw *oauth_key;
+  dbd_async_cb cb; /* NULL once the query has been answered, while its reply is still due */
+  void *arg;
+  struct event *timer;
+  struct timeval start;
+} redis_query;
+
+static pthread_key_t redis_pool_key;
+static pthread_once_t redis_pool_key_once = PTHREAD_ONCE_INIT;
+
+static void make_redis_pool_key(void) { (void)pthread_key_create(&redis_pool_key, NULL); }
+
+static redis_pool *get_redis_pool(struct event_base *base) {
+  (void)pthread_once(&redis_pool_key_once, make_redis_pool_key);
+
+  redis_pool *pool = (redis_pool *)pthread_getspecific(redis_pool_key);
+  if (!pool && base && (turn_params.db_pool_size > 0)) {
+    pool = (redis_pool *)calloc(1, sizeof(redis_pool));
+    if (!pool) {
+      return NULL;
+    }
+    pool->conns = (redis_pool_conn *)calloc((size_t)turn_params.db_pool_size, sizeof(redis_pool_conn));
+    if (!(pool->conns)) {
+      free(pool);
+      return NULL;
+    }
+    pool->base = base;
+    pool->size = (size_t)turn_params.db_pool_size;
+    (void)pthread_setspecific(redis_pool_key, pool);
+  }
+
+  return (pool && (pool->base == base)) ? pool : NULL;
+}
+
+static int redis_pool_conn_open(redis_pool *pool, redis_pool_conn *c) {
+  c->next_attempt = turn_time() + REDIS_POOL_RECONNECT_DELAY;
+
+  persistent_users_db_t *pud = get_persistent_users_db();
+  char *errmsg = NULL;
+  Ryconninfo *co = RyconninfoParse(pud->userdb, &errmsg);
+  if (errmsg) {
+    free(errmsg);
+  }
+  if (co) {
+    c->rch = redisLibeventAttach(pool->base, co->host, (int)(co->port), co->user, co->password, atoi(co->dbname));
+    RyconninfoFree(co);
+  }
+
+  if (!(c->rch)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot open Redis DB async connection: <%s>\n", pud->userdb_sanitized);
+    return -1;
+  }
+  return 0;
+}
+
+/* The least loaded connection, or one more while all of them are busy */
+static redis_pool_conn *redis_pool_conn_pick(redis_pool *pool) {
+  redis_pool_conn *c = NULL;
+  size_t i;
+  for (i = 0; i < pool->size; ++i) {
+    redis_pool_conn *cc = &(pool->conns[i]);
+    if (cc->rch && (!c || (cc->inflight < c->inflight))) {
+      c = cc;
+    }
+  }
+  if (c && !(c->inflight)) {
+    return c;
+  }
+  for (i = 0; i < pool->size; ++i) {
+    redis_pool_conn *cc = &(pool->conns[i]);
+    if (!(cc->rch) && !turn_time_before(turn_time(), cc->next_attempt) && (redis_pool_conn_open(pool, cc) >= 0)) {
+      return cc;
+    }
+  }
+  return c;
+}
+
+static void redis_query_answer(redis_query *q, int ret, bool timed_out) {
+  dbd_report_query(redis_query_names[q->type], &(q->start), timed_out);
+
+  if (q->timer) {
+    event_free(q->timer);
+    q->timer = NULL;
+  }
+
+  dbd_async_cb cb = q->cb;
+  q->cb = NULL;
+  cb(ret, q->arg);
+}
+
+static void redis_query_reply(struct redisAsyncContext *ac, void *r, void *arg) {
+  UNUSED_ARG(ac);
+
+  redis_query *q = (redis_query *)arg;
+  redisReply *reply = (redisReply *)r;
+
+  --(q->conn->inflight);
+
+  if (q->cb) {
+    int ret = -1;
+    if (reply) {
+      switch (q->type) {
+      case REDIS_QUERY_AUTH_SECRETS:
+        ret = redis_reply_auth_secrets(reply, q->sl);
+        break;
+      case REDIS_QUERY_USER_KEY:
+        ret = redis_reply_user_key(reply, q->name, q->key);
+        break;
+      case REDIS_QUERY_OAUTH_KEY:
+        ret = redis_reply_oauth_key(reply, q->name, q->oauth_key);
+        break;
+      default:;
+      }
+    }
+    redis_query_answer(q, ret, false);
+  }
+
+  free(q);
+}
+
+static void redis_query_timeout(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  redis_query *q = (redis_query *)arg;
+  redis_context_handle rch = q->conn->rch;
+
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "Redis DB query %s timed out\n", redis_query_names[q->type]);
+
+  redis_query_answer(q, -1, true);
+
+  /* the queries behind it on the connection would wait as long; the query itself goes with its reply */
+  reset_redis_connection(rch);
+}
+
+static redis_query *redis_query_new(struct event_base *base, redis_query_type type, const uint8_t *name,
+                                    dbd_async_cb cb, void *arg) {
+  redis_pool *pool = get_redis_pool(base);
+  if (!pool) {
+    return NULL;
+  }
+  redis_pool_conn *c = redis_pool_conn_pick(pool);
+  if (!c) {
+    return NULL;
+  }
+  redis_query *q = (redis_query *)calloc(1, sizeof(redis_query));
+  if (!q) {
+    return NULL;
+  }
+  q->pool = pool;
+  q->conn = c;
+  q->type = type;
+  if (name) {
+    STRCPY(q->name, name);
+  }
+  q->cb = cb;
+  q->arg = arg;
+  gettimeofday(&(q->start), NULL);
+  return q;
+}
+
+/* Arm the deadline of a query, once its command has been queued on the connection */
+static int redis_query_sent(redis_query *q, int sent) {
+  if (sent < 0) {
+    free(q);
+    return -1;
+  }
+  ++(q->conn->inflight);
+  q->timer = evtimer_new(q->pool->base, redis_query_timeout, q);
+  struct timeval tv = {turn_params.db_query_timeout, 0};
+  evtimer_add(q->timer, &tv);
+  return 0;
+}
+
+static int redis_get_auth_secrets_async(struct event_base *base, secrets_list_t *sl, uint8_t *realm, dbd_async_cb cb,
+                                        void *arg) {
+  redis_query *q = redis_query_new(base, REDIS_QUERY_AUTH_SECRETS, NULL, cb, arg);
+  if (!q) {
+    return -1;
+  }
+  q->sl = sl;
+  return redis_query_sent(
+      q, send_command_to_redis(q->conn->rch, redis_query_reply, q, "smembers turn/realm/%s/secret", (char *)realm));
+}
+
+static int redis_get_user_key_async(struct event_base *base, uint8_t *usname, uint8_t *realm, hmackey_t key,
+                                    dbd_async_cb cb, void *arg) {
+  redis_query *q = redis_query_new(base, REDIS_QUERY_USER_KEY, usname, cb, arg);
+  if (!q) {
+    return -1;
+  }
+  q->key = key;
+  return redis_query_sent(q, send_command_to_redis(q->conn->rch, redis_query_reply, q,
+                                                   "get turn/realm/%s/user/%s/key", (char *)realm, (char *)usname));
+}
+
+static int redis_get_oauth_key_async(struct event_base *base, const uint8_t *kid, oauth_key_data_raw *key,
+                                     dbd_async_cb cb, void *arg) {
+  redis_query *q = redis_query_new(base, REDIS_QUERY_OAUTH_KEY, kid, cb, arg);
+  if (!q) {
+    return -1;
+  }
+  q->oauth_key = key;
+  return redis_query_sent(
+      q, send_command_to_redis(q->conn->rch, redis_query_reply, q, "hgetall turn/oauth/kid/%s", (const char *)kid));
+}
+
 //////////////////////////////////////////////////////
 
 static const turn_dbdriver_t driver = {
@@ -1422,7 +1679,8 @@ static const turn_dbdriver_t driver = {
     &redis_list_realm_options, &redis_auth_ping,      &redis_get_ip_list,    &redis_set_permission_ip,
     &redis_reread_realms,      &redis_set_oauth_key,  &redis_get_oauth_key,  &redis_del_oauth_key,
     &redis_list_oauth_keys,    &redis_get_admin_user, &redis_set_admin_user, &redis_del_admin_user,
-    &redis_list_admin_users,   &redis_disconnect};
+    &redis_list_admin_users,   &redis_disconnect,     &redis_get_auth_secrets_async,
+    &redis_get_user_key_async, &redis_get_oauth_key_async, NULL};
 
 const turn_dbdriver_t *get_redis_dbdriver(void) { return &driver; }
 
@@ -1362,6 +1362,43 @@ static void sqlite_disconnect(void) {
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "SQLite connection was closed.\n");
 }
 
+/*
+ * SQLite does not tell which tables were modified: the data version of the
+ * connection changes whenever another connection commits to the DB file.
+ */
+static int sqlite_data_version = -1;
+
+static int sqlite_get_changes(unsigned int *changes) {
+  sqlite3 *const sqliteconnection = get_sqlite_connection();
+  if (sqliteconnection == NULL) {
+    return -1;
+  }
+
+  int ret = -1;
+
+  sqlite_lock(0);
+
+  sqlite3_stmt *st = NULL;
+  if (sqlite3_prepare(sqliteconnection, "PRAGMA data_version", -1, &st, 0) == SQLITE_OK) {
+    if (sqlite3_step(st) == SQLITE_ROW) {
+      int version = sqlite3_column_int(st, 0);
+      if ((sqlite_data_version >= 0) && (version != sqlite_data_version)) {
+        *changes |= DBD_CHANGE_ALL;
+      }
+      sqlite_data_version = version;
+      ret = 0;
+    }
+  } else {
+    const char *errmsg = sqlite3_errmsg(sqliteconnection);
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Error retrieving SQLite DB information: %s\n", errmsg);
+  }
+  sqlite3_finalize(st);
+
+  sqlite_unlock(0);
+
+  return ret;
+}
+
 ///////////////////////////////////////////////////////
 
 static const turn_dbdriver_t driver = {
@@ -1371,7 +1408,8 @@ static const turn_dbdriver_t driver = {
     &sqlite_list_realm_options, &sqlite_auth_ping,      &sqlite_get_ip_list,    &sqlite_set_permission_ip,
     &sqlite_reread_realms,      &sqlite_set_oauth_key,  &sqlite_get_oauth_key,  &sqlite_del_oauth_key,
     &sqlite_list_oauth_keys,    &sqlite_get_admin_user, &sqlite_set_admin_user, &sqlite_del_admin_user,
-    &sqlite_list_admin_users,   &sqlite_disconnect};
+    &sqlite_list_admin_users,   &sqlite_disconnect,     NULL,                   NULL,
+    NULL,                       &sqlite_get_changes};
 
 //////////////////////////////////////////////////
 
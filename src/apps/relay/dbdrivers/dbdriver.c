@@ -30,6 +30,7 @@
  */
 
 #include "../mainrelay.h"
+#include "../prom_server.h"
 
 #include "apputils.h"
 
@@ -132,3 +133,10 @@ char *sanitize_userdb_string(char *udb) {
   }
   return ret;
 }
+
+void dbd_report_query(const char *query, const struct timeval *start, bool timed_out) {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  double seconds = (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_usec - start->tv_usec) / 1000000.0;
+  prom_observe_db_query(query, seconds, timed_out);
+}
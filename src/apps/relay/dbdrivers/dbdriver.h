@@ -36,7 +36,11 @@
 
 #include "ns_turn_msg_defs.h"
 
+#include <event2/event.h>
+
 #include <pthread.h>
+#include <stdbool.h>
+#include <sys/time.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,6 +51,23 @@ extern "C" {
 extern pthread_key_t connection_key;
 extern pthread_once_t connection_key_once;
 
+/*
+ * Completion of an asynchronous lookup: ret is 0 on success, when the
+ * output arguments of the lookup have been filled in, and -1 otherwise.
+ */
+typedef void (*dbd_async_cb)(int ret, void *arg);
+
+/* Kinds of DB data reported by get_changes */
+#define DBD_CHANGE_REALMS (1U << 0)
+#define DBD_CHANGE_ALLOWED_PEER_IP (1U << 1)
+#define DBD_CHANGE_DENIED_PEER_IP (1U << 2)
+#define DBD_CHANGE_SECRETS (1U << 3)
+#define DBD_CHANGE_USERS (1U << 4)
+/* Everything that the periodic reread covers */
+#define DBD_CHANGE_CONFIG                                                                                              \
+  (DBD_CHANGE_REALMS | DBD_CHANGE_ALLOWED_PEER_IP | DBD_CHANGE_DENIED_PEER_IP | DBD_CHANGE_SECRETS)
+#define DBD_CHANGE_ALL (DBD_CHANGE_CONFIG | DBD_CHANGE_USERS)
+
 typedef struct _turn_dbdriver_t {
   int (*get_auth_secrets)(secrets_list_t *sl, uint8_t *realm);
   int (*get_user_key)(uint8_t *usname, uint8_t *realm, hmackey_t key);
@@ -75,6 +96,25 @@ typedef struct _turn_dbdriver_t {
   int (*del_admin_user)(const uint8_t *usname);
   int (*list_admin_users)(int no_print);
   void (*disconnect)(void);
+  /*
+   * Asynchronous lookups, optional: called from the thread that runs the
+   * event base, and answered from that event base, with the output
+   * arguments kept valid by the caller until then. Return -1 when the
+   * lookup cannot be started (the callback is not called), and 0 when the
+   * callback will be called, or has been called already.
+   */
+  int (*get_auth_secrets_async)(struct event_base *base, secrets_list_t *sl, uint8_t *realm, dbd_async_cb cb,
+                                void *arg);
+  int (*get_user_key_async)(struct event_base *base, uint8_t *usname, uint8_t *realm, hmackey_t key, dbd_async_cb cb,
+                            void *arg);
+  int (*get_oauth_key_async)(struct event_base *base, const uint8_t *kid, oauth_key_data_raw *key, dbd_async_cb cb,
+                             void *arg);
+  /*
+   * Change tracking, optional: adds to *changes the kinds of data modified
+   * in the DB since the previous call, without blocking. Returns -1 when the
+   * changes cannot be tracked at the moment.
+   */
+  int (*get_changes)(unsigned int *changes);
 } turn_dbdriver_t;
 
 /////////// USER DB CHECK //////////////////
@@ -84,6 +124,9 @@ persistent_users_db_t *get_persistent_users_db(void);
 const turn_dbdriver_t *get_dbdriver(void);
 char *sanitize_userdb_string(char *udb);
 
+/* Record the latency of an asynchronous query started at the given time */
+void dbd_report_query(const char *query, const struct timeval *start, bool timed_out);
+
 ////////////////////////////////////////////
 
 #ifdef __cplusplus
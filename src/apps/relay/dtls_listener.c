@@ -33,6 +33,8 @@
 
 #include "dtls_listener.h"
 #include "ns_ioalib_impl.h"
+#include "ns_ioalib_uring.h"
+#include "prom_server.h"
 
 #include "ns_turn_openssl.h"
 
@@ -58,6 +60,11 @@ typedef uint16_t in_port_t;
 
 #define MAX_SINGLE_UDP_BATCH (16)
 
+/* Searches for the session of a DTLS record from an unknown address, per remote IP address and second */
+#define DTLS_REBIND_SEARCHES_PER_SEC (16)
+/* Sessions of the same IP address that such a record is tried on per search */
+#define DTLS_REBIND_MAX_TRIES (8)
+
 struct dtls_listener_relay_server_info {
   char ifname[1025];
   ioa_addr addr;
@@ -67,9 +74,17 @@ struct dtls_listener_relay_server_info {
   struct event *udp_listen_ev;
   ioa_socket_handle udp_listen_s;
   ur_addr_map *children_ss; /* map of socket children on remote addr */
+  ur_addr_map *children_ip; /* index of DTLS socket children on remote IP, for rebinding */
   struct message_to_relay sm;
   int slen0;
   ioa_engine_new_connection_event_handler connect_cb;
+  int recv_batch;         /* datagrams per recvmmsg() call, 0 - batching is off */
+  ioa_net_data *batch_nd; /* recvmmsg() slots, allocated on first use */
+  int gro;                /* UDP GRO is on: split coalesced datagrams */
+  udp_gro_area *batch_gro; /* recvmmsg() receive areas with GRO, allocated on first use */
+  size_t gro_segsz;        /* the last seen GRO segment size and count */
+  size_t gro_nsegs;
+  uint64_t uring_recv; /* io_uring multishot receive id, 0 - libevent is used */
 };
 
 ///////////// forward declarations ////////
@@ -227,7 +242,7 @@ static ioa_socket_handle dtls_accept_client_connection(dtls_listener_relay_serve
     return NULL;
   }
 
-  int rc = ssl_read(sock->fd, ssl, nbh, server->verbose);
+  int rc = ssl_read(sock->fd, ssl, nbh, server->e->ssl_scratch, server->verbose);
 
   if (rc < 0) {
     return NULL;
@@ -299,6 +314,57 @@ static ioa_socket_handle dtls_server_input_handler(dtls_listener_relay_server_ty
   return rc;
 }
 
+/* Epoch of a DTLS record: 0 before ChangeCipherSpec; -1 - not a DTLS record */
+static int get_dtls_epoch(const unsigned char *buf, int len) {
+  if (is_dtls_message(buf, len) && (len > 4)) {
+    return ((int)buf[3] << 8) | (int)buf[4];
+  }
+  return -1;
+}
+
+/*
+ * A record of an established DTLS session from an address without a client
+ * socket: the NAT binding of the client may have changed its port. Look for
+ * the session among the clients of the same IP address.
+ * Return: the client socket, moved to the new address, with the decrypted
+ * record in nbh; NULL - none.
+ */
+static ioa_socket_handle dtls_find_rebound_client(dtls_listener_relay_server_type *server,
+                                                  ioa_network_buffer_handle nbh, const ioa_addr *remote_addr) {
+  if (!turn_params.dtls_rebind) {
+    return NULL;
+  }
+
+  ioa_socket_ip_bucket *b = get_ip_index_bucket(server->children_ip, remote_addr);
+  if (!b || !(b->head)) {
+    return NULL;
+  }
+
+  turn_time_t now = turn_time();
+  if (now != b->search_time) {
+    b->search_time = now;
+    b->searches = 0;
+  }
+  if (++(b->searches) > DTLS_REBIND_SEARCHES_PER_SEC) {
+    return NULL;
+  }
+
+  /* Resume where the last search stopped, so that all the sessions get their turn */
+  ioa_socket_handle start = b->cursor ? b->cursor : b->head;
+  ioa_socket_handle s = start;
+  int tries = 0;
+  do {
+    ioa_socket_handle next = s->ip_next ? s->ip_next : b->head;
+    if ((s->magic == SOCKET_MAGIC) && dtls_socket_rebind(s, nbh, remote_addr)) {
+      return s;
+    }
+    s = next;
+  } while ((s != start) && (++tries < DTLS_REBIND_MAX_TRIES));
+  b->cursor = s;
+
+  return NULL;
+}
+
 #endif
 
 static int handle_udp_packet(dtls_listener_relay_server_type *server, struct message_to_relay *sm,
@@ -311,18 +377,46 @@ static int handle_udp_packet(dtls_listener_relay_server_type *server, struct mes
     server->children_ss = (ur_addr_map *)allocate_super_memory_engine(server->e, sizeof(ur_addr_map));
     ur_addr_map_init(server->children_ss);
   }
+#if DTLS_SUPPORTED
+  if (!(server->children_ip) && turn_params.dtls_rebind && !turn_params.no_dtls) {
+    server->children_ip = (ur_addr_map *)allocate_super_memory_engine(server->e, sizeof(ur_addr_map));
+    ur_addr_map_init(server->children_ip);
+  }
+#endif
   ur_addr_map *amap = server->children_ss;
 
   ioa_socket_handle chs = NULL;
+  int rebound = 0;
   if ((ur_addr_map_get(amap, &(sm->m.sm.nd.src_addr), &mvt) > 0) && mvt) {
     chs = (ioa_socket_handle)mvt;
   }
 
+#if DTLS_SUPPORTED
+  if (!chs && !turn_params.no_dtls) {
+    ioa_network_buffer_handle nbh = sm->m.sm.nd.nbh;
+    if (get_dtls_epoch(ioa_network_buffer_data(nbh), (int)ioa_network_buffer_get_size(nbh)) > 0) {
+      /* Not a new client: the records after ChangeCipherSpec belong to an established session */
+      chs = dtls_find_rebound_client(server, nbh, &(sm->m.sm.nd.src_addr));
+      if (!chs) {
+        ioa_network_buffer_delete(ioa_eng, nbh);
+        sm->m.sm.nd.nbh = NULL;
+        return 0;
+      }
+      rebound = 1;
+    }
+  }
+#endif
+
   if (chs && !ioa_socket_tobeclosed(chs) && (chs->sockets_container == amap) && (chs->magic == SOCKET_MAGIC)) {
     s = chs;
     sm->m.sm.s = s;
-    if (s->ssl) {
-      int sslret = ssl_read(s->fd, s->ssl, sm->m.sm.nd.nbh, verbose);
+    if (rebound) {
+      /* the record is already read through the SSL */
+    } else if (s->ssl && dtls_handshake_offload(s, sm->m.sm.nd.nbh)) {
+      /* the handshake thread owns the datagram, its reply delivers the data */
+      sm->m.sm.nd.nbh = NULL;
+    } else if (s->ssl) {
+      int sslret = ssl_read(s->fd, s->ssl, sm->m.sm.nd.nbh, ioa_eng->ssl_scratch, verbose);
       if (sslret < 0) {
         ioa_network_buffer_delete(ioa_eng, sm->m.sm.nd.nbh);
         sm->m.sm.nd.nbh = NULL;
@@ -447,6 +541,9 @@ static int handle_udp_packet(dtls_listener_relay_server_type *server, struct mes
       }
       s->e = ioa_eng;
       add_socket_to_map(s, amap);
+      if (s->st == DTLS_SOCKET) {
+        add_socket_to_ip_index(s, server->children_ip);
+      }
       if (open_client_connection_session(ts, &(sm->m.sm)) < 0) {
         return -1;
       }
@@ -550,7 +647,7 @@ static int create_new_connected_udp_socket(dtls_listener_relay_server_type *serv
     );
 
     SSL_set_max_cert_list(connecting_ssl, 655350);
-    int rc = ssl_read(ret->fd, connecting_ssl, server->sm.m.sm.nd.nbh, server->verbose);
+    int rc = ssl_read(ret->fd, connecting_ssl, server->sm.m.sm.nd.nbh, server->e->ssl_scratch, server->verbose);
 
     if (rc < 0) {
       if (!(SSL_get_shutdown(connecting_ssl) & SSL_SENT_SHUTDOWN)) {
@@ -573,10 +670,152 @@ static int create_new_connected_udp_socket(dtls_listener_relay_server_type *serv
   }
 #endif
 
+  if (server->gro && (ret->st != DTLS_SOCKET)) {
+    ret->gro = (set_raw_socket_gro_options(ret->fd, 1) >= 0);
+  }
+
   server->sm.m.sm.s = ret;
   return server->connect_cb(server->e, &(server->sm));
 }
 
+static void udp_server_dispatch_packet(dtls_listener_relay_server_type *server, ioa_socket_handle s) {
+
+  int rc = 0;
+
+  if (server->connect_cb) {
+
+    rc = create_new_connected_udp_socket(server, s);
+    if (rc < 0) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot handle UDP packet, size %d\n",
+                    (int)ioa_network_buffer_get_size(server->sm.m.sm.nd.nbh));
+    }
+
+  } else {
+    server->sm.m.sm.s = s;
+    rc = handle_udp_packet(server, &(server->sm), server->e, server->ts);
+  }
+
+  if (rc < 0) {
+    if (eve(server->e->verbose)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot handle UDP event\n");
+    }
+  }
+}
+
+#if UDP_GRO_SUPPORTED
+/*
+ * Dispatches the segments of the i-th datagram of a GRO batch. The receive
+ * area was scattered over buffers of the last seen segment size, so each
+ * segment usually is in its own buffer already.
+ */
+static void udp_server_dispatch_segments(dtls_listener_relay_server_type *server, const ioa_net_data *nd,
+                                         udp_gro_area *a) {
+
+  size_t nsegs = udp_gro_area_segments(a);
+
+  if (a->seglen) {
+    server->gro_segsz = a->seglen;
+    server->gro_nsegs = nsegs;
+  }
+
+  for (size_t k = 0; k < nsegs; ++k) {
+    ioa_network_buffer_handle nbh = udp_gro_area_take(server->e, a, k);
+    if (!nbh) {
+      break;
+    }
+
+    memcpy(&(server->sm.m.sm.nd), nd, sizeof(ioa_net_data));
+    server->sm.m.sm.nd.nbh = nbh;
+    server->sm.m.sm.can_resume = 1;
+
+    udp_server_dispatch_packet(server, server->udp_listen_s);
+
+    ioa_network_buffer_delete(server->e, server->sm.m.sm.nd.nbh);
+    server->sm.m.sm.nd.nbh = NULL;
+  }
+}
+#endif
+
+/*
+ * Read up to server->recv_batch datagrams with one recvmmsg() call and
+ * dispatch them one by one. The unused buffers stay in the batch slots
+ * for the next call.
+ * Return: number of dispatched datagrams, -1 - error (errno is set).
+ */
+static int udp_server_input_batch(dtls_listener_relay_server_type *server, evutil_socket_t fd) {
+
+  if (!(server->batch_nd)) {
+    server->batch_nd =
+        (ioa_net_data *)allocate_super_memory_engine(server->e, sizeof(ioa_net_data) * MAX_UDP_RECV_BATCH);
+  }
+
+  ioa_net_data *nd = server->batch_nd;
+  udp_gro_area *gro = NULL;
+  int vlen = server->recv_batch;
+  int i = 0;
+
+#if UDP_GRO_SUPPORTED
+  if (server->gro) {
+    if (!(server->batch_gro)) {
+      server->batch_gro =
+          (udp_gro_area *)allocate_super_memory_engine(server->e, sizeof(udp_gro_area) * MAX_UDP_RECV_BATCH);
+    }
+    gro = server->batch_gro;
+  }
+#endif
+
+  for (i = 0; i < vlen; ++i) {
+    addr_set_any(&(nd[i].src_addr));
+#if UDP_GRO_SUPPORTED
+    if (gro) {
+      if (!udp_gro_area_fill(server->e, &(gro[i]), server->gro_segsz, server->gro_nsegs)) {
+        vlen = i;
+        break;
+      }
+      continue;
+    }
+#endif
+    if (!(nd[i].nbh)) {
+      nd[i].nbh = ioa_network_buffer_allocate_size(server->e, NBUF_SMALL_DATAGRAM_SIZE);
+    }
+  }
+
+  if (vlen < 1) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  int n = udp_recvmmsg(server->e, fd, &(server->addr), nd, vlen, gro);
+  if (n <= 0) {
+    return n;
+  }
+
+  prom_inc_udp_recv_batch((unsigned long)n);
+
+  for (i = 0; i < n; ++i) {
+
+#if UDP_GRO_SUPPORTED
+    if (gro) {
+      udp_server_dispatch_segments(server, &(nd[i]), &(gro[i]));
+      continue;
+    }
+#endif
+
+    memcpy(&(server->sm.m.sm.nd), &(nd[i]), sizeof(ioa_net_data));
+    nd[i].nbh = NULL;
+    server->sm.m.sm.can_resume = 1;
+
+    if (ioa_network_buffer_get_size(server->sm.m.sm.nd.nbh) > 0) {
+      udp_server_dispatch_packet(server, server->udp_listen_s);
+    }
+
+    ioa_network_buffer_delete(server->e, server->sm.m.sm.nd.nbh);
+    server->sm.m.sm.nd.nbh = NULL;
+  }
+
+  return n;
+}
+
 static void udp_server_input_handler(evutil_socket_t fd, short what, void *arg) {
 
   if (!arg) {
@@ -596,13 +835,39 @@ static void udp_server_input_handler(evutil_socket_t fd, short what, void *arg)
 
   // printf_server_socket(server, fd);
 
-  ioa_network_buffer_handle *elem = NULL;
+  if (server->recv_batch > 0) {
+    int n = 0;
+    do {
+      n = udp_server_input_batch(server, fd);
+    } while ((n == server->recv_batch) && (cycle++ < MAX_SINGLE_UDP_BATCH));
 
-start_udp_cycle:
+    if (n >= 0 || would_block()) {
+      FUNCEND;
+      return;
+    }
+
+    if (socket_errno() == ENOSYS) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: recvmmsg is not available, UDP receive batching is disabled\n",
+                    __FUNCTION__);
+      server->recv_batch = 0;
+      if (server->gro) {
+        /* the single datagram path does not split coalesced datagrams */
+        set_raw_socket_gro_options(fd, 0);
+        server->gro = 0;
+      }
+    }
 
-  elem = (ioa_network_buffer_handle *)ioa_network_buffer_allocate(server->e);
+    /* fall through to the single datagram path for the error handling */
+    cycle = 0;
+  }
+
+start_udp_cycle:
 
-  server->sm.m.sm.nd.nbh = elem;
+  server->sm.m.sm.nd.nbh = ioa_network_buffer_allocate_size(server->e, NBUF_SMALL_DATAGRAM_SIZE);
+  if (!(server->sm.m.sm.nd.nbh)) {
+    FUNCEND;
+    return;
+  }
   server->sm.m.sm.nd.recv_ttl = TTL_IGNORE;
   server->sm.m.sm.nd.recv_tos = TOS_IGNORE;
   server->sm.m.sm.can_resume = 1;
@@ -617,9 +882,8 @@ start_udp_cycle:
 #else
   int flags = MSG_DONTWAIT;
 #endif
-  bsize = udp_recvfrom(fd, &(server->sm.m.sm.nd.src_addr), &(server->addr), (char *)ioa_network_buffer_data(elem),
-                       (int)ioa_network_buffer_get_capacity_udp(), &(server->sm.m.sm.nd.recv_ttl),
-                       &(server->sm.m.sm.nd.recv_tos), server->e->cmsg, flags, NULL);
+  bsize = udp_recvfrom_nbh(server->e, fd, &(server->sm.m.sm.nd.src_addr), &(server->addr), &(server->sm.m.sm.nd.nbh),
+                           &(server->sm.m.sm.nd.recv_ttl), &(server->sm.m.sm.nd.recv_tos), flags, NULL);
 
   int conn_reset = is_connreset();
   int to_block = would_block();
@@ -653,14 +917,11 @@ start_udp_cycle:
     ioa_addr orig_addr;
     int ttl = 0;
     int tos = 0;
-    int slen = server->slen0;
     udp_recvfrom(fd, &orig_addr, &(server->addr), buffer, (int)sizeof(buffer), &ttl, &tos, server->e->cmsg, eflags,
                  &errcode);
     // try again...
-    do {
-      bsize = recvfrom(fd, ioa_network_buffer_data(elem), ioa_network_buffer_get_capacity_udp(), flags,
-                       (struct sockaddr *)&(server->sm.m.sm.nd.src_addr), (socklen_t *)&slen);
-    } while (bsize < 0 && socket_eintr());
+    bsize = udp_recvfrom_nbh(server->e, fd, &(server->sm.m.sm.nd.src_addr), &(server->addr), &(server->sm.m.sm.nd.nbh),
+                             &(server->sm.m.sm.nd.recv_ttl), &(server->sm.m.sm.nd.recv_tos), flags, NULL);
 
     conn_reset = is_connreset();
     to_block = would_block();
@@ -694,37 +955,73 @@ start_udp_cycle:
   }
 
   if (bsize > 0) {
+    udp_server_dispatch_packet(server, s);
+  }
+
+  ioa_network_buffer_delete(server->e, server->sm.m.sm.nd.nbh);
+  server->sm.m.sm.nd.nbh = NULL;
 
-    int rc = 0;
-    ioa_network_buffer_set_size(elem, (size_t)bsize);
+  if ((bsize > 0) && (cycle++ < MAX_SINGLE_UDP_BATCH)) {
+    goto start_udp_cycle;
+  }
 
-    if (server->connect_cb) {
+  FUNCEND;
+}
 
-      rc = create_new_connected_udp_socket(server, s);
-      if (rc < 0) {
-        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot handle UDP packet, size %d\n", (int)bsize);
-      }
+static void udp_server_listen_event(dtls_listener_relay_server_type *server, evutil_socket_t udp_listen_fd) {
+  server->udp_listen_ev =
+      event_new(server->e->event_base, udp_listen_fd, EV_READ | EV_PERSIST, udp_server_input_handler, server);
 
-    } else {
-      server->sm.m.sm.s = s;
-      rc = handle_udp_packet(server, &(server->sm), server->e, server->ts);
-    }
+  event_add(server->udp_listen_ev, NULL);
+}
 
-    if (rc < 0) {
-      if (eve(server->e->verbose)) {
-        TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot handle UDP event\n");
-      }
-    }
+static void udp_server_input_uring(void *arg, ioa_net_data *nd) {
+
+  dtls_listener_relay_server_type *server = (dtls_listener_relay_server_type *)arg;
+
+  if (!server || !(server->udp_listen_s)) {
+    return;
   }
 
+  if (!nd) {
+    /* io_uring gave the socket up */
+    server->uring_recv = 0;
+    udp_server_listen_event(server, server->udp_listen_s->fd);
+    return;
+  }
+
+  memcpy(&(server->sm.m.sm.nd), nd, sizeof(ioa_net_data));
+  nd->nbh = NULL;
+  server->sm.m.sm.can_resume = 1;
+
+  udp_server_dispatch_packet(server, server->udp_listen_s);
+
   ioa_network_buffer_delete(server->e, server->sm.m.sm.nd.nbh);
   server->sm.m.sm.nd.nbh = NULL;
+}
 
-  if ((bsize > 0) && (cycle++ < MAX_SINGLE_UDP_BATCH)) {
-    goto start_udp_cycle;
+/*
+ * Start reading the listener socket: with the engine io_uring if the
+ * engine has one, or with a libevent event. GRO needs the recvmmsg() path.
+ */
+static void udp_server_listen(dtls_listener_relay_server_type *server, evutil_socket_t udp_listen_fd) {
+
+  if (server->e->uring && !(server->gro)) {
+    server->uring_recv = ioa_uring_recv_start(server->e, udp_listen_fd, udp_server_input_uring, server);
+    if (server->uring_recv) {
+      return;
+    }
   }
 
-  FUNCEND;
+  udp_server_listen_event(server, udp_listen_fd);
+}
+
+static void udp_server_unlisten(dtls_listener_relay_server_type *server) {
+  EVENT_DEL(server->udp_listen_ev);
+  if (server->uring_recv) {
+    ioa_uring_recv_stop(server->e, server->uring_recv);
+    server->uring_recv = 0;
+  }
 }
 
 ///////////////////// operations //////////////////////////
@@ -760,6 +1057,10 @@ static int create_server_socket(dtls_listener_relay_server_type *server, int rep
     set_raw_socket_ttl_options(udp_listen_fd, server->addr.ss.sa_family);
     set_raw_socket_tos_options(udp_listen_fd, server->addr.ss.sa_family);
 
+    if (server->gro) {
+      set_raw_socket_gro_options(udp_listen_fd, 1);
+    }
+
     {
       const int max_binding_time = 60;
       int addr_bind_cycle = 0;
@@ -781,10 +1082,7 @@ static int create_server_socket(dtls_listener_relay_server_type *server, int rep
       }
     }
 
-    server->udp_listen_ev =
-        event_new(server->e->event_base, udp_listen_fd, EV_READ | EV_PERSIST, udp_server_input_handler, server);
-
-    event_add(server->udp_listen_ev, NULL);
+    udp_server_listen(server, udp_listen_fd);
   }
 
   if (report_creation) {
@@ -812,7 +1110,7 @@ static int reopen_server_socket(dtls_listener_relay_server_type *server, evutil_
   FUNCSTART;
 
   {
-    EVENT_DEL(server->udp_listen_ev);
+    udp_server_unlisten(server);
 
     if (server->udp_listen_s->fd >= 0) {
       socket_closesocket(server->udp_listen_s->fd);
@@ -839,6 +1137,10 @@ static int reopen_server_socket(dtls_listener_relay_server_type *server, evutil_
 
     set_sock_buf_size(udp_listen_fd, UR_SERVER_SOCK_BUF_SIZE);
 
+    if (server->gro) {
+      set_raw_socket_gro_options(udp_listen_fd, 1);
+    }
+
     if (sock_bind_to_device(udp_listen_fd, (unsigned char *)server->ifname) < 0) {
       TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "Cannot bind listener socket to device %s\n", server->ifname);
     }
@@ -851,10 +1153,7 @@ static int reopen_server_socket(dtls_listener_relay_server_type *server, evutil_
       return -1;
     }
 
-    server->udp_listen_ev =
-        event_new(server->e->event_base, udp_listen_fd, EV_READ | EV_PERSIST, udp_server_input_handler, server);
-
-    event_add(server->udp_listen_ev, NULL);
+    udp_server_listen(server, udp_listen_fd);
   }
 
   if (!turn_params.no_udp && !turn_params.no_dtls) {
@@ -911,14 +1210,42 @@ static int init_server(dtls_listener_relay_server_type *server, const char *ifna
 
   server->e = e;
 
+#if UDP_MMSG_SUPPORTED
+  if (turn_params.udp_recv_batch > 1) {
+    server->recv_batch = turn_params.udp_recv_batch;
+  }
+#endif
+#if UDP_GRO_SUPPORTED
+  if (turn_params.udp_gro) {
+    /* coalesced datagrams are read through the recvmmsg() path */
+    server->gro = 1;
+    if (!(server->recv_batch)) {
+      server->recv_batch = 1;
+    }
+  }
+#endif
+
   return create_server_socket(server, report_creation);
 }
 
 static int clean_server(dtls_listener_relay_server_type *server) {
   if (server) {
-    EVENT_DEL(server->udp_listen_ev);
+    udp_server_unlisten(server);
     close_ioa_socket(server->udp_listen_s);
     server->udp_listen_s = NULL;
+    if (server->batch_nd) {
+      for (int i = 0; i < MAX_UDP_RECV_BATCH; ++i) {
+        ioa_network_buffer_delete(server->e, server->batch_nd[i].nbh);
+        server->batch_nd[i].nbh = NULL;
+      }
+    }
+#if UDP_GRO_SUPPORTED
+    if (server->batch_gro) {
+      for (int i = 0; i < MAX_UDP_RECV_BATCH; ++i) {
+        udp_gro_area_clear(server->e, &(server->batch_gro[i]));
+      }
+    }
+#endif
   }
   return 0;
 }
@@ -963,6 +1290,13 @@ ioa_engine_handle get_engine(dtls_listener_relay_server_type *server) {
   return NULL;
 }
 
+int dtls_listener_set_reuseport_steering(dtls_listener_relay_server_type *server, int group_size, int by_port) {
+  if (!server || !(server->udp_listen_s) || (server->udp_listen_s->fd < 0)) {
+    return -1;
+  }
+  return sock_set_reuseport_steering(server->udp_listen_s->fd, group_size, by_port);
+}
+
 //////////// UDP send ////////////////
 
 void udp_send_message(dtls_listener_relay_server_type *server, ioa_network_buffer_handle nbh, ioa_addr *dest) {
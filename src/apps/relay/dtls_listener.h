@@ -63,6 +63,8 @@ void udp_send_message(dtls_listener_relay_server_type *server, ioa_network_buffe
 
 ioa_engine_handle get_engine(dtls_listener_relay_server_type *server);
 
+int dtls_listener_set_reuseport_steering(dtls_listener_relay_server_type *server, int group_size, int by_port);
+
 ///////////////////////////////////////////
 
 #ifdef __cplusplus
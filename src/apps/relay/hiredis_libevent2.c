@@ -211,6 +211,48 @@ void send_message_to_redis(redis_context_handle rch, const char *command, const
   }
 }
 
+/*
+ * Queues a command whose reply goes to the callback: returns -1 when the
+ * command cannot be sent, and the callback is not called then.
+ */
+int send_command_to_redis(redis_context_handle rch, redis_reply_cb cb, void *arg, const char *format, ...) {
+  if (!rch) {
+    return -1;
+  }
+
+  struct redisLibeventEvents *e = (struct redisLibeventEvents *)rch;
+
+  if (!redis_le_valid(e)) {
+    redis_reconnect(e);
+  }
+
+  if (!redis_le_valid(e)) {
+    return -1;
+  }
+
+  redisAsyncContext *ac = e->context;
+
+  va_list args;
+  va_start(args, format);
+  int r = redisvAsyncCommand(ac, cb, arg, format, args);
+  va_end(args);
+
+  if (r != REDIS_OK) {
+    e->invalid = 1;
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Redis connection broken: ac=0x%p, e=0x%p\n", __FUNCTION__, ac, e);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Drops the connection, with the pending commands, and opens it again */
+void reset_redis_connection(redis_context_handle rch) {
+  if (rch) {
+    redis_reconnect((struct redisLibeventEvents *)rch);
+  }
+}
+
 ///////////////////////// Attach /////////////////////////////////
 
 redis_context_handle redisLibeventAttach(struct event_base *base, char *ip0, int port0, char *user, char *pwd, int db) {
@@ -346,7 +388,7 @@ static void redis_reconnect(struct redisLibeventEvents *e) {
   ac->ev.data = e;
 
   /* Initialize and install read/write events */
-  e->rev = event_new(e->base, e->context->c.fd, EV_READ, redisLibeventReadEvent, e);
+  e->rev = event_new(e->base, e->context->c.fd, EV_READ | EV_PERSIST, redisLibeventReadEvent, e);
 
   e->wev = event_new(e->base, e->context->c.fd, EV_WRITE, redisLibeventWriteEvent, e);
 
@@ -44,6 +44,11 @@ extern "C" {
 
 typedef void *redis_context_handle;
 
+struct redisAsyncContext;
+
+/* The reply of a command, NULL when the connection is closed before it comes */
+typedef void (*redis_reply_cb)(struct redisAsyncContext *ac, void *reply, void *arg);
+
 //////////////////////////////////////
 
 #if !defined(TURN_NO_HIREDIS)
@@ -52,8 +57,12 @@ redis_context_handle redisLibeventAttach(struct event_base *base, char *ip, int
 
 void send_message_to_redis(redis_context_handle rch, const char *command, const char *key, const char *format, ...);
 
+int send_command_to_redis(redis_context_handle rch, redis_reply_cb cb, void *arg, const char *format, ...);
+
 int is_redis_asyncconn_good(redis_context_handle rch);
 
+void reset_redis_connection(redis_context_handle rch);
+
 #endif
 /* TURN_NO_HIREDIS */
 
@@ -31,6 +31,7 @@
 #include "mainrelay.h"
 #include "dbdrivers/dbdriver.h"
 
+#include "ns_tls_tickets.h"
 #include "prom_server.h"
 
 #if defined(WINDOWS)
@@ -107,6 +108,13 @@ turn_params_t turn_params = {
     0,
 #endif
 
+    0,    /*no_tls_session_tickets*/
+    "",   /*tls_ticket_key_file*/
+    3600, /*tls_ticket_key_rotation*/
+    0,    /*ktls*/
+    0,    /*handshake_threads*/
+    0,    /*dtls_rebind*/
+
     NULL,      /*tls_ctx_update_ev*/
     {0, NULL}, /*tls_mutex*/
 
@@ -133,6 +141,11 @@ turn_params_t turn_params = {
     0, /* no_udp */
     0, /* no_tcp */
     0, /* tcp_use_proxy */
+    0, /* udp_recv_batch */
+    0, /* udp_send_batch */
+    0, /* udp_gro */
+    0, /* udp_reuseport_steering */
+    MAX_BUFFER_QUEUE_SIZE_PER_ENGINE, /* buffer_pool_size */
 
     0, /* no_tcp_relay */
     0, /* no_udp_relay */
@@ -145,8 +158,8 @@ turn_params_t turn_params = {
     {NULL, 0},                                                                /*ip_whitelist*/
     {NULL, 0},                                                                /*ip_blacklist*/
     NEV_UNKNOWN,                                                              /*net_engine_version*/
-    {"Unknown", "UDP listening socket per session", "UDP thread per network endpoint",
-     "UDP thread per CPU core"}, /*net_engine_version_txt*/
+    {"Unknown", "UDP listening socket per session", "UDP thread per network endpoint", "UDP thread per CPU core",
+     "UDP thread per CPU core, io_uring"}, /*net_engine_version_txt*/
 
     //////////////// Relay servers //////////////////////////////////
     LOW_DEFAULT_PORTS_BOUNDARY,  /*min_port*/
@@ -197,6 +210,12 @@ turn_params_t turn_params = {
     0,                                  /* mobility */
     TURN_CREDENTIALS_NONE,              /* ct */
     0,                                  /* use_auth_secret_with_timestamp */
+    1024,                               /* auth_cache_size */
+    60,                                 /* auth_cache_ttl */
+    2,                                  /* db_pool_size */
+    5,                                  /* db_query_timeout */
+    0,                                  /* db_change_notifications */
+    0,                                  /* db_reread_interval */
     0,                                  /* max_bps */
     0,                                  /* bps_capacity */
     0,                                  /* bps_capacity_allocated */
@@ -255,6 +274,7 @@ static char procgroupname[1025] = "\0";
 
 static void read_config_file(int argc, char **argv, int pass);
 static void reload_ssl_certs(evutil_socket_t sock, short events, void *args);
+static void rotate_tls_ticket_keys(evutil_socket_t sock, short events, void *args);
 
 static void shutdown_handler(evutil_socket_t sock, short events, void *args);
 static void drain_handler(evutil_socket_t sock, short events, void *args);
@@ -1198,6 +1218,29 @@ static char Usage[] =
     " --no-tlsv1_2					Set TLSv1.3/DTLSv1.2 as a minimum supported protocol version.\n"
     "						With openssl-1.0.2 and below, do not allow "
     "TLSv1.2/DTLSv1.2 protocols.\n"
+    " --no-tls-session-tickets			Do not issue TLS/DTLS session tickets: every reconnecting client pays\n"
+    "						a full handshake.\n"
+    " --tls-ticket-key-file	<filename>		File of the keys of the session tickets, shared by the servers that\n"
+    "						resume each other's sessions: one or more keys of 80 random bytes\n"
+    "						(like 'openssl rand 80'), the first one encrypts the new tickets.\n"
+    "						The file is checked for changes at each rotation interval, and reread\n"
+    "						on SIGUSR2. By default, each server uses its own random keys.\n"
+    " --tls-ticket-key-rotation	<seconds>	Interval of the rotations of the random ticket key, or of the checks of\n"
+    "						the ticket key file. A ticket is valid for two intervals. Default is\n"
+    "						3600 seconds.\n"
+    " --ktls						Hand the TLS record encryption of the TCP client connections over\n"
+    "						to the kernel (kTLS) after the handshake, where the kernel and the\n"
+    "						negotiated cipher support it; the other connections keep the\n"
+    "						OpenSSL encryption.\n"
+    " --handshake-threads		<number>	Number of threads that run the TLS and DTLS handshakes of the client\n"
+    "						connections, so that the key exchanges do not hold up the relay\n"
+    "						threads. Default is 0: the handshakes run in the relay threads.\n"
+    " --dtls-rebind					Keep a DTLS session when the NAT binding of the client changes its port:\n"
+    "						a record of an established session from a new port of the same IP\n"
+    "						address is matched to its session by decryption, and the session\n"
+    "						moves to the new address. With the network engines 3 and 4, the UDP\n"
+    "						listeners then steer the clients to the relay threads by the IP\n"
+    "						address only (Linux only). Not with the network engine 1.\n"
     " --no-udp					Do not start UDP client listeners.\n"
     " --no-tcp					Do not start TCP client listeners.\n"
     " --no-tls					Do not start TLS client listeners.\n"
@@ -1321,8 +1364,10 @@ static char Usage[] =
     " --cli-max-output-sessions			Maximum number of output sessions in ps CLI command.\n"
     "						This value can be changed on-the-fly in CLI. The default value is "
     "256.\n"
-    " --ne=[1|2|3]					Set network engine type for the process (for internal "
+    " --ne=[1|2|3|4]					Set network engine type for the process (for internal "
     "purposes).\n"
+    "						4 is the UDP thread per CPU core engine (3) with the UDP\n"
+    "						receive done by io_uring (Linux 6.0+).\n"
     " --no-rfc5780					Disable RFC5780 (NAT behavior discovery).\n"
     "						Originally, if there are more than one listener address from the same\n"
     "						address family, then by default the NAT behavior discovery feature "
@@ -1342,6 +1387,38 @@ static char Usage[] =
     "connections made to ports not\n"
     "						supporting HTTP. The default behaviour is to immediately "
     "close the connection.\n"
+    " --udp-recv-batch		<number>	Number of datagrams a UDP/DTLS listener thread reads with one "
+    "recvmmsg() call\n"
+    "						(Linux only, maximum 64). Values 0 and 1 disable batching (default).\n"
+    " --udp-send-batch		<number>	Number of outgoing UDP datagrams a relay thread queues during one event "
+    "loop\n"
+    "						iteration before sending them with sendmmsg() (Linux only, maximum 64).\n"
+    "						Datagrams of equal size to the same destination are sent with UDP GSO\n"
+    "						when the kernel supports it. Values 0 and 1 disable batching (default).\n"
+    " --udp-gro					Enable UDP GRO on the UDP listener and relay sockets (Linux only):\n"
+    "						the kernel coalesces bursts of equal-sized datagrams, and the server\n"
+    "						splits them back into the original datagrams. Off by default.\n"
+    " --udp-reuseport-steering			With the network engines 3 and 4, attach a BPF program to each UDP\n"
+    "						listener SO_REUSEPORT group that picks the relay thread socket by\n"
+    "						the client address and port hash (Linux only). Off by default.\n"
+    " --buffer-pool-size		<number>	Number of free network buffers each relay thread keeps for reuse, per\n"
+    "						buffer size class (small datagrams and large messages). The value 0\n"
+    "						disables the caching. Default is 64.\n"
+    " --auth-cache-size		<number>	Number of users whose credential keys each relay thread keeps, so\n"
+    "						that their following requests skip the authentication threads.\n"
+    "						The value 0 disables the cache. Default is 1024.\n"
+    " --auth-cache-ttl		<seconds>	Lifetime of the cached credential keys. Default is 60 seconds.\n"
+    " --db-pool-size		<number>	Number of asynchronous PostgreSQL or Redis connections of each\n"
+    "						authentication thread, that the credential lookups are pipelined on.\n"
+    "						The value 0 makes the lookups synchronous. Default is 2.\n"
+    " --db-query-timeout		<seconds>	Time after which an asynchronous lookup fails. Default is 5 seconds.\n"
+    " --db-change-notifications			Apply the changes of the realms, secrets, users and IP lists as the DB\n"
+    "						reports them: PostgreSQL notifications sent by the triggers of\n"
+    "						turndb/schema.notify.pgsql, or the data version of the SQLite file.\n"
+    "						Off by default.\n"
+    " --db-reread-interval		<seconds>	Interval of the full reread of the realms, secrets and IP lists from\n"
+    "						the DB. With the change notifications, it is only a safety net.\n"
+    "						Default is 5 seconds, or 300 seconds with the change notifications.\n"
     " --version					Print version (and exit).\n"
     " -h						Help\n"
     "\n";
@@ -1499,6 +1576,23 @@ enum EXTRA_OPTS {
   NO_STUN_BACKWARD_COMPATIBILITY_OPT,
   RESPONSE_ORIGIN_ONLY_WITH_RFC5780_OPT,
   RESPOND_HTTP_UNSUPPORTED_OPT,
+  UDP_RECV_BATCH_OPT,
+  UDP_SEND_BATCH_OPT,
+  UDP_GRO_OPT,
+  UDP_REUSEPORT_STEERING_OPT,
+  BUFFER_POOL_SIZE_OPT,
+  AUTH_CACHE_SIZE_OPT,
+  AUTH_CACHE_TTL_OPT,
+  DB_POOL_SIZE_OPT,
+  DB_QUERY_TIMEOUT_OPT,
+  DB_CHANGE_NOTIFICATIONS_OPT,
+  DB_REREAD_INTERVAL_OPT,
+  NO_TLS_SESSION_TICKETS_OPT,
+  TLS_TICKET_KEY_FILE_OPT,
+  TLS_TICKET_KEY_ROTATION_OPT,
+  KTLS_OPT,
+  HANDSHAKE_THREADS_OPT,
+  DTLS_REBIND_OPT,
   VERSION_OPT
 };
 
@@ -1642,6 +1736,23 @@ static const struct myoption long_options[] = {
     {"no-stun-backward-compatibility", optional_argument, NULL, NO_STUN_BACKWARD_COMPATIBILITY_OPT},
     {"response-origin-only-with-rfc5780", optional_argument, NULL, RESPONSE_ORIGIN_ONLY_WITH_RFC5780_OPT},
     {"respond-http-unsupported", optional_argument, NULL, RESPOND_HTTP_UNSUPPORTED_OPT},
+    {"udp-recv-batch", required_argument, NULL, UDP_RECV_BATCH_OPT},
+    {"udp-send-batch", required_argument, NULL, UDP_SEND_BATCH_OPT},
+    {"udp-gro", optional_argument, NULL, UDP_GRO_OPT},
+    {"udp-reuseport-steering", optional_argument, NULL, UDP_REUSEPORT_STEERING_OPT},
+    {"buffer-pool-size", required_argument, NULL, BUFFER_POOL_SIZE_OPT},
+    {"auth-cache-size", required_argument, NULL, AUTH_CACHE_SIZE_OPT},
+    {"auth-cache-ttl", required_argument, NULL, AUTH_CACHE_TTL_OPT},
+    {"db-pool-size", required_argument, NULL, DB_POOL_SIZE_OPT},
+    {"db-query-timeout", required_argument, NULL, DB_QUERY_TIMEOUT_OPT},
+    {"db-change-notifications", optional_argument, NULL, DB_CHANGE_NOTIFICATIONS_OPT},
+    {"db-reread-interval", required_argument, NULL, DB_REREAD_INTERVAL_OPT},
+    {"no-tls-session-tickets", optional_argument, NULL, NO_TLS_SESSION_TICKETS_OPT},
+    {"tls-ticket-key-file", required_argument, NULL, TLS_TICKET_KEY_FILE_OPT},
+    {"tls-ticket-key-rotation", required_argument, NULL, TLS_TICKET_KEY_ROTATION_OPT},
+    {"ktls", optional_argument, NULL, KTLS_OPT},
+    {"handshake-threads", required_argument, NULL, HANDSHAKE_THREADS_OPT},
+    {"dtls-rebind", optional_argument, NULL, DTLS_REBIND_OPT},
     {"version", optional_argument, NULL, VERSION_OPT},
     {"syslog-facility", required_argument, NULL, SYSLOG_FACILITY_OPT},
     {NULL, no_argument, NULL, 0}};
@@ -1918,6 +2029,12 @@ static void set_option(int c, char *value) {
     if ((ne < (int)NEV_MIN) || (ne > (int)NEV_MAX)) {
       TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "ERROR: wrong version of the network engine: %d\n", ne);
     }
+    if ((ne == (int)NEV_UDP_SOCKET_PER_THREAD_URING) && !ioa_uring_supported()) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING,
+                    "WARNING: io_uring multishot receive is not supported, network engine %d is used instead\n",
+                    (int)NEV_UDP_SOCKET_PER_THREAD);
+      ne = (int)NEV_UDP_SOCKET_PER_THREAD;
+    }
     turn_params.net_engine_version = (NET_ENG_VERSION)ne;
   } break;
   case DH566_OPT:
@@ -2358,6 +2475,108 @@ static void set_option(int c, char *value) {
   case RESPOND_HTTP_UNSUPPORTED_OPT:
     turn_params.respond_http_unsupported = get_bool_value(value);
     break;
+  case UDP_RECV_BATCH_OPT: {
+    int batch = atoi(value);
+    if (batch < 0) {
+      batch = 0;
+    } else if (batch > MAX_UDP_RECV_BATCH) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "WARNING: udp-recv-batch %d is too large, using %d\n", batch,
+                    MAX_UDP_RECV_BATCH);
+      batch = MAX_UDP_RECV_BATCH;
+    }
+#if !UDP_MMSG_SUPPORTED
+    if (batch > 1) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING,
+                    "WARNING: option --udp-recv-batch is not supported on this platform; ignored.\n");
+      batch = 0;
+    }
+#endif
+    turn_params.udp_recv_batch = batch;
+  } break;
+  case UDP_SEND_BATCH_OPT: {
+    int batch = atoi(value);
+    if (batch < 0) {
+      batch = 0;
+    } else if (batch > MAX_UDP_SEND_BATCH) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "WARNING: udp-send-batch %d is too large, using %d\n", batch,
+                    MAX_UDP_SEND_BATCH);
+      batch = MAX_UDP_SEND_BATCH;
+    }
+#if !UDP_MMSG_SUPPORTED
+    if (batch > 1) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING,
+                    "WARNING: option --udp-send-batch is not supported on this platform; ignored.\n");
+      batch = 0;
+    }
+#endif
+    turn_params.udp_send_batch = batch;
+  } break;
+  case UDP_GRO_OPT:
+    turn_params.udp_gro = get_bool_value(value);
+#if !UDP_GRO_SUPPORTED
+    if (turn_params.udp_gro) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "WARNING: option --udp-gro is not supported on this platform; ignored.\n");
+      turn_params.udp_gro = 0;
+    }
+#endif
+    break;
+  case UDP_REUSEPORT_STEERING_OPT:
+    turn_params.udp_reuseport_steering = get_bool_value(value);
+#if !defined(SO_ATTACH_REUSEPORT_CBPF)
+    if (turn_params.udp_reuseport_steering) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING,
+                    "WARNING: option --udp-reuseport-steering is not supported on this platform; ignored.\n");
+      turn_params.udp_reuseport_steering = 0;
+    }
+#endif
+    break;
+  case BUFFER_POOL_SIZE_OPT: {
+    int size = atoi(value);
+    turn_params.buffer_pool_size = (size < 0) ? 0 : size;
+  } break;
+  case AUTH_CACHE_SIZE_OPT: {
+    int size = atoi(value);
+    turn_params.auth_cache_size = (size < 0) ? 0 : size;
+  } break;
+  case AUTH_CACHE_TTL_OPT: {
+    int ttl = atoi(value);
+    turn_params.auth_cache_ttl = (ttl < 1) ? 1 : ttl;
+  } break;
+  case DB_POOL_SIZE_OPT: {
+    int size = atoi(value);
+    turn_params.db_pool_size = (size < 0) ? 0 : size;
+  } break;
+  case DB_QUERY_TIMEOUT_OPT: {
+    int timeout = atoi(value);
+    turn_params.db_query_timeout = (timeout < 1) ? 1 : timeout;
+  } break;
+  case DB_CHANGE_NOTIFICATIONS_OPT:
+    turn_params.db_change_notifications = get_bool_value(value);
+    break;
+  case DB_REREAD_INTERVAL_OPT: {
+    int interval = atoi(value);
+    turn_params.db_reread_interval = (interval < 1) ? 1 : interval;
+  } break;
+  case NO_TLS_SESSION_TICKETS_OPT:
+    turn_params.no_tls_session_tickets = get_bool_value(value);
+    break;
+  case TLS_TICKET_KEY_FILE_OPT:
+    STRCPY(turn_params.tls_ticket_key_file, value);
+    break;
+  case TLS_TICKET_KEY_ROTATION_OPT: {
+    int rotation = atoi(value);
+    turn_params.tls_ticket_key_rotation = (rotation < 60) ? 60 : rotation;
+  } break;
+  case KTLS_OPT:
+    turn_params.ktls = get_bool_value(value);
+    break;
+  case HANDSHAKE_THREADS_OPT: {
+    int threads = atoi(value);
+    turn_params.handshake_threads = (threads < 0) ? 0 : ((threads > 128) ? 128 : threads);
+  } break;
+  case DTLS_REBIND_OPT:
+    turn_params.dtls_rebind = get_bool_value(value);
+    break;
 
   /* these options have been already taken care of before: */
   case 'l':
@@ -2961,7 +3180,6 @@ int main(int argc, char **argv) {
 
   init_listener();
   init_secrets_list(&turn_params.default_users_db.ram_db.static_auth_secrets);
-  init_dynamic_ip_lists();
 
   if (!strstr(argv[0], "turnadmin")) {
 
@@ -3312,6 +3530,12 @@ int main(int argc, char **argv) {
 
   setup_server();
 
+  if (!(turn_params.no_tls && turn_params.no_dtls) && !turn_params.no_tls_session_tickets) {
+    struct event *ev = event_new(turn_params.listener.event_base, -1, EV_PERSIST, rotate_tls_ticket_keys, NULL);
+    struct timeval tv = {turn_params.tls_ticket_key_rotation, 0};
+    event_add(ev, &tv);
+  }
+
 #if defined(WINDOWS)
   // TODO: implement it!!! add windows server
 #else
@@ -3558,7 +3782,13 @@ static void set_ctx(SSL_CTX **out, const char *protocol, const SSL_METHOD *metho
   }
 
   SSL_CTX_set_cipher_list(ctx, turn_params.cipher_list);
+  /* Sessions are only resumed with the stateless tickets */
   SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  if (turn_params.no_tls_session_tickets) {
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+  } else {
+    tls_tickets_set_ctx(ctx);
+  }
   SSL_CTX_set_ciphersuites(ctx, turn_params.cipher_list);
 
   if (!SSL_CTX_use_certificate_chain_file(ctx, turn_params.cert_file)) {
@@ -3747,6 +3977,24 @@ static void set_ctx(SSL_CTX **out, const char *protocol, const SSL_METHOD *metho
 }
 
 static void openssl_load_certificates(void);
+#if KTLS_SUPPORTED
+/* Whether the kernel has the TLS upper layer (the "tls" module) */
+static int ktls_kernel_supported(void) {
+#if defined(TCP_ULP)
+  evutil_socket_t fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return 1;
+  }
+  /* an unconnected socket refuses a known ULP with ENOTCONN */
+  int ret = (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")) == 0) || (errno != ENOENT);
+  socket_closesocket(fd);
+  return ret;
+#else
+  return 0;
+#endif
+}
+#endif
+
 static void openssl_setup(void) {
   THREAD_setup();
   SSL_load_error_strings();
@@ -3773,8 +4021,23 @@ static void openssl_setup(void) {
     turn_params.no_dtls = 1;
   }
 
+  if (turn_params.ktls && !turn_params.no_tls) {
+#if KTLS_SUPPORTED
+    if (!ktls_kernel_supported()) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING,
+                    "WARNING: the kernel has no TLS support (tls module), the TLS records stay in OpenSSL\n");
+    }
+#else
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "WARNING: OpenSSL is built without kTLS, option --ktls is ignored\n");
+    turn_params.ktls = 0;
+#endif
+  }
+
   if (!(turn_params.no_tls && turn_params.no_dtls)) {
     adjust_key_file_names();
+    if (!turn_params.no_tls_session_tickets) {
+      tls_tickets_init(turn_params.tls_ticket_key_file, turn_params.tls_ticket_key_rotation);
+    }
   }
 
   openssl_load_certificates();
@@ -3788,6 +4051,11 @@ static void openssl_load_certificates(void) {
   TURN_MUTEX_LOCK(&turn_params.tls_mutex);
   if (!turn_params.no_tls) {
     set_ctx(&turn_params.tls_ctx, "TLS", TLS_server_method());
+#if KTLS_SUPPORTED
+    if (turn_params.ktls) {
+      SSL_CTX_set_options(turn_params.tls_ctx, SSL_OP_ENABLE_KTLS);
+    }
+#endif
     if (turn_params.no_tlsv1) {
       SSL_CTX_set_min_proto_version(turn_params.tls_ctx, TLS1_1_VERSION);
     }
@@ -3820,6 +4088,9 @@ static void openssl_load_certificates(void) {
 
 static void reload_ssl_certs(evutil_socket_t sock, short events, void *args) {
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "Reloading TLS certificates and keys\n");
+  if (!turn_params.no_tls_session_tickets) {
+    tls_tickets_reload();
+  }
   openssl_load_certificates();
   if (turn_params.tls_ctx_update_ev != NULL) {
     event_active(turn_params.tls_ctx_update_ev, EV_READ, 0);
@@ -3830,6 +4101,14 @@ static void reload_ssl_certs(evutil_socket_t sock, short events, void *args) {
   UNUSED_ARG(args);
 }
 
+static void rotate_tls_ticket_keys(evutil_socket_t sock, short events, void *args) {
+  tls_tickets_rotate();
+
+  UNUSED_ARG(sock);
+  UNUSED_ARG(events);
+  UNUSED_ARG(args);
+}
+
 static void shutdown_handler(evutil_socket_t sock, short events, void *args) {
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "Terminating on signal %d\n", sock);
   turn_params.stop_turn_server = true;
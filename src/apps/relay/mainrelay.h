@@ -81,6 +81,7 @@
 #include "apputils.h"
 
 #include "ns_ioalib_impl.h"
+#include "ns_ioalib_uring.h"
 
 #include <openssl/aes.h>
 #include <openssl/err.h>
@@ -120,6 +121,10 @@ extern "C" {
 
 #define DEFAULT_CPUS_NUMBER (2)
 
+/* Full DB reread intervals, in seconds, when db-reread-interval is not set: without and with change notifications */
+#define DEFAULT_DB_REREAD_INTERVAL (5)
+#define DEFAULT_DB_NOTIFY_REREAD_INTERVAL (300)
+
 /////////// TYPES ///////////////////////////////////
 
 enum _DH_KEY_SIZE { DH_566, DH_1066, DH_2066, DH_CUSTOM };
@@ -166,7 +171,8 @@ enum _NET_ENG_VERSION {
   NEV_UDP_SOCKET_PER_SESSION = NEV_MIN,
   NEV_UDP_SOCKET_PER_ENDPOINT,
   NEV_UDP_SOCKET_PER_THREAD,
-  NEV_MAX = NEV_UDP_SOCKET_PER_THREAD,
+  NEV_UDP_SOCKET_PER_THREAD_URING,
+  NEV_MAX = NEV_UDP_SOCKET_PER_THREAD_URING,
   NEV_TOTAL
 };
 
@@ -199,6 +205,13 @@ typedef struct _turn_params_ {
   int no_tls;
   int no_dtls;
 
+  int no_tls_session_tickets;
+  char tls_ticket_key_file[1025];
+  int tls_ticket_key_rotation;
+  int ktls;
+  int handshake_threads;
+  int dtls_rebind;
+
   struct event *tls_ctx_update_ev;
   TURN_MUTEX_DECLARE(tls_mutex)
 
@@ -226,6 +239,11 @@ typedef struct _turn_params_ {
   int no_udp;
   int no_tcp;
   int tcp_use_proxy;
+  int udp_recv_batch;
+  int udp_send_batch;
+  int udp_gro;
+  int udp_reuseport_steering;
+  int buffer_pool_size;
 
   vint no_tcp_relay;
   vint no_udp_relay;
@@ -301,6 +319,12 @@ typedef struct _turn_params_ {
   vint mobility;
   turn_credential_type ct;
   int use_auth_secret_with_timestamp;
+  int auth_cache_size;
+  int auth_cache_ttl;
+  int db_pool_size;
+  int db_query_timeout;
+  int db_change_notifications;
+  int db_reread_interval;
   band_limit_t max_bps;
   band_limit_t bps_capacity;
   band_limit_t bps_capacity_allocated;
@@ -370,6 +394,7 @@ void set_ssl_ctx(ioa_engine_handle e, turn_params_t *params);
 ///////// Auth ////////////////
 
 void send_auth_message_to_auth_server(struct auth_message *am);
+auth_cache *get_relay_auth_cache(turnserver_id id);
 
 /////////// Setup server ////////
 
@@ -30,8 +30,13 @@
 
 #include "mainrelay.h"
 
+#include "ns_tls_handshake.h"
 #include "ns_turn_ioalib.h"
 
+#include "prom_server.h"
+
+#include "dbdrivers/dbdriver.h"
+
 //////////// Backward compatibility with OpenSSL 1.0.x //////////////
 #if defined(LIBRESSL_VERSION_NUMBER) && LIBRESSL_VERSION_NUMBER <= 0x3040000fL
 #define SSL_CTX_up_ref(ctx) CRYPTO_add(&(ctx)->references, 1, CRYPTO_LOCK_SSL_CTX)
@@ -51,12 +56,16 @@ typedef unsigned char authserver_id;
 struct auth_server {
   authserver_id id;
   struct event_base *event_base;
-  struct bufferevent *in_buf;
-  struct bufferevent *out_buf;
+  mpsc_queue *queue; // struct auth_message
+  mpsc_queue_stats queue_reported;
   pthread_t thr;
   redis_context_handle rch;
 };
 
+/* Inter-thread queue sizes, in messages */
+#define RELAY_QUEUE_SIZE (0x1000)
+#define AUTH_QUEUE_SIZE (0x400)
+
 #define MIN_AUTHSERVER_NUMBER (3)
 static authserver_id authserver_number = MIN_AUTHSERVER_NUMBER;
 static struct auth_server authserver[256];
@@ -78,6 +87,12 @@ static struct relay_server *get_relay_server(turnserver_id id);
 static void run_events(struct event_base *eb, ioa_engine_handle e);
 static void setup_relay_server(struct relay_server *rs, ioa_engine_handle e, int to_set_rfc5780);
 
+/* The io_uring engine shares the thread-per-core layout */
+static inline int udp_socket_per_thread(void) {
+  return (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_THREAD) ||
+         (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_THREAD_URING);
+}
+
 /////////////// BARRIERS ///////////////////
 
 #if !defined(PTHREAD_BARRIER_SERIAL_THREAD)
@@ -475,51 +490,54 @@ void send_auth_message_to_auth_server(struct auth_message *am) {
   authserver_id sn = auth_message_counter++;
   TURN_MUTEX_UNLOCK(&auth_message_counter_mutex);
 
-  struct evbuffer *output = bufferevent_get_output(authserver[sn].out_buf);
-  if (evbuffer_add(output, am, sizeof(struct auth_message)) < 0) {
-    fprintf(stderr, "%s: Weird buffer error\n", __FUNCTION__);
+  if (!mpsc_queue_push(authserver[sn].queue, am)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: auth queue %s is full\n", __FUNCTION__,
+                  mpsc_queue_name(authserver[sn].queue));
+    ioa_network_buffer_delete(NULL, am->in_buffer.nbh);
+    am->in_buffer.nbh = NULL;
   }
 }
 
-static void auth_server_receive_message(struct bufferevent *bev, void *ptr) {
-  UNUSED_ARG(ptr);
+auth_cache *get_relay_auth_cache(turnserver_id id) {
+  struct relay_server *rs = get_relay_server(id);
+  return rs ? rs->auth_cache : NULL;
+}
 
-  struct auth_message am;
-  int n = 0;
-  struct evbuffer *input = bufferevent_get_input(bev);
+static void answer_auth_message(struct auth_message *am) {
+  struct relay_server *relay_server = get_relay_server(am->id);
+  if (!relay_server) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: can't find relay for turn_server_id: %d\n", __FUNCTION__, (int)am->id);
+  } else if (!mpsc_queue_push(relay_server->auth_queue, am)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: auth queue %s is full\n", __FUNCTION__,
+                  mpsc_queue_name(relay_server->auth_queue));
+  } else {
+    return;
+  }
 
-  while ((n = evbuffer_remove(input, &am, sizeof(struct auth_message))) > 0) {
-    if (n != sizeof(struct auth_message)) {
-      fprintf(stderr, "%s: Weird buffer error: size=%d\n", __FUNCTION__, n);
-      continue;
-    }
+  ioa_network_buffer_delete(NULL, am->in_buffer.nbh);
+  am->in_buffer.nbh = NULL;
+}
 
-    {
-      hmackey_t key;
-      if (get_user_key(am.in_oauth, &(am.out_oauth), &(am.max_session_time), am.username, am.realm, key,
-                       am.in_buffer.nbh) < 0) {
-        am.success = 0;
-      } else {
-        memcpy(am.key, key, sizeof(hmackey_t));
-        am.success = 1;
-      }
-    }
+static void auth_server_receive_message(void *msg, void *arg) {
+  struct auth_server *as = (struct auth_server *)arg;
+  struct auth_message *am = (struct auth_message *)msg;
 
-    struct evbuffer *output = NULL;
-    struct relay_server *relay_server = get_relay_server(am.id);
-    if (relay_server) {
-      output = bufferevent_get_output(relay_server->auth_out_buf);
-    } else {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: can't find relay for turn_server_id: %d\n", __FUNCTION__, (int)am.id);
-    }
+  if (start_async_user_check(as->event_base, am, answer_auth_message)) {
+    return;
+  }
 
-    if (output) {
-      evbuffer_add(output, &am, sizeof(struct auth_message));
+  {
+    hmackey_t key;
+    if (get_user_key(am->in_oauth, &(am->out_oauth), &(am->max_session_time), am->username, am->realm, key,
+                     am->in_buffer.nbh) < 0) {
+      am->success = 0;
     } else {
-      ioa_network_buffer_delete(NULL, am.in_buffer.nbh);
-      am.in_buffer.nbh = NULL;
+      memcpy(am->key, key, sizeof(hmackey_t));
+      am->success = 1;
     }
   }
+
+  answer_auth_message(am);
 }
 
 static int send_socket_to_general_relay(ioa_engine_handle e, struct message_to_relay *sm) {
@@ -534,23 +552,18 @@ static int send_socket_to_general_relay(ioa_engine_handle e, struct message_to_r
 
   smptr->t = RMT_SOCKET;
 
-  struct evbuffer *output = NULL;
   int success = 0;
 
   if (!rdest) {
     goto label_end;
   }
 
-  output = bufferevent_get_output(rdest->out_buf);
-
-  if (output) {
-
-    if (evbuffer_add(output, smptr, sizeof(struct message_to_relay)) < 0) {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot add message to relay output buffer\n", __FUNCTION__);
-    } else {
-      success = 1;
-      smptr->m.sm.nd.nbh = NULL;
-    }
+  if (!mpsc_queue_push(rdest->queue, smptr)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot add message to relay queue %s\n", __FUNCTION__,
+                  mpsc_queue_name(rdest->queue));
+  } else {
+    success = 1;
+    smptr->m.sm.nd.nbh = NULL;
   }
 
 label_end:
@@ -631,11 +644,8 @@ static int send_socket_to_relay(turnserver_id id, uint64_t cid, stun_tid *tid, i
 
   if (ret == 0) {
 
-    struct evbuffer *output = bufferevent_get_output(rs->out_buf);
-    if (output) {
-      evbuffer_add(output, &sm, sizeof(struct message_to_relay));
-    } else {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Empty output buffer\n", __FUNCTION__);
+    if (!mpsc_queue_push(rs->queue, &sm)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: relay queue %s is full\n", __FUNCTION__, mpsc_queue_name(rs->queue));
       ret = -1;
       s_to_delete = s;
     }
@@ -681,14 +691,9 @@ int send_session_cancellation_to_relay(turnsession_id sid) {
   sm.relay_server = rs;
   sm.m.csm.id = sid;
 
-  {
-    struct evbuffer *output = bufferevent_get_output(rs->out_buf);
-    if (output) {
-      evbuffer_add(output, &sm, sizeof(struct message_to_relay));
-    } else {
-      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Empty output buffer\n", __FUNCTION__);
-      ret = -1;
-    }
+  if (!mpsc_queue_push(rs->queue, &sm)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: relay queue %s is full\n", __FUNCTION__, mpsc_queue_name(rs->queue));
+    ret = -1;
   }
 
 err:
@@ -785,6 +790,7 @@ static int handle_relay_message(relay_server_handle rs, struct message_to_relay
 }
 
 static void handle_relay_auth_message(struct relay_server *rs, struct auth_message *am) {
+  cache_user_check_result(rs->auth_cache, am);
   am->resume_func(am->success, am->out_oauth, am->max_session_time, am->key, am->pwd, &(rs->server), am->ctxkey,
                   &(am->in_buffer), am->realm);
   if (am->in_buffer.nbh) {
@@ -793,38 +799,12 @@ static void handle_relay_auth_message(struct relay_server *rs, struct auth_messa
   }
 }
 
-static void relay_receive_message(struct bufferevent *bev, void *ptr) {
-  struct message_to_relay sm;
-  int n = 0;
-  struct evbuffer *input = bufferevent_get_input(bev);
-  struct relay_server *rs = (struct relay_server *)ptr;
-
-  while ((n = evbuffer_remove(input, &sm, sizeof(struct message_to_relay))) > 0) {
-
-    if (n != sizeof(struct message_to_relay)) {
-      perror("Weird buffer error\n");
-      continue;
-    }
-
-    handle_relay_message(rs, &sm);
-  }
+static void relay_receive_message(void *msg, void *arg) {
+  handle_relay_message((struct relay_server *)arg, (struct message_to_relay *)msg);
 }
 
-static void relay_receive_auth_message(struct bufferevent *bev, void *ptr) {
-  struct auth_message am;
-  int n = 0;
-  struct evbuffer *input = bufferevent_get_input(bev);
-  struct relay_server *rs = (struct relay_server *)ptr;
-
-  while ((n = evbuffer_remove(input, &am, sizeof(struct auth_message))) > 0) {
-
-    if (n != sizeof(struct auth_message)) {
-      perror("Weird auth_buffer error\n");
-      continue;
-    }
-
-    handle_relay_auth_message(rs, &am);
-  }
+static void relay_receive_auth_message(void *msg, void *arg) {
+  handle_relay_auth_message((struct relay_server *)arg, (struct auth_message *)msg);
 }
 
 static int send_message_from_listener_to_client(ioa_engine_handle e, ioa_network_buffer_handle nbh, ioa_addr *origin,
@@ -866,7 +846,7 @@ static void listener_receive_message(struct bufferevent *bev, void *ptr) {
 
     size_t relay_thread_index = 0;
 
-    if (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_THREAD) {
+    if (udp_socket_per_thread()) {
       size_t ri;
       for (ri = 0; ri < get_real_general_relay_servers_number(); ri++) {
         if (!(general_relay_servers[ri])) {
@@ -934,8 +914,11 @@ static void listener_receive_message(struct bufferevent *bev, void *ptr) {
 // <<== communications between listener and relays
 
 static ioa_engine_handle create_new_listener_engine(void) {
+  static unsigned int listener_engines = 0;
+  char sm_name[32];
+  snprintf(sm_name, sizeof(sm_name), "listener-%u", ++listener_engines);
   struct event_base *eb = turn_event_base_new();
-  super_memory_t *sm = new_super_memory_region();
+  super_memory_t *sm = new_super_memory_region(sm_name);
   ioa_engine_handle e =
       create_ioa_engine(sm, eb, turn_params.listener.tp, turn_params.relay_ifname, turn_params.relays_number,
                         turn_params.relay_addrs, turn_params.default_relays, turn_params.verbose
@@ -946,6 +929,10 @@ static ioa_engine_handle create_new_listener_engine(void) {
       );
   set_ssl_ctx(e, &turn_params);
   ioa_engine_set_rtcp_map(e, turn_params.listener.rtcpmap);
+  ioa_engine_set_udp_send_batch(e, turn_params.udp_send_batch);
+  ioa_engine_set_udp_gro(e, turn_params.udp_gro);
+  ioa_engine_set_buffer_pool_size(e, turn_params.buffer_pool_size);
+  ioa_engine_set_handshake_offload(e);
   return e;
 }
 
@@ -966,7 +953,7 @@ static void *run_udp_listener_thread(void *arg) {
 }
 
 static void setup_listener(void) {
-  super_memory_t *sm = new_super_memory_region();
+  super_memory_t *sm = new_super_memory_region("listener");
 
   turn_params.listener.tp = turnipports_create(sm, turn_params.min_port, turn_params.max_port);
 
@@ -990,6 +977,10 @@ static void setup_listener(void) {
   set_ssl_ctx(turn_params.listener.ioa_eng, &turn_params);
   turn_params.listener.rtcpmap = rtcp_map_create(turn_params.listener.ioa_eng);
   ioa_engine_set_rtcp_map(turn_params.listener.ioa_eng, turn_params.listener.rtcpmap);
+  ioa_engine_set_udp_send_batch(turn_params.listener.ioa_eng, turn_params.udp_send_batch);
+  ioa_engine_set_udp_gro(turn_params.listener.ioa_eng, turn_params.udp_gro);
+  ioa_engine_set_buffer_pool_size(turn_params.listener.ioa_eng, turn_params.buffer_pool_size);
+  ioa_engine_set_handshake_offload(turn_params.listener.ioa_eng);
 
   {
     struct bufferevent *pair[2];
@@ -1113,7 +1104,9 @@ static void setup_socket_per_endpoint_udp_listener_servers(void) {
           is_5780 = is_5780 && (i >= (size_t)(turn_params.aux_servers_list.size));
         }
 
-        super_memory_t *sm = new_super_memory_region();
+        char sm_name[32];
+        snprintf(sm_name, sizeof(sm_name), "udp-relay-%lu", (unsigned long)i);
+        super_memory_t *sm = new_super_memory_region(sm_name);
         struct relay_server *udp_rs =
             (struct relay_server *)allocate_super_memory_region(sm, sizeof(struct relay_server));
         udp_rs->id = (turnserver_id)i + TURNSERVER_ID_BOUNDARY_BETWEEN_TCP_AND_UDP;
@@ -1258,6 +1251,19 @@ static void setup_socket_per_endpoint_udp_listener_servers(void) {
   }
 }
 
+/*
+ * All the relay threads have bound their own socket to the address: make
+ * the kernel pick the socket (and so the thread) by the client address.
+ * A DTLS session can only follow its client to a new port in the same
+ * thread, so with --dtls-rebind the port is left out of the hash.
+ */
+static void steer_udp_listener_servers(dtls_listener_relay_server_type **servers) {
+  size_t n = get_real_general_relay_servers_number();
+  if ((turn_params.udp_reuseport_steering || turn_params.dtls_rebind) && servers && (n > 1) && servers[n - 1]) {
+    dtls_listener_set_reuseport_steering(servers[n - 1], (int)n, !turn_params.dtls_rebind);
+  }
+}
+
 static void setup_socket_per_thread_udp_listener_servers(void) {
   size_t i = 0;
   size_t relayindex = 0;
@@ -1292,6 +1298,7 @@ static void setup_socket_per_thread_udp_listener_servers(void) {
             turn_params.listener_ifname, saddr, port, turn_params.verbose, general_relay_servers[relayindex]->ioa_eng,
             &(general_relay_servers[relayindex]->server), !relayindex, NULL);
       }
+      steer_udp_listener_servers(turn_params.listener.aux_udp_services[index]);
     }
   }
 
@@ -1313,6 +1320,7 @@ static void setup_socket_per_thread_udp_listener_servers(void) {
             general_relay_servers[relayindex]->ioa_eng, &(general_relay_servers[relayindex]->server), !relayindex,
             NULL);
       }
+      steer_udp_listener_servers(turn_params.listener.udp_services[index]);
 
       if (turn_params.rfc5780) {
 
@@ -1326,6 +1334,7 @@ static void setup_socket_per_thread_udp_listener_servers(void) {
               general_relay_servers[relayindex]->ioa_eng, &(general_relay_servers[relayindex]->server), !relayindex,
               NULL);
         }
+        steer_udp_listener_servers(turn_params.listener.udp_services[index + 1]);
       }
     } else {
       turn_params.listener.udp_services[index] = NULL;
@@ -1345,6 +1354,7 @@ static void setup_socket_per_thread_udp_listener_servers(void) {
             turn_params.verbose, general_relay_servers[relayindex]->ioa_eng,
             &(general_relay_servers[relayindex]->server), !relayindex, NULL);
       }
+      steer_udp_listener_servers(turn_params.listener.dtls_services[index]);
 
       if (turn_params.rfc5780) {
 
@@ -1359,6 +1369,7 @@ static void setup_socket_per_thread_udp_listener_servers(void) {
               turn_params.verbose, general_relay_servers[relayindex]->ioa_eng,
               &(general_relay_servers[relayindex]->server), !relayindex, NULL);
         }
+        steer_udp_listener_servers(turn_params.listener.dtls_services[index + 1]);
       }
     } else {
       turn_params.listener.dtls_services[index] = NULL;
@@ -1611,6 +1622,8 @@ void run_listener_server(struct listener_server *ls) {
 
     run_events(ls->event_base, ls->ioa_eng);
 
+    report_super_memory();
+
     rollover_logfile();
   }
 
@@ -1619,9 +1632,41 @@ void run_listener_server(struct listener_server *ls) {
 #endif
 }
 
-static void setup_relay_server(struct relay_server *rs, ioa_engine_handle e, int to_set_rfc5780) {
-  struct bufferevent *pair[2];
+static void report_queue(const mpsc_queue *q, mpsc_queue_stats *reported) {
+  mpsc_queue_stats stats;
+  mpsc_queue_get_stats(q, &stats);
+  prom_set_queue(mpsc_queue_name(q), (unsigned long)stats.depth, (unsigned long)(stats.wakeups - reported->wakeups),
+                 (unsigned long)(stats.drops - reported->drops));
+  *reported = stats;
+}
 
+static void report_auth_server(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  struct auth_server *as = (struct auth_server *)arg;
+  report_queue(as->queue, &(as->queue_reported));
+}
+
+static void report_relay_server(ioa_engine_handle e, void *arg) {
+  UNUSED_ARG(e);
+
+  struct relay_server *rs = (struct relay_server *)arg;
+  uint64_t fast = rs->server.channel_data_fast;
+  uint64_t slow = rs->server.channel_data_slow;
+
+  if ((fast != rs->channel_data_fast_reported) || (slow != rs->channel_data_slow_reported)) {
+    prom_add_channel_data((unsigned long)(fast - rs->channel_data_fast_reported),
+                          (unsigned long)(slow - rs->channel_data_slow_reported));
+    rs->channel_data_fast_reported = fast;
+    rs->channel_data_slow_reported = slow;
+  }
+
+  report_queue(rs->queue, &(rs->queue_reported));
+  report_queue(rs->auth_queue, &(rs->auth_queue_reported));
+}
+
+static void setup_relay_server(struct relay_server *rs, ioa_engine_handle e, int to_set_rfc5780) {
   if (e) {
     rs->event_base = e->event_base;
     rs->ioa_eng = e;
@@ -1637,19 +1682,42 @@ static void setup_relay_server(struct relay_server *rs, ioa_engine_handle e, int
     );
     set_ssl_ctx(rs->ioa_eng, &turn_params);
     ioa_engine_set_rtcp_map(rs->ioa_eng, turn_params.listener.rtcpmap);
+    ioa_engine_set_udp_send_batch(rs->ioa_eng, turn_params.udp_send_batch);
+    ioa_engine_set_udp_gro(rs->ioa_eng, turn_params.udp_gro);
+    ioa_engine_set_buffer_pool_size(rs->ioa_eng, turn_params.buffer_pool_size);
+  }
+  ioa_engine_set_handshake_offload(rs->ioa_eng);
+  /* the turn server reads the dynamic peer IP lists */
+  ioa_engine_track_quiescence(rs->ioa_eng);
+
+  if (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_THREAD_URING) {
+    if (ioa_engine_set_io_uring(rs->ioa_eng) < 0) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: io_uring is not available, relay server %d uses libevent\n",
+                    __FUNCTION__, (int)rs->id);
+    } else if (!turn_params.udp_send_batch) {
+      /* the transmit side of the io_uring engine is the sendmmsg() queue */
+      ioa_engine_set_udp_send_batch(rs->ioa_eng, MAX_UDP_SEND_BATCH);
+    }
   }
 
-  bufferevent_pair_new(rs->event_base, TURN_BUFFEREVENTS_OPTIONS, pair);
-  rs->in_buf = pair[0];
-  rs->out_buf = pair[1];
-  bufferevent_setcb(rs->in_buf, relay_receive_message, NULL, NULL, rs);
-  bufferevent_enable(rs->in_buf, EV_READ);
+  {
+    char name[32];
+    snprintf(name, sizeof(name), "relay-%lu", (unsigned long)rs->id);
+    rs->queue = mpsc_queue_new(rs->event_base, name, RELAY_QUEUE_SIZE, sizeof(struct message_to_relay),
+                               relay_receive_message, rs);
+    snprintf(name, sizeof(name), "relay-%lu-auth", (unsigned long)rs->id);
+    rs->auth_queue = mpsc_queue_new(rs->event_base, name, AUTH_QUEUE_SIZE, sizeof(struct auth_message),
+                                    relay_receive_auth_message, rs);
+    if (!(rs->queue) || !(rs->auth_queue)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: cannot create the queues of relay server %d\n", __FUNCTION__,
+                    (int)rs->id);
+      exit(-1);
+    }
+  }
 
-  bufferevent_pair_new(rs->event_base, TURN_BUFFEREVENTS_OPTIONS, pair);
-  rs->auth_in_buf = pair[0];
-  rs->auth_out_buf = pair[1];
-  bufferevent_setcb(rs->auth_in_buf, relay_receive_auth_message, NULL, NULL, rs);
-  bufferevent_enable(rs->auth_in_buf, EV_READ);
+  if (turn_params.auth_cache_size > 0) {
+    rs->auth_cache = auth_cache_new((size_t)turn_params.auth_cache_size, (turn_time_t)turn_params.auth_cache_ttl);
+  }
 
   init_turn_server(
       &(rs->server), rs->id, turn_params.verbose, rs->ioa_eng, turn_params.ct, turn_params.fingerprint,
@@ -1670,7 +1738,11 @@ static void setup_relay_server(struct relay_server *rs, ioa_engine_handle e, int
     set_rfc5780(&(rs->server), get_alt_addr, send_message_from_listener_to_client);
   }
 
-  if (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_THREAD) {
+  if (turn_params.prometheus) {
+    set_ioa_timer(rs->ioa_eng, 1, 0, report_relay_server, rs, 1, "report_relay_server");
+  }
+
+  if (udp_socket_per_thread()) {
     setup_tcp_listener_servers(rs->ioa_eng, rs);
   }
 }
@@ -1679,8 +1751,7 @@ static void *run_general_relay_thread(void *arg) {
   static int always_true = 1;
   struct relay_server *rs = (struct relay_server *)arg;
 
-  int udp_reuses_the_same_relay_server = (turn_params.general_relay_servers_number <= 1) ||
-                                         (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_THREAD) ||
+  int udp_reuses_the_same_relay_server = (turn_params.general_relay_servers_number <= 1) || udp_socket_per_thread() ||
                                          (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_SESSION);
 
   int we_need_rfc5780 = udp_reuses_the_same_relay_server && turn_params.rfc5780;
@@ -1709,12 +1780,14 @@ static void setup_general_relay_servers(void) {
       general_relay_servers[i]->id = (turnserver_id)i;
       general_relay_servers[i]->sm = NULL;
       setup_relay_server(general_relay_servers[i], turn_params.listener.ioa_eng,
-                         ((turn_params.net_engine_version == NEV_UDP_SOCKET_PER_THREAD) ||
+                         (udp_socket_per_thread() ||
                           (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_SESSION)) &&
                              turn_params.rfc5780);
       general_relay_servers[i]->thr = pthread_self();
     } else {
-      super_memory_t *sm = new_super_memory_region();
+      char sm_name[32];
+      snprintf(sm_name, sizeof(sm_name), "relay-%lu", (unsigned long)i);
+      super_memory_t *sm = new_super_memory_region(sm_name);
       general_relay_servers[i] = (struct relay_server *)allocate_super_memory_region(sm, sizeof(struct relay_server));
       general_relay_servers[i]->id = (turnserver_id)i;
       general_relay_servers[i]->sm = sm;
@@ -1738,18 +1811,53 @@ static void *run_auth_server_thread(void *arg) {
 
   if (id == 0) {
 
-    reread_realms();
-    update_white_and_black_lists();
+    const turn_dbdriver_t *dbd = get_dbdriver();
+    bool track_changes = turn_params.db_change_notifications && dbd && dbd->get_changes;
+
+    if (turn_params.db_change_notifications && !track_changes) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "The user DB does not report its changes, it is reread periodically\n");
+    }
+
+    int reread_interval = turn_params.db_reread_interval;
+    if (reread_interval < 1) {
+      reread_interval = track_changes ? DEFAULT_DB_NOTIFY_REREAD_INTERVAL : DEFAULT_DB_REREAD_INTERVAL;
+    }
+    if (track_changes) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "DB change notifications are on, full DB reread every %d seconds\n",
+                    reread_interval);
+    }
+
+    if (track_changes) {
+      /* Start the tracking early: the changes made until it is ready are reported as changes of everything */
+      unsigned int changes = 0;
+      (*dbd->get_changes)(&changes);
+    }
+    reread_db_changes(DBD_CHANGE_CONFIG);
 
     barrier_wait();
 
+    turn_time_t last_reread = turn_time();
+
     while (run_auth_server_flag) {
 #if defined(DB_TEST)
       run_db_test();
 #endif
-      sleep(5);
-      reread_realms();
-      update_white_and_black_lists();
+      sleep(track_changes ? 1 : (unsigned int)reread_interval);
+
+      unsigned int changes = 0;
+      if (track_changes) {
+        (*dbd->get_changes)(&changes);
+      }
+
+      turn_time_t now = turn_time();
+      if (!track_changes || (now >= last_reread + (turn_time_t)reread_interval)) {
+        changes |= DBD_CHANGE_CONFIG;
+        last_reread = now;
+      }
+
+      if (changes) {
+        reread_db_changes(changes);
+      }
     }
 
   } else {
@@ -1760,13 +1868,20 @@ static void *run_auth_server_thread(void *arg) {
 
     as->event_base = turn_event_base_new();
 
-    struct bufferevent *pair[2];
+    char name[32];
+    snprintf(name, sizeof(name), "auth-%lu", (unsigned long)id);
+    as->queue = mpsc_queue_new(as->event_base, name, AUTH_QUEUE_SIZE, sizeof(struct auth_message),
+                               auth_server_receive_message, as);
+    if (!(as->queue)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: cannot create the queue of auth server %d\n", __FUNCTION__, (int)id);
+      exit(-1);
+    }
 
-    bufferevent_pair_new(as->event_base, TURN_BUFFEREVENTS_OPTIONS, pair);
-    as->in_buf = pair[0];
-    as->out_buf = pair[1];
-    bufferevent_setcb(as->in_buf, auth_server_receive_message, NULL, NULL, as);
-    bufferevent_enable(as->in_buf, EV_READ);
+    if (turn_params.prometheus) {
+      struct event *ev = event_new(as->event_base, -1, EV_PERSIST, report_auth_server, as);
+      struct timeval tv = {1, 0};
+      evtimer_add(ev, &tv);
+    }
 
 #if !defined(TURN_NO_HIREDIS)
     as->rch = get_redis_async_connection(as->event_base, &turn_params.redis_statsdb, 1);
@@ -1832,6 +1947,11 @@ void setup_server(void) {
   TURN_MUTEX_INIT(&mutex_bps);
   TURN_MUTEX_INIT(&auth_message_counter_mutex);
 
+  if (tls_handshake_pool_start(turn_params.handshake_threads) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: cannot start the handshake threads\n", __FUNCTION__);
+    exit(-1);
+  }
+
   authserver_number = 1 + (authserver_id)(turn_params.cpus / 2);
 
   if (authserver_number < MIN_AUTHSERVER_NUMBER) {
@@ -1853,7 +1973,12 @@ void setup_server(void) {
   setup_general_relay_servers();
   TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "Total General servers: %d\n", (int)get_real_general_relay_servers_number());
 
-  if (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_THREAD) {
+  if (turn_params.udp_reuseport_steering && !udp_socket_per_thread()) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: --udp-reuseport-steering needs the network engine %d or %d; ignored\n",
+                  __FUNCTION__, (int)NEV_UDP_SOCKET_PER_THREAD, (int)NEV_UDP_SOCKET_PER_THREAD_URING);
+  }
+
+  if (udp_socket_per_thread()) {
     setup_socket_per_thread_udp_listener_servers();
   } else if (turn_params.net_engine_version == NEV_UDP_SOCKET_PER_ENDPOINT) {
     setup_socket_per_endpoint_udp_listener_servers();
@@ -1861,7 +1986,7 @@ void setup_server(void) {
     setup_socket_per_session_udp_listener_servers();
   }
 
-  if (turn_params.net_engine_version != NEV_UDP_SOCKET_PER_THREAD) {
+  if (!udp_socket_per_thread()) {
     setup_tcp_listener_servers(turn_params.listener.ioa_eng, NULL);
   }
 
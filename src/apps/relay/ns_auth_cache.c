@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#include "ns_auth_cache.h"
+
+#include "ns_turn_ioaddr.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Set-associative table: a user can only live in the AUTH_CACHE_WAYS
+ * entries of the set selected by its hash, and a new user takes the place
+ * of the entry of the set that expires first. The entries of a former
+ * generation are treated as expired.
+ */
+
+#define AUTH_CACHE_WAYS (4)
+
+typedef struct _auth_cache_entry {
+  uint32_t hash;
+  unsigned int generation;
+  turn_time_t expiration;
+  bool success;
+  char *realm; /* the username follows the realm in the same allocation */
+  char *usname;
+  hmackey_t key;
+} auth_cache_entry;
+
+struct _auth_cache {
+  auth_cache_entry *entries;
+  size_t sets_mask;
+  turn_time_t ttl;
+};
+
+static unsigned int auth_cache_current_generation = 0;
+
+static uint32_t auth_cache_hash(const uint8_t *realm, const uint8_t *usname) {
+  uint32_t hash = 0;
+  int c = 0;
+
+  while ((c = *realm++)) {
+    hash = c + (hash << 6) + (hash << 16) - hash;
+  }
+  hash = (hash << 6) + (hash << 16) - hash;
+  while ((c = *usname++)) {
+    hash = c + (hash << 6) + (hash << 16) - hash;
+  }
+
+  return hash_int32(hash);
+}
+
+static bool auth_cache_entry_valid(const auth_cache_entry *e, unsigned int generation, turn_time_t ct) {
+  return e->realm && (e->generation == generation) && turn_time_before(ct, e->expiration);
+}
+
+static void auth_cache_entry_clean(auth_cache_entry *e) {
+  free(e->realm);
+  memset(e, 0, sizeof(auth_cache_entry));
+}
+
+auth_cache *auth_cache_new(size_t size, turn_time_t ttl) {
+  size_t entries = AUTH_CACHE_WAYS;
+  while (entries < size) {
+    entries <<= 1;
+  }
+
+  auth_cache *ac = (auth_cache *)calloc(1, sizeof(auth_cache));
+  if (!ac) {
+    return NULL;
+  }
+
+  ac->entries = (auth_cache_entry *)calloc(entries, sizeof(auth_cache_entry));
+  if (!(ac->entries)) {
+    free(ac);
+    return NULL;
+  }
+
+  ac->sets_mask = entries / AUTH_CACHE_WAYS - 1;
+  ac->ttl = ttl;
+
+  return ac;
+}
+
+void auth_cache_free(auth_cache *ac) {
+  if (ac) {
+    size_t i;
+    for (i = 0; i < (ac->sets_mask + 1) * AUTH_CACHE_WAYS; ++i) {
+      auth_cache_entry_clean(&(ac->entries[i]));
+    }
+    free(ac->entries);
+    free(ac);
+  }
+}
+
+static auth_cache_entry *auth_cache_set(auth_cache *ac, uint32_t hash) {
+  return ac->entries + (hash & ac->sets_mask) * AUTH_CACHE_WAYS;
+}
+
+static auth_cache_entry *auth_cache_find(auth_cache_entry *set, uint32_t hash, const uint8_t *realm,
+                                         const uint8_t *usname) {
+  size_t i;
+  for (i = 0; i < AUTH_CACHE_WAYS; ++i) {
+    auth_cache_entry *e = &(set[i]);
+    if (e->realm && (e->hash == hash) && !strcmp(e->realm, (const char *)realm) &&
+        !strcmp(e->usname, (const char *)usname)) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+const uint8_t *auth_cache_get(auth_cache *ac, const uint8_t *realm, const uint8_t *usname, bool *found) {
+  *found = false;
+
+  if (!ac || !realm || !usname) {
+    return NULL;
+  }
+
+  uint32_t hash = auth_cache_hash(realm, usname);
+  auth_cache_entry *e = auth_cache_find(auth_cache_set(ac, hash), hash, realm, usname);
+  if (!e) {
+    return NULL;
+  }
+
+  if (!auth_cache_entry_valid(e, auth_cache_generation(), turn_time())) {
+    auth_cache_entry_clean(e);
+    return NULL;
+  }
+
+  *found = true;
+
+  return e->success ? e->key : NULL;
+}
+
+void auth_cache_put(auth_cache *ac, const uint8_t *realm, const uint8_t *usname, const uint8_t *key,
+                    unsigned int generation, turn_time_t not_after) {
+  if (!ac || !realm || !usname || (generation != auth_cache_generation())) {
+    return;
+  }
+
+  turn_time_t ct = turn_time();
+  turn_time_t ttl = ac->ttl;
+  if (!key && (ttl > AUTH_CACHE_NEGATIVE_TTL)) {
+    ttl = AUTH_CACHE_NEGATIVE_TTL;
+  }
+  turn_time_t expiration = ct + ttl;
+  if (not_after && turn_time_before(not_after, expiration)) {
+    expiration = not_after;
+  }
+  if (!turn_time_before(ct, expiration)) {
+    return;
+  }
+
+  uint32_t hash = auth_cache_hash(realm, usname);
+  auth_cache_entry *set = auth_cache_set(ac, hash);
+  auth_cache_entry *e = auth_cache_find(set, hash, realm, usname);
+
+  if (!e) {
+    size_t i;
+    for (i = 0; i < AUTH_CACHE_WAYS; ++i) {
+      if (!auth_cache_entry_valid(&(set[i]), generation, ct)) {
+        e = &(set[i]);
+        break;
+      }
+      if (!e || turn_time_before(set[i].expiration, e->expiration)) {
+        e = &(set[i]);
+      }
+    }
+
+    auth_cache_entry_clean(e);
+
+    size_t realm_len = strlen((const char *)realm);
+    size_t usname_len = strlen((const char *)usname);
+    e->realm = (char *)malloc(realm_len + usname_len + 2);
+    if (!(e->realm)) {
+      return;
+    }
+    memcpy(e->realm, realm, realm_len + 1);
+    e->usname = e->realm + realm_len + 1;
+    memcpy(e->usname, usname, usname_len + 1);
+    e->hash = hash;
+  }
+
+  e->generation = generation;
+  e->expiration = expiration;
+  e->success = (key != NULL);
+  if (key) {
+    memcpy(e->key, key, sizeof(hmackey_t));
+  } else {
+    memset(e->key, 0, sizeof(hmackey_t));
+  }
+}
+
+unsigned int auth_cache_generation(void) {
+  return __atomic_load_n(&auth_cache_current_generation, __ATOMIC_ACQUIRE);
+}
+
+void auth_cache_invalidate_all(void) { __atomic_add_fetch(&auth_cache_current_generation, 1, __ATOMIC_ACQ_REL); }
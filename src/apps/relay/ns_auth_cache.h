@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Per-relay-thread cache of the long-term credential keys
+ */
+
+#ifndef __IOA_AUTH_CACHE__
+#define __IOA_AUTH_CACHE__
+
+#include "ns_turn_defs.h"
+#include "ns_turn_msg.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////
+
+/*
+ * Maps (realm, username) to the key derived by the auth threads, or to the
+ * fact that the user could not be authenticated. The cache is owned by one
+ * relay thread and is not thread-safe; only the generation counter, which
+ * invalidates every cache at once, is shared.
+ */
+
+typedef struct _auth_cache auth_cache;
+
+/* Failed lookups are remembered for at most that many seconds */
+#define AUTH_CACHE_NEGATIVE_TTL (5)
+
+/*
+ * Create a cache of size (rounded up to a power of 2) entries; the entries
+ * expire ttl seconds after they are stored.
+ * Return: the cache, or NULL on failure.
+ */
+auth_cache *auth_cache_new(size_t size, turn_time_t ttl);
+void auth_cache_free(auth_cache *ac);
+
+/*
+ * Find the user; *found is set when the cache has an answer, and the
+ * answer is the returned key, or NULL if the user has been rejected.
+ * The key is valid until the next change of the cache.
+ */
+const uint8_t *auth_cache_get(auth_cache *ac, const uint8_t *realm, const uint8_t *usname, bool *found);
+
+/*
+ * Remember the key of the user (NULL when the user was rejected), as
+ * obtained at the given generation. not_after, if not 0, is the time after
+ * which the credentials are no longer valid.
+ */
+void auth_cache_put(auth_cache *ac, const uint8_t *realm, const uint8_t *usname, const uint8_t *key,
+                    unsigned int generation, turn_time_t not_after);
+
+/* Current generation; may be called from any thread */
+unsigned int auth_cache_generation(void);
+
+/* Drop the entries of all the caches; may be called from any thread */
+void auth_cache_invalidate_all(void);
+
+///////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__IOA_AUTH_CACHE__
@@ -28,6 +28,10 @@
  * SUCH DAMAGE.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* recvmmsg() */
+#endif
+
 #include "ns_turn_khash.h"
 #include "ns_turn_server.h"
 #include "ns_turn_session.h"
@@ -37,6 +41,8 @@
 #include "stun_buffer.h"
 
 #include "ns_ioalib_impl.h"
+#include "ns_ioalib_uring.h"
+#include "ns_tls_handshake.h"
 
 #include "prom_server.h"
 
@@ -88,9 +94,6 @@ struct turn_sock_extended_err {
 
 #define SSL_MAX_RENEG_NUMBER (3)
 
-const int predef_timer_intervals[PREDEF_TIMERS_NUM] = {30,  60,  90,  120, 240, 300,  360,
-                                                       540, 600, 700, 800, 900, 1800, 3600};
-
 /************** Forward function declarations ******/
 
 static int socket_readerr(evutil_socket_t fd, ioa_addr *orig_addr);
@@ -106,6 +109,11 @@ static int set_accept_cb(ioa_socket_handle s, accept_cb acb, void *arg);
 
 static void close_socket_net_data(ioa_socket_handle s);
 
+static void udp_send_failed(ioa_socket_handle s, const ioa_addr *dest_addr);
+
+static uint64_t timer_wheel_clock(void);
+static void report_timer_wheel(ioa_engine_handle e);
+
 /************** Utils **************************/
 
 static const int tcp_congestion_control = 1;
@@ -232,6 +240,7 @@ int set_df_on_ioa_socket(ioa_socket_handle s, int value) {
   }
 
   if (s->current_df_relay_flag != value) {
+    ioa_engine_flush_udp_send_queue(s->e);
     s->current_df_relay_flag = value;
     return set_socket_df(s->fd, s->family, value);
   }
@@ -244,6 +253,7 @@ void set_do_not_use_df(ioa_socket_handle s) {
     return;
   }
 
+  ioa_engine_flush_udp_send_queue(s->e);
   s->do_not_use_df = 1;
   s->current_df_relay_flag = 1;
   set_socket_df(s->fd, s->family, 0);
@@ -258,45 +268,43 @@ static int buffer_list_empty(stun_buffer_list *bufs) {
   return 1;
 }
 
-static stun_buffer_list_elem *get_elem_from_buffer_list(stun_buffer_list *bufs) {
-  stun_buffer_list_elem *ret = NULL;
-
+static void pop_elem_from_buffer_list(stun_buffer_list *bufs) {
   if (bufs && bufs->head && bufs->tsz) {
 
-    ret = bufs->head;
+    stun_buffer_list_elem *ret = bufs->head;
     bufs->head = ret->next;
     --bufs->tsz;
     if (bufs->tsz == 0) {
       bufs->tail = NULL;
     }
-
-    ret->next = NULL;
-    ret->buf.len = 0;
-    ret->buf.offset = 0;
-    ret->buf.coffset = 0;
+    free(ret);
   }
+}
 
-  return ret;
+static inline size_t blist_elem_alloc_size(nbuf_class bclass) {
+  return (bclass == NBUF_CLASS_SMALL) ? NBUF_SMALL_ALLOC_SIZE : sizeof(stun_buffer_list_elem);
 }
 
-static void pop_elem_from_buffer_list(stun_buffer_list *bufs) {
-  if (bufs && bufs->head && bufs->tsz) {
+static inline size_t blist_elem_capacity(const stun_buffer_list_elem *buf_elem) {
+  return (buf_elem->bclass == NBUF_CLASS_SMALL) ? NBUF_SMALL_CAPACITY : STUN_BUFFER_SIZE;
+}
 
-    stun_buffer_list_elem *ret = bufs->head;
+/*
+ * The engine keeps a free list per size class. It is used as a stack, so
+ * that the most recently released (cache-hot) buffer is reused first.
+ */
+static stun_buffer_list_elem *new_blist_elem_class(ioa_engine_handle e, nbuf_class bclass) {
+  stun_buffer_list *bufs = &(e->bufs[bclass]);
+  stun_buffer_list_elem *ret = bufs->head;
+
+  if (ret) {
     bufs->head = ret->next;
-    --bufs->tsz;
-    if (bufs->tsz == 0) {
+    if (--bufs->tsz == 0) {
       bufs->tail = NULL;
     }
-    free(ret);
-  }
-}
-
-static stun_buffer_list_elem *new_blist_elem(ioa_engine_handle e) {
-  stun_buffer_list_elem *ret = get_elem_from_buffer_list(&(e->bufs));
-
-  if (!ret) {
-    ret = (stun_buffer_list_elem *)malloc(sizeof(stun_buffer_list_elem));
+  } else {
+    ret = (stun_buffer_list_elem *)malloc(blist_elem_alloc_size(bclass));
+    ++(e->bufs_stats[bclass].misses);
   }
 
   if (ret) {
@@ -304,6 +312,11 @@ static stun_buffer_list_elem *new_blist_elem(ioa_engine_handle e) {
     ret->buf.offset = 0;
     ret->buf.coffset = 0;
     ret->next = NULL;
+    ret->bclass = bclass;
+    nbuf_pool_stats *st = &(e->bufs_stats[bclass]);
+    if (++(st->in_use) > st->high_water) {
+      st->high_water = st->in_use;
+    }
   } else {
     TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: Cannot allocate memory for STUN buffer!\n", __FUNCTION__);
   }
@@ -311,6 +324,14 @@ static stun_buffer_list_elem *new_blist_elem(ioa_engine_handle e) {
   return ret;
 }
 
+static stun_buffer_list_elem *new_blist_elem(ioa_engine_handle e) {
+  return new_blist_elem_class(e, NBUF_CLASS_LARGE);
+}
+
+static stun_buffer_list_elem *new_blist_elem_size(ioa_engine_handle e, size_t size) {
+  return new_blist_elem_class(e, (size <= NBUF_SMALL_DATAGRAM_SIZE) ? NBUF_CLASS_SMALL : NBUF_CLASS_LARGE);
+}
+
 static inline void add_elem_to_buffer_list(stun_buffer_list *bufs, stun_buffer_list_elem *buf_elem) {
   // We want a queue, so add to tail
   if (bufs->tail) {
@@ -325,7 +346,9 @@ static inline void add_elem_to_buffer_list(stun_buffer_list *bufs, stun_buffer_l
 
 static void add_buffer_to_buffer_list(stun_buffer_list *bufs, char *buf, size_t len) {
   if (bufs && buf && (bufs->tsz < MAX_SOCKET_BUFFER_BACKLOG)) {
-    stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)malloc(sizeof(stun_buffer_list_elem));
+    nbuf_class bclass = (len <= NBUF_SMALL_CAPACITY) ? NBUF_CLASS_SMALL : NBUF_CLASS_LARGE;
+    stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)malloc(blist_elem_alloc_size(bclass));
+    buf_elem->bclass = bclass;
     memcpy(buf_elem->buf.buf, buf, len);
     buf_elem->buf.len = len;
     buf_elem->buf.offset = 0;
@@ -336,16 +359,87 @@ static void add_buffer_to_buffer_list(stun_buffer_list *bufs, char *buf, size_t
 
 static void free_blist_elem(ioa_engine_handle e, stun_buffer_list_elem *buf_elem) {
   if (buf_elem) {
-    if (e && (e->bufs.tsz < MAX_BUFFER_QUEUE_SIZE_PER_ENGINE)) {
-      add_elem_to_buffer_list(&(e->bufs), buf_elem);
-    } else {
-      free(buf_elem);
+    if (e) {
+      stun_buffer_list *bufs = &(e->bufs[buf_elem->bclass]);
+      --(e->bufs_stats[buf_elem->bclass].in_use);
+      if (bufs->tsz < e->bufs_max) {
+        buf_elem->next = bufs->head;
+        bufs->head = buf_elem;
+        if (!(bufs->tail)) {
+          bufs->tail = buf_elem;
+        }
+        bufs->tsz += 1;
+        return;
+      }
+    }
+    free(buf_elem);
+  }
+}
+
+void ioa_engine_set_buffer_pool_size(ioa_engine_handle e, int size) {
+  if (e) {
+    e->bufs_max = (size > 0) ? (size_t)size : 0;
+    for (int i = 0; i < NBUF_CLASS_NUM; ++i) {
+      while (e->bufs[i].tsz > e->bufs_max) {
+        pop_elem_from_buffer_list(&(e->bufs[i]));
+      }
+    }
+  }
+}
+
+static void report_buffer_pool(ioa_engine_handle e) {
+  for (int i = 0; i < NBUF_CLASS_NUM; ++i) {
+    nbuf_pool_stats *st = &(e->bufs_stats[i]);
+    nbuf_pool_stats *rep = &(e->bufs_reported[i]);
+    if ((st->in_use != rep->in_use) || (st->high_water != rep->high_water) || (st->misses != rep->misses)) {
+      prom_add_buffer_pool(i == NBUF_CLASS_SMALL, st->in_use - rep->in_use, st->high_water - rep->high_water,
+                           st->misses - rep->misses);
+      memcpy(rep, st, sizeof(nbuf_pool_stats));
     }
   }
 }
 
 /************** ENGINE *************************/
 
+/////////////// Quiescent states ////////////////
+
+static uint64_t quiescent_epoch = 1;
+static pthread_mutex_t quiescent_engines_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ioa_engine_handle quiescent_engines = NULL;
+
+void ioa_engine_track_quiescence(ioa_engine_handle e) {
+  if (e) {
+    pthread_mutex_lock(&quiescent_engines_mutex);
+    ioa_engine_handle te = quiescent_engines;
+    while (te && (te != e)) {
+      te = te->quiescent_next;
+    }
+    if (!te) {
+      __atomic_store_n(&(e->quiescent_epoch), __atomic_load_n(&quiescent_epoch, __ATOMIC_SEQ_CST), __ATOMIC_RELEASE);
+      e->quiescent_next = quiescent_engines;
+      quiescent_engines = e;
+    }
+    pthread_mutex_unlock(&quiescent_engines_mutex);
+  }
+}
+
+uint64_t ioa_engines_next_epoch(void) { return __atomic_add_fetch(&quiescent_epoch, 1, __ATOMIC_SEQ_CST); }
+
+uint64_t ioa_engines_quiescent_epoch(void) {
+  uint64_t ret = UINT64_MAX;
+  pthread_mutex_lock(&quiescent_engines_mutex);
+  for (ioa_engine_handle e = quiescent_engines; e; e = e->quiescent_next) {
+    uint64_t epoch = __atomic_load_n(&(e->quiescent_epoch), __ATOMIC_ACQUIRE);
+    if (epoch < ret) {
+      ret = epoch;
+    }
+  }
+  pthread_mutex_unlock(&quiescent_engines_mutex);
+  return ret;
+}
+
+/////////////// Engine timer ////////////////
+
 static void timer_handler(ioa_engine_handle e, void *arg) {
 
   UNUSED_ARG(arg);
@@ -354,6 +448,20 @@ static void timer_handler(ioa_engine_handle e, void *arg) {
   _log_time_value_set = 1;
 
   e->jiffie = _log_time_value;
+
+  __atomic_store_n(&(e->quiescent_epoch), __atomic_load_n(&quiescent_epoch, __ATOMIC_SEQ_CST), __ATOMIC_RELEASE);
+
+  report_buffer_pool(e);
+  report_timer_wheel(e);
+
+  if (e->handshake_queue) {
+    mpsc_queue_stats stats;
+    mpsc_queue_get_stats(e->handshake_queue, &stats);
+    prom_set_queue(mpsc_queue_name(e->handshake_queue), (unsigned long)stats.depth,
+                   (unsigned long)(stats.wakeups - e->handshake_queue_reported.wakeups),
+                   (unsigned long)(stats.drops - e->handshake_queue_reported.drops));
+    e->handshake_queue_reported = stats;
+  }
 }
 
 ioa_engine_handle create_ioa_engine(super_memory_t *sm, struct event_base *eb, turnipports *tp,
@@ -400,6 +508,7 @@ ioa_engine_handle create_ioa_engine(super_memory_t *sm, struct event_base *eb, t
     e->default_relays = default_relays;
     e->verbose = verbose;
     e->tp = tp;
+    e->bufs_max = MAX_BUFFER_QUEUE_SIZE_PER_ENGINE;
     if (eb) {
       e->event_base = eb;
       e->deallocate_eb = 0;
@@ -412,23 +521,8 @@ ioa_engine_handle create_ioa_engine(super_memory_t *sm, struct event_base *eb, t
     e->rch = get_redis_async_connection(e->event_base, redis_stats_db, 0);
 #endif
 
-    {
-      int t;
-      for (t = 0; t < PREDEF_TIMERS_NUM; ++t) {
-        struct timeval duration;
-        duration.tv_sec = predef_timer_intervals[t];
-        duration.tv_usec = 0;
-        const struct timeval *ptv = event_base_init_common_timeout(e->event_base, &duration);
-        if (!ptv) {
-          TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "FATAL: cannot create preferable timeval for %d secs (%d number)\n",
-                        predef_timer_intervals[t], t);
-          exit(-1);
-        } else {
-          memcpy(&(e->predef_timers[t]), ptv, sizeof(struct timeval));
-          e->predef_timer_intervals[t] = predef_timer_intervals[t];
-        }
-      }
-    }
+    e->tw_tick = timer_wheel_clock() / TIMER_WHEEL_TICK_MS;
+    timer_wheel_init(&(e->tw), e->tw_tick);
 
     if (relay_ifname) {
       STRCPY(e->relay_ifname, relay_ifname);
@@ -456,6 +550,217 @@ void ioa_engine_set_rtcp_map(ioa_engine_handle e, rtcp_map *rtcpmap) {
   }
 }
 
+/************** UDP send queue *************************/
+
+static void udp_send_queue_handler(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+  ioa_engine_flush_udp_send_queue((ioa_engine_handle)arg);
+}
+
+void ioa_engine_set_udp_send_batch(ioa_engine_handle e, int batch) {
+  if (e) {
+#if UDP_MMSG_SUPPORTED
+    if (batch > MAX_UDP_SEND_BATCH) {
+      batch = MAX_UDP_SEND_BATCH;
+    }
+    if (batch > 1) {
+      if (!(e->udp_sq_ev)) {
+        e->udp_sq_ev = event_new(e->event_base, -1, 0, udp_send_queue_handler, e);
+      }
+      if (e->udp_sq_ev) {
+        e->udp_send_batch = batch;
+        e->udp_gso = UDP_GSO_SUPPORTED;
+        return;
+      }
+    }
+#endif
+    ioa_engine_flush_udp_send_queue(e);
+    e->udp_send_batch = 0;
+  }
+}
+
+void ioa_engine_set_udp_gro(ioa_engine_handle e, int gro) {
+  if (e) {
+    e->udp_gro = UDP_GRO_SUPPORTED && gro;
+  }
+}
+
+/*
+ * Takes the ownership of nbh. The datagram is sent when the queue is
+ * flushed: at the end of the current event loop iteration, when the queue
+ * is full, or before the socket options (TTL, TOS, DF) or the socket
+ * itself change.
+ */
+static void udp_send_enqueue(ioa_socket_handle s, const ioa_addr *dest_addr, ioa_network_buffer_handle nbh) {
+  ioa_engine_handle e = s->e;
+
+  if (e->udp_sq_size >= (size_t)e->udp_send_batch) {
+    ioa_engine_flush_udp_send_queue(e);
+  }
+
+  udp_send_queue_elem *qe = &(e->udp_sq[e->udp_sq_size++]);
+  qe->s = s;
+  qe->fd = s->parent_s ? s->parent_s->fd : s->fd;
+  qe->nbh = nbh;
+  if (dest_addr) {
+    qe->dest_set = 1;
+    addr_cpy(&(qe->dest), dest_addr);
+  } else {
+    qe->dest_set = 0;
+  }
+
+  if (e->udp_sq_size == 1) {
+    event_active(e->udp_sq_ev, EV_WRITE, 0);
+  }
+}
+
+static void udp_send_queue_elem_send(udp_send_queue_elem *qe) {
+  const ioa_addr *dest_addr = qe->dest_set ? &(qe->dest) : NULL;
+  if (udp_send(qe->s, dest_addr, (char *)ioa_network_buffer_data(qe->nbh),
+               (int)ioa_network_buffer_get_size(qe->nbh)) < 0) {
+    udp_send_failed(qe->s, dest_addr);
+  }
+}
+
+#if UDP_MMSG_SUPPORTED
+
+/*
+ * Number of queue elements, starting from the first one, that can be sent
+ * as one UDP GSO datagram: same socket and destination, equal sizes (only
+ * the last segment may be shorter).
+ */
+static size_t udp_send_queue_gso_segments(ioa_engine_handle e, size_t first, size_t last) {
+  size_t n = 1;
+#if UDP_GSO_SUPPORTED
+  if (e->udp_gso) {
+    const udp_send_queue_elem *qf = &(e->udp_sq[first]);
+    size_t seg = ioa_network_buffer_get_size(qf->nbh);
+    size_t total = seg;
+    while ((first + n < last) && (n < MAX_UDP_SEND_BATCH)) {
+      const udp_send_queue_elem *qe = &(e->udp_sq[first + n]);
+      size_t sz = ioa_network_buffer_get_size(qe->nbh);
+      if ((qe->fd != qf->fd) || (qe->dest_set != qf->dest_set) ||
+          (qe->dest_set && !addr_eq(&(qe->dest), &(qf->dest))) || !sz || (sz > seg) ||
+          (total + sz > UDP_GSO_MAX_SIZE)) {
+        break;
+      }
+      total += sz;
+      ++n;
+      if (sz < seg) {
+        break;
+      }
+    }
+  }
+#else
+  UNUSED_ARG(e);
+  UNUSED_ARG(first);
+  UNUSED_ARG(last);
+#endif
+  return n;
+}
+
+#endif
+
+void ioa_engine_flush_udp_send_queue(ioa_engine_handle e) {
+  if (!e || !(e->udp_sq_size)) {
+    return;
+  }
+
+  const size_t qsz = e->udp_sq_size;
+  size_t pos = 0;
+
+#if UDP_MMSG_SUPPORTED
+  struct mmsghdr msgs[MAX_UDP_SEND_BATCH];
+  struct iovec iovs[MAX_UDP_SEND_BATCH];
+  size_t msg_elems[MAX_UDP_SEND_BATCH];
+#if UDP_GSO_SUPPORTED
+  union {
+    char buf[CMSG_SPACE(sizeof(uint16_t))];
+    struct cmsghdr align;
+  } gso_cmsg[MAX_UDP_SEND_BATCH];
+#endif
+
+  while (pos < qsz) {
+    const evutil_socket_t fd = e->udp_sq[pos].fd;
+    unsigned int vlen = 0;
+    size_t i = pos;
+
+    /* sendmmsg() works on one socket: collect the consecutive datagrams of this fd */
+    while ((i < qsz) && (e->udp_sq[i].fd == fd)) {
+      size_t n = udp_send_queue_gso_segments(e, i, qsz);
+      struct msghdr *mh = &(msgs[vlen].msg_hdr);
+      size_t k;
+
+      memset(&(msgs[vlen]), 0, sizeof(msgs[vlen]));
+      for (k = 0; k < n; ++k) {
+        iovs[i + k].iov_base = ioa_network_buffer_data(e->udp_sq[i + k].nbh);
+        iovs[i + k].iov_len = ioa_network_buffer_get_size(e->udp_sq[i + k].nbh);
+      }
+      mh->msg_iov = &(iovs[i]);
+      mh->msg_iovlen = n;
+      if (e->udp_sq[i].dest_set) {
+        mh->msg_name = &(e->udp_sq[i].dest);
+        mh->msg_namelen = (socklen_t)get_ioa_addr_len(&(e->udp_sq[i].dest));
+      }
+#if UDP_GSO_SUPPORTED
+      if (n > 1) {
+        uint16_t seg = (uint16_t)iovs[i].iov_len;
+        mh->msg_control = gso_cmsg[vlen].buf;
+        mh->msg_controllen = sizeof(gso_cmsg[vlen].buf);
+        struct cmsghdr *cmsgh = CMSG_FIRSTHDR(mh);
+        cmsgh->cmsg_level = SOL_UDP;
+        cmsgh->cmsg_type = UDP_SEGMENT;
+        cmsgh->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cmsgh), &seg, sizeof(seg));
+      }
+#endif
+      msg_elems[vlen++] = n;
+      i += n;
+    }
+
+    int sent = 0;
+    do {
+      sent = sendmmsg(fd, msgs, vlen, 0);
+    } while ((sent < 0) && socket_eintr());
+
+    if (sent > 0) {
+      for (int m = 0; m < sent; ++m) {
+        pos += msg_elems[m];
+      }
+      continue;
+    }
+
+    /*
+     * The first message failed: send its datagrams one by one through
+     * the regular path, which deals with ENOBUFS, ECONNRESET and the
+     * unrecoverable errors.
+     */
+    if (msg_elems[0] > 1) {
+      int err = socket_errno();
+      if ((err == EIO) || (err == EINVAL) || (err == ENOPROTOOPT) || (err == EOPNOTSUPP)) {
+        TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "%s: UDP GSO send failed (errno %d), GSO is disabled\n", __FUNCTION__, err);
+        e->udp_gso = 0;
+      }
+    }
+    for (i = 0; i < msg_elems[0]; ++i) {
+      udp_send_queue_elem_send(&(e->udp_sq[pos++]));
+    }
+  }
+#else
+  for (pos = 0; pos < qsz; ++pos) {
+    udp_send_queue_elem_send(&(e->udp_sq[pos]));
+  }
+#endif
+
+  for (pos = 0; pos < qsz; ++pos) {
+    ioa_network_buffer_delete(e, e->udp_sq[pos].nbh);
+    e->udp_sq[pos].nbh = NULL;
+    e->udp_sq[pos].s = NULL;
+  }
+  e->udp_sq_size = 0;
+}
+
 static const ioa_addr *ioa_engine_get_relay_addr(ioa_engine_handle e, ioa_socket_handle client_s, int address_family,
                                                  int *err_code) {
   if (e) {
@@ -540,6 +845,18 @@ static const ioa_addr *ioa_engine_get_relay_addr(ioa_engine_handle e, ioa_socket
 
 /******************** Timers ****************************/
 
+static void timer_event_fire(timer_event *te) {
+  if (te->e && eve(te->e->verbose)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "%s: timeout %p: %s\n", __FUNCTION__, te, te->txt);
+  }
+
+  ioa_timer_event_handler cb = te->cb;
+  ioa_engine_handle e = te->e;
+  void *ctx = te->ctx;
+
+  cb(e, ctx);
+}
+
 static void timer_event_handler(evutil_socket_t fd, short what, void *arg) {
   timer_event *te = (timer_event *)arg;
 
@@ -553,56 +870,108 @@ static void timer_event_handler(evutil_socket_t fd, short what, void *arg) {
     return;
   }
 
-  if (te->e && eve(te->e->verbose)) {
-    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "%s: timeout %p: %s\n", __FUNCTION__, te, te->txt);
+  timer_event_fire(te);
+}
+
+/************** Timer wheel ***************************/
+
+static uint64_t timer_wheel_clock(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+static inline uint64_t timer_wheel_ticks(int secs) { return ((uint64_t)secs * 1000) / TIMER_WHEEL_TICK_MS; }
+
+static void timer_wheel_expire(timer_wheel_entry *twe, void *arg) {
+  ioa_engine_handle e = (ioa_engine_handle)arg;
+  timer_event *te = (timer_event *)twe;
+
+  uint64_t lag = (e->tw_tick - twe->expires) * TIMER_WHEEL_TICK_MS;
+  if (lag > e->tw_lag_max) {
+    e->tw_lag_max = lag;
   }
+  ++(e->tw_expired);
 
-  ioa_timer_event_handler cb = te->cb;
+  /* the callback may delete the timer */
+  if (te->period) {
+    timer_wheel_add(&(e->tw), twe, e->tw_tick + te->period);
+  }
+
+  timer_event_fire(te);
+}
+
+static void timer_wheel_handler(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  ioa_engine_handle e = (ioa_engine_handle)arg;
+
+  e->tw_tick = timer_wheel_clock() / TIMER_WHEEL_TICK_MS;
+  timer_wheel_advance(&(e->tw), e->tw_tick, timer_wheel_expire, e);
+
+  if (!(e->tw.count)) {
+    event_del(e->tw_ev);
+  }
+}
+
+static void timer_wheel_schedule(timer_event *te, uint64_t ticks) {
   ioa_engine_handle e = te->e;
-  void *ctx = te->ctx;
 
-  cb(e, ctx);
+  e->tw_tick = timer_wheel_clock() / TIMER_WHEEL_TICK_MS;
+  timer_wheel_add(&(e->tw), &(te->twe), e->tw_tick + (ticks ? ticks : 1));
+
+  if (!(e->tw_ev)) {
+    e->tw_ev = event_new(e->event_base, -1, EV_PERSIST, timer_wheel_handler, e);
+  }
+  if (!evtimer_pending(e->tw_ev, NULL)) {
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = TIMER_WHEEL_TICK_MS * 1000;
+    evtimer_add(e->tw_ev, &tv);
+  }
 }
 
+static void report_timer_wheel(ioa_engine_handle e) {
+  prom_set_timers(e->sm ? get_super_memory_region_name(e->sm) : "main", (unsigned long)e->tw.count,
+                  e->tw_expired - e->tw_reported_expired, (unsigned long)e->tw_lag_max);
+  e->tw_reported_expired = e->tw_expired;
+  e->tw_lag_max = 0;
+}
+
+/*
+ * Timers of whole seconds go to the engine timer wheel: adding, refreshing
+ * and deleting them does not touch the libevent timer heap.
+ */
 ioa_timer_handle set_ioa_timer(ioa_engine_handle e, int secs, int ms, ioa_timer_event_handler cb, void *ctx,
                                int persist, const char *txt) {
   ioa_timer_handle ret = NULL;
 
   if (e && cb && secs > 0) {
 
-    timer_event *te = (timer_event *)malloc(sizeof(timer_event));
-    int flags = EV_TIMEOUT;
-    if (persist) {
-      flags |= EV_PERSIST;
-    }
-    struct event *ev = event_new(e->event_base, -1, flags, timer_event_handler, te);
-    struct timeval tv;
-
-    tv.tv_sec = secs;
+    timer_event *te = (timer_event *)calloc(1, sizeof(timer_event));
 
     te->ctx = ctx;
     te->e = e;
-    te->ev = ev;
     te->cb = cb;
     te->txt = strdup(txt);
 
     if (!ms) {
-      tv.tv_usec = 0;
-      int found = 0;
-      int t;
-      for (t = 0; t < PREDEF_TIMERS_NUM; ++t) {
-        if (e->predef_timer_intervals[t] == secs) {
-          evtimer_add(ev, &(e->predef_timers[t]));
-          found = 1;
-          break;
-        }
-      }
-      if (!found) {
-        evtimer_add(ev, &tv);
+      if (persist) {
+        te->period = timer_wheel_ticks(secs);
       }
+      timer_wheel_schedule(te, timer_wheel_ticks(secs));
     } else {
+      int flags = EV_TIMEOUT;
+      if (persist) {
+        flags |= EV_PERSIST;
+      }
+      te->ev = event_new(e->event_base, -1, flags, timer_event_handler, te);
+
+      struct timeval tv;
+      tv.tv_sec = secs;
       tv.tv_usec = ms * 1000;
-      evtimer_add(ev, &tv);
+      evtimer_add(te->ev, &tv);
     }
 
     ret = te;
@@ -611,10 +980,28 @@ ioa_timer_handle set_ioa_timer(ioa_engine_handle e, int secs, int ms, ioa_timer_
   return ret;
 }
 
+void restart_ioa_timer(ioa_timer_handle th, int secs) {
+  if (th && secs > 0) {
+    timer_event *te = (timer_event *)th;
+    if (te->ev) {
+      struct timeval tv;
+      tv.tv_sec = secs;
+      tv.tv_usec = 0;
+      evtimer_add(te->ev, &tv);
+    } else {
+      timer_wheel_schedule(te, timer_wheel_ticks(secs));
+    }
+  }
+}
+
 void stop_ioa_timer(ioa_timer_handle th) {
   if (th) {
     timer_event *te = (timer_event *)th;
-    EVENT_DEL(te->ev);
+    if (te->ev) {
+      EVENT_DEL(te->ev);
+    } else {
+      timer_wheel_del(&(te->e->tw), &(te->twe));
+    }
   }
 }
 
@@ -725,6 +1112,7 @@ static int set_socket_ttl(ioa_socket_handle s, int ttl) {
   }
 
   if (s->current_ttl != ttl) {
+    ioa_engine_flush_udp_send_queue(s->e);
     int ret = set_raw_socket_ttl(s->fd, s->family, ttl);
     s->current_ttl = ttl;
     return ret;
@@ -745,6 +1133,7 @@ static int set_socket_tos(ioa_socket_handle s, int tos) {
   CORRECT_RAW_TOS(tos);
 
   if (s->current_tos != tos) {
+    ioa_engine_flush_udp_send_queue(s->e);
     int ret = set_raw_socket_tos(s->fd, s->family, tos);
     s->current_tos = tos;
     return ret;
@@ -801,6 +1190,20 @@ int set_raw_socket_tos_options(evutil_socket_t fd, int family) {
   return 0;
 }
 
+int set_raw_socket_gro_options(evutil_socket_t fd, int on) {
+#if UDP_GRO_SUPPORTED
+  if (setsockopt(fd, SOL_UDP, UDP_GRO, (const void *)&on, sizeof(on)) < 0) {
+    perror("cannot set UDP GRO\n");
+    return -1;
+  }
+  return 0;
+#else
+  UNUSED_ARG(fd);
+  UNUSED_ARG(on);
+  return -1;
+#endif
+}
+
 int set_socket_options_fd(evutil_socket_t fd, SOCKET_TYPE st, int family) {
   if (fd < 0) {
     return 0;
@@ -931,6 +1334,10 @@ ioa_socket_handle create_unbound_relay_ioa_socket(ioa_engine_handle e, int famil
 
   set_socket_options(ret);
 
+  if ((st == UDP_SOCKET) && e && e->udp_gro) {
+    ret->gro = (set_raw_socket_gro_options(fd, 1) >= 0);
+  }
+
   return ret;
 }
 
@@ -1321,12 +1728,86 @@ void add_socket_to_map(ioa_socket_handle s, ur_addr_map *amap) {
   }
 }
 
+static void delete_socket_from_ip_index(ioa_socket_handle s) {
+  if (s && s->sockets_ip_index) {
+    ioa_addr key;
+    addr_cpy(&key, &(s->remote_addr));
+    addr_set_port(&key, 0);
+    ioa_socket_ip_bucket *b = get_ip_index_bucket(s->sockets_ip_index, &key);
+    if (b) {
+      if (b->cursor == s) {
+        b->cursor = s->ip_next;
+      }
+      if (s->ip_prev) {
+        s->ip_prev->ip_next = s->ip_next;
+      } else {
+        b->head = s->ip_next;
+      }
+      if (s->ip_next) {
+        s->ip_next->ip_prev = s->ip_prev;
+      }
+      if (!(b->head)) {
+        ur_addr_map_del(s->sockets_ip_index, &key, NULL);
+        free(b);
+      }
+    }
+    s->ip_prev = NULL;
+    s->ip_next = NULL;
+    s->sockets_ip_index = NULL;
+  }
+}
+
 void delete_socket_from_map(ioa_socket_handle s) {
   if (s && s->sockets_container) {
 
     ur_addr_map_del(s->sockets_container, &(s->remote_addr), NULL);
     s->sockets_container = NULL;
   }
+  delete_socket_from_ip_index(s);
+}
+
+ioa_socket_ip_bucket *get_ip_index_bucket(ur_addr_map *ipmap, const ioa_addr *remote_addr) {
+  if (!ipmap || !remote_addr) {
+    return NULL;
+  }
+  ioa_addr key;
+  addr_cpy(&key, remote_addr);
+  addr_set_port(&key, 0);
+  ur_addr_map_value_type mvt = 0;
+  if (ur_addr_map_get(ipmap, &key, &mvt) && mvt) {
+    return (ioa_socket_ip_bucket *)mvt;
+  }
+  return NULL;
+}
+
+void add_socket_to_ip_index(ioa_socket_handle s, ur_addr_map *ipmap) {
+  if (!ipmap || !s || (s->sockets_ip_index == ipmap)) {
+    return;
+  }
+  delete_socket_from_ip_index(s);
+
+  ioa_socket_ip_bucket *b = get_ip_index_bucket(ipmap, &(s->remote_addr));
+  if (!b) {
+    ioa_addr key;
+    addr_cpy(&key, &(s->remote_addr));
+    addr_set_port(&key, 0);
+    b = (ioa_socket_ip_bucket *)calloc(sizeof(ioa_socket_ip_bucket), 1);
+    if (!b) {
+      return;
+    }
+    if (!ur_addr_map_put(ipmap, &key, (ur_addr_map_value_type)b)) {
+      free(b);
+      return;
+    }
+  }
+
+  s->ip_prev = NULL;
+  s->ip_next = b->head;
+  if (b->head) {
+    b->head->ip_prev = s;
+  }
+  b->head = s;
+  s->sockets_ip_index = ipmap;
 }
 
 ioa_socket_handle create_ioa_socket_from_fd(ioa_engine_handle e, ioa_socket_raw fd, ioa_socket_handle parent_s,
@@ -1378,6 +1859,22 @@ static void ssl_info_callback(SSL *ssl, int where, int ret) {
 
 typedef void (*ssl_info_callback_t)(const SSL *ssl, int type, int val);
 
+/*
+ * Handshake of a client socket in the handshake threads. While jobs are out,
+ * the SSL belongs to a handshake thread. If the socket is closed before the
+ * replies come, the SSL (and the fd of a TLS socket) are released with the
+ * last reply.
+ */
+typedef struct _ioa_handshake {
+  ioa_socket_handle s; /* NULL once the socket is closed */
+  SSL *ssl;            /* of the closed socket */
+  evutil_socket_t fd;  /* of the closed socket, -1 if not owned */
+  int jobs;
+  uint64_t start_us;
+} ioa_handshake;
+
+static inline int handshake_pending(ioa_socket_handle s) { return s->hs && s->hs->jobs; }
+
 static void set_socket_ssl(ioa_socket_handle s, SSL *ssl) {
   if (s && (s->ssl != ssl)) {
     if (s->ssl) {
@@ -1401,6 +1898,17 @@ static void set_socket_ssl(ioa_socket_handle s, SSL *ssl) {
   }
 }
 
+#if TLS_SUPPORTED
+/* TLS over a stream socket: whether the connection is gone or shut down */
+static int tls_socket_shutdown(ioa_socket_handle s) {
+  if (handshake_pending(s)) {
+    return 0;
+  }
+  SSL *ssl = (s->ktls > 0) ? s->ssl : bufferevent_openssl_get_ssl(s->bev);
+  return !ssl || SSL_get_shutdown(ssl);
+}
+#endif
+
 /* Only must be called for DTLS_SOCKET */
 ioa_socket_handle create_ioa_socket_from_ssl(ioa_engine_handle e, ioa_socket_handle parent_s, SSL *ssl, SOCKET_TYPE st,
                                              SOCKET_APP_TYPE sat, const ioa_addr *remote_addr,
@@ -1422,6 +1930,10 @@ static void close_socket_net_data(ioa_socket_handle s) {
   if (s) {
 
     EVENT_DEL(s->read_event);
+    if (s->uring_recv) {
+      ioa_uring_recv_stop(s->e, s->uring_recv);
+      s->uring_recv = 0;
+    }
     if (s->list_ev) {
       evconnlistener_free(s->list_ev);
       s->list_ev = NULL;
@@ -1429,6 +1941,22 @@ static void close_socket_net_data(ioa_socket_handle s) {
     BUFFEREVENT_FREE(s->conn_bev);
     BUFFEREVENT_FREE(s->bev);
 
+    if (s->hs) {
+      ioa_handshake *hs = s->hs;
+      s->hs = NULL;
+      if (hs->jobs) {
+        hs->s = NULL;
+        hs->ssl = s->ssl;
+        s->ssl = NULL;
+        if (!(s->parent_s)) {
+          hs->fd = s->fd;
+          s->fd = -1;
+        }
+      } else {
+        free(hs);
+      }
+    }
+
     if (s->ssl) {
       if (!s->broken) {
         if (!(SSL_get_shutdown(s->ssl) & SSL_SENT_SHUTDOWN)) {
@@ -1461,6 +1989,10 @@ static void close_socket_net_data(ioa_socket_handle s) {
 void detach_socket_net_data(ioa_socket_handle s) {
   if (s) {
     EVENT_DEL(s->read_event);
+    if (s->uring_recv) {
+      ioa_uring_recv_stop(s->e, s->uring_recv);
+      s->uring_recv = 0;
+    }
     s->read_cb = NULL;
     s->read_ctx = NULL;
     if (s->list_ev) {
@@ -1492,6 +2024,9 @@ void close_ioa_socket(ioa_socket_handle s) {
       return;
     }
 
+    /* the queued datagrams reference the socket */
+    ioa_engine_flush_udp_send_queue(s->e);
+
     s->done = 1;
 
     while (!buffer_list_empty(&(s->bufs))) {
@@ -1553,6 +2088,13 @@ ioa_socket_handle detach_ioa_socket(ioa_socket_handle s) {
                     s, s->st, s->sat);
       return ret;
     }
+    if (handshake_pending(s)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "!!! %s detach on socket in handshake: %p, st=%d, sat=%d\n", __FUNCTION__, s,
+                    s->st, s->sat);
+      return ret;
+    }
+
+    ioa_engine_flush_udp_send_queue(s->e);
 
     s->tobeclosed = 1;
 
@@ -1629,6 +2171,7 @@ ioa_socket_handle detach_ioa_socket(ioa_socket_handle s) {
     addr_cpy(&(ret->local_addr), &(s->local_addr));
     ret->connected = s->connected;
     addr_cpy(&(ret->remote_addr), &(s->remote_addr));
+    ret->gro = s->gro;
 
     delete_socket_from_map(s);
     delete_socket_from_parent(s);
@@ -1638,6 +2181,11 @@ ioa_socket_handle detach_ioa_socket(ioa_socket_handle s) {
       ret->fd = udp_fd;
 
       set_socket_options(ret);
+
+      ret->gro = 0;
+      if (s->e->udp_gro && !(ret->ssl)) {
+        ret->gro = (set_raw_socket_gro_options(udp_fd, 1) >= 0);
+      }
     }
 
     ret->current_ttl = s->current_ttl;
@@ -1782,10 +2330,10 @@ int get_local_mtu_ioa_socket(ioa_socket_handle s) {
  * Return: -1 - error, 0 or >0 - OK
  * *read_len -1 - no data, >=0 - data available
  */
-int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int verbose) {
+int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, char *scratch, int verbose) {
   int ret = 0;
 
-  if (!ssl || !nbh) {
+  if (!ssl || !nbh || !scratch) {
     return -1;
   }
 
@@ -1800,6 +2348,13 @@ int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int ve
   char *new_buffer = buffer + buf_size;
   int old_buffer_len = read_len;
 
+  /* a small buffer has no room for the decrypted data after the record */
+  char *out_buffer = NULL;
+  if (ioa_network_buffer_get_capacity(nbh) < (size_t)buf_size + (size_t)buf_size) {
+    out_buffer = scratch;
+    new_buffer = out_buffer;
+  }
+
   int len = 0;
 
   if (eve(verbose)) {
@@ -1807,17 +2362,20 @@ int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int ve
   }
 
   BIO *wbio = SSL_get_wbio(ssl);
-  if (wbio) {
+  if (wbio && (BIO_get_fd(wbio, NULL) != fd)) {
     BIO_set_fd(wbio, fd, BIO_NOCLOSE);
   }
 
+#if DTLS_READ_BIO_SUPPORTED
+  BIO *rbio = get_dtls_read_bio(ssl);
+  if (!rbio) {
+    return -1;
+  }
+  dtls_read_bio_set(rbio, buffer, (size_t)old_buffer_len);
+#else
   BIO *rbio = BIO_new_mem_buf(buffer, old_buffer_len);
   BIO_set_mem_eof_return(rbio, -1);
-
-#if defined LIBRESSL_VERSION_NUMBER && LIBRESSL_VERSION_NUMBER < 0x3040000fL
   ssl->rbio = rbio;
-#else
-  SSL_set0_rbio(ssl, rbio);
 #endif
 
   int if1 = SSL_is_init_finished(ssl);
@@ -1910,19 +2468,265 @@ int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int ve
     }
   }
 
-  if (ret > 0) {
+  if (out_buffer) {
+    if (ret > 0) {
+      if ((size_t)ret > ioa_network_buffer_get_capacity(nbh)) {
+        ret = (int)ioa_network_buffer_get_capacity(nbh);
+      }
+      memcpy(buffer, out_buffer, (size_t)ret);
+      ioa_network_buffer_set_size(nbh, (size_t)ret);
+    }
+  } else if (ret > 0) {
     ioa_network_buffer_add_offset_size(nbh, (uint16_t)buf_size, 0, (size_t)ret);
   }
-#if defined LIBRESSL_VERSION_NUMBER && LIBRESSL_VERSION_NUMBER < 0x3040000fL
+#if DTLS_READ_BIO_SUPPORTED
+  /* The BIO stays with the SSL for the next datagram */
+  dtls_read_bio_set(rbio, NULL, 0);
+#else
   ssl->rbio = NULL;
   BIO_free(rbio);
-#else
-  SSL_set0_rbio(ssl, NULL);
 #endif
 
   return ret;
 }
 
+int dtls_socket_rebind(ioa_socket_handle s, ioa_network_buffer_handle nbh, const ioa_addr *remote_addr) {
+  if (!s || !(s->e) || !nbh || !remote_addr || (s->st != DTLS_SOCKET) || !(s->ssl) || s->hs || s->done ||
+      s->tobeclosed || !SSL_is_init_finished(s->ssl)) {
+    return 0;
+  }
+
+  /* A record of another session fails the integrity check and is dropped by the SSL */
+  if (ssl_read(s->fd, s->ssl, nbh, s->e->ssl_scratch, s->e->verbose) < 1) {
+    return 0;
+  }
+
+  if (s->e && s->e->verbose) {
+    uint8_t sfrom[129];
+    uint8_t sto[129];
+    addr_to_string(&(s->remote_addr), sfrom);
+    addr_to_string(remote_addr, sto);
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "DTLS client moved from %s to %s\n", (char *)sfrom, (char *)sto);
+  }
+
+  /* Same IP address: the socket keeps its place in the IP index */
+  ur_addr_map *amap = s->sockets_container;
+  if (amap) {
+    ur_addr_map_del(amap, &(s->remote_addr), NULL);
+  }
+  addr_cpy(&(s->remote_addr), remote_addr);
+  if (amap) {
+    ur_addr_map_put(amap, &(s->remote_addr), (ur_addr_map_value_type)s);
+  }
+
+  BIO *wbio = SSL_get_wbio(s->ssl);
+  if (wbio) {
+    (void)BIO_dgram_set_peer(wbio, (struct sockaddr *)&(s->remote_addr));
+  }
+
+  return 1;
+}
+
+/************** Handshake threads ************/
+
+static uint64_t handshake_clock_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)(ts.tv_nsec / 1000);
+}
+
+static ioa_handshake *handshake_get(ioa_socket_handle s) {
+  if (!(s->hs)) {
+    s->hs = (ioa_handshake *)calloc(1, sizeof(ioa_handshake));
+    if (s->hs) {
+      s->hs->s = s;
+      s->hs->fd = -1;
+      s->hs->start_us = handshake_clock_us();
+    }
+  }
+  return s->hs;
+}
+
+int dtls_handshake_offload(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
+  if (!s || !(s->e) || !(s->e->handshake_queue) || !(s->ssl)) {
+    return 0;
+  }
+
+  if (!handshake_pending(s)) {
+    if (SSL_is_init_finished(s->ssl)) {
+      if (s->hs) {
+        free(s->hs);
+        s->hs = NULL;
+      }
+      return 0;
+    }
+    if (!handshake_get(s)) {
+      return 0;
+    }
+  }
+
+  tls_handshake_job job;
+  memset(&job, 0, sizeof(job));
+  job.type = TLS_HANDSHAKE_DTLS_RECORD;
+  job.ssl = s->ssl;
+  job.fd = s->fd;
+  job.nbh = nbh;
+  job.ctx = s->hs;
+  job.reply = s->e->handshake_queue;
+  job.verbose = s->e->verbose;
+
+  if (!tls_handshake_submit(&job)) {
+    if (!(s->hs->jobs)) {
+      return 0;
+    }
+    /* The SSL is busy in a handshake thread: drop, the client retransmits */
+    ioa_network_buffer_delete(s->e, nbh);
+    return 1;
+  }
+
+  ++(s->hs->jobs);
+  return 1;
+}
+
+static int tls_handshake_offload(ioa_socket_handle s) {
+  if (!(s->e->handshake_queue) || s->hs) {
+    return 0;
+  }
+
+  if (!SSL_set_fd(s->ssl, s->fd) || !handshake_get(s)) {
+    return 0;
+  }
+  SSL_set_accept_state(s->ssl);
+
+  tls_handshake_job job;
+  memset(&job, 0, sizeof(job));
+  job.type = TLS_HANDSHAKE_TLS_ACCEPT;
+  job.ssl = s->ssl;
+  job.fd = s->fd;
+  job.ctx = s->hs;
+  job.reply = s->e->handshake_queue;
+  job.verbose = s->e->verbose;
+
+  if (!tls_handshake_submit(&job)) {
+    free(s->hs);
+    s->hs = NULL;
+    return 0;
+  }
+
+  s->hs->jobs = 1;
+  return 1;
+}
+
+static void handshake_open_tls_bev(ioa_socket_handle s) {
+  s->bev = bufferevent_openssl_socket_new(s->e->event_base, s->fd, s->ssl, BUFFEREVENT_SSL_OPEN,
+                                          TURN_BUFFEREVENTS_OPTIONS);
+  if (!(s->bev)) {
+    s->tobeclosed = 1;
+    s->broken = 1;
+    log_socket_event(s, "cannot create TLS bufferevent, to be closed", 1);
+    return;
+  }
+  bufferevent_setcb(s->bev, socket_input_handler_bev, socket_output_handler_bev, eventcb_bev, s);
+  bufferevent_setwatermark(s->bev, EV_READ | EV_WRITE, 0, BUFFEREVENT_HIGH_WATERMARK);
+  bufferevent_enable(s->bev, EV_READ | EV_WRITE); /* Start reading. */
+
+  /* What was sent during the handshake */
+  while (!buffer_list_empty(&(s->bufs))) {
+    stun_buffer_list_elem *buf_elem = s->bufs.head;
+    bufferevent_write(s->bev, buf_elem->buf.buf + buf_elem->buf.offset - buf_elem->buf.coffset,
+                      (size_t)buf_elem->buf.len);
+    pop_elem_from_buffer_list(&(s->bufs));
+  }
+}
+
+static void handshake_deliver(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
+  if (ioa_socket_check_bandwidth(s, nbh, 1)) {
+    if (s->read_cb) {
+      ioa_net_data nd;
+
+      memset(&nd, 0, sizeof(ioa_net_data));
+      addr_cpy(&(nd.src_addr), &(s->remote_addr));
+      nd.nbh = nbh;
+      nd.recv_ttl = TTL_IGNORE;
+      nd.recv_tos = TOS_IGNORE;
+
+      s->read_cb(s, IOA_EV_READ, &nd, s->read_ctx, 1);
+
+      nbh = nd.nbh;
+    } else {
+      ioa_network_buffer_delete(s->e, s->defer_nbh);
+      s->defer_nbh = nbh;
+      nbh = NULL;
+    }
+  }
+  ioa_network_buffer_delete(s->e, nbh);
+}
+
+static void handshake_receive_reply(void *msg, void *arg) {
+  ioa_engine_handle e = (ioa_engine_handle)arg;
+  tls_handshake_job *job = (tls_handshake_job *)msg;
+  ioa_handshake *hs = (ioa_handshake *)job->ctx;
+  ioa_socket_handle s = hs->s;
+
+  --(hs->jobs);
+
+  if (!s) {
+    /* The socket is closed */
+    ioa_network_buffer_delete(e, job->nbh);
+    if (!(hs->jobs)) {
+      SSL_free(hs->ssl);
+      if (hs->fd >= 0) {
+        socket_closesocket(hs->fd);
+      }
+      free(hs);
+    }
+    return;
+  }
+
+  if (!(hs->jobs) && (job->result >= 0) && SSL_is_init_finished(s->ssl)) {
+    prom_observe_tls_handshake((job->type == TLS_HANDSHAKE_TLS_ACCEPT) ? "tls" : "dtls",
+                               (double)(handshake_clock_us() - hs->start_us) / 1000000.0);
+    s->hs = NULL;
+    free(hs);
+  }
+
+  if (job->result < 0) {
+    ioa_network_buffer_delete(e, job->nbh);
+    s->tobeclosed = 1;
+    s->broken = 1;
+    log_socket_event(s, "TLS handshake failed, to be closed", 0);
+  } else if (job->type == TLS_HANDSHAKE_TLS_ACCEPT) {
+    handshake_open_tls_bev(s);
+  } else {
+    if (!(s->hs)) {
+      send_ssl_backlog_buffers(s);
+    }
+    if (!(s->tobeclosed) && (ioa_network_buffer_get_size(job->nbh) > 0)) {
+      handshake_deliver(s, job->nbh);
+      if ((s->magic != SOCKET_MAGIC) || (s->done)) {
+        return;
+      }
+    } else {
+      ioa_network_buffer_delete(e, job->nbh);
+    }
+  }
+
+  close_ioa_socket_after_processing_if_necessary(s);
+}
+
+void ioa_engine_set_handshake_offload(ioa_engine_handle e) {
+  if (e && !(e->handshake_queue) && (tls_handshake_pool_size() > 0)) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s-handshake", e->sm ? get_super_memory_region_name(e->sm) : "main");
+    e->handshake_queue = mpsc_queue_new(e->event_base, name, TLS_HANDSHAKE_QUEUE_SIZE, sizeof(tls_handshake_job),
+                                        handshake_receive_reply, e);
+    if (!(e->handshake_queue)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: cannot create the handshake reply queue, handshakes run inline\n",
+                    __FUNCTION__);
+    }
+  }
+}
+
 static int socket_readerr(evutil_socket_t fd, ioa_addr *orig_addr) {
   if ((fd < 0) || !orig_addr) {
     return -1;
@@ -1974,32 +2778,100 @@ static int socket_readerr(evutil_socket_t fd, ioa_addr *orig_addr) {
 typedef unsigned char recv_ttl_t;
 typedef unsigned char recv_tos_t;
 
-int udp_recvfrom(evutil_socket_t fd, ioa_addr *orig_addr, const ioa_addr *like_addr, char *buffer, int buf_size,
-                 int *ttl, int *tos, char *ecmsg, int flags, uint32_t *errcode) {
-  int len = 0;
+#if !defined(_MSC_VER) && defined(CMSG_SPACE)
+void udp_recv_cmsg(struct msghdr *msg, int *ttl, int *tos, uint32_t *errcode, int *segsz) {
+  struct cmsghdr *cmsgh;
 
-  if (fd < 0 || !orig_addr || !like_addr || !buffer) {
-    return -1;
+  // Receive auxiliary data in msg
+  for (cmsgh = CMSG_FIRSTHDR(msg); cmsgh != NULL; cmsgh = CMSG_NXTHDR(msg, cmsgh)) {
+    int l = cmsgh->cmsg_level;
+    int t = cmsgh->cmsg_type;
+
+    switch (l) {
+    case IPPROTO_IP:
+      switch (t) {
+#if defined(IP_RECVTTL) && !defined(__sparc_v9__)
+      case IP_RECVTTL:
+      case IP_TTL:
+        *ttl = *((recv_ttl_t *)CMSG_DATA(cmsgh));
+        break;
+#endif
+#if defined(IP_RECVTOS)
+      case IP_RECVTOS:
+      case IP_TOS:
+        *tos = *((recv_tos_t *)CMSG_DATA(cmsgh));
+        break;
+#endif
+#if defined(IP_RECVERR)
+      case IP_RECVERR: {
+        struct turn_sock_extended_err *e = (struct turn_sock_extended_err *)CMSG_DATA(cmsgh);
+        if (errcode) {
+          *errcode = e->ee_errno;
+        }
+      } break;
+#endif
+      default:;
+        /* no break */
+      };
+      break;
+    case IPPROTO_IPV6:
+      switch (t) {
+#if defined(IPV6_RECVHOPLIMIT) && !defined(__sparc_v9__)
+      case IPV6_RECVHOPLIMIT:
+      case IPV6_HOPLIMIT:
+        *ttl = *((recv_ttl_t *)CMSG_DATA(cmsgh));
+        break;
+#endif
+#if defined(IPV6_RECVTCLASS)
+      case IPV6_RECVTCLASS:
+      case IPV6_TCLASS:
+        *tos = *((recv_tos_t *)CMSG_DATA(cmsgh));
+        break;
+#endif
+#if defined(IPV6_RECVERR)
+      case IPV6_RECVERR: {
+        struct turn_sock_extended_err *e = (struct turn_sock_extended_err *)CMSG_DATA(cmsgh);
+        if (errcode) {
+          *errcode = e->ee_errno;
+        }
+      } break;
+#endif
+      default:;
+        /* no break */
+      };
+      break;
+#if UDP_GRO_SUPPORTED
+    case SOL_UDP:
+      if ((t == UDP_GRO) && segsz) {
+        memcpy(segsz, CMSG_DATA(cmsgh), sizeof(int));
+      }
+      break;
+#endif
+    default:;
+      /* no break */
+    };
   }
 
+#if !UDP_GRO_SUPPORTED
+  UNUSED_ARG(segsz);
+#endif
+}
+#endif
+
+#if !defined(_MSC_VER) && defined(CMSG_SPACE)
+static int udp_recvmsg_iov(evutil_socket_t fd, ioa_addr *orig_addr, const ioa_addr *like_addr, struct iovec *iov,
+                           size_t iovlen, int *ttl, int *tos, char *ecmsg, int flags, uint32_t *errcode) {
+  int len = 0;
+
   if (errcode) {
     *errcode = 0;
   }
 
   int slen = get_ioa_addr_len(like_addr);
-  recv_ttl_t recv_ttl = TTL_DEFAULT;
-  recv_tos_t recv_tos = TOS_DEFAULT;
+  int recv_ttl = TTL_DEFAULT;
+  int recv_tos = TOS_DEFAULT;
 
-#if defined(_MSC_VER) || !defined(CMSG_SPACE)
-  do {
-    len = recvfrom(fd, buffer, buf_size, flags, (struct sockaddr *)orig_addr, (socklen_t *)&slen);
-  } while (len < 0 && socket_eintr());
-  if (len < 0 && errcode) {
-    *errcode = (uint32_t)socket_errno();
-  }
-#else
   struct msghdr msg;
-  struct iovec iov;
 
   char *cmsg = (char *)ecmsg;
 
@@ -2009,10 +2881,8 @@ int udp_recvfrom(evutil_socket_t fd, ioa_addr *orig_addr, const ioa_addr *like_a
 
   msg.msg_name = orig_addr;
   msg.msg_namelen = (socklen_t)slen;
-  msg.msg_iov = &iov;
-  msg.msg_iovlen = 1;
-  msg.msg_iov->iov_base = buffer;
-  msg.msg_iov->iov_len = (size_t)buf_size;
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iovlen;
   msg.msg_flags = 0;
 
 #if defined(MSG_ERRQUEUE)
@@ -2036,7 +2906,8 @@ try_again:
     // Linux
     int eflags = MSG_ERRQUEUE | MSG_DONTWAIT;
     uint32_t errcode1 = 0;
-    udp_recvfrom(fd, orig_addr, like_addr, buffer, buf_size, ttl, tos, ecmsg, eflags, &errcode1);
+    udp_recvfrom(fd, orig_addr, like_addr, (char *)(iov[0].iov_base), (int)(iov[0].iov_len), ttl, tos, ecmsg, eflags,
+                 &errcode1);
     // try again...
     do {
       len = recvmsg(fd, &msg, flags);
@@ -2045,84 +2916,222 @@ try_again:
 #endif
 
   if (len >= 0) {
+    udp_recv_cmsg(&msg, &recv_ttl, &recv_tos, errcode, NULL);
+  }
+
+  *ttl = recv_ttl;
 
-    struct cmsghdr *cmsgh;
+  CORRECT_RAW_TTL(*ttl);
 
-    // Receive auxiliary data in msg
-    for (cmsgh = CMSG_FIRSTHDR(&msg); cmsgh != NULL; cmsgh = CMSG_NXTHDR(&msg, cmsgh)) {
-      int l = cmsgh->cmsg_level;
-      int t = cmsgh->cmsg_type;
+  *tos = recv_tos;
 
-      switch (l) {
-      case IPPROTO_IP:
-        switch (t) {
-#if defined(IP_RECVTTL) && !defined(__sparc_v9__)
-        case IP_RECVTTL:
-        case IP_TTL:
-          recv_ttl = *((recv_ttl_t *)CMSG_DATA(cmsgh));
-          break;
-#endif
-#if defined(IP_RECVTOS)
-        case IP_RECVTOS:
-        case IP_TOS:
-          recv_tos = *((recv_tos_t *)CMSG_DATA(cmsgh));
-          break;
-#endif
-#if defined(IP_RECVERR)
-        case IP_RECVERR: {
-          struct turn_sock_extended_err *e = (struct turn_sock_extended_err *)CMSG_DATA(cmsgh);
-          if (errcode) {
-            *errcode = e->ee_errno;
-          }
-        } break;
-#endif
-        default:;
-          /* no break */
-        };
-        break;
-      case IPPROTO_IPV6:
-        switch (t) {
-#if defined(IPV6_RECVHOPLIMIT) && !defined(__sparc_v9__)
-        case IPV6_RECVHOPLIMIT:
-        case IPV6_HOPLIMIT:
-          recv_ttl = *((recv_ttl_t *)CMSG_DATA(cmsgh));
-          break;
-#endif
-#if defined(IPV6_RECVTCLASS)
-        case IPV6_RECVTCLASS:
-        case IPV6_TCLASS:
-          recv_tos = *((recv_tos_t *)CMSG_DATA(cmsgh));
-          break;
+  CORRECT_RAW_TOS(*tos);
+
+  return len;
+}
 #endif
-#if defined(IPV6_RECVERR)
-        case IPV6_RECVERR: {
-          struct turn_sock_extended_err *e = (struct turn_sock_extended_err *)CMSG_DATA(cmsgh);
-          if (errcode) {
-            *errcode = e->ee_errno;
-          }
-        } break;
+
+int udp_recvfrom(evutil_socket_t fd, ioa_addr *orig_addr, const ioa_addr *like_addr, char *buffer, int buf_size,
+                 int *ttl, int *tos, char *ecmsg, int flags, uint32_t *errcode) {
+
+  if (fd < 0 || !orig_addr || !like_addr || !buffer) {
+    return -1;
+  }
+
+#if defined(_MSC_VER) || !defined(CMSG_SPACE)
+  int len = 0;
+
+  if (errcode) {
+    *errcode = 0;
+  }
+
+  int slen = get_ioa_addr_len(like_addr);
+
+  do {
+    len = recvfrom(fd, buffer, buf_size, flags, (struct sockaddr *)orig_addr, (socklen_t *)&slen);
+  } while (len < 0 && socket_eintr());
+  if (len < 0 && errcode) {
+    *errcode = (uint32_t)socket_errno();
+  }
+
+  *ttl = TTL_DEFAULT;
+
+  CORRECT_RAW_TTL(*ttl);
+
+  *tos = TOS_DEFAULT;
+
+  CORRECT_RAW_TOS(*tos);
+
+  return len;
+#else
+  struct iovec iov;
+  iov.iov_base = buffer;
+  iov.iov_len = (size_t)buf_size;
+  return udp_recvmsg_iov(fd, orig_addr, like_addr, &iov, 1, ttl, tos, ecmsg, flags, errcode);
 #endif
-        default:;
-          /* no break */
-        };
-        break;
-      default:;
-        /* no break */
-      };
+}
+
+#if !defined(_MSC_VER) && defined(CMSG_SPACE)
+/*
+ * Datagram receive straight into a network buffer of any size class. The
+ * bytes that do not fit a small buffer spill over into the overflow area
+ * of the engine, one area per recvmmsg() slot, and only such a datagram is
+ * moved into a large buffer.
+ */
+static uint8_t *udp_recv_overflow(ioa_engine_handle e, int slots) {
+  if (slots > e->recv_overflow_slots) {
+    uint8_t *overflow = (uint8_t *)malloc((size_t)slots * UDP_RECV_OVERFLOW_SIZE);
+    if (!overflow) {
+      return NULL;
     }
+    free(e->recv_overflow);
+    e->recv_overflow = overflow;
+    e->recv_overflow_slots = slots;
   }
+  return e->recv_overflow;
+}
 
+static size_t udp_recv_iov(ioa_network_buffer_handle nbh, uint8_t *overflow, struct iovec *iov) {
+  stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
+  iov[0].iov_base = buf_elem->buf.buf;
+  if ((buf_elem->bclass != NBUF_CLASS_SMALL) || !overflow) {
+    iov[0].iov_len = (buf_elem->bclass == NBUF_CLASS_SMALL) ? NBUF_SMALL_DATAGRAM_SIZE : UDP_STUN_BUFFER_SIZE;
+    return 1;
+  }
+  iov[0].iov_len = NBUF_SMALL_DATAGRAM_SIZE;
+  iov[1].iov_base = overflow;
+  iov[1].iov_len = UDP_RECV_OVERFLOW_SIZE;
+  return 2;
+}
+
+static ioa_network_buffer_handle udp_recv_join(ioa_engine_handle e, ioa_network_buffer_handle nbh,
+                                               const struct iovec *iov, size_t len) {
+  stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
+  if (len > iov[0].iov_len) {
+    stun_buffer_list_elem *large = new_blist_elem(e);
+    if (large) {
+      memcpy(large->buf.buf, iov[0].iov_base, iov[0].iov_len);
+      memcpy(large->buf.buf + iov[0].iov_len, iov[1].iov_base, len - iov[0].iov_len);
+      free_blist_elem(e, buf_elem);
+      buf_elem = large;
+    } else {
+      len = iov[0].iov_len;
+    }
+  }
+  buf_elem->buf.len = len;
+  return buf_elem;
+}
 #endif
 
-  *ttl = recv_ttl;
+int udp_recvfrom_nbh(ioa_engine_handle e, evutil_socket_t fd, ioa_addr *orig_addr, const ioa_addr *like_addr,
+                     ioa_network_buffer_handle *nbh, int *ttl, int *tos, int flags, uint32_t *errcode) {
 
-  CORRECT_RAW_TTL(*ttl);
+  if (!e || !nbh || !(*nbh) || fd < 0 || !orig_addr || !like_addr) {
+    return -1;
+  }
 
-  *tos = recv_tos;
+#if defined(_MSC_VER) || !defined(CMSG_SPACE)
+  stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)(*nbh);
+  if (buf_elem->bclass != NBUF_CLASS_LARGE) {
+    stun_buffer_list_elem *large = new_blist_elem(e);
+    if (!large) {
+      return -1;
+    }
+    free_blist_elem(e, buf_elem);
+    buf_elem = large;
+    *nbh = large;
+  }
+  int len = udp_recvfrom(fd, orig_addr, like_addr, (char *)(buf_elem->buf.buf), UDP_STUN_BUFFER_SIZE, ttl, tos, e->cmsg,
+                         flags, errcode);
+  if (len >= 0) {
+    buf_elem->buf.len = (size_t)len;
+  }
+  return len;
+#else
+  struct iovec iov[2];
+  size_t iovlen = udp_recv_iov(*nbh, udp_recv_overflow(e, 1), iov);
+  int len = udp_recvmsg_iov(fd, orig_addr, like_addr, iov, iovlen, ttl, tos, e->cmsg, flags, errcode);
+  if (len >= 0) {
+    *nbh = udp_recv_join(e, *nbh, iov, (size_t)len);
+  }
+  return len;
+#endif
+}
 
-  CORRECT_RAW_TOS(*tos);
+int udp_recvmmsg(ioa_engine_handle e, evutil_socket_t fd, const ioa_addr *like_addr, ioa_net_data *nd, int vlen,
+                 udp_gro_area *gro) {
+#if UDP_MMSG_SUPPORTED
+  struct mmsghdr msgs[MAX_UDP_RECV_BATCH];
+  struct iovec iovs[MAX_UDP_RECV_BATCH][2];
+  int i = 0;
+  int n = 0;
+
+  if (!e || fd < 0 || !like_addr || !nd || vlen < 1) {
+    return -1;
+  }
+
+  if (vlen > MAX_UDP_RECV_BATCH) {
+    vlen = MAX_UDP_RECV_BATCH;
+  }
+
+  uint8_t *overflow = gro ? NULL : udp_recv_overflow(e, vlen);
+
+  socklen_t slen = (socklen_t)get_ioa_addr_len(like_addr);
+
+  for (i = 0; i < vlen; ++i) {
+    msgs[i].msg_hdr.msg_name = &(nd[i].src_addr);
+    msgs[i].msg_hdr.msg_namelen = slen;
+#if UDP_GRO_SUPPORTED
+    if (gro) {
+      msgs[i].msg_hdr.msg_iov = gro[i].iov;
+      msgs[i].msg_hdr.msg_iovlen = gro[i].nbufs;
+    } else
+#endif
+    {
+      msgs[i].msg_hdr.msg_iov = iovs[i];
+      msgs[i].msg_hdr.msg_iovlen =
+          udp_recv_iov(nd[i].nbh, overflow ? (overflow + (size_t)i * UDP_RECV_OVERFLOW_SIZE) : NULL, iovs[i]);
+    }
+    msgs[i].msg_hdr.msg_control = e->cmsg + (size_t)i * UDP_MMSG_CMSG_SZ;
+    msgs[i].msg_hdr.msg_controllen = UDP_MMSG_CMSG_SZ;
+    msgs[i].msg_hdr.msg_flags = 0;
+    msgs[i].msg_len = 0;
+  }
+
+  do {
+    n = recvmmsg(fd, msgs, (unsigned int)vlen, MSG_DONTWAIT, NULL);
+  } while (n < 0 && socket_eintr());
+
+  for (i = 0; i < n; ++i) {
+    int ttl = TTL_DEFAULT;
+    int tos = TOS_DEFAULT;
+    int segsz = 0;
+    udp_recv_cmsg(&(msgs[i].msg_hdr), &ttl, &tos, NULL, &segsz);
+    CORRECT_RAW_TTL(ttl);
+    CORRECT_RAW_TOS(tos);
+    nd[i].recv_ttl = ttl;
+    nd[i].recv_tos = tos;
+#if UDP_GRO_SUPPORTED
+    if (gro) {
+      gro[i].len = (size_t)msgs[i].msg_len;
+      gro[i].seglen = (segsz > 0) ? (size_t)segsz : gro[i].len;
+      continue;
+    }
+#endif
+    nd[i].nbh = udp_recv_join(e, nd[i].nbh, iovs[i], (size_t)msgs[i].msg_len);
+  }
 
-  return len;
+  return n;
+#else
+  UNUSED_ARG(e);
+  UNUSED_ARG(fd);
+  UNUSED_ARG(like_addr);
+  UNUSED_ARG(nd);
+  UNUSED_ARG(vlen);
+  UNUSED_ARG(gro);
+  errno = ENOSYS;
+  return -1;
+#endif
 }
 
 #if TLS_SUPPORTED
@@ -2345,6 +3354,230 @@ static ssize_t socket_parse_proxy(ioa_socket_handle s, uint8_t *buf, size_t len)
   return tlen;
 }
 
+#if UDP_GRO_SUPPORTED
+
+/*
+ * Copies len bytes at offset off of the scattered receive area into buf.
+ */
+static void gro_copy_segment(const struct iovec *iov, size_t iovlen, size_t off, uint8_t *buf, size_t len) {
+  size_t i = 0;
+  for (i = 0; (i < iovlen) && len; ++i) {
+    if (off >= iov[i].iov_len) {
+      off -= iov[i].iov_len;
+      continue;
+    }
+    size_t chunk = iov[i].iov_len - off;
+    if (chunk > len) {
+      chunk = len;
+    }
+    memcpy(buf, (uint8_t *)iov[i].iov_base + off, chunk);
+    buf += chunk;
+    len -= chunk;
+    off = 0;
+  }
+}
+
+size_t udp_gro_area_fill(ioa_engine_handle e, udp_gro_area *a, size_t segsz, size_t nsegs) {
+  size_t nbufs = 1;
+  size_t i = 0;
+
+  if (segsz) {
+    nbufs = 2 * (nsegs ? nsegs : 1);
+    if (nbufs > UDP_GRO_MAX_SEGMENTS) {
+      nbufs = UDP_GRO_MAX_SEGMENTS;
+    }
+    if ((nbufs - 1) * segsz > STUN_BUFFER_SIZE) {
+      nbufs = STUN_BUFFER_SIZE / segsz + 1;
+    }
+  }
+
+  if (a->segsz != segsz) {
+    udp_gro_area_clear(e, a);
+    a->segsz = segsz;
+  }
+
+  for (i = nbufs; i < a->nbufs; ++i) {
+    ioa_network_buffer_delete(e, a->bufs[i]);
+    a->bufs[i] = NULL;
+  }
+
+  for (i = 0; i < nbufs; ++i) {
+    size_t sz = (i + 1 < nbufs) ? segsz : STUN_BUFFER_SIZE;
+    if (a->bufs[i] && (ioa_network_buffer_get_capacity(a->bufs[i]) < sz)) {
+      ioa_network_buffer_delete(e, a->bufs[i]);
+      a->bufs[i] = NULL;
+    }
+    if (!(a->bufs[i])) {
+      a->bufs[i] = (i + 1 < nbufs) ? new_blist_elem_size(e, segsz) : new_blist_elem(e);
+      if (!(a->bufs[i])) {
+        break;
+      }
+    }
+    a->iov[i].iov_base = ioa_network_buffer_data(a->bufs[i]);
+    a->iov[i].iov_len = sz;
+  }
+
+  a->nbufs = i;
+  a->len = 0;
+  a->seglen = 0;
+
+  return a->nbufs;
+}
+
+ioa_network_buffer_handle udp_gro_area_take(ioa_engine_handle e, udp_gro_area *a, size_t k) {
+  size_t nsegs = udp_gro_area_segments(a);
+  size_t seglen = a->seglen;
+  size_t off = k * seglen;
+  if ((k >= nsegs) || (off >= a->len)) {
+    return NULL;
+  }
+  size_t sz = (a->len - off < seglen) ? (a->len - off) : seglen;
+
+  /* find the buffer the segment starts in */
+  size_t base = 0;
+  size_t i = 0;
+  for (i = 0; (i + 1 < a->nbufs) && (off >= base + a->iov[i].iov_len); ++i) {
+    base += a->iov[i].iov_len;
+  }
+
+  stun_buffer_list_elem *buf_elem = NULL;
+
+  /* take the buffer as is if no other segment starts in it */
+  if ((off == base) && a->bufs[i] && (sz <= a->iov[i].iov_len) &&
+      ((k + 1 == nsegs) || (off + seglen >= base + a->iov[i].iov_len))) {
+    buf_elem = (stun_buffer_list_elem *)a->bufs[i];
+    a->bufs[i] = NULL;
+  } else {
+    buf_elem = new_blist_elem_size(e, sz);
+    if (!buf_elem) {
+      return NULL;
+    }
+    gro_copy_segment(a->iov, a->nbufs, off, buf_elem->buf.buf, sz);
+  }
+  buf_elem->buf.len = sz;
+
+  return buf_elem;
+}
+
+void udp_gro_area_clear(ioa_engine_handle e, udp_gro_area *a) {
+  for (size_t i = 0; i < UDP_GRO_MAX_SEGMENTS; ++i) {
+    if (a->bufs[i]) {
+      ioa_network_buffer_delete(e, a->bufs[i]);
+      a->bufs[i] = NULL;
+    }
+  }
+  a->nbufs = 0;
+}
+
+/*
+ * UDP GRO input. The kernel may coalesce a burst of equal-sized datagrams
+ * from one source into one super-datagram and report the segment size in
+ * the UDP_GRO control message. The receive area is scattered over separate
+ * network buffers of the last seen segment size (udp_gro_area_fill()).
+ */
+static int socket_input_worker_gro(ioa_socket_handle s) {
+  udp_gro_area area;
+  int len = -1;
+  int try_cycle = 0;
+  const int MAX_TRIES = 16;
+
+  memset(&area, 0, sizeof(area));
+
+  do {
+    if (!udp_gro_area_fill(s->e, &area, s->gro_segsz, s->gro_nsegs)) {
+      return -1;
+    }
+
+    ioa_addr remote_addr;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &remote_addr;
+    msg.msg_namelen = (socklen_t)get_ioa_addr_len(&(s->local_addr));
+    msg.msg_iov = area.iov;
+    msg.msg_iovlen = area.nbufs;
+    msg.msg_control = s->e->cmsg;
+    msg.msg_controllen = TURN_CMSG_SZ;
+
+    do {
+      len = recvmsg(s->fd, &msg, 0);
+    } while (len < 0 && socket_eintr());
+
+    if (len < 0) {
+#if defined(MSG_ERRQUEUE)
+      if (!would_block()) {
+        int ttl = 0;
+        int tos = 0;
+        udp_recvfrom(s->fd, &remote_addr, &(s->local_addr), (char *)(area.iov[0].iov_base),
+                     (int)(area.iov[0].iov_len), &ttl, &tos, s->e->cmsg, MSG_ERRQUEUE | MSG_DONTWAIT, NULL);
+      }
+#endif
+      break;
+    }
+
+    int ttl = TTL_DEFAULT;
+    int tos = TOS_DEFAULT;
+    int gso = 0;
+    udp_recv_cmsg(&msg, &ttl, &tos, NULL, &gso);
+    CORRECT_RAW_TTL(ttl);
+    CORRECT_RAW_TOS(tos);
+
+    area.len = (size_t)len;
+    area.seglen = (gso > 0) ? (size_t)gso : (size_t)len;
+
+    size_t nsegs = udp_gro_area_segments(&area);
+    size_t k = 0;
+
+    if (area.seglen) {
+      s->gro_segsz = area.seglen;
+      s->gro_nsegs = nsegs;
+    }
+
+    for (k = 0; k < nsegs; ++k) {
+      stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)udp_gro_area_take(s->e, &area, k);
+      if (!buf_elem) {
+        break;
+      }
+
+      if (ioa_socket_check_bandwidth(s, buf_elem, 1)) {
+        if (s->read_cb) {
+          ioa_net_data nd;
+
+          memset(&nd, 0, sizeof(ioa_net_data));
+          addr_cpy(&(nd.src_addr), &remote_addr);
+          nd.nbh = buf_elem;
+          nd.recv_ttl = ttl;
+          nd.recv_tos = tos;
+
+          s->read_cb(s, IOA_EV_READ, &nd, s->read_ctx, 1);
+
+          if (nd.nbh) {
+            free_blist_elem(s->e, buf_elem);
+          }
+        } else {
+          ioa_network_buffer_delete(s->e, s->defer_nbh);
+          s->defer_nbh = buf_elem;
+        }
+        buf_elem = NULL;
+      }
+
+      if (buf_elem) {
+        free_blist_elem(s->e, buf_elem);
+      }
+
+      if (s->done || s->tobeclosed) {
+        break;
+      }
+    }
+
+  } while (!(s->done) && !(s->tobeclosed) && ((++try_cycle) < MAX_TRIES) && !(s->parent_s));
+
+  udp_gro_area_clear(s->e, &area);
+
+  return len;
+}
+
+#endif
+
 static int socket_input_worker(ioa_socket_handle s) {
   int len = 0;
   int ret = 0;
@@ -2398,14 +3631,13 @@ static int socket_input_worker(ioa_socket_handle s) {
 
   if ((s->st == TLS_SOCKET) || (s->st == TLS_SCTP_SOCKET)) {
 #if TLS_SUPPORTED
-    SSL *ctx = bufferevent_openssl_get_ssl(s->bev);
-    if (!ctx || SSL_get_shutdown(ctx)) {
+    if (tls_socket_shutdown(s)) {
       s->tobeclosed = 1;
       return 0;
     }
 #endif
   } else if (s->st == DTLS_SOCKET) {
-    if (!(s->ssl) || SSL_get_shutdown(s->ssl)) {
+    if (!(s->ssl) || (!handshake_pending(s) && SSL_get_shutdown(s->ssl))) {
       s->tobeclosed = 1;
       return 0;
     }
@@ -2434,6 +3666,10 @@ static int socket_input_worker(ioa_socket_handle s) {
         set_socket_ssl(s, SSL_new(s->e->tls_ctx));
       }
 
+      if (s->ssl && tls_handshake_offload(s)) {
+        return 0;
+      }
+
       if (s->ssl) {
         s->bev = bufferevent_openssl_socket_new(s->e->event_base, s->fd, s->ssl, BUFFEREVENT_SSL_ACCEPTING,
                                                 TURN_BUFFEREVENTS_OPTIONS);
@@ -2493,6 +3729,12 @@ static int socket_input_worker(ioa_socket_handle s) {
     }
   }
 
+#if UDP_GRO_SUPPORTED
+  if (s->gro && !(s->bev) && !(s->ssl) && (s->fd >= 0)) {
+    return socket_input_worker_gro(s);
+  }
+#endif
+
 try_start:
 
   if (!(s->e)) {
@@ -2502,9 +3744,14 @@ try_start:
   try_again = 0;
   try_ok = 0;
 
-  stun_buffer_list_elem *buf_elem = new_blist_elem(s->e);
+  /* a datagram is received into a small buffer, which is swapped for a large one if it does not fit */
+  stun_buffer_list_elem *buf_elem = s->bev ? new_blist_elem(s->e) : new_blist_elem_class(s->e, NBUF_CLASS_SMALL);
   len = -1;
 
+  if (!buf_elem) {
+    return -1;
+  }
+
   if (s->bev) { /* TCP & TLS  & SCTP & SCTP/TLS */
     struct evbuffer *inbuf = bufferevent_get_input(s->bev);
     if (inbuf) {
@@ -2549,8 +3796,7 @@ try_start:
               log_socket_event(s, "socket read failed, to be closed", 1);
             } else if ((s->st == TLS_SOCKET) || (s->st == TLS_SCTP_SOCKET)) {
 #if TLS_SUPPORTED
-              SSL *ctx = bufferevent_openssl_get_ssl(s->bev);
-              if (!ctx || SSL_get_shutdown(ctx)) {
+              if (tls_socket_shutdown(s)) {
                 ret = -1;
                 s->tobeclosed = 1;
               }
@@ -2578,24 +3824,31 @@ try_start:
       len = -1;
     }
   } else if (s->fd >= 0) { /* UDP and DTLS */
-    ret = udp_recvfrom(s->fd, &remote_addr, &(s->local_addr), (char *)(buf_elem->buf.buf), UDP_STUN_BUFFER_SIZE, &ttl,
-                       &tos, s->e->cmsg, 0, NULL);
+    ioa_network_buffer_handle nbh = buf_elem;
+    ret = udp_recvfrom_nbh(s->e, s->fd, &remote_addr, &(s->local_addr), &nbh, &ttl, &tos, 0, NULL);
+    buf_elem = (stun_buffer_list_elem *)nbh;
     len = ret;
     if (s->ssl && (len > 0)) { /* DTLS */
-      send_ssl_backlog_buffers(s);
-      buf_elem->buf.len = (size_t)len;
-      ret = ssl_read(s->fd, s->ssl, (ioa_network_buffer_handle)buf_elem, (s->e ? s->e->verbose : TURN_VERBOSE_NONE));
-      addr_cpy(&remote_addr, &(s->remote_addr));
-      if (ret < 0) {
-        len = -1;
-        s->tobeclosed = 1;
-        s->broken = 1;
-        log_socket_event(s, "SSL read failed, to be closed", 0);
+      if (dtls_handshake_offload(s, (ioa_network_buffer_handle)buf_elem)) {
+        /* the handshake thread owns the datagram, its reply delivers the data */
+        buf_elem = NULL;
+        ret = -1;
+        len = 0;
       } else {
-        len = (int)ioa_network_buffer_get_size((ioa_network_buffer_handle)buf_elem);
-      }
-      if ((ret != -1) && (len > 0)) {
-        try_again = 1;
+        send_ssl_backlog_buffers(s);
+        ret = ssl_read(s->fd, s->ssl, (ioa_network_buffer_handle)buf_elem, s->e->ssl_scratch, s->e->verbose);
+        addr_cpy(&remote_addr, &(s->remote_addr));
+        if (ret < 0) {
+          len = -1;
+          s->tobeclosed = 1;
+          s->broken = 1;
+          log_socket_event(s, "SSL read failed, to be closed", 0);
+        } else {
+          len = (int)ioa_network_buffer_get_size((ioa_network_buffer_handle)buf_elem);
+        }
+        if ((ret != -1) && (len > 0)) {
+          try_again = 1;
+        }
       }
     } else { /* UDP */
       if (ret >= 0) {
@@ -2705,6 +3958,54 @@ static void socket_input_handler(evutil_socket_t fd, short what, void *arg) {
   close_ioa_socket_after_processing_if_necessary(s);
 }
 
+/*
+ * io_uring receive completion of a UDP socket: the datagram is already
+ * read, only the delivery part of socket_input_worker() is left. When
+ * io_uring gives the socket up, it is read by libevent, which reports
+ * the errors the usual way.
+ */
+static void socket_input_uring(void *arg, ioa_net_data *nd) {
+
+  ioa_socket_handle s = (ioa_socket_handle)arg;
+
+  if (!s || (s->magic != SOCKET_MAGIC) || (s->done) || !(s->e)) {
+    return;
+  }
+
+  if (!nd) {
+    s->uring_recv = 0;
+    if (!(s->read_event)) {
+      s->read_event = event_new(s->e->event_base, s->fd, EV_READ | EV_PERSIST, socket_input_handler, s);
+      event_add(s->read_event, NULL);
+    }
+    return;
+  }
+
+  if (ioa_socket_tobeclosed(s)) {
+    return;
+  }
+
+  if (s->connected) {
+    addr_cpy(&(nd->src_addr), &(s->remote_addr));
+  }
+
+  if (ioa_socket_check_bandwidth(s, nd->nbh, 1)) {
+    if (s->read_cb) {
+      s->read_cb(s, IOA_EV_READ, nd, s->read_ctx, 1);
+    } else {
+      ioa_network_buffer_delete(s->e, s->defer_nbh);
+      s->defer_nbh = nd->nbh;
+      nd->nbh = NULL;
+    }
+  }
+
+  if ((s->magic != SOCKET_MAGIC) || (s->done)) {
+    return;
+  }
+
+  close_ioa_socket_after_processing_if_necessary(s);
+}
+
 void close_ioa_socket_after_processing_if_necessary(ioa_socket_handle s) {
   if (s && ioa_socket_tobeclosed(s)) {
 
@@ -2803,6 +4104,73 @@ static int read_spare_buffer_bev(struct bufferevent *bev) {
   return 0;
 }
 
+#if KTLS_SUPPORTED
+/*
+ * After the handshake of a TLS client connection, OpenSSL hands the record
+ * encryption over to the kernel when it can (SSL_OP_ENABLE_KTLS, see --ktls).
+ * If the kernel does both directions of a TLSv1.2 connection, the OpenSSL
+ * bufferevent is replaced by a plain socket one, and the relay thread reads and
+ * writes the application data directly. A record other than application data
+ * (close_notify) then makes the socket read fail, and the connection is closed.
+ * TLSv1.3 clients send KeyUpdate records in the normal course of a session, so
+ * their records stay with the OpenSSL bufferevent, which still uses the kernel
+ * offload through its kTLS BIOs; so does a connection with kTLS in one
+ * direction only.
+ */
+static void socket_switch_to_ktls(ioa_socket_handle s) {
+  SSL *ssl = s->ssl;
+
+  if (!ssl || !(s->bev) || (bufferevent_openssl_get_ssl(s->bev) != ssl)) {
+    return;
+  }
+
+  if (!(SSL_get_options(ssl) & SSL_OP_ENABLE_KTLS)) {
+    s->ktls = -1;
+    return;
+  }
+
+  if (!SSL_is_init_finished(ssl)) {
+    return;
+  }
+
+  /* the keys are installed with the handshake, so the kernel will not take the records later */
+  if (!BIO_get_ktls_send(SSL_get_wbio(ssl)) || !BIO_get_ktls_recv(SSL_get_rbio(ssl))) {
+    s->ktls = -1;
+    log_socket_event(s, "kTLS is not available, TLS records stay in OpenSSL", 0);
+    return;
+  }
+
+  if (SSL_version(ssl) != TLS1_2_VERSION) {
+    s->ktls = -1;
+    log_socket_event(s, "kTLS is done through OpenSSL, which handles the TLSv1.3 KeyUpdate records", 0);
+    return;
+  }
+
+  /* wait until OpenSSL has nothing buffered in either direction */
+  if (SSL_has_pending(ssl) || evbuffer_get_length(bufferevent_get_output(s->bev))) {
+    return;
+  }
+
+  struct bufferevent *bev = bufferevent_socket_new(s->e->event_base, s->fd, TURN_BUFFEREVENTS_OPTIONS);
+  if (!bev) {
+    s->ktls = -1;
+    return;
+  }
+
+  short enabled = bufferevent_get_enabled(s->bev);
+  evbuffer_add_buffer(bufferevent_get_input(bev), bufferevent_get_input(s->bev));
+  BUFFEREVENT_FREE(s->bev);
+
+  s->bev = bev;
+  s->ktls = 1;
+  bufferevent_setcb(s->bev, socket_input_handler_bev, socket_output_handler_bev, eventcb_bev, s);
+  bufferevent_setwatermark(s->bev, EV_READ | EV_WRITE, 0, BUFFEREVENT_HIGH_WATERMARK);
+  bufferevent_enable(s->bev, enabled);
+
+  log_socket_event(s, "kTLS enabled, TLS records are done by the kernel", 0);
+}
+#endif
+
 static void socket_input_handler_bev(struct bufferevent *bev, void *arg) {
 
   if (bev) {
@@ -2827,6 +4195,12 @@ static void socket_input_handler_bev(struct bufferevent *bev, void *arg) {
       return;
     }
 
+#if KTLS_SUPPORTED
+    if ((s->st == TLS_SOCKET) && !(s->ktls)) {
+      socket_switch_to_ktls(s);
+    }
+#endif
+
     {
       size_t cycle = 0;
       do {
@@ -3186,6 +4560,26 @@ int udp_send(ioa_socket_handle s, const ioa_addr *dest_addr, const char *buffer,
   return rc;
 }
 
+static void udp_send_failed(ioa_socket_handle s, const ioa_addr *dest_addr) {
+  s->tobeclosed = 1;
+#if defined(EADDRNOTAVAIL)
+  int perr = socket_errno();
+#endif
+  perror("udp send");
+#if defined(EADDRNOTAVAIL)
+  if (dest_addr && (perr == EADDRNOTAVAIL)) {
+    char sfrom[129];
+    addr_to_string(&(s->local_addr), (uint8_t *)sfrom);
+    char sto[129];
+    addr_to_string(dest_addr, (uint8_t *)sto);
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: network error: address unreachable from %s to %s\n", __FUNCTION__, sfrom,
+                  sto);
+  }
+#else
+  UNUSED_ARG(dest_addr);
+#endif
+}
+
 int send_data_from_ioa_socket_nbh(ioa_socket_handle s, ioa_addr *dest_addr, ioa_network_buffer_handle nbh, int ttl,
                                   int tos, int *skip) {
   int ret = -1;
@@ -3218,8 +4612,7 @@ int send_data_from_ioa_socket_nbh(ioa_socket_handle s, ioa_addr *dest_addr, ioa_
           if (s->connected && s->bev) {
             if ((s->st == TLS_SOCKET) || (s->st == TLS_SCTP_SOCKET)) {
 #if TLS_SUPPORTED
-              SSL *ctx = bufferevent_openssl_get_ssl(s->bev);
-              if (!ctx || SSL_get_shutdown(ctx)) {
+              if (tls_socket_shutdown(s)) {
                 s->tobeclosed = 1;
                 ret = 0;
               }
@@ -3250,6 +4643,9 @@ int send_data_from_ioa_socket_nbh(ioa_socket_handle s, ioa_addr *dest_addr, ioa_
                 ;
               }
             }
+          } else if (s->ssl && handshake_pending(s)) {
+            ret = (int)ioa_network_buffer_get_size(nbh);
+            add_buffer_to_buffer_list(&(s->bufs), (char *)ioa_network_buffer_data(nbh), (size_t)ret);
           } else if (s->ssl) {
             send_ssl_backlog_buffers(s);
             ret = ssl_send(s, (char *)ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh),
@@ -3268,23 +4664,15 @@ int send_data_from_ioa_socket_nbh(ioa_socket_handle s, ioa_addr *dest_addr, ioa_
               dest_addr = &(s->remote_addr);
             }
 
-            ret = udp_send(s, dest_addr, (char *)ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh));
-            if (ret < 0) {
-              s->tobeclosed = 1;
-#if defined(EADDRNOTAVAIL)
-              int perr = socket_errno();
-#endif
-              perror("udp send");
-#if defined(EADDRNOTAVAIL)
-              if (dest_addr && (perr == EADDRNOTAVAIL)) {
-                char sfrom[129];
-                addr_to_string(&(s->local_addr), (uint8_t *)sfrom);
-                char sto[129];
-                addr_to_string(dest_addr, (uint8_t *)sto);
-                TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: network error: address unreachable from %s to %s\n",
-                              __FUNCTION__, sfrom, sto);
+            if (s->e->udp_send_batch > 1) {
+              ret = (int)ioa_network_buffer_get_size(nbh);
+              udp_send_enqueue(s, dest_addr, nbh);
+              nbh = NULL;
+            } else {
+              ret = udp_send(s, dest_addr, (char *)ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh));
+              if (ret < 0) {
+                udp_send_failed(s, dest_addr);
               }
-#endif
             }
           }
         }
@@ -3311,8 +4699,7 @@ int send_data_from_ioa_socket_tcp(ioa_socket_handle s, const void *data, size_t
     } else if (s->connected && s->bev) {
       if ((s->st == TLS_SOCKET) || (s->st == TLS_SCTP_SOCKET)) {
 #if TLS_SUPPORTED
-        SSL *ctx = bufferevent_openssl_get_ssl(s->bev);
-        if (!ctx || SSL_get_shutdown(ctx)) {
+        if (tls_socket_shutdown(s)) {
           s->tobeclosed = 1;
           ret = 0;
         }
@@ -3369,14 +4756,19 @@ int register_callback_on_ioa_socket(ioa_engine_handle e, ioa_socket_handle s, in
         switch (s->st) {
         case DTLS_SOCKET:
         case UDP_SOCKET:
-          if (s->read_event) {
+          if (s->read_event || s->uring_recv) {
             if (!clean_preexisting) {
               TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: software error: buffer preset 1\n", __FUNCTION__);
               return -1;
             }
           } else {
-            s->read_event = event_new(s->e->event_base, s->fd, EV_READ | EV_PERSIST, socket_input_handler, s);
-            event_add(s->read_event, NULL);
+            if (s->e->uring && (s->st == UDP_SOCKET) && !(s->gro)) {
+              s->uring_recv = ioa_uring_recv_start(s->e, s->fd, socket_input_uring, s);
+            }
+            if (!(s->uring_recv)) {
+              s->read_event = event_new(s->e->event_base, s->fd, EV_READ | EV_PERSIST, socket_input_handler, s);
+              event_add(s->read_event, NULL);
+            }
           }
           break;
         case TENTATIVE_TCP_SOCKET:
@@ -3424,7 +4816,7 @@ int register_callback_on_ioa_socket(ioa_engine_handle e, ioa_socket_handle s, in
               TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: software error: buffer preset 5\n", __FUNCTION__);
               return -1;
             }
-          } else {
+          } else if (!handshake_pending(s)) {
 #if TLS_SUPPORTED
             if (!(s->ssl)) {
               //??? how we can get to this point ???
@@ -3482,7 +4874,7 @@ int ioa_socket_tobeclosed(ioa_socket_handle s) {
       s->tobeclosed = 1;
       log_socket_event(s, "socket fd<0", 0);
       return 1;
-    } else if (s->ssl) {
+    } else if (s->ssl && !handshake_pending(s)) {
       if (SSL_get_shutdown(s->ssl)) {
         s->tobeclosed = 1;
         log_socket_event(s, "socket SSL shutdown", 0);
@@ -3510,6 +4902,10 @@ ioa_network_buffer_handle ioa_network_buffer_allocate(ioa_engine_handle e) {
   return buf_elem;
 }
 
+ioa_network_buffer_handle ioa_network_buffer_allocate_size(ioa_engine_handle e, size_t size) {
+  return new_blist_elem_size(e, size);
+}
+
 /* We do not use special header in this simple implementation */
 void ioa_network_buffer_header_init(ioa_network_buffer_handle nbh) { UNUSED_ARG(nbh); }
 
@@ -3532,8 +4928,9 @@ size_t ioa_network_buffer_get_capacity(ioa_network_buffer_handle nbh) {
     return 0;
   } else {
     stun_buffer_list_elem *buf_elem = (stun_buffer_list_elem *)nbh;
-    if (buf_elem->buf.offset < STUN_BUFFER_SIZE) {
-      return (STUN_BUFFER_SIZE - buf_elem->buf.offset);
+    size_t capacity = blist_elem_capacity(buf_elem);
+    if (buf_elem->buf.offset < capacity) {
+      return (capacity - buf_elem->buf.offset);
     }
     return 0;
   }
@@ -3552,7 +4949,7 @@ void ioa_network_buffer_add_offset_size(ioa_network_buffer_handle nbh, uint16_t
   buf_elem->buf.offset += offset;
   buf_elem->buf.coffset += coffset;
 
-  if ((buf_elem->buf.offset + buf_elem->buf.len - buf_elem->buf.coffset) >= sizeof(buf_elem->buf.buf) ||
+  if ((buf_elem->buf.offset + buf_elem->buf.len - buf_elem->buf.coffset) >= blist_elem_capacity(buf_elem) ||
       (buf_elem->buf.offset + sizeof(buf_elem->buf.channel) < buf_elem->buf.coffset)) {
     buf_elem->buf.coffset = 0;
     buf_elem->buf.len = 0;
@@ -3578,14 +4975,14 @@ void ioa_network_buffer_delete(ioa_engine_handle e, ioa_network_buffer_handle nb
 /////////// REPORTING STATUS /////////////////////
 
 const char *get_ioa_socket_cipher(ioa_socket_handle s) {
-  if (s && s->ssl) {
+  if (s && s->ssl && !handshake_pending(s)) {
     return SSL_get_cipher(s->ssl);
   }
   return "no SSL";
 }
 
 const char *get_ioa_socket_ssl_method(ioa_socket_handle s) {
-  if (s && s->ssl) {
+  if (s && s->ssl && !handshake_pending(s)) {
     return turn_get_ssl_method(s->ssl, "UNKNOWN");
   }
   return "no SSL";
@@ -3832,14 +5229,14 @@ void turn_report_session_usage(void *session, int force_invalid) {
 /////////////// SSL ///////////////////
 
 const char *get_ioa_socket_tls_cipher(ioa_socket_handle s) {
-  if (s && (s->ssl)) {
+  if (s && (s->ssl) && !handshake_pending(s)) {
     return SSL_get_cipher(s->ssl);
   }
   return "";
 }
 
 const char *get_ioa_socket_tls_method(ioa_socket_handle s) {
-  if (s && (s->ssl)) {
+  if (s && (s->ssl) && !handshake_pending(s)) {
     return turn_get_ssl_method(s->ssl, "UNKNOWN");
   }
   return "";
@@ -3848,48 +5245,86 @@ const char *get_ioa_socket_tls_method(ioa_socket_handle s) {
 ///////////// Super Memory Region //////////////
 
 #define TURN_SM_SIZE (1024 << 11)
+#define TURN_SM_ALIGN (16)
+#define TURN_SM_ALIGN_SIZE(size) (((size) + TURN_SM_ALIGN - 1) & ~((size_t)TURN_SM_ALIGN - 1))
+/* Allocations larger than this get a chunk of their own */
+#define TURN_SM_MAX_SHARED_SIZE (TURN_SM_SIZE >> 2)
+
+/*
+ * A region is a list of zeroed chunks. Memory is taken from the current
+ * chunk (the list head) by moving its used size forward with an atomic
+ * compare-and-swap, so the allocations do not take any lock; the mutex
+ * only serializes adding a chunk. Memory is never given back.
+ */
+typedef struct _super_memory_chunk {
+  struct _super_memory_chunk *next;
+  size_t size;
+  size_t used;
+} super_memory_chunk;
+
+#define TURN_SM_CHUNK_HDR TURN_SM_ALIGN_SIZE(sizeof(super_memory_chunk))
 
 struct _super_memory {
   TURN_MUTEX_DECLARE(mutex_sm)
-  char **super_memory;
-  size_t *sm_allocated;
+  super_memory_chunk *chunk;
   size_t sm_total_sz;
-  size_t sm_chunk;
+  size_t sm_allocated;
+  size_t sm_reported_total_sz;
+  size_t sm_reported_allocated;
   uint32_t id;
+  char name[32];
+  struct _super_memory *next_region;
 };
 
-static void init_super_memory_region(super_memory_t *r) {
-  if (r) {
-    r->super_memory = (char **)malloc(sizeof(char *));
-    r->super_memory[0] = (char *)calloc(1, TURN_SM_SIZE);
-
-    r->sm_allocated = (size_t *)malloc(sizeof(size_t));
-    r->sm_allocated[0] = 0;
+/* All regions, for the usage report */
+static pthread_mutex_t super_memory_regions_mutex = PTHREAD_MUTEX_INITIALIZER;
+static super_memory_t *super_memory_regions = NULL;
 
-    r->sm_total_sz = TURN_SM_SIZE;
-    r->sm_chunk = 0;
+void init_super_memory(void) { ; }
 
+super_memory_t *new_super_memory_region(const char *name) {
+  super_memory_t *r = (super_memory_t *)calloc(1, sizeof(super_memory_t));
+  if (r) {
     while (r->id == 0) {
       r->id = (uint32_t)turn_random();
     }
-
+    if (name) {
+      STRCPY(r->name, name);
+    } else {
+      snprintf(r->name, sizeof(r->name), "%u", (unsigned int)r->id);
+    }
     TURN_MUTEX_INIT(&r->mutex_sm);
+
+    pthread_mutex_lock(&super_memory_regions_mutex);
+    r->next_region = super_memory_regions;
+    super_memory_regions = r;
+    pthread_mutex_unlock(&super_memory_regions_mutex);
   }
+  return r;
 }
 
-void init_super_memory(void) { ; }
+const char *get_super_memory_region_name(super_memory_t *r) { return r ? r->name : ""; }
 
-super_memory_t *new_super_memory_region(void) {
-  super_memory_t *r = (super_memory_t *)calloc(1, sizeof(super_memory_t));
-  init_super_memory_region(r);
-  return r;
+static super_memory_chunk *new_super_memory_chunk(super_memory_t *r, size_t size) {
+  super_memory_chunk *c = (super_memory_chunk *)calloc(1, TURN_SM_CHUNK_HDR + size);
+  if (c) {
+    c->size = size;
+    __atomic_add_fetch(&(r->sm_total_sz), TURN_SM_CHUNK_HDR + size, __ATOMIC_RELAXED);
+  }
+  return c;
 }
 
-void *allocate_super_memory_region_func(super_memory_t *r, size_t size, const char *file, const char *func, int line) {
-  UNUSED_ARG(file);
-  UNUSED_ARG(func);
-  UNUSED_ARG(line);
+static void *allocate_super_memory_chunk(super_memory_chunk *c, size_t size) {
+  size_t used = __atomic_load_n(&(c->used), __ATOMIC_RELAXED);
+  do {
+    if (c->size - used < size) {
+      return NULL;
+    }
+  } while (!__atomic_compare_exchange_n(&(c->used), &used, used + size, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  return (char *)c + TURN_SM_CHUNK_HDR + used;
+}
 
+void *allocate_super_memory_region_func(super_memory_t *r, size_t size, const char *file, const char *func, int line) {
   void *ret = NULL;
 
   if (!r) {
@@ -3897,66 +5332,79 @@ void *allocate_super_memory_region_func(super_memory_t *r, size_t size, const ch
     return ret;
   }
 
-  TURN_MUTEX_LOCK(&r->mutex_sm);
-
-  size = ((size_t)((size + sizeof(void *)) / (sizeof(void *)))) * sizeof(void *);
-
-  if (size >= TURN_SM_SIZE) {
+  size = TURN_SM_ALIGN_SIZE(size ? size : 1);
 
-    TURN_LOG_FUNC(
-        TURN_LOG_LEVEL_INFO,
-        "(%s:%s:%d): Size too large for super memory: region id = %u, chunk=%lu, total=%lu, allocated=%lu, want=%lu\n",
-        file, func, line, (unsigned int)r->id, (unsigned long)r->sm_chunk, (unsigned long)r->sm_total_sz,
-        (unsigned long)r->sm_allocated[r->sm_chunk], (unsigned long)size);
+  if (size > TURN_SM_MAX_SHARED_SIZE) {
 
-  } else {
-
-    size_t i = 0;
-    char *region = NULL;
-    size_t *rsz = NULL;
-    for (i = 0; i <= r->sm_chunk; ++i) {
-
-      size_t left = (size_t)r->sm_total_sz - r->sm_allocated[i];
-
-      if (left < size + sizeof(void *)) {
-        continue;
+    super_memory_chunk *c = new_super_memory_chunk(r, size);
+    if (c) {
+      c->used = size;
+      TURN_MUTEX_LOCK(&r->mutex_sm);
+      super_memory_chunk *head = r->chunk;
+      if (head) {
+        c->next = head->next;
+        head->next = c;
       } else {
-        region = r->super_memory[i];
-        rsz = r->sm_allocated + i;
-        break;
+        __atomic_store_n(&(r->chunk), c, __ATOMIC_RELEASE);
       }
+      TURN_MUTEX_UNLOCK(&r->mutex_sm);
+      ret = (char *)c + TURN_SM_CHUNK_HDR;
     }
 
-    if (!region) {
-      r->sm_chunk += 1;
-      r->super_memory = (char **)realloc(r->super_memory, (r->sm_chunk + 1) * sizeof(char *));
-      r->super_memory[r->sm_chunk] = (char *)calloc(1, TURN_SM_SIZE);
-      r->sm_allocated = (size_t *)realloc(r->sm_allocated, (r->sm_chunk + 1) * sizeof(size_t));
-      r->sm_allocated[r->sm_chunk] = 0;
-      region = r->super_memory[r->sm_chunk];
-      rsz = r->sm_allocated + r->sm_chunk;
-    }
-
-    {
-      char *ptr = region + *rsz;
+  } else {
 
-      memset(ptr, 0, size);
+    for (;;) {
+      super_memory_chunk *head = __atomic_load_n(&(r->chunk), __ATOMIC_ACQUIRE);
+      if (head) {
+        ret = allocate_super_memory_chunk(head, size);
+        if (ret) {
+          break;
+        }
+      }
 
-      *rsz += size;
+      TURN_MUTEX_LOCK(&r->mutex_sm);
+      if (r->chunk == head) {
+        super_memory_chunk *c = new_super_memory_chunk(r, TURN_SM_SIZE - TURN_SM_CHUNK_HDR);
+        if (c) {
+          c->next = head;
+          __atomic_store_n(&(r->chunk), c, __ATOMIC_RELEASE);
+        }
+      }
+      int added = (r->chunk != head);
+      TURN_MUTEX_UNLOCK(&r->mutex_sm);
 
-      ret = ptr;
+      if (!added) {
+        break;
+      }
     }
   }
 
-  TURN_MUTEX_UNLOCK(&r->mutex_sm);
-
-  if (!ret) {
+  if (ret) {
+    __atomic_add_fetch(&(r->sm_allocated), size, __ATOMIC_RELAXED);
+  } else {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "(%s:%s:%d): Cannot allocate super memory: region %s, total=%lu, want=%lu\n",
+                  file, func, line, r->name, (unsigned long)__atomic_load_n(&(r->sm_total_sz), __ATOMIC_RELAXED),
+                  (unsigned long)size);
     ret = calloc(1, size);
   }
 
   return ret;
 }
 
+void report_super_memory(void) {
+  pthread_mutex_lock(&super_memory_regions_mutex);
+  for (super_memory_t *r = super_memory_regions; r; r = r->next_region) {
+    size_t total_sz = __atomic_load_n(&(r->sm_total_sz), __ATOMIC_RELAXED);
+    size_t allocated = __atomic_load_n(&(r->sm_allocated), __ATOMIC_RELAXED);
+    if ((total_sz != r->sm_reported_total_sz) || (allocated != r->sm_reported_allocated)) {
+      prom_set_super_memory(r->name, total_sz, allocated);
+      r->sm_reported_total_sz = total_sz;
+      r->sm_reported_allocated = allocated;
+    }
+  }
+  pthread_mutex_unlock(&super_memory_regions_mutex);
+}
+
 void *allocate_super_memory_engine_func(ioa_engine_handle e, size_t size, const char *file, const char *func,
                                         int line) {
   if (e) {
@@ -48,7 +48,10 @@
 #include "stun_buffer.h"
 #include "userdb.h"
 
+#include "ns_auth_cache.h"
+#include "ns_mpsc_queue.h"
 #include "ns_sm.h"
+#include "ns_timer_wheel.h"
 
 #include <event2/buffer.h>
 #include <event2/bufferevent.h>
@@ -58,24 +61,49 @@
 
 #include <pthread.h>
 
+#if defined(__linux__)
+#include <netinet/udp.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 //////////////////////////////////////////////////////
 
-#define MAX_BUFFER_QUEUE_SIZE_PER_ENGINE (64)
+#define MAX_BUFFER_QUEUE_SIZE_PER_ENGINE (64) /* default cap of the free buffers per size class */
 #define MAX_SOCKET_BUFFER_BACKLOG (16)
 
 #define BUFFEREVENT_HIGH_WATERMARK (128 << 10)
 #define BUFFEREVENT_MAX_UDP_TO_TCP_WRITE (64 << 9)
 #define BUFFEREVENT_MAX_TCP_TO_TCP_WRITE (192 << 10)
 
+/*
+ * Network buffer size classes. A small buffer holds a datagram of the usual
+ * path MTU, a large one holds any STUN/TURN message (STUN_BUFFER_SIZE).
+ */
+typedef enum { NBUF_CLASS_SMALL = 0, NBUF_CLASS_LARGE, NBUF_CLASS_NUM } nbuf_class;
+
 typedef struct _stun_buffer_list_elem {
   struct _stun_buffer_list_elem *next;
+  nbuf_class bclass;
   stun_buffer buf;
 } stun_buffer_list_elem;
 
+#define NBUF_SMALL_ALLOC_SIZE (2048)
+#define NBUF_SMALL_CAPACITY (NBUF_SMALL_ALLOC_SIZE - offsetof(stun_buffer_list_elem, buf.buf))
+/* Largest datagram kept in a small buffer, room is left for the ChannelData padding */
+#define NBUF_SMALL_DATAGRAM_SIZE (NBUF_SMALL_CAPACITY - 4)
+/* Receive area for the rest of a datagram that does not fit a small buffer */
+#define UDP_RECV_OVERFLOW_SIZE (UDP_STUN_BUFFER_SIZE - NBUF_SMALL_DATAGRAM_SIZE)
+
+/* Buffer pool usage of one size class */
+typedef struct _nbuf_pool_stats {
+  long in_use;
+  long high_water;
+  unsigned long misses; /* allocations not served from the free list */
+} nbuf_pool_stats;
+
 typedef struct _stun_buffer_list {
   stun_buffer_list_elem *head;
   stun_buffer_list_elem *tail;
@@ -104,13 +132,16 @@ struct relay_server {
   turnserver_id id;
   super_memory_t *sm;
   struct event_base *event_base;
-  struct bufferevent *in_buf;
-  struct bufferevent *out_buf;
-  struct bufferevent *auth_in_buf;
-  struct bufferevent *auth_out_buf;
+  mpsc_queue *queue;      // struct message_to_relay
+  mpsc_queue *auth_queue; // struct auth_message, answered by the auth servers
+  auth_cache *auth_cache; // keys of the users authenticated by this thread
   ioa_engine_handle ioa_eng;
   turn_turnserver server;
   pthread_t thr;
+  uint64_t channel_data_fast_reported;
+  uint64_t channel_data_slow_reported;
+  mpsc_queue_stats queue_reported;
+  mpsc_queue_stats auth_queue_reported;
 };
 
 struct message_to_relay {
@@ -131,8 +162,48 @@ typedef int (*ioa_engine_udp_event_handler)(relay_server_handle rs, struct messa
 
 #define TURN_CMSG_SZ (65536)
 
-#define PREDEF_TIMERS_NUM (14)
-extern const int predef_timer_intervals[PREDEF_TIMERS_NUM];
+/* Batched UDP receive (recvmmsg) */
+#if defined(__linux__)
+#define UDP_MMSG_SUPPORTED 1
+#else
+#define UDP_MMSG_SUPPORTED 0
+#endif
+
+#define MAX_UDP_RECV_BATCH (64)
+#define UDP_MMSG_CMSG_SZ (256) /* per-datagram part of the engine cmsg buffer */
+
+/* Batched UDP transmit (sendmmsg, UDP GSO) */
+#define MAX_UDP_SEND_BATCH (64)
+#if UDP_MMSG_SUPPORTED && defined(UDP_SEGMENT) && defined(SOL_UDP)
+#define UDP_GSO_SUPPORTED 1
+#else
+#define UDP_GSO_SUPPORTED 0
+#endif
+#define UDP_GSO_MAX_SIZE (65000) /* total payload of one GSO super-datagram */
+
+/* UDP GRO receive */
+#if UDP_MMSG_SUPPORTED && defined(UDP_GRO) && defined(SOL_UDP)
+#define UDP_GRO_SUPPORTED 1
+#else
+#define UDP_GRO_SUPPORTED 0
+#endif
+#define UDP_GRO_MAX_SEGMENTS (64)
+
+typedef struct _udp_gro_area udp_gro_area;
+
+typedef struct _udp_send_queue_elem {
+  ioa_socket_handle s;
+  evutil_socket_t fd;
+  int dest_set;
+  ioa_addr dest;
+  ioa_network_buffer_handle nbh;
+} udp_send_queue_elem;
+
+/* io_uring receive ring of an engine, see ns_ioalib_uring.h */
+typedef struct _ioa_uring ioa_uring;
+
+/* Timer wheel resolution; timers with milliseconds stay libevent timers */
+#define TIMER_WHEEL_TICK_MS (100)
 
 struct _ioa_engine {
   super_memory_t *sm;
@@ -141,14 +212,28 @@ struct _ioa_engine {
   int verbose;
   turnipports *tp;
   rtcp_map *map_rtcp;
-  stun_buffer_list bufs;
+  /* Free network buffers per size class */
+  stun_buffer_list bufs[NBUF_CLASS_NUM];
+  size_t bufs_max;
+  nbuf_pool_stats bufs_stats[NBUF_CLASS_NUM];
+  nbuf_pool_stats bufs_reported[NBUF_CLASS_NUM];
   SSL_CTX *tls_ctx;
   SSL_CTX *dtls_ctx;
   turn_time_t jiffie; /* bandwidth check interval */
   ioa_timer_handle timer_ev;
   char cmsg[TURN_CMSG_SZ + 1];
-  int predef_timer_intervals[PREDEF_TIMERS_NUM];
-  struct timeval predef_timers[PREDEF_TIMERS_NUM];
+  /* UDP receive overflow areas, one per recvmmsg() slot */
+  uint8_t *recv_overflow;
+  int recv_overflow_slots;
+  /* Decrypted data of a DTLS record received in a small buffer */
+  char ssl_scratch[UDP_STUN_BUFFER_SIZE];
+  /* Timers, driven by one libevent timer per engine */
+  timer_wheel tw;
+  struct event *tw_ev;
+  uint64_t tw_tick;
+  unsigned long tw_expired;
+  unsigned long tw_reported_expired;
+  uint64_t tw_lag_max; /* ms, since the last report */
   /* Relays */
   char relay_ifname[1025];
   int default_relays;
@@ -156,10 +241,33 @@ struct _ioa_engine {
   size_t relay_addr_counter;
   ioa_addr *relay_addrs;
   redis_context_handle rch;
+  /* UDP transmit queue, flushed once per event loop iteration */
+  int udp_send_batch;
+  int udp_gso;
+  int udp_gro;
+  struct event *udp_sq_ev;
+  size_t udp_sq_size;
+  udp_send_queue_elem udp_sq[MAX_UDP_SEND_BATCH];
+  /* io_uring receive, NULL - libevent only */
+  ioa_uring *uring;
+  /* replies of the handshake threads, NULL - the handshakes run in this thread */
+  mpsc_queue *handshake_queue;
+  mpsc_queue_stats handshake_queue_reported;
+  /* last quiescent epoch seen by the engine timer, see ioa_engine_track_quiescence() */
+  uint64_t quiescent_epoch;
+  struct _ioa_engine *quiescent_next;
 };
 
 #define SOCKET_MAGIC (0xABACADEF)
 
+/* The sockets of one remote IP address in a relay index, the value of the index map */
+typedef struct _ioa_socket_ip_bucket {
+  struct _ioa_socket *head;
+  struct _ioa_socket *cursor; /* where the next search of the bucket starts */
+  turn_time_t search_time;    /* the second that searches counts */
+  int searches;
+} ioa_socket_ip_bucket;
+
 struct traffic_bytes {
   band_limit_t jiffie_bytes_read;
   band_limit_t jiffie_bytes_write;
@@ -170,6 +278,9 @@ struct _ioa_socket {
   struct _ioa_socket *parent_s;
   uint32_t magic;
   ur_addr_map *sockets_container; /* relay container for UDP sockets */
+  ur_addr_map *sockets_ip_index;  /* relay index of the DTLS sockets by remote IP */
+  struct _ioa_socket *ip_prev;    /* sockets of the same remote IP in the index */
+  struct _ioa_socket *ip_next;
   struct bufferevent *bev;
   ioa_network_buffer_handle defer_nbh;
   int family;
@@ -177,6 +288,7 @@ struct _ioa_socket {
   SOCKET_APP_TYPE sat;
   SSL *ssl;
   uint32_t ssl_renegs;
+  int ktls; /* TLS: 1 if the kernel does the records and bev is a plain socket bufferevent, -1 if OpenSSL does them */
   int in_write;
   int bound;
   int local_addr_known;
@@ -216,14 +328,24 @@ struct _ioa_socket {
   /* <<== RFC 6062 */
   void *special_session;
   size_t special_session_size;
+  /* UDP GRO: segment size and count of the last coalesced read */
+  int gro;
+  size_t gro_segsz;
+  size_t gro_nsegs;
+  /* io_uring multishot receive id, 0 - not used */
+  uint64_t uring_recv;
+  /* TLS/DTLS handshake in the handshake threads */
+  struct _ioa_handshake *hs;
 };
 
 typedef struct _timer_event {
-  struct event *ev;
+  timer_wheel_entry twe;
+  struct event *ev; /* NULL - the timer is in the engine timer wheel */
   ioa_engine_handle e;
   ioa_timer_event_handler cb;
   void *ctx;
   char *txt;
+  uint64_t period; /* ticks of a persistent wheel timer, 0 - one-shot */
 } timer_event;
 
 ///////////////////////////////////
@@ -244,6 +366,29 @@ ioa_engine_handle create_ioa_engine(super_memory_t *sm, struct event_base *eb, t
 );
 
 void ioa_engine_set_rtcp_map(ioa_engine_handle e, rtcp_map *rtcpmap);
+void ioa_engine_set_udp_send_batch(ioa_engine_handle e, int batch);
+void ioa_engine_flush_udp_send_queue(ioa_engine_handle e);
+void ioa_engine_set_udp_gro(ioa_engine_handle e, int gro);
+/* Hand the TLS/DTLS handshakes of the client sockets over to the handshake threads, if they run */
+void ioa_engine_set_handshake_offload(ioa_engine_handle e);
+/* Set the number of free network buffers kept per size class, 0 - no caching */
+void ioa_engine_set_buffer_pool_size(ioa_engine_handle e, int size);
+
+/*
+ * Quiescent state tracking, for the data that the engines read without
+ * locks and another thread replaces. The engine timer callback is a
+ * quiescent point: no lookup of such data spans it. A writer publishes the
+ * new data, then takes a new epoch with ioa_engines_next_epoch() for the old
+ * data; the old data can be freed once ioa_engines_quiescent_epoch() has
+ * reached that epoch.
+ */
+void ioa_engine_track_quiescence(ioa_engine_handle e);
+uint64_t ioa_engines_next_epoch(void);
+/* Return: the oldest epoch seen by the tracked engines, UINT64_MAX if there are none */
+uint64_t ioa_engines_quiescent_epoch(void);
+
+/* Allocate a network buffer of the smallest size class with the given capacity */
+ioa_network_buffer_handle ioa_network_buffer_allocate_size(ioa_engine_handle e, size_t size);
 
 ioa_socket_handle create_ioa_socket_from_fd(ioa_engine_handle e, ioa_socket_raw fd, ioa_socket_handle parent_s,
                                             SOCKET_TYPE st, SOCKET_APP_TYPE sat, const ioa_addr *remote_addr,
@@ -259,16 +404,84 @@ void delete_socket_from_parent(ioa_socket_handle s);
 
 void add_socket_to_map(ioa_socket_handle s, ur_addr_map *amap);
 void delete_socket_from_map(ioa_socket_handle s);
+void add_socket_to_ip_index(ioa_socket_handle s, ur_addr_map *ipmap);
+ioa_socket_ip_bucket *get_ip_index_bucket(ur_addr_map *ipmap, const ioa_addr *remote_addr);
 
 int is_connreset(void);
 int would_block(void);
 int udp_send(ioa_socket_handle s, const ioa_addr *dest_addr, const char *buffer, int len);
 int udp_recvfrom(evutil_socket_t fd, ioa_addr *orig_addr, const ioa_addr *like_addr, char *buffer, int buf_size,
                  int *ttl, int *tos, char *ecmsg, int flags, uint32_t *errcode);
-int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, int verbose);
+/*
+ * Receive a datagram into *nbh, a network buffer of any size class. A small
+ * buffer is replaced by a large one only if the datagram does not fit it.
+ * Return: as udp_recvfrom(); on success the size of *nbh is set.
+ */
+int udp_recvfrom_nbh(ioa_engine_handle e, evutil_socket_t fd, ioa_addr *orig_addr, const ioa_addr *like_addr,
+                     ioa_network_buffer_handle *nbh, int *ttl, int *tos, int flags, uint32_t *errcode);
+/*
+ * Receive up to vlen datagrams with one system call. Every nd[i].nbh must be
+ * an allocated network buffer, of any size class as with udp_recvfrom_nbh();
+ * on return the first N entries have their buffer, size, source address,
+ * TTL and TOS set. If gro is not NULL the socket has
+ * UDP GRO on: the i-th datagram is received into the area gro[i] instead of
+ * nd[i].nbh, which is not used.
+ * Return: N (>0) - number of datagrams, -1 - error (errno is set).
+ */
+int udp_recvmmsg(ioa_engine_handle e, evutil_socket_t fd, const ioa_addr *like_addr, ioa_net_data *nd, int vlen,
+                 udp_gro_area *gro);
+#if UDP_GRO_SUPPORTED
+/*
+ * Receive area of a UDP GRO super-datagram, scattered over network buffers
+ * of the expected segment size and a last large one: while the peer keeps
+ * its packet size, every segment lands at the start of its own buffer and
+ * is handed over as is.
+ */
+struct _udp_gro_area {
+  ioa_network_buffer_handle bufs[UDP_GRO_MAX_SEGMENTS];
+  struct iovec iov[UDP_GRO_MAX_SEGMENTS];
+  size_t nbufs;
+  size_t segsz;  /* size of the buffers but the last one */
+  size_t len;    /* received datagram size */
+  size_t seglen; /* received GRO segment size */
+};
+/* Set the area up for about nsegs segments of segsz bytes, reusing its buffers; return the number of buffers */
+size_t udp_gro_area_fill(ioa_engine_handle e, udp_gro_area *a, size_t segsz, size_t nsegs);
+static inline size_t udp_gro_area_segments(const udp_gro_area *a) {
+  return a->seglen ? ((a->len + a->seglen - 1) / a->seglen) : 1;
+}
+/* Take the k-th segment out of the area: its own buffer, or a copy. NULL - no such segment */
+ioa_network_buffer_handle udp_gro_area_take(ioa_engine_handle e, udp_gro_area *a, size_t k);
+void udp_gro_area_clear(ioa_engine_handle e, udp_gro_area *a);
+#endif
+#if !defined(_MSC_VER) && defined(CMSG_SPACE)
+/* Parse the TTL, TOS, error and GRO segment size control messages of a received datagram */
+void udp_recv_cmsg(struct msghdr *msg, int *ttl, int *tos, uint32_t *errcode, int *segsz);
+#endif
+/*
+ * Read the DTLS record in nbh through the SSL; the decrypted data replaces it.
+ * scratch (UDP_STUN_BUFFER_SIZE bytes) takes the decrypted data when nbh has
+ * no room for it after the record, as a small buffer.
+ */
+int ssl_read(evutil_socket_t fd, SSL *ssl, ioa_network_buffer_handle nbh, char *scratch, int verbose);
+/*
+ * Hand a received datagram of a DTLS socket whose handshake is not over to
+ * the handshake threads; the reply runs it through the read callback.
+ * Return: 1 - handed over (or dropped), nbh is not ours anymore; 0 - read it here.
+ */
+int dtls_handshake_offload(ioa_socket_handle s, ioa_network_buffer_handle nbh);
+/*
+ * Read a DTLS record that came from another address than the remote address
+ * of the socket through its established session, as after a NAT rebinding of
+ * the client. Only a record of this session passes the integrity check.
+ * Return: 1 - it did: the decrypted data is in nbh, and the socket is moved
+ * to the new remote address in its sockets map; 0 - not this session.
+ */
+int dtls_socket_rebind(ioa_socket_handle s, ioa_network_buffer_handle nbh, const ioa_addr *remote_addr);
 
 int set_raw_socket_ttl_options(evutil_socket_t fd, int family);
 int set_raw_socket_tos_options(evutil_socket_t fd, int family);
+int set_raw_socket_gro_options(evutil_socket_t fd, int on);
 
 int set_socket_options_fd(evutil_socket_t fd, SOCKET_TYPE st, int family);
 int set_socket_options(ioa_socket_handle s);
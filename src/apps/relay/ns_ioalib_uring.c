@@ -0,0 +1,677 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ns_ioalib_uring.h"
+
+#include "ns_turn_utils.h"
+
+#if defined(__linux__) && !defined(TURN_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup)
+#define IO_URING_SUPPORTED 1
+#else
+#define IO_URING_SUPPORTED 0
+#endif
+
+#if IO_URING_SUPPORTED
+
+#include <sys/mman.h>
+#include <sys/utsname.h>
+
+#define IO_URING_SQ_ENTRIES (256)
+#define IO_URING_CQ_ENTRIES (1024)
+#define IO_URING_BUFFERS (64)       /* provided small receive buffers per engine, power of 2 */
+#define IO_URING_LARGE_BUFFERS (16) /* provided large receive buffers per engine, power of 2 */
+#define IO_URING_BGID_SMALL (0)
+#define IO_URING_BGID_LARGE (1)
+#define IO_URING_ID_LARGE (((uint64_t)1) << 31) /* user_data flag: the receive takes the large buffers */
+#define IO_URING_CMSG_SZ (64) /* TTL and TOS */
+#define IO_URING_MAX_RECV_ERRORS (16)
+
+typedef struct _ioa_uring_slot {
+  evutil_socket_t fd;
+  ioa_uring_recv_cb cb;
+  void *arg;
+  uint32_t gen;
+  int active;
+  int errors;
+  int large; /* a datagram did not fit a small buffer: receive into the large ones */
+  size_t next_free;
+} ioa_uring_slot;
+
+/* Provided buffer ring of one buffer size class */
+typedef struct _ioa_uring_group {
+  uint16_t nbufs;
+  size_t size; /* receive size of a buffer */
+  struct io_uring_buf_ring *br;
+  uint16_t br_tail;
+  ioa_network_buffer_handle bufs[IO_URING_BUFFERS];
+} ioa_uring_group;
+
+struct _ioa_uring {
+  ioa_engine_handle e;
+  int fd;
+  struct event *ev;
+  /* submission queue */
+  void *sq_ring;
+  size_t sq_ring_sz;
+  struct io_uring_sqe *sqes;
+  size_t sqes_sz;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_flags;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  unsigned sq_local_tail;
+  /* completion queue */
+  void *cq_ring;
+  size_t cq_ring_sz;
+  struct io_uring_cqe *cqes;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  /*
+   * provided buffer rings, shared by all the receives of the engine:
+   * small buffers, and large ones for the sockets with bigger datagrams
+   */
+  ioa_uring_group small;
+  ioa_uring_group large;
+  /* multishot recvmsg layout: name and control sizes */
+  struct msghdr msg;
+  size_t hdr_len;
+  /* receives */
+  ioa_uring_slot *slots;
+  size_t slots_sz;
+  size_t free_slot; /* head of the free slots list, slots_sz - empty */
+};
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static inline uint64_t uring_slot_id(size_t idx, uint32_t gen) { return (((uint64_t)gen) << 32) | (uint64_t)(idx + 1); }
+
+static ioa_uring_slot *uring_get_slot(ioa_uring *r, uint64_t id) {
+  size_t idx = (size_t)(id & 0xFFFFFFFF);
+  if (!idx || (idx > r->slots_sz)) {
+    return NULL;
+  }
+  ioa_uring_slot *slot = &(r->slots[idx - 1]);
+  if (!(slot->active) || (slot->gen != (uint32_t)(id >> 32))) {
+    return NULL;
+  }
+  return slot;
+}
+
+static int uring_submit(ioa_uring *r) {
+  __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+  unsigned to_submit = r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+  if (!to_submit) {
+    return 0;
+  }
+  int ret = 0;
+  do {
+    ret = sys_io_uring_enter(r->fd, to_submit, 0, 0);
+  } while ((ret < 0) && socket_eintr());
+  if (ret < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: io_uring_enter error %d\n", __FUNCTION__, errno);
+  }
+  return ret;
+}
+
+static struct io_uring_sqe *uring_get_sqe(ioa_uring *r) {
+  if (r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+    uring_submit(r);
+    if (r->sq_local_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+      return NULL;
+    }
+  }
+  struct io_uring_sqe *sqe = &(r->sqes[r->sq_local_tail & r->sq_mask]);
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  ++(r->sq_local_tail);
+  return sqe;
+}
+
+static int uring_arm_recv(ioa_uring *r, size_t idx) {
+  struct io_uring_sqe *sqe = uring_get_sqe(r);
+  if (!sqe) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: io_uring submission queue is full\n", __FUNCTION__);
+    return -1;
+  }
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = r->slots[idx].fd;
+  sqe->addr = (uint64_t)(uintptr_t)&(r->msg);
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->user_data = uring_slot_id(idx, r->slots[idx].gen);
+  if (r->slots[idx].large) {
+    sqe->buf_group = IO_URING_BGID_LARGE;
+    sqe->user_data |= IO_URING_ID_LARGE;
+  } else {
+    sqe->buf_group = IO_URING_BGID_SMALL;
+  }
+  return 0;
+}
+
+static void uring_cancel_recv(ioa_uring *r, uint64_t user_data) {
+  struct io_uring_sqe *sqe = uring_get_sqe(r);
+  if (sqe) {
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = 0;
+  }
+}
+
+static void uring_provide_buffer(ioa_uring_group *g, uint16_t bid) {
+  struct io_uring_buf *b = &(g->br->bufs[g->br_tail & (g->nbufs - 1)]);
+  b->addr = (uint64_t)(uintptr_t)ioa_network_buffer_data(g->bufs[bid]);
+  b->len = (uint32_t)(g->size);
+  b->bid = bid;
+  ++(g->br_tail);
+  __atomic_store_n(&(g->br->tail), g->br_tail, __ATOMIC_RELEASE);
+}
+
+/*
+ * A datagram was truncated by a small buffer; it is lost. The receive is
+ * cancelled and re-armed, on its termination, with the large buffers.
+ */
+static void uring_recv_grow(ioa_uring *r, size_t idx, uint64_t id) {
+  ioa_uring_slot *slot = &(r->slots[idx]);
+  if (!(slot->large)) {
+    if (r->e->verbose) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "%s: datagram on fd %d does not fit a small buffer, switching to large ones\n",
+                    __FUNCTION__, (int)slot->fd);
+    }
+    slot->large = 1;
+    uring_cancel_recv(r, id);
+  }
+}
+
+/*
+ * Deliver one multishot recvmsg completion. The buffer is handed over to
+ * the callback as is: the payload follows the recvmsg header, name and
+ * control data, so the network buffer offset is moved past them. The
+ * buffer ring slot gets a fresh buffer of the same size class.
+ */
+static void uring_deliver(ioa_uring *r, size_t idx, uint64_t user_data, uint16_t bid, int res) {
+
+  ioa_uring_group *g = (user_data & IO_URING_ID_LARGE) ? &(r->large) : &(r->small);
+  ioa_network_buffer_handle nbh = g->bufs[bid];
+  uint8_t *buf = ioa_network_buffer_data(nbh);
+  struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *)buf;
+
+  if (((size_t)res < r->hdr_len) || (out->flags & MSG_TRUNC)) {
+    if ((out->flags & MSG_TRUNC) && (g == &(r->small))) {
+      uring_recv_grow(r, idx, user_data);
+    }
+    uring_provide_buffer(g, bid);
+    return;
+  }
+
+  ioa_network_buffer_handle fresh = ioa_network_buffer_allocate_size(r->e, g->size);
+  if (!fresh) {
+    uring_provide_buffer(g, bid);
+    return;
+  }
+  g->bufs[bid] = fresh;
+  uring_provide_buffer(g, bid);
+
+  ioa_net_data nd;
+  memset(&nd, 0, sizeof(ioa_net_data));
+  memcpy(&(nd.src_addr), buf + sizeof(struct io_uring_recvmsg_out),
+         (out->namelen < sizeof(ioa_addr)) ? out->namelen : sizeof(ioa_addr));
+  nd.recv_ttl = TTL_IGNORE;
+  nd.recv_tos = TOS_IGNORE;
+
+  struct msghdr cmsg;
+  memset(&cmsg, 0, sizeof(cmsg));
+  cmsg.msg_control = buf + sizeof(struct io_uring_recvmsg_out) + r->msg.msg_namelen;
+  cmsg.msg_controllen = out->controllen;
+  udp_recv_cmsg(&cmsg, &(nd.recv_ttl), &(nd.recv_tos), NULL, NULL);
+
+  ioa_network_buffer_add_offset_size(nbh, (uint16_t)(r->hdr_len), 0, (size_t)res - r->hdr_len);
+  nd.nbh = nbh;
+
+  /* the callback may start new receives and move the slots array */
+  ioa_uring_recv_cb cb = r->slots[idx].cb;
+  void *arg = r->slots[idx].arg;
+  r->slots[idx].errors = 0;
+
+  cb(arg, &nd);
+
+  if (nd.nbh) {
+    ioa_network_buffer_delete(r->e, nd.nbh);
+  }
+}
+
+static void uring_release_slot(ioa_uring *r, uint64_t id) {
+  ioa_uring_slot *slot = &(r->slots[(size_t)(id & 0xFFFFFFFF) - 1]);
+  /* late completions of this receive do not match the slot any more */
+  slot->active = 0;
+  slot->cb = NULL;
+  slot->arg = NULL;
+  ++(slot->gen);
+  slot->next_free = r->free_slot;
+  r->free_slot = (size_t)(id & 0xFFFFFFFF) - 1;
+}
+
+static void uring_handle_cqe(ioa_uring *r, const struct io_uring_cqe *cqe) {
+
+  if (!(cqe->user_data)) {
+    return; /* cancel */
+  }
+
+  uint64_t id = cqe->user_data & ~IO_URING_ID_LARGE;
+  size_t idx = (size_t)(id & 0xFFFFFFFF) - 1;
+  int more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+  if (cqe->flags & IORING_CQE_F_BUFFER) {
+    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    if (uring_get_slot(r, id) && (cqe->res > 0)) {
+      uring_deliver(r, idx, cqe->user_data, bid, cqe->res);
+    } else {
+      uring_provide_buffer((cqe->user_data & IO_URING_ID_LARGE) ? &(r->large) : &(r->small), bid);
+    }
+  }
+
+  if (more) {
+    return;
+  }
+
+  /* The multishot receive has terminated; re-arm it if it is still wanted */
+  ioa_uring_slot *slot = uring_get_slot(r, id);
+  if (!slot) {
+    return;
+  }
+
+  if (cqe->res < 0) {
+    int err = -(cqe->res);
+    if ((err != ENOBUFS) && (err != ECANCELED) && (++(slot->errors) > IO_URING_MAX_RECV_ERRORS)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: receive on fd %d failed, error %d, giving it back to the owner\n",
+                    __FUNCTION__, (int)slot->fd, err);
+      /* the receive is not armed any more: nothing to cancel */
+      ioa_uring_recv_cb cb = slot->cb;
+      void *arg = slot->arg;
+      uring_release_slot(r, id);
+      cb(arg, NULL);
+      return;
+    }
+  }
+
+  uring_arm_recv(r, idx);
+}
+
+static void uring_input_handler(evutil_socket_t fd, short what, void *arg) {
+
+  UNUSED_ARG(fd);
+
+  if (!(what & EV_READ) || !arg) {
+    return;
+  }
+
+  ioa_uring *r = (ioa_uring *)arg;
+  unsigned cycle = 0;
+
+  for (;;) {
+    unsigned head = *(r->cq_head);
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+    while ((head != tail) && (cycle++ < IO_URING_CQ_ENTRIES)) {
+      struct io_uring_cqe cqe;
+      memcpy(&cqe, &(r->cqes[head & r->cq_mask]), sizeof(struct io_uring_cqe));
+      __atomic_store_n(r->cq_head, ++head, __ATOMIC_RELEASE);
+      uring_handle_cqe(r, &cqe);
+    }
+
+    if ((head != tail) || !(__atomic_load_n(r->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW)) {
+      break;
+    }
+
+    /* flush the overflown completions to the ring */
+    sys_io_uring_enter(r->fd, 0, 0, IORING_ENTER_GETEVENTS);
+  }
+
+  /* re-armed receives go out with one system call */
+  uring_submit(r);
+}
+
+static void uring_free_group(ioa_uring *r, ioa_uring_group *g) {
+  for (size_t i = 0; i < IO_URING_BUFFERS; ++i) {
+    if (g->bufs[i]) {
+      ioa_network_buffer_delete(r->e, g->bufs[i]);
+    }
+  }
+  if (g->br) {
+    free(g->br);
+  }
+}
+
+static void uring_free(ioa_uring *r) {
+  if (r) {
+    EVENT_DEL(r->ev);
+    if (r->fd >= 0) {
+      close(r->fd);
+    }
+    uring_free_group(r, &(r->small));
+    uring_free_group(r, &(r->large));
+    if (r->sqes && (r->sqes != MAP_FAILED)) {
+      munmap(r->sqes, r->sqes_sz);
+    }
+    if (r->cq_ring && (r->cq_ring != MAP_FAILED) && (r->cq_ring != r->sq_ring)) {
+      munmap(r->cq_ring, r->cq_ring_sz);
+    }
+    if (r->sq_ring && (r->sq_ring != MAP_FAILED)) {
+      munmap(r->sq_ring, r->sq_ring_sz);
+    }
+    free(r->slots);
+    free(r);
+  }
+}
+
+static int uring_map_rings(ioa_uring *r, struct io_uring_params *p) {
+
+  r->sq_ring_sz = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+  r->cq_ring_sz = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+  if (p->features & IORING_FEAT_SINGLE_MMAP) {
+    if (r->cq_ring_sz > r->sq_ring_sz) {
+      r->sq_ring_sz = r->cq_ring_sz;
+    }
+    r->cq_ring_sz = r->sq_ring_sz;
+  }
+
+  r->sq_ring = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  if (r->sq_ring == MAP_FAILED) {
+    return -1;
+  }
+
+  if (p->features & IORING_FEAT_SINGLE_MMAP) {
+    r->cq_ring = r->sq_ring;
+  } else {
+    r->cq_ring =
+        mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    if (r->cq_ring == MAP_FAILED) {
+      return -1;
+    }
+  }
+
+  r->sqes_sz = p->sq_entries * sizeof(struct io_uring_sqe);
+  r->sqes = (struct io_uring_sqe *)mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+                                        IORING_OFF_SQES);
+  if (r->sqes == MAP_FAILED) {
+    return -1;
+  }
+
+  uint8_t *sq = (uint8_t *)r->sq_ring;
+  r->sq_head = (unsigned *)(sq + p->sq_off.head);
+  r->sq_tail = (unsigned *)(sq + p->sq_off.tail);
+  r->sq_flags = (unsigned *)(sq + p->sq_off.flags);
+  r->sq_mask = *(unsigned *)(sq + p->sq_off.ring_mask);
+  r->sq_entries = *(unsigned *)(sq + p->sq_off.ring_entries);
+  r->sq_local_tail = *(r->sq_tail);
+
+  /* SQ slots map one to one to the SQ array */
+  unsigned *sq_array = (unsigned *)(sq + p->sq_off.array);
+  for (unsigned i = 0; i < r->sq_entries; ++i) {
+    sq_array[i] = i;
+  }
+
+  uint8_t *cq = (uint8_t *)r->cq_ring;
+  r->cq_head = (unsigned *)(cq + p->cq_off.head);
+  r->cq_tail = (unsigned *)(cq + p->cq_off.tail);
+  r->cq_mask = *(unsigned *)(cq + p->cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+
+  return 0;
+}
+
+static int uring_setup_group(ioa_uring *r, ioa_uring_group *g, uint16_t bgid, uint16_t nbufs, size_t size) {
+
+  g->nbufs = nbufs;
+  g->size = size;
+
+  void *br = NULL;
+  if (posix_memalign(&br, (size_t)sysconf(_SC_PAGESIZE), nbufs * sizeof(struct io_uring_buf))) {
+    return -1;
+  }
+  memset(br, 0, nbufs * sizeof(struct io_uring_buf));
+  g->br = (struct io_uring_buf_ring *)br;
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)(uintptr_t)br;
+  reg.ring_entries = nbufs;
+  reg.bgid = bgid;
+  if (sys_io_uring_register(r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    return -1;
+  }
+
+  for (uint16_t i = 0; i < nbufs; ++i) {
+    g->bufs[i] = ioa_network_buffer_allocate_size(r->e, size);
+    if (!(g->bufs[i])) {
+      return -1;
+    }
+    uring_provide_buffer(g, i);
+  }
+
+  return 0;
+}
+
+static int uring_setup_buffers(ioa_uring *r) {
+  if (uring_setup_group(r, &(r->small), IO_URING_BGID_SMALL, IO_URING_BUFFERS, NBUF_SMALL_DATAGRAM_SIZE) < 0) {
+    return -1;
+  }
+  return uring_setup_group(r, &(r->large), IO_URING_BGID_LARGE, IO_URING_LARGE_BUFFERS, STUN_BUFFER_SIZE);
+}
+
+int ioa_uring_supported(void) {
+
+  static int supported = -1;
+
+  if (supported < 0) {
+    supported = 0;
+
+    /* multishot recvmsg is in the kernels 6.0+ */
+    struct utsname un;
+    int major = 0;
+    if (!uname(&un) && (sscanf(un.release, "%d.", &major) == 1) && (major >= 6)) {
+      struct io_uring_params p;
+      memset(&p, 0, sizeof(p));
+      int fd = sys_io_uring_setup(4, &p);
+      if (fd >= 0) {
+        supported = 1;
+        close(fd);
+      }
+    }
+  }
+
+  return supported;
+}
+
+int ioa_engine_set_io_uring(ioa_engine_handle e) {
+
+  if (!e) {
+    return -1;
+  }
+
+  if (e->uring) {
+    return 0;
+  }
+
+  ioa_uring *r = (ioa_uring *)calloc(1, sizeof(ioa_uring));
+  if (!r) {
+    return -1;
+  }
+  r->e = e;
+
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_CQSIZE;
+  p.cq_entries = IO_URING_CQ_ENTRIES;
+  r->fd = sys_io_uring_setup(IO_URING_SQ_ENTRIES, &p);
+  if (r->fd < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: cannot create io_uring instance, error %d\n", __FUNCTION__, errno);
+    uring_free(r);
+    return -1;
+  }
+
+  if (uring_map_rings(r, &p) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: cannot map io_uring rings, error %d\n", __FUNCTION__, errno);
+    uring_free(r);
+    return -1;
+  }
+
+  if (uring_setup_buffers(r) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: cannot register io_uring buffer ring, error %d\n", __FUNCTION__,
+                  errno);
+    uring_free(r);
+    return -1;
+  }
+
+  r->msg.msg_namelen = sizeof(ioa_addr);
+  r->msg.msg_controllen = IO_URING_CMSG_SZ;
+  r->hdr_len = sizeof(struct io_uring_recvmsg_out) + r->msg.msg_namelen + r->msg.msg_controllen;
+
+  r->free_slot = 0;
+
+  r->ev = event_new(e->event_base, r->fd, EV_READ | EV_PERSIST, uring_input_handler, r);
+  event_add(r->ev, NULL);
+
+  e->uring = r;
+
+  return 0;
+}
+
+uint64_t ioa_uring_recv_start(ioa_engine_handle e, evutil_socket_t fd, ioa_uring_recv_cb cb, void *arg) {
+
+  if (!e || !(e->uring) || (fd < 0) || !cb) {
+    return 0;
+  }
+
+  ioa_uring *r = e->uring;
+
+  if (r->free_slot >= r->slots_sz) {
+    size_t sz = r->slots_sz ? (r->slots_sz << 1) : 64;
+    ioa_uring_slot *slots = (ioa_uring_slot *)realloc(r->slots, sz * sizeof(ioa_uring_slot));
+    if (!slots) {
+      return 0;
+    }
+    for (size_t i = r->slots_sz; i < sz; ++i) {
+      memset(&(slots[i]), 0, sizeof(ioa_uring_slot));
+      slots[i].gen = 1;
+      slots[i].next_free = i + 1;
+    }
+    r->free_slot = r->slots_sz;
+    r->slots = slots;
+    r->slots_sz = sz;
+  }
+
+  size_t idx = r->free_slot;
+  ioa_uring_slot *slot = &(r->slots[idx]);
+  r->free_slot = slot->next_free;
+
+  slot->fd = fd;
+  slot->cb = cb;
+  slot->arg = arg;
+  slot->active = 1;
+  slot->errors = 0;
+  slot->large = 0;
+
+  uint64_t id = uring_slot_id(idx, slot->gen);
+
+  if ((uring_arm_recv(r, idx) < 0) || (uring_submit(r) < 0)) {
+    ioa_uring_recv_stop(e, id);
+    return 0;
+  }
+
+  return id;
+}
+
+void ioa_uring_recv_stop(ioa_engine_handle e, uint64_t id) {
+
+  if (!e || !(e->uring) || !id) {
+    return;
+  }
+
+  ioa_uring *r = e->uring;
+  ioa_uring_slot *slot = uring_get_slot(r, id);
+  if (!slot) {
+    return;
+  }
+
+  int large = slot->large;
+  uring_release_slot(r, id);
+
+  /* the kernel holds a file reference until the receive is cancelled */
+  uring_cancel_recv(r, id);
+  if (large) {
+    /* the small buffers receive may not have terminated yet */
+    uring_cancel_recv(r, id | IO_URING_ID_LARGE);
+  }
+  uring_submit(r);
+}
+
+#else /* IO_URING_SUPPORTED */
+
+int ioa_uring_supported(void) { return 0; }
+
+int ioa_engine_set_io_uring(ioa_engine_handle e) {
+  UNUSED_ARG(e);
+  return -1;
+}
+
+uint64_t ioa_uring_recv_start(ioa_engine_handle e, evutil_socket_t fd, ioa_uring_recv_cb cb, void *arg) {
+  UNUSED_ARG(e);
+  UNUSED_ARG(fd);
+  UNUSED_ARG(cb);
+  UNUSED_ARG(arg);
+  return 0;
+}
+
+void ioa_uring_recv_stop(ioa_engine_handle e, uint64_t id) {
+  UNUSED_ARG(e);
+  UNUSED_ARG(id);
+}
+
+#endif /* IO_URING_SUPPORTED */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * io_uring UDP receive for the IO Abstraction library
+ */
+
+#ifndef __IOA_URING__
+#define __IOA_URING__
+
+#include "ns_ioalib_impl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////
+
+/*
+ * Receive callback. nd->nbh is the received datagram; the callback may
+ * take the buffer ownership by setting nd->nbh to NULL. nd is NULL when
+ * the receive keeps failing: it is then stopped, and the socket has to be
+ * read another way.
+ */
+typedef void (*ioa_uring_recv_cb)(void *arg, ioa_net_data *nd);
+
+/* Return 1 if the kernel supports multishot receive with provided buffer rings */
+int ioa_uring_supported(void);
+
+/*
+ * Attach an io_uring instance to the engine. The ring is polled from the
+ * engine event base, so all the io_uring completions of the engine are
+ * processed by the engine thread.
+ * Return: 0 - success, -1 - io_uring is not available.
+ */
+int ioa_engine_set_io_uring(ioa_engine_handle e);
+
+/*
+ * Start the multishot receive on a datagram socket.
+ * Return: receive id (not 0), or 0 on failure.
+ */
+uint64_t ioa_uring_recv_start(ioa_engine_handle e, evutil_socket_t fd, ioa_uring_recv_cb cb, void *arg);
+
+/* Cancel the receive; must be called before the socket is closed */
+void ioa_uring_recv_stop(ioa_engine_handle e, uint64_t id);
+
+///////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__IOA_URING__
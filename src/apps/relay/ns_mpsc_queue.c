@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ns_mpsc_queue.h"
+
+#include "ns_turn_utils.h"
+
+#include <event2/util.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <sys/socket.h>
+#endif
+
+/*
+ * Slots are claimed by producers with a CAS on the tail, as in the bounded
+ * queue of D. Vyukov: a slot sequence number equal to the claimed position
+ * means the slot is free, position + 1 means the message is published, and
+ * the consumer frees it for the next lap with position + capacity.
+ */
+
+#define MPSC_QUEUE_CACHE_LINE (64)
+
+/* Messages handled per wakeup before other events get a chance */
+#define MPSC_QUEUE_BATCH (256)
+
+#if defined(WINDOWS)
+#define MPSC_QUEUE_SOCKETPAIR_AF AF_INET
+#else
+#define MPSC_QUEUE_SOCKETPAIR_AF AF_UNIX
+#endif
+
+struct _mpsc_queue {
+  /* producers */
+  size_t tail;
+  int wakeup_pending;
+  uint64_t wakeups;
+  uint64_t drops;
+  char pad0[MPSC_QUEUE_CACHE_LINE];
+  /* consumer */
+  size_t head;
+  char pad1[MPSC_QUEUE_CACHE_LINE];
+  uint8_t *slots;
+  size_t mask;
+  size_t msg_size;
+  size_t slot_size;
+  evutil_socket_t rfd;
+  evutil_socket_t wfd;
+  struct event *ev;
+  mpsc_queue_handler handler;
+  void *arg;
+  char name[32];
+};
+
+static inline size_t *mpsc_queue_slot_seq(const mpsc_queue *q, size_t pos) {
+  return (size_t *)(q->slots + (pos & q->mask) * q->slot_size);
+}
+
+static inline void *mpsc_queue_slot_msg(const mpsc_queue *q, size_t pos) {
+  return q->slots + (pos & q->mask) * q->slot_size + MPSC_QUEUE_CACHE_LINE;
+}
+
+static void mpsc_queue_signal(mpsc_queue *q) {
+  if (__atomic_exchange_n(&(q->wakeup_pending), 1, __ATOMIC_SEQ_CST)) {
+    return;
+  }
+
+  __atomic_add_fetch(&(q->wakeups), 1, __ATOMIC_RELAXED);
+
+#if defined(__linux__)
+  uint64_t one = 1;
+  if (write(q->wfd, &one, sizeof(one)) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: cannot wake up queue %s\n", __FUNCTION__, q->name);
+  }
+#else
+  char c = 0;
+  if (send(q->wfd, &c, 1, 0) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: cannot wake up queue %s\n", __FUNCTION__, q->name);
+  }
+#endif
+}
+
+static void mpsc_queue_consume(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(what);
+
+  mpsc_queue *q = (mpsc_queue *)arg;
+
+#if defined(__linux__)
+  uint64_t cnt = 0;
+  if (read(fd, &cnt, sizeof(cnt)) < 0) {
+    cnt = 0;
+  }
+#else
+  char buf[64];
+  while (recv(fd, buf, sizeof(buf), 0) > 0) {
+  }
+#endif
+
+  /* Clear the flag before looking at the slots, so that a message pushed
+   * after the last check below signals again */
+  __atomic_store_n(&(q->wakeup_pending), 0, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  for (size_t n = 0; n < MPSC_QUEUE_BATCH; ++n) {
+    const size_t pos = q->head;
+    size_t *seq = mpsc_queue_slot_seq(q, pos);
+    if (__atomic_load_n(seq, __ATOMIC_ACQUIRE) != pos + 1) {
+      return;
+    }
+
+    q->handler(mpsc_queue_slot_msg(q, pos), q->arg);
+
+    __atomic_store_n(seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&(q->head), pos + 1, __ATOMIC_RELAXED);
+  }
+
+  /* Batch limit reached: come back after the other pending events */
+  mpsc_queue_signal(q);
+}
+
+mpsc_queue *mpsc_queue_new(struct event_base *base, const char *name, size_t capacity, size_t msg_size,
+                           mpsc_queue_handler handler, void *arg) {
+  if (!base || !handler || !capacity || !msg_size) {
+    return NULL;
+  }
+
+  size_t sz = 1;
+  while (sz < capacity) {
+    sz <<= 1;
+  }
+
+  mpsc_queue *q = (mpsc_queue *)calloc(1, sizeof(mpsc_queue));
+  if (!q) {
+    return NULL;
+  }
+
+  q->mask = sz - 1;
+  q->msg_size = msg_size;
+  /* The sequence number has the first cache line of the slot to itself */
+  q->slot_size =
+      MPSC_QUEUE_CACHE_LINE + ((msg_size + MPSC_QUEUE_CACHE_LINE - 1) & ~((size_t)MPSC_QUEUE_CACHE_LINE - 1));
+  q->handler = handler;
+  q->arg = arg;
+  STRCPY(q->name, name ? name : "");
+  q->rfd = -1;
+  q->wfd = -1;
+
+  q->slots = (uint8_t *)calloc(sz, q->slot_size);
+  if (!q->slots) {
+    goto err;
+  }
+  for (size_t i = 0; i < sz; ++i) {
+    *mpsc_queue_slot_seq(q, i) = i;
+  }
+
+#if defined(__linux__)
+  q->rfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (q->rfd < 0) {
+    goto err;
+  }
+  q->wfd = q->rfd;
+#else
+  {
+    evutil_socket_t fds[2];
+    if (evutil_socketpair(MPSC_QUEUE_SOCKETPAIR_AF, SOCK_STREAM, 0, fds) < 0) {
+      goto err;
+    }
+    q->rfd = fds[0];
+    q->wfd = fds[1];
+    evutil_make_socket_nonblocking(q->rfd);
+    evutil_make_socket_nonblocking(q->wfd);
+  }
+#endif
+
+  q->ev = event_new(base, q->rfd, EV_READ | EV_PERSIST, mpsc_queue_consume, q);
+  if (!(q->ev) || (event_add(q->ev, NULL) < 0)) {
+    goto err;
+  }
+
+  return q;
+
+err:
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: cannot create queue %s\n", __FUNCTION__, q->name);
+  if (q->ev) {
+    event_free(q->ev);
+  }
+  if (q->wfd >= 0 && q->wfd != q->rfd) {
+    evutil_closesocket(q->wfd);
+  }
+  if (q->rfd >= 0) {
+#if defined(__linux__)
+    close(q->rfd);
+#else
+    evutil_closesocket(q->rfd);
+#endif
+  }
+  free(q->slots);
+  free(q);
+  return NULL;
+}
+
+bool mpsc_queue_push(mpsc_queue *q, const void *msg) {
+  if (!q || !msg) {
+    return false;
+  }
+
+  size_t pos = __atomic_load_n(&(q->tail), __ATOMIC_RELAXED);
+  for (;;) {
+    const size_t seq = __atomic_load_n(mpsc_queue_slot_seq(q, pos), __ATOMIC_ACQUIRE);
+    const intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+    if (dif == 0) {
+      if (__atomic_compare_exchange_n(&(q->tail), &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (dif < 0) {
+      __atomic_add_fetch(&(q->drops), 1, __ATOMIC_RELAXED);
+      return false;
+    } else {
+      pos = __atomic_load_n(&(q->tail), __ATOMIC_RELAXED);
+    }
+  }
+
+  memcpy(mpsc_queue_slot_msg(q, pos), msg, q->msg_size);
+  __atomic_store_n(mpsc_queue_slot_seq(q, pos), pos + 1, __ATOMIC_RELEASE);
+
+  mpsc_queue_signal(q);
+
+  return true;
+}
+
+const char *mpsc_queue_name(const mpsc_queue *q) { return q ? q->name : ""; }
+
+void mpsc_queue_get_stats(const mpsc_queue *q, mpsc_queue_stats *stats) {
+  if (!q || !stats) {
+    return;
+  }
+
+  const size_t head = __atomic_load_n(&(q->head), __ATOMIC_RELAXED);
+  const size_t tail = __atomic_load_n(&(q->tail), __ATOMIC_RELAXED);
+  stats->depth = (tail > head) ? (tail - head) : 0;
+  stats->wakeups = __atomic_load_n(&(q->wakeups), __ATOMIC_RELAXED);
+  stats->drops = __atomic_load_n(&(q->drops), __ATOMIC_RELAXED);
+}
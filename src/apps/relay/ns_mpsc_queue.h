@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Bounded lock-free multi-producer single-consumer message queue
+ */
+
+#ifndef __IOA_MPSC_QUEUE__
+#define __IOA_MPSC_QUEUE__
+
+#include <event2/event.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////
+
+/*
+ * Messages are fixed-size records copied into the queue slots by any
+ * thread, and handled in place by the thread that runs the consumer event
+ * base. The consumer is woken up through an eventfd (a pipe where eventfd
+ * is not available); producers only signal it when it is not signalled
+ * already, so a burst of messages costs one wakeup.
+ */
+
+typedef struct _mpsc_queue mpsc_queue;
+
+/* Called in the consumer thread; msg is valid until the handler returns */
+typedef void (*mpsc_queue_handler)(void *msg, void *arg);
+
+typedef struct _mpsc_queue_stats {
+  size_t depth;
+  uint64_t wakeups;
+  uint64_t drops;
+} mpsc_queue_stats;
+
+/*
+ * Create a queue of capacity (rounded up to a power of 2) messages of
+ * msg_size bytes, consumed from the event base.
+ * Return: the queue, or NULL on failure.
+ */
+mpsc_queue *mpsc_queue_new(struct event_base *base, const char *name, size_t capacity, size_t msg_size,
+                           mpsc_queue_handler handler, void *arg);
+
+/*
+ * Copy the message into the queue; may be called from any thread.
+ * Return: false if the queue is full (the message is not queued).
+ */
+bool mpsc_queue_push(mpsc_queue *q, const void *msg);
+
+const char *mpsc_queue_name(const mpsc_queue *q);
+void mpsc_queue_get_stats(const mpsc_queue *q, mpsc_queue_stats *stats);
+
+///////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__IOA_MPSC_QUEUE__
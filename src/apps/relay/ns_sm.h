@@ -52,13 +52,23 @@ typedef struct _super_memory super_memory_t;
 
 void init_super_memory(void);
 
-super_memory_t *new_super_memory_region(void);
+/*
+ * A region is an arena: memory is allocated from it without locking and
+ * is never released. It holds the structures that live as long as the
+ * process (engines, listeners, relay servers). The name labels the region
+ * usage report.
+ */
+super_memory_t *new_super_memory_region(const char *name);
+const char *get_super_memory_region_name(super_memory_t *region);
 
 #define allocate_super_memory_region(region, size)                                                                     \
   allocate_super_memory_region_func(region, size, __FILE__, __FUNCTION__, __LINE__)
 void *allocate_super_memory_region_func(super_memory_t *region, size_t size, const char *file, const char *func,
                                         int line);
 
+/* Report the reserved and allocated size of every region to Prometheus */
+void report_super_memory(void);
+
 /////////////////////////////////////////////////
 
 #ifdef __cplusplus
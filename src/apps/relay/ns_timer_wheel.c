@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ns_timer_wheel.h"
+
+#include <string.h>
+
+static inline void list_add(timer_wheel_entry **head, timer_wheel_entry *te) {
+  te->next = *head;
+  if (te->next) {
+    te->next->pprev = &(te->next);
+  }
+  *head = te;
+  te->pprev = head;
+}
+
+static inline void list_del(timer_wheel_entry *te) {
+  *(te->pprev) = te->next;
+  if (te->next) {
+    te->next->pprev = te->pprev;
+  }
+  te->next = NULL;
+  te->pprev = NULL;
+}
+
+static inline size_t level_index(uint64_t tick, int level) {
+  return (size_t)((tick >> (TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS)) & (TIMER_WHEEL_LEVEL_SIZE - 1));
+}
+
+static void wheel_insert(timer_wheel *tw, timer_wheel_entry *te) {
+  uint64_t expires = te->expires;
+  timer_wheel_entry **head = NULL;
+
+  if ((int64_t)(expires - tw->now) < 0) {
+    head = &(tw->root[tw->now & (TIMER_WHEEL_ROOT_SIZE - 1)]);
+  } else {
+    uint64_t delta = expires - tw->now;
+    if (delta > TIMER_WHEEL_MAX_TICKS) {
+      expires = tw->now + TIMER_WHEEL_MAX_TICKS;
+      te->expires = expires;
+      delta = TIMER_WHEEL_MAX_TICKS;
+    }
+    if (delta < TIMER_WHEEL_ROOT_SIZE) {
+      head = &(tw->root[expires & (TIMER_WHEEL_ROOT_SIZE - 1)]);
+    } else {
+      int level = 0;
+      while ((level + 1 < TIMER_WHEEL_LEVELS) &&
+             (delta >= (1ULL << (TIMER_WHEEL_ROOT_BITS + (level + 1) * TIMER_WHEEL_LEVEL_BITS)))) {
+        ++level;
+      }
+      head = &(tw->levels[level][level_index(expires, level)]);
+    }
+  }
+
+  list_add(head, te);
+}
+
+/* Move the entries of a higher level slot down; return the slot index */
+static size_t cascade(timer_wheel *tw, int level) {
+  size_t index = level_index(tw->now, level);
+  timer_wheel_entry *te = tw->levels[level][index];
+  tw->levels[level][index] = NULL;
+
+  while (te) {
+    timer_wheel_entry *next = te->next;
+    te->next = NULL;
+    te->pprev = NULL;
+    wheel_insert(tw, te);
+    te = next;
+  }
+
+  return index;
+}
+
+void timer_wheel_init(timer_wheel *tw, uint64_t now) {
+  if (tw) {
+    memset(tw, 0, sizeof(timer_wheel));
+    tw->now = now;
+  }
+}
+
+void timer_wheel_add(timer_wheel *tw, timer_wheel_entry *te, uint64_t expires) {
+  if (tw && te) {
+    if (te->pprev) {
+      list_del(te);
+    } else {
+      ++(tw->count);
+    }
+    te->expires = expires;
+    wheel_insert(tw, te);
+  }
+}
+
+void timer_wheel_del(timer_wheel *tw, timer_wheel_entry *te) {
+  if (tw && te && te->pprev) {
+    list_del(te);
+    --(tw->count);
+  }
+}
+
+size_t timer_wheel_advance(timer_wheel *tw, uint64_t now, timer_wheel_expire_cb cb, void *arg) {
+  size_t expired = 0;
+
+  while (tw->count && ((int64_t)(now - tw->now) >= 0)) {
+    size_t index = (size_t)(tw->now & (TIMER_WHEEL_ROOT_SIZE - 1));
+
+    if (!index) {
+      int level = 0;
+      while ((level < TIMER_WHEEL_LEVELS) && !cascade(tw, level)) {
+        ++level;
+      }
+    }
+    ++(tw->now);
+
+    /* the slot list is taken as a whole, so that the callbacks can add timers to the slot */
+    timer_wheel_entry *work = tw->root[index];
+    tw->root[index] = NULL;
+    if (work) {
+      work->pprev = &work;
+    }
+
+    while (work) {
+      timer_wheel_entry *te = work;
+      list_del(te);
+      --(tw->count);
+      ++expired;
+      cb(te, arg);
+    }
+  }
+
+  if (!(tw->count) && ((int64_t)(now - tw->now) >= 0)) {
+    tw->now = now + 1;
+  }
+
+  return expired;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Hierarchical timing wheel
+ */
+
+#ifndef __IOA_TIMER_WHEEL__
+#define __IOA_TIMER_WHEEL__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////
+
+/*
+ * The first level has one slot per tick, each next level has slots of the
+ * whole span of the previous level: 2^8 ticks, 2^14, 2^20 and 2^26 ticks
+ * in total. A timer is stored in the level that its distance falls into
+ * and moves down a level when the lower level wraps around, so adding,
+ * deleting and expiring a timer are O(1).
+ */
+#define TIMER_WHEEL_ROOT_BITS (8)
+#define TIMER_WHEEL_LEVEL_BITS (6)
+#define TIMER_WHEEL_LEVELS (3) /* above the root level */
+#define TIMER_WHEEL_ROOT_SIZE (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_MAX_TICKS ((1ULL << (TIMER_WHEEL_ROOT_BITS + TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_BITS)) - 1)
+
+typedef struct _timer_wheel_entry {
+  struct _timer_wheel_entry *next;
+  struct _timer_wheel_entry **pprev; /* NULL - not in the wheel */
+  uint64_t expires;                  /* tick */
+} timer_wheel_entry;
+
+typedef struct _timer_wheel {
+  uint64_t now; /* the next tick to process */
+  size_t count;
+  timer_wheel_entry *root[TIMER_WHEEL_ROOT_SIZE];
+  timer_wheel_entry *levels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+} timer_wheel;
+
+typedef void (*timer_wheel_expire_cb)(timer_wheel_entry *te, void *arg);
+
+void timer_wheel_init(timer_wheel *tw, uint64_t now);
+
+/* (Re)schedule the entry; a tick in the past expires on the next advance */
+void timer_wheel_add(timer_wheel *tw, timer_wheel_entry *te, uint64_t expires);
+
+void timer_wheel_del(timer_wheel *tw, timer_wheel_entry *te);
+
+static inline int timer_wheel_pending(const timer_wheel_entry *te) { return te->pprev != NULL; }
+
+/*
+ * Expire all the entries up to the tick now (inclusive). The entry is
+ * removed from the wheel before the callback, which may add or delete
+ * any entry, this one included.
+ * Return: the number of expired entries.
+ */
+size_t timer_wheel_advance(timer_wheel *tw, uint64_t now, timer_wheel_expire_cb cb, void *arg);
+
+///////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__IOA_TIMER_WHEEL__
@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ns_tls_handshake.h"
+
+#include "mainrelay.h"
+#include "ns_ioalib_impl.h"
+#include "prom_server.h"
+
+#include <openssl/err.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Each handshake thread runs its own event base, where the jobs arrive
+ * through an MPSC queue. A DTLS job is one datagram; a TLS job waits on the
+ * socket for the client until its handshake is over. The reply hands the SSL
+ * back, so it is never dropped: while the reply queue is full, the replies
+ * are parked in the order they are done, and pushed again from a timer, so
+ * that the other handshakes of the thread go on.
+ */
+
+/* Interval of the retries of the parked replies, in microseconds */
+#define TLS_HANDSHAKE_REPLY_RETRY_USEC (1000)
+
+/* A reply that waits for room in its reply queue */
+typedef struct _tls_parked_reply {
+  struct _tls_parked_reply *next;
+  tls_handshake_job job;
+} tls_parked_reply;
+
+typedef struct _tls_handshake_thread {
+  int id;
+  pthread_t thr;
+  struct event_base *event_base;
+  mpsc_queue *queue; // tls_handshake_job
+  mpsc_queue_stats queue_reported;
+  tls_parked_reply *parked_head; /* in the order of the replies */
+  tls_parked_reply *parked_tail;
+  size_t parked;
+  struct event *retry_ev;
+  char ssl_scratch[UDP_STUN_BUFFER_SIZE]; /* see ssl_read() */
+} tls_handshake_thread;
+
+/* TLS handshake in progress */
+typedef struct _tls_accept {
+  tls_handshake_job job;
+  tls_handshake_thread *thread;
+  struct event *io_ev;
+  struct event *timeout_ev;
+} tls_accept;
+
+static tls_handshake_thread *handshake_threads = NULL;
+static int handshake_threads_number = 0;
+
+static void tls_handshake_retry(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  tls_handshake_thread *t = (tls_handshake_thread *)arg;
+
+  /* the first one that does not fit keeps the later ones back, so that the replies of an SSL stay in order */
+  tls_parked_reply *pr = NULL;
+  while ((pr = t->parked_head) && mpsc_queue_push(pr->job.reply, &(pr->job))) {
+    t->parked_head = pr->next;
+    if (!(t->parked_head)) {
+      t->parked_tail = NULL;
+    }
+    --(t->parked);
+    free(pr);
+  }
+
+  if (t->parked_head) {
+    struct timeval tv = {0, TLS_HANDSHAKE_REPLY_RETRY_USEC};
+    evtimer_add(t->retry_ev, &tv);
+  }
+}
+
+static void tls_handshake_reply(tls_handshake_thread *t, tls_handshake_job *job) {
+  if (!(t->parked_head) && mpsc_queue_push(job->reply, job)) {
+    return;
+  }
+
+  tls_parked_reply *pr = (tls_parked_reply *)malloc(sizeof(tls_parked_reply));
+  if (!pr) {
+    /* the SSL cannot be dropped: wait for the queue, as a last resort */
+    while (!mpsc_queue_push(job->reply, job)) {
+      usleep(TLS_HANDSHAKE_REPLY_RETRY_USEC);
+    }
+    return;
+  }
+
+  pr->next = NULL;
+  pr->job = *job;
+  if (t->parked_tail) {
+    t->parked_tail->next = pr;
+  } else {
+    t->parked_head = pr;
+    struct timeval tv = {0, TLS_HANDSHAKE_REPLY_RETRY_USEC};
+    evtimer_add(t->retry_ev, &tv);
+  }
+  t->parked_tail = pr;
+  ++(t->parked);
+}
+
+static void tls_accept_finish(tls_accept *ta, int result) {
+  EVENT_DEL(ta->io_ev);
+  EVENT_DEL(ta->timeout_ev);
+  ta->job.result = result;
+  tls_handshake_reply(ta->thread, &(ta->job));
+  free(ta);
+}
+
+static void tls_accept_timeout(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  tls_accept *ta = (tls_accept *)arg;
+  if (ta->job.verbose) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "%s: TLS handshake timeout on fd %d\n", __FUNCTION__, (int)ta->job.fd);
+  }
+  tls_accept_finish(ta, -1);
+}
+
+static void tls_accept_step(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(what);
+
+  tls_accept *ta = (tls_accept *)arg;
+
+  ERR_clear_error();
+  int rc = SSL_do_handshake(ta->job.ssl);
+  if (rc == 1) {
+    tls_accept_finish(ta, 0);
+    return;
+  }
+
+  short events = 0;
+  switch (SSL_get_error(ta->job.ssl, rc)) {
+  case SSL_ERROR_WANT_READ:
+    events = EV_READ;
+    break;
+  case SSL_ERROR_WANT_WRITE:
+    events = EV_WRITE;
+    break;
+  default:
+    if (ta->job.verbose) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "%s: TLS handshake failed on fd %d\n", __FUNCTION__, (int)fd);
+    }
+    tls_accept_finish(ta, -1);
+    return;
+  }
+
+  EVENT_DEL(ta->io_ev);
+  ta->io_ev = event_new(ta->thread->event_base, fd, events, tls_accept_step, ta);
+  if (!(ta->io_ev) || (event_add(ta->io_ev, NULL) < 0)) {
+    tls_accept_finish(ta, -1);
+  }
+}
+
+static void tls_handshake_receive(void *msg, void *arg) {
+  tls_handshake_thread *t = (tls_handshake_thread *)arg;
+  tls_handshake_job *job = (tls_handshake_job *)msg;
+
+  if (job->type == TLS_HANDSHAKE_DTLS_RECORD) {
+    job->result = ssl_read(job->fd, job->ssl, job->nbh, t->ssl_scratch, job->verbose);
+    tls_handshake_reply(t, job);
+    return;
+  }
+
+  tls_accept *ta = (tls_accept *)calloc(1, sizeof(tls_accept));
+  if (!ta) {
+    job->result = -1;
+    tls_handshake_reply(t, job);
+    return;
+  }
+
+  ta->job = *job;
+  ta->thread = t;
+  ta->timeout_ev = evtimer_new(t->event_base, tls_accept_timeout, ta);
+  struct timeval tv = {TLS_HANDSHAKE_TIMEOUT, 0};
+  if (!(ta->timeout_ev) || (evtimer_add(ta->timeout_ev, &tv) < 0)) {
+    tls_accept_finish(ta, -1);
+    return;
+  }
+
+  tls_accept_step(job->fd, EV_READ, ta);
+}
+
+static void tls_handshake_report(evutil_socket_t fd, short what, void *arg) {
+  UNUSED_ARG(fd);
+  UNUSED_ARG(what);
+
+  tls_handshake_thread *t = (tls_handshake_thread *)arg;
+  mpsc_queue_stats stats;
+  mpsc_queue_get_stats(t->queue, &stats);
+  prom_set_queue(mpsc_queue_name(t->queue), (unsigned long)stats.depth,
+                 (unsigned long)(stats.wakeups - t->queue_reported.wakeups),
+                 (unsigned long)(stats.drops - t->queue_reported.drops));
+  prom_set_queue_parked(mpsc_queue_name(t->queue), (unsigned long)t->parked);
+  t->queue_reported = stats;
+}
+
+static void *run_tls_handshake_thread(void *arg) {
+  ignore_sigpipe();
+
+  tls_handshake_thread *t = (tls_handshake_thread *)arg;
+  event_base_dispatch(t->event_base);
+
+  return arg;
+}
+
+int tls_handshake_pool_start(int threads) {
+  if (threads < 1) {
+    return 0;
+  }
+
+  handshake_threads = (tls_handshake_thread *)calloc((size_t)threads, sizeof(tls_handshake_thread));
+  if (!handshake_threads) {
+    return -1;
+  }
+
+  for (int i = 0; i < threads; ++i) {
+    tls_handshake_thread *t = &(handshake_threads[i]);
+    t->id = i;
+    t->event_base = turn_event_base_new();
+    if (!(t->event_base)) {
+      return -1;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "handshake-%d", i);
+    t->queue = mpsc_queue_new(t->event_base, name, TLS_HANDSHAKE_QUEUE_SIZE, sizeof(tls_handshake_job),
+                              tls_handshake_receive, t);
+    if (!(t->queue)) {
+      return -1;
+    }
+
+    t->retry_ev = evtimer_new(t->event_base, tls_handshake_retry, t);
+    if (!(t->retry_ev)) {
+      return -1;
+    }
+
+    if (turn_params.prometheus) {
+      struct event *ev = event_new(t->event_base, -1, EV_PERSIST, tls_handshake_report, t);
+      struct timeval tv = {1, 0};
+      evtimer_add(ev, &tv);
+    }
+
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) || pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) ||
+        pthread_create(&(t->thr), &attr, run_tls_handshake_thread, t)) {
+      return -1;
+    }
+  }
+
+  handshake_threads_number = threads;
+
+  return 0;
+}
+
+int tls_handshake_pool_size(void) { return handshake_threads_number; }
+
+bool tls_handshake_submit(const tls_handshake_job *job) {
+  if (!handshake_threads_number || !job || !(job->ssl)) {
+    return false;
+  }
+
+  /* the SSL objects are heap blocks: the low bits carry no information */
+  uintptr_t h = (uintptr_t)(job->ssl) >> 4;
+  h ^= h >> 16;
+
+  return mpsc_queue_push(handshake_threads[h % (uintptr_t)handshake_threads_number].queue, job);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Threads that run the TLS and DTLS handshakes of the client connections
+ */
+
+#ifndef __IOA_TLS_HANDSHAKE__
+#define __IOA_TLS_HANDSHAKE__
+
+#include "ns_mpsc_queue.h"
+#include "ns_turn_ioalib.h"
+
+#include <event2/util.h>
+#include <openssl/ssl.h>
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////
+
+/* Capacity of the queues of the handshake threads, and of their reply queues */
+#define TLS_HANDSHAKE_QUEUE_SIZE (4096)
+
+/* A TLS handshake that takes longer fails */
+#define TLS_HANDSHAKE_TIMEOUT (10)
+
+typedef enum {
+  TLS_HANDSHAKE_DTLS_RECORD, /* run a DTLS datagram of the handshake through the SSL */
+  TLS_HANDSHAKE_TLS_ACCEPT   /* run the server side of the TLS handshake on the TCP socket */
+} tls_handshake_job_type;
+
+/*
+ * A job is copied into the queue of a handshake thread, and copied back with
+ * its result into the reply queue. The SSL (and the datagram) belong to the
+ * handshake thread from the submission to the reply.
+ */
+typedef struct _tls_handshake_job {
+  tls_handshake_job_type type;
+  SSL *ssl;
+  evutil_socket_t fd;
+  ioa_network_buffer_handle nbh; /* DTLS: the datagram, replaced by its decrypted data */
+  void *ctx;                     /* of the submitter, handed back with the result */
+  mpsc_queue *reply;
+  int verbose;
+  int result; /* DTLS: the ssl_read() result; TLS: 0 if the handshake is complete, -1 if it failed */
+} tls_handshake_job;
+
+/*
+ * Start the handshake threads.
+ * Return: 0 on success, -1 if they cannot be started.
+ */
+int tls_handshake_pool_start(int threads);
+
+/* Number of the handshake threads; 0 if the handshakes run in the relay threads */
+int tls_handshake_pool_size(void);
+
+/*
+ * Queue the job to a handshake thread. All the jobs of an SSL go to the same
+ * thread, and are done in order.
+ * Return: false if the queue is full (the job is not queued).
+ */
+bool tls_handshake_submit(const tls_handshake_job *job);
+
+///////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__IOA_TLS_HANDSHAKE__
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#include "ns_tls_tickets.h"
+
+#include "ns_turn_utils.h"
+#include "prom_server.h"
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * The first key of the ring encrypts the new tickets, all of them decrypt
+ * the tickets of the clients. A ticket of a former key is accepted, and
+ * replaced by a ticket of the current key. The ticket callbacks run in all
+ * the relay threads, so the ring is copied out under the mutex.
+ */
+
+#define TLS_TICKET_KEYS_MAX (16)
+
+typedef struct _tls_ticket_key {
+  uint8_t name[16];
+  uint8_t hmac_key[32];
+  uint8_t aes_key[32];
+} tls_ticket_key;
+
+static pthread_mutex_t tls_tickets_mutex = PTHREAD_MUTEX_INITIALIZER;
+static tls_ticket_key tls_ticket_keys[TLS_TICKET_KEYS_MAX];
+static size_t tls_ticket_keys_number = 0;
+
+static char tls_ticket_key_file[1025] = "";
+static time_t tls_ticket_key_file_mtime = 0;
+static int tls_ticket_rotation = 0;
+
+static void tls_tickets_new_random_key(void) {
+  tls_ticket_key key;
+  if (RAND_bytes((unsigned char *)&key, sizeof(key)) != 1) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot generate a TLS session ticket key\n");
+    return;
+  }
+
+  pthread_mutex_lock(&tls_tickets_mutex);
+  size_t kept = tls_ticket_keys_number;
+  if (kept > TLS_TICKET_FORMER_KEYS) {
+    kept = TLS_TICKET_FORMER_KEYS;
+  }
+  memmove(&tls_ticket_keys[1], &tls_ticket_keys[0], kept * sizeof(tls_ticket_key));
+  tls_ticket_keys[0] = key;
+  tls_ticket_keys_number = kept + 1;
+  pthread_mutex_unlock(&tls_tickets_mutex);
+
+  OPENSSL_cleanse(&key, sizeof(key));
+}
+
+static int tls_tickets_read_file(bool force) {
+  struct stat st;
+  if (stat(tls_ticket_key_file, &st) < 0) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot find the TLS ticket key file %s\n", tls_ticket_key_file);
+    return -1;
+  }
+  if (!force && (st.st_mtime == tls_ticket_key_file_mtime)) {
+    return 0;
+  }
+
+  FILE *f = fopen(tls_ticket_key_file, "rb");
+  if (!f) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot open the TLS ticket key file %s\n", tls_ticket_key_file);
+    return -1;
+  }
+
+  uint8_t buf[TLS_TICKET_KEY_SIZE * TLS_TICKET_KEYS_MAX + 1];
+  size_t len = fread(buf, 1, sizeof(buf), f);
+  fclose(f);
+
+  int ret = -1;
+  if (!len || (len % TLS_TICKET_KEY_SIZE) || (len > TLS_TICKET_KEY_SIZE * TLS_TICKET_KEYS_MAX)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "The TLS ticket key file %s must hold 1 to %d keys of %d bytes\n",
+                  tls_ticket_key_file, TLS_TICKET_KEYS_MAX, TLS_TICKET_KEY_SIZE);
+  } else {
+    pthread_mutex_lock(&tls_tickets_mutex);
+    memcpy(tls_ticket_keys, buf, len);
+    tls_ticket_keys_number = len / TLS_TICKET_KEY_SIZE;
+    pthread_mutex_unlock(&tls_tickets_mutex);
+
+    tls_ticket_key_file_mtime = st.st_mtime;
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "TLS ticket keys loaded from %s: %lu keys\n", tls_ticket_key_file,
+                  (unsigned long)(len / TLS_TICKET_KEY_SIZE));
+    ret = 0;
+  }
+
+  OPENSSL_cleanse(buf, sizeof(buf));
+
+  return ret;
+}
+
+void tls_tickets_init(const char *key_file, int rotation) {
+  tls_ticket_rotation = rotation;
+  if (key_file && key_file[0]) {
+    STRCPY(tls_ticket_key_file, key_file);
+    if (tls_tickets_read_file(true) == 0) {
+      return;
+    }
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "The TLS session tickets are only resumed by this server\n");
+    tls_ticket_key_file[0] = 0;
+  }
+  tls_tickets_new_random_key();
+}
+
+void tls_tickets_rotate(void) {
+  if (tls_ticket_key_file[0]) {
+    tls_tickets_read_file(false);
+  } else {
+    tls_tickets_new_random_key();
+  }
+}
+
+void tls_tickets_reload(void) {
+  if (tls_ticket_key_file[0]) {
+    tls_tickets_read_file(true);
+  }
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int tls_tickets_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *cctx,
+                              EVP_MAC_CTX *hctx, int enc) {
+#else
+static int tls_tickets_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *cctx,
+                              HMAC_CTX *hctx, int enc) {
+#endif
+  UNUSED_ARG(ssl);
+
+  tls_ticket_key key;
+  int ret = 0;
+
+  pthread_mutex_lock(&tls_tickets_mutex);
+  if (enc) {
+    if (tls_ticket_keys_number) {
+      key = tls_ticket_keys[0];
+      ret = 1;
+    }
+  } else {
+    size_t i;
+    for (i = 0; i < tls_ticket_keys_number; ++i) {
+      if (!memcmp(tls_ticket_keys[i].name, key_name, sizeof(key.name))) {
+        key = tls_ticket_keys[i];
+        /* 2 asks for a new ticket with the current key */
+        ret = i ? 2 : 1;
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&tls_tickets_mutex);
+
+  if (!ret) {
+    return 0;
+  }
+
+  const EVP_CIPHER *cipher = EVP_aes_256_cbc();
+
+  if (enc) {
+    memcpy(key_name, key.name, sizeof(key.name));
+    if ((RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) != 1) ||
+        (EVP_EncryptInit_ex(cctx, cipher, NULL, key.aes_key, iv) != 1)) {
+      ret = -1;
+    }
+  } else if (EVP_DecryptInit_ex(cctx, cipher, NULL, key.aes_key, iv) != 1) {
+    ret = -1;
+  }
+
+  if (ret > 0) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[3];
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key, sizeof(key.hmac_key));
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0);
+    params[2] = OSSL_PARAM_construct_end();
+    if (EVP_MAC_CTX_set_params(hctx, params) != 1) {
+      ret = -1;
+    }
+#else
+    if (HMAC_Init_ex(hctx, key.hmac_key, sizeof(key.hmac_key), EVP_sha256(), NULL) != 1) {
+      ret = -1;
+    }
+#endif
+  }
+
+  OPENSSL_cleanse(&key, sizeof(key));
+
+  return ret;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+static SSL_TICKET_RETURN tls_tickets_decrypt_cb(SSL *ssl, SSL_SESSION *ss, const unsigned char *keyname,
+                                                size_t keyname_length, SSL_TICKET_STATUS status, void *arg) {
+  UNUSED_ARG(ssl);
+  UNUSED_ARG(ss);
+  UNUSED_ARG(keyname);
+  UNUSED_ARG(keyname_length);
+  UNUSED_ARG(arg);
+
+  switch (status) {
+  case SSL_TICKET_SUCCESS:
+    prom_inc_tls_resumption(true);
+    return SSL_TICKET_RETURN_USE;
+  case SSL_TICKET_SUCCESS_RENEW:
+    prom_inc_tls_resumption(true);
+    return SSL_TICKET_RETURN_USE_RENEW;
+  case SSL_TICKET_NO_DECRYPT:
+    /* Expired key, key of another fleet, or corrupted ticket */
+    prom_inc_tls_resumption(false);
+    return SSL_TICKET_RETURN_IGNORE_RENEW;
+  case SSL_TICKET_EMPTY:
+  case SSL_TICKET_NONE:
+    return SSL_TICKET_RETURN_IGNORE_RENEW;
+  default:
+    return SSL_TICKET_RETURN_ABORT;
+  }
+}
+#endif
+
+void tls_tickets_set_ctx(SSL_CTX *ctx) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, tls_tickets_key_cb);
+#else
+  SSL_CTX_set_tlsext_ticket_key_cb(ctx, tls_tickets_key_cb);
+#endif
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+  SSL_CTX_set_session_ticket_cb(ctx, NULL, tls_tickets_decrypt_cb, NULL);
+#endif
+  /* A ticket outlives TLS_TICKET_FORMER_KEYS rotations of the random key */
+  SSL_CTX_set_timeout(ctx, (long)tls_ticket_rotation * TLS_TICKET_FORMER_KEYS);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/*
+ * Key ring of the TLS session tickets, shared by the TLS and DTLS contexts
+ */
+
+#ifndef __IOA_TLS_TICKETS__
+#define __IOA_TLS_TICKETS__
+
+#include <openssl/ssl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////
+
+/*
+ * A key is 16 bytes of name, 32 bytes of HMAC-SHA256 key and 32 bytes of
+ * AES-256 key, as in the key files of nginx; a key file holds one or more
+ * keys, the first of them encrypts the new tickets.
+ */
+#define TLS_TICKET_KEY_SIZE (80)
+
+/* Number of the keys that still decrypt the tickets after a rotation */
+#define TLS_TICKET_FORMER_KEYS (2)
+
+/*
+ * Set up the key ring with the keys of key_file, or with a random key when
+ * key_file is empty (or cannot be read). rotation is the interval, in
+ * seconds, of the rotations of the random key, or of the checks for a new
+ * version of the key file.
+ */
+void tls_tickets_init(const char *key_file, int rotation);
+
+/* Make the context issue and accept the tickets of the key ring */
+void tls_tickets_set_ctx(SSL_CTX *ctx);
+
+/* Rotate the random key, or reread the key file if it has been modified */
+void tls_tickets_rotate(void);
+
+/* Reread the key file, if any */
+void tls_tickets_reload(void);
+
+///////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__IOA_TLS_TICKETS__
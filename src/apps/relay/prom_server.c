@@ -35,6 +35,35 @@ prom_counter_t *turn_total_traffic_peer_sentb;
 
 prom_gauge_t *turn_total_allocations;
 
+prom_gauge_t *turn_udp_recv_batch_size;
+prom_counter_t *turn_udp_recv_batches;
+prom_counter_t *turn_udp_recv_batch_packets;
+
+prom_gauge_t *turn_buffer_pool_in_use;
+prom_gauge_t *turn_buffer_pool_high_water;
+prom_counter_t *turn_buffer_pool_misses;
+
+prom_gauge_t *turn_super_memory_reserved;
+prom_gauge_t *turn_super_memory_allocated;
+
+prom_gauge_t *turn_timers;
+prom_counter_t *turn_timers_expired;
+prom_gauge_t *turn_timer_lag;
+
+prom_counter_t *turn_channel_data_packets;
+
+prom_gauge_t *turn_queue_depth;
+prom_counter_t *turn_queue_wakeups;
+prom_counter_t *turn_queue_drops;
+prom_gauge_t *turn_queue_parked;
+
+prom_histogram_t *turn_db_query_duration;
+prom_counter_t *turn_db_query_timeouts;
+
+prom_counter_t *turn_tls_resumptions;
+
+prom_histogram_t *turn_tls_handshake_duration;
+
 #if MHD_VERSION >= 0x00097002
 #define MHD_RESULT enum MHD_Result
 #else
@@ -139,6 +168,85 @@ void start_prometheus_server(void) {
   turn_total_allocations = prom_collector_registry_must_register_metric(
       prom_gauge_new("turn_total_allocations", "Represents current allocations number", 1, typeLabel));
 
+  // Create batched UDP receive metrics
+  turn_udp_recv_batch_size = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_udp_recv_batch_size", "Maximum number of datagrams read by one recvmmsg call in UDP listeners", 0, NULL));
+  prom_gauge_set(turn_udp_recv_batch_size, (double)turn_params.udp_recv_batch, NULL);
+  turn_udp_recv_batches = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_udp_recv_batches", "Represents recvmmsg calls returning data in UDP listeners", 0, NULL));
+  turn_udp_recv_batch_packets = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_udp_recv_batch_packets", "Represents datagrams received with recvmmsg in UDP listeners", 0, NULL));
+
+  // Create network buffer pool metrics
+  const char *classLabel[] = {"class"};
+  turn_buffer_pool_in_use = prom_collector_registry_must_register_metric(
+      prom_gauge_new("turn_buffer_pool_in_use", "Represents network buffers in use", 1, classLabel));
+  turn_buffer_pool_high_water = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_buffer_pool_high_water", "Represents the sum of the per-thread high-water marks of network buffers in use",
+      1, classLabel));
+  turn_buffer_pool_misses = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_buffer_pool_misses", "Represents network buffers allocated because the thread pool was empty", 1,
+      classLabel));
+
+  // Create super memory region metrics
+  const char *regionLabel[] = {"region"};
+  turn_super_memory_reserved = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_super_memory_reserved", "Represents bytes reserved by a super memory region", 1, regionLabel));
+  turn_super_memory_allocated = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_super_memory_allocated", "Represents bytes allocated from a super memory region", 1, regionLabel));
+
+  // Create timer wheel metrics
+  const char *threadLabel[] = {"thread"};
+  turn_timers = prom_collector_registry_must_register_metric(
+      prom_gauge_new("turn_timers", "Represents pending timers of a server thread", 1, threadLabel));
+  turn_timers_expired = prom_collector_registry_must_register_metric(
+      prom_counter_new("turn_timers_expired", "Represents expired timers of a server thread", 1, threadLabel));
+  turn_timer_lag = prom_collector_registry_must_register_metric(prom_gauge_new(
+      "turn_timer_lag_ms", "Represents the maximum timer expiry lag of a server thread in the last second", 1,
+      threadLabel));
+
+  // Create ChannelData path metrics
+  const char *pathLabel[] = {"path"};
+  turn_channel_data_packets = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_channel_data_packets", "Represents ChannelData packets relayed by the fast path or the generic read path",
+      1, pathLabel));
+
+  // Create inter-thread queue metrics
+  const char *queueLabel[] = {"queue"};
+  turn_queue_depth = prom_collector_registry_must_register_metric(
+      prom_gauge_new("turn_queue_depth", "Represents messages waiting in an inter-thread queue", 1, queueLabel));
+  turn_queue_wakeups = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_queue_wakeups", "Represents wakeups of the consumer thread of an inter-thread queue", 1, queueLabel));
+  turn_queue_drops = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_queue_drops", "Represents messages rejected because an inter-thread queue was full", 1, queueLabel));
+  turn_queue_parked = prom_collector_registry_must_register_metric(
+      prom_gauge_new("turn_queue_parked",
+                     "Represents replies that the consumer of an inter-thread queue holds until their queue has room",
+                     1, queueLabel));
+
+  // Create asynchronous database query metrics
+  const char *queryLabel[] = {"query"};
+  turn_db_query_duration = prom_collector_registry_must_register_metric(prom_histogram_new(
+      "turn_db_query_duration_seconds", "Represents the latency of the asynchronous database queries",
+      prom_histogram_buckets_exponential(0.0005, 2, 14), 1, queryLabel));
+  turn_db_query_timeouts = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_db_query_timeouts", "Represents asynchronous database queries that were not answered in time", 1,
+      queryLabel));
+
+  // Create TLS session resumption metrics
+  const char *resultLabel[] = {"result"};
+  turn_tls_resumptions = prom_collector_registry_must_register_metric(prom_counter_new(
+      "turn_tls_resumptions", "Represents TLS session tickets presented by the clients, accepted (hit) or not (miss)",
+      1, resultLabel));
+
+  // Create TLS handshake pool metrics
+  const char *protocolLabel[] = {"protocol"};
+  turn_tls_handshake_duration = prom_collector_registry_must_register_metric(prom_histogram_new(
+      "turn_tls_handshake_duration_seconds",
+      "Represents the time from the first message of a TLS/DTLS handshake handed to the handshake threads to the "
+      "completed handshake",
+      prom_histogram_buckets_exponential(0.001, 2, 14), 1, protocolLabel));
+
   // some flags appeared first in microhttpd v0.9.53
   unsigned int flags = 0;
 #if MHD_VERSION >= 0x00095300
@@ -263,6 +371,89 @@ void prom_inc_stun_binding_error(void) {
   }
 }
 
+void prom_inc_udp_recv_batch(unsigned long packets) {
+  if (turn_params.prometheus == 1) {
+    prom_counter_add(turn_udp_recv_batches, 1, NULL);
+    prom_counter_add(turn_udp_recv_batch_packets, packets, NULL);
+  }
+}
+
+void prom_add_buffer_pool(bool small, long in_use, long high_water, unsigned long misses) {
+  if (turn_params.prometheus == 1 && turn_buffer_pool_in_use) {
+    const char *label[] = {small ? "small" : "large"};
+    prom_gauge_add(turn_buffer_pool_in_use, (double)in_use, label);
+    prom_gauge_add(turn_buffer_pool_high_water, (double)high_water, label);
+    prom_counter_add(turn_buffer_pool_misses, (double)misses, label);
+  }
+}
+
+void prom_set_super_memory(const char *region, size_t reserved, size_t allocated) {
+  if (turn_params.prometheus == 1 && turn_super_memory_reserved) {
+    const char *label[] = {region};
+    prom_gauge_set(turn_super_memory_reserved, (double)reserved, label);
+    prom_gauge_set(turn_super_memory_allocated, (double)allocated, label);
+  }
+}
+
+void prom_set_timers(const char *thread, unsigned long timers, unsigned long expired, unsigned long lag_ms) {
+  if (turn_params.prometheus == 1 && turn_timers) {
+    const char *label[] = {thread};
+    prom_gauge_set(turn_timers, (double)timers, label);
+    prom_counter_add(turn_timers_expired, (double)expired, label);
+    prom_gauge_set(turn_timer_lag, (double)lag_ms, label);
+  }
+}
+
+void prom_add_channel_data(unsigned long fast, unsigned long slow) {
+  if (turn_params.prometheus == 1 && turn_channel_data_packets) {
+    const char *fast_label[] = {"fast"};
+    const char *slow_label[] = {"slow"};
+    prom_counter_add(turn_channel_data_packets, (double)fast, fast_label);
+    prom_counter_add(turn_channel_data_packets, (double)slow, slow_label);
+  }
+}
+
+void prom_set_queue(const char *queue, unsigned long depth, unsigned long wakeups, unsigned long drops) {
+  if (turn_params.prometheus == 1 && turn_queue_depth) {
+    const char *label[] = {queue};
+    prom_gauge_set(turn_queue_depth, (double)depth, label);
+    prom_counter_add(turn_queue_wakeups, (double)wakeups, label);
+    prom_counter_add(turn_queue_drops, (double)drops, label);
+  }
+}
+
+void prom_set_queue_parked(const char *queue, unsigned long parked) {
+  if (turn_params.prometheus == 1 && turn_queue_parked) {
+    const char *label[] = {queue};
+    prom_gauge_set(turn_queue_parked, (double)parked, label);
+  }
+}
+
+void prom_observe_db_query(const char *query, double seconds, bool timed_out) {
+  if (turn_params.prometheus == 1 && turn_db_query_duration) {
+    const char *label[] = {query};
+    if (timed_out) {
+      prom_counter_inc(turn_db_query_timeouts, label);
+    } else {
+      prom_histogram_observe(turn_db_query_duration, seconds, label);
+    }
+  }
+}
+
+void prom_inc_tls_resumption(bool hit) {
+  if (turn_params.prometheus == 1 && turn_tls_resumptions) {
+    const char *label[] = {hit ? "hit" : "miss"};
+    prom_counter_inc(turn_tls_resumptions, label);
+  }
+}
+
+void prom_observe_tls_handshake(const char *protocol, double seconds) {
+  if (turn_params.prometheus == 1 && turn_tls_handshake_duration) {
+    const char *label[] = {protocol};
+    prom_histogram_observe(turn_tls_handshake_duration, seconds, label);
+  }
+}
+
 int is_ipv6_enabled(void) {
   int ret = 0;
 
@@ -301,4 +492,56 @@ void prom_inc_allocation(SOCKET_TYPE type) { UNUSED_ARG(type); }
 
 void prom_dec_allocation(SOCKET_TYPE type) { UNUSED_ARG(type); }
 
+void prom_inc_udp_recv_batch(unsigned long packets) { UNUSED_ARG(packets); }
+
+void prom_add_buffer_pool(bool small, long in_use, long high_water, unsigned long misses) {
+  UNUSED_ARG(small);
+  UNUSED_ARG(in_use);
+  UNUSED_ARG(high_water);
+  UNUSED_ARG(misses);
+}
+
+void prom_set_super_memory(const char *region, size_t reserved, size_t allocated) {
+  UNUSED_ARG(region);
+  UNUSED_ARG(reserved);
+  UNUSED_ARG(allocated);
+}
+
+void prom_set_timers(const char *thread, unsigned long timers, unsigned long expired, unsigned long lag_ms) {
+  UNUSED_ARG(thread);
+  UNUSED_ARG(timers);
+  UNUSED_ARG(expired);
+  UNUSED_ARG(lag_ms);
+}
+
+void prom_add_channel_data(unsigned long fast, unsigned long slow) {
+  UNUSED_ARG(fast);
+  UNUSED_ARG(slow);
+}
+
+void prom_set_queue(const char *queue, unsigned long depth, unsigned long wakeups, unsigned long drops) {
+  UNUSED_ARG(queue);
+  UNUSED_ARG(depth);
+  UNUSED_ARG(wakeups);
+  UNUSED_ARG(drops);
+}
+
+void prom_set_queue_parked(const char *queue, unsigned long parked) {
+  UNUSED_ARG(queue);
+  UNUSED_ARG(parked);
+}
+
+void prom_observe_db_query(const char *query, double seconds, bool timed_out) {
+  UNUSED_ARG(query);
+  UNUSED_ARG(seconds);
+  UNUSED_ARG(timed_out);
+}
+
+void prom_inc_tls_resumption(bool hit) { UNUSED_ARG(hit); }
+
+void prom_observe_tls_handshake(const char *protocol, double seconds) {
+  UNUSED_ARG(protocol);
+  UNUSED_ARG(seconds);
+}
+
 #endif /* TURN_NO_PROMETHEUS */
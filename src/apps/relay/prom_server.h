@@ -52,6 +52,35 @@ extern prom_counter_t *turn_total_traffic_peer_sentb;
 
 extern prom_gauge_t *turn_total_allocations_number;
 
+extern prom_gauge_t *turn_udp_recv_batch_size;
+extern prom_counter_t *turn_udp_recv_batches;
+extern prom_counter_t *turn_udp_recv_batch_packets;
+
+extern prom_gauge_t *turn_buffer_pool_in_use;
+extern prom_gauge_t *turn_buffer_pool_high_water;
+extern prom_counter_t *turn_buffer_pool_misses;
+
+extern prom_gauge_t *turn_super_memory_reserved;
+extern prom_gauge_t *turn_super_memory_allocated;
+
+extern prom_gauge_t *turn_timers;
+extern prom_counter_t *turn_timers_expired;
+extern prom_gauge_t *turn_timer_lag;
+
+extern prom_counter_t *turn_channel_data_packets;
+
+extern prom_gauge_t *turn_queue_depth;
+extern prom_counter_t *turn_queue_wakeups;
+extern prom_counter_t *turn_queue_drops;
+extern prom_gauge_t *turn_queue_parked;
+
+extern prom_histogram_t *turn_db_query_duration;
+extern prom_counter_t *turn_db_query_timeouts;
+
+extern prom_counter_t *turn_tls_resumptions;
+
+extern prom_histogram_t *turn_tls_handshake_duration;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -70,6 +99,25 @@ void prom_inc_stun_binding_request(void);
 void prom_inc_stun_binding_response(void);
 void prom_inc_stun_binding_error(void);
 
+void prom_inc_udp_recv_batch(unsigned long packets);
+
+void prom_add_buffer_pool(bool small, long in_use, long high_water, unsigned long misses);
+
+void prom_set_super_memory(const char *region, size_t reserved, size_t allocated);
+
+void prom_set_timers(const char *thread, unsigned long timers, unsigned long expired, unsigned long lag_ms);
+
+void prom_add_channel_data(unsigned long fast, unsigned long slow);
+
+void prom_set_queue(const char *queue, unsigned long depth, unsigned long wakeups, unsigned long drops);
+void prom_set_queue_parked(const char *queue, unsigned long parked);
+
+void prom_observe_db_query(const char *query, double seconds, bool timed_out);
+
+void prom_inc_tls_resumption(bool hit);
+
+void prom_observe_tls_handshake(const char *protocol, double seconds);
+
 #else
 
 void start_prometheus_server(void);
@@ -80,6 +128,25 @@ void prom_set_finished_traffic(const char *realm, const char *user, unsigned lon
 void prom_inc_allocation(SOCKET_TYPE type);
 void prom_dec_allocation(SOCKET_TYPE type);
 
+void prom_inc_udp_recv_batch(unsigned long packets);
+
+void prom_add_buffer_pool(bool small, long in_use, long high_water, unsigned long misses);
+
+void prom_set_super_memory(const char *region, size_t reserved, size_t allocated);
+
+void prom_set_timers(const char *thread, unsigned long timers, unsigned long expired, unsigned long lag_ms);
+
+void prom_add_channel_data(unsigned long fast, unsigned long slow);
+
+void prom_set_queue(const char *queue, unsigned long depth, unsigned long wakeups, unsigned long drops);
+void prom_set_queue_parked(const char *queue, unsigned long parked);
+
+void prom_observe_db_query(const char *query, double seconds, bool timed_out);
+
+void prom_inc_tls_resumption(bool hit);
+
+void prom_observe_tls_handshake(const char *protocol, double seconds);
+
 #endif /* TURN_NO_PROMETHEUS */
 
 #ifdef __cplusplus
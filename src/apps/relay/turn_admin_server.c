@@ -1317,7 +1317,7 @@ static int send_socket_to_admin_server(ioa_engine_handle e, struct message_to_re
 
 void setup_admin_thread(void) {
   adminserver.event_base = turn_event_base_new();
-  super_memory_t *sm = new_super_memory_region();
+  super_memory_t *sm = new_super_memory_region("admin");
   adminserver.e = create_ioa_engine(sm, adminserver.event_base, turn_params.listener.tp, turn_params.relay_ifname,
                                     turn_params.relays_number, turn_params.relay_addrs, turn_params.default_relays,
                                     turn_params.verbose
@@ -3453,6 +3453,7 @@ static void handle_https(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
                   STRCPY(u, user);
                   STRCPY(r, realm);
                   dbd->del_user(u, r);
+                  auth_cache_invalidate_all();
                 }
               }
             }
@@ -3511,6 +3512,7 @@ static void handle_https(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
                     skey[sz * 2] = 0;
 
                     (*dbd->set_user_key)(u, r, skey);
+                    auth_cache_invalidate_all();
                   }
 
                   add_realm = (const uint8_t *)"";
@@ -3554,6 +3556,7 @@ static void handle_https(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
                   STRCPY(ss, secret);
                   STRCPY(r, realm);
                   dbd->del_secret(ss, r);
+                  auth_cache_invalidate_all();
                 }
               }
             }
@@ -3589,6 +3592,7 @@ static void handle_https(ioa_socket_handle s, ioa_network_buffer_handle nbh) {
                 STRCPY(ss, add_secret);
                 STRCPY(r, add_realm);
                 (*dbd->set_secret)(ss, r);
+                auth_cache_invalidate_all();
               }
 
               add_secret = (const uint8_t *)"";
@@ -54,6 +54,7 @@
 
 #include "ns_turn_utils.h"
 
+#include "ns_turn_ip_trie.h"
 #include "ns_turn_maps.h"
 #include "ns_turn_server.h"
 
@@ -399,6 +400,209 @@ static char *get_real_username(char *usname) {
   return strdup(usname);
 }
 
+/*
+ * TURN REST API: the key of the username is valid if the request was signed
+ * with the password derived from one of the secrets.
+ */
+static int get_rest_api_user_key(secrets_list_t *sl, uint8_t *usname, uint8_t *realm, hmackey_t key,
+                                 ioa_network_buffer_handle nbh) {
+  int ret = -1;
+
+  turn_time_t ctime = (turn_time_t)time(NULL);
+  turn_time_t ts = get_rest_api_timestamp((char *)usname);
+
+  if (!turn_time_before(ts, ctime)) {
+
+    uint8_t hmac[MAXSHASIZE];
+    unsigned int hmac_len;
+    password_t pwdtmp;
+    size_t sll = 0;
+
+    hmac[0] = 0;
+
+    stun_attr_ref sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh),
+                                                        STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+    if (!sar) {
+      return -1;
+    }
+
+    int sarlen = stun_attr_get_len(sar);
+    switch (sarlen) {
+    case SHA1SIZEBYTES:
+      hmac_len = SHA1SIZEBYTES;
+      break;
+    case SHA256SIZEBYTES:
+    case SHA384SIZEBYTES:
+    case SHA512SIZEBYTES:
+    default:
+      return -1;
+    };
+
+    for (sll = 0; sll < get_secrets_list_size(sl); ++sll) {
+
+      const char *secret = get_secrets_list_elem(sl, sll);
+
+      if (secret) {
+        if (stun_calculate_hmac(usname, strlen((char *)usname), (const uint8_t *)secret, strlen(secret), hmac,
+                                &hmac_len, SHATYPE_DEFAULT)) {
+          size_t pwd_length = 0;
+          char *pwd = base64_encode(hmac, hmac_len, &pwd_length);
+
+          if (pwd) {
+            if (pwd_length < 1) {
+              free(pwd);
+            } else {
+              if (stun_produce_integrity_key_str((uint8_t *)usname, realm, (uint8_t *)pwd, key, SHATYPE_DEFAULT)) {
+                if (stun_check_message_integrity_by_key_str(TURN_CREDENTIALS_LONG_TERM, ioa_network_buffer_data(nbh),
+                                                            ioa_network_buffer_get_size(nbh), key, pwdtmp,
+                                                            SHATYPE_DEFAULT) > 0) {
+
+                  ret = 0;
+                }
+              }
+              free(pwd);
+
+              if (ret == 0) {
+                break;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  return ret;
+}
+
+static int get_static_user_key(uint8_t *usname, hmackey_t key) {
+  int ret = -1;
+
+  ur_string_map_value_type ukey = NULL;
+  ur_string_map_lock(turn_params.default_users_db.ram_db.static_accounts);
+  if (ur_string_map_get(turn_params.default_users_db.ram_db.static_accounts, (ur_string_map_key_type)usname, &ukey)) {
+    size_t sz = get_hmackey_size(SHATYPE_DEFAULT);
+    memcpy(key, ukey, sz);
+    ret = 0;
+  }
+  ur_string_map_unlock(turn_params.default_users_db.ram_db.static_accounts);
+
+  return ret;
+}
+
+/*
+ * Checks the oAuth access token of the request with the key of its kid,
+ * and takes the session key out of the token.
+ */
+static int get_oauth_user_key(const oauth_key_data_raw *rawKey, int *max_session_time, uint8_t *realm, hmackey_t key,
+                              ioa_network_buffer_handle nbh) {
+  stun_attr_ref sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh),
+                                                      STUN_ATTRIBUTE_OAUTH_ACCESS_TOKEN);
+  if (!sar) {
+    return -1;
+  }
+
+  int len = stun_attr_get_len(sar);
+  const uint8_t *value = stun_attr_get_value(sar);
+  if (len <= 0 || !value) {
+    return -1;
+  }
+
+  if (!rawKey->kid[0]) {
+    return -1;
+  }
+
+  if (rawKey->lifetime) {
+    if (!turn_time_before(turn_time(), (turn_time_t)(rawKey->timestamp + rawKey->lifetime + OAUTH_TIME_DELTA))) {
+      return -1;
+    }
+  }
+
+  oauth_key_data okd;
+  memset(&okd, 0, sizeof(okd));
+
+  convert_oauth_key_data_raw(rawKey, &okd);
+
+  char err_msg[1025] = "\0";
+  size_t err_msg_size = sizeof(err_msg) - 1;
+
+  oauth_key okey;
+  memset(&okey, 0, sizeof(okey));
+
+  if (!convert_oauth_key_data(&okd, &okey, err_msg, err_msg_size)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s\n", err_msg);
+    return -1;
+  }
+
+  oauth_token dot;
+  memset((&dot), 0, sizeof(dot));
+
+  encoded_oauth_token etoken;
+  memset(&etoken, 0, sizeof(etoken));
+
+  if ((size_t)len > sizeof(etoken.token)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Encoded oAuth token is too large\n");
+    return -1;
+  }
+  memcpy(etoken.token, value, (size_t)len);
+  etoken.size = (size_t)len;
+
+  const char *server_name = (char *)turn_params.oauth_server_name;
+  if (!(server_name && server_name[0])) {
+    server_name = (char *)realm;
+    if (!(server_name && server_name[0])) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot determine oAuth server name");
+      return -1;
+    }
+  }
+
+  if (!decode_oauth_token((const uint8_t *)server_name, &etoken, &okey, &dot)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot decode oauth token\n");
+    return -1;
+  }
+
+  switch (dot.enc_block.key_length) {
+  case SHA1SIZEBYTES:
+    break;
+  case SHA256SIZEBYTES:
+  case SHA384SIZEBYTES:
+  case SHA512SIZEBYTES:
+  default:
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong size of the MAC key in oAuth token(3): %d\n",
+                  (int)dot.enc_block.key_length);
+    return -1;
+  };
+
+  password_t pwdtmp;
+  if (stun_check_message_integrity_by_key_str(TURN_CREDENTIALS_LONG_TERM, ioa_network_buffer_data(nbh),
+                                              ioa_network_buffer_get_size(nbh), dot.enc_block.mac_key, pwdtmp,
+                                              SHATYPE_DEFAULT) <= 0) {
+    return -1;
+  }
+
+  turn_time_t lifetime = (turn_time_t)(dot.enc_block.lifetime);
+  if (lifetime) {
+    turn_time_t ts = (turn_time_t)(dot.enc_block.timestamp >> 16);
+    turn_time_t to = ts + lifetime + OAUTH_TIME_DELTA;
+    turn_time_t ct = turn_time();
+    if (!turn_time_before(ct, to)) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "oAuth token is too old\n");
+      return -1;
+    }
+    if (max_session_time) {
+      *max_session_time = to - ct;
+    }
+  }
+
+  memcpy(key, dot.enc_block.mac_key, dot.enc_block.key_length);
+
+  if (rawKey->realm[0]) {
+    memcpy(realm, rawKey->realm, sizeof(rawKey->realm));
+  }
+
+  return 0;
+}
+
 /*
  * Password retrieval
  */
@@ -435,98 +639,7 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
             return ret;
           }
 
-          if (!rawKey.kid[0]) {
-            return ret;
-          }
-
-          if (rawKey.lifetime) {
-            if (!turn_time_before(turn_time(), (turn_time_t)(rawKey.timestamp + rawKey.lifetime + OAUTH_TIME_DELTA))) {
-              return ret;
-            }
-          }
-
-          oauth_key_data okd;
-          memset(&okd, 0, sizeof(okd));
-
-          convert_oauth_key_data_raw(&rawKey, &okd);
-
-          char err_msg[1025] = "\0";
-          size_t err_msg_size = sizeof(err_msg) - 1;
-
-          oauth_key okey;
-          memset(&okey, 0, sizeof(okey));
-
-          if (!convert_oauth_key_data(&okd, &okey, err_msg, err_msg_size)) {
-            TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s\n", err_msg);
-            return -1;
-          }
-
-          oauth_token dot;
-          memset((&dot), 0, sizeof(dot));
-
-          encoded_oauth_token etoken;
-          memset(&etoken, 0, sizeof(etoken));
-
-          if ((size_t)len > sizeof(etoken.token)) {
-            TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Encoded oAuth token is too large\n");
-            return -1;
-          }
-          memcpy(etoken.token, value, (size_t)len);
-          etoken.size = (size_t)len;
-
-          const char *server_name = (char *)turn_params.oauth_server_name;
-          if (!(server_name && server_name[0])) {
-            server_name = (char *)realm;
-            if (!(server_name && server_name[0])) {
-              TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot determine oAuth server name");
-              return -1;
-            }
-          }
-
-          if (!decode_oauth_token((const uint8_t *)server_name, &etoken, &okey, &dot)) {
-            TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot decode oauth token\n");
-            return -1;
-          }
-
-          switch (dot.enc_block.key_length) {
-          case SHA1SIZEBYTES:
-            break;
-          case SHA256SIZEBYTES:
-          case SHA384SIZEBYTES:
-          case SHA512SIZEBYTES:
-          default:
-            TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Wrong size of the MAC key in oAuth token(3): %d\n",
-                          (int)dot.enc_block.key_length);
-            return -1;
-          };
-
-          password_t pwdtmp;
-          if (stun_check_message_integrity_by_key_str(TURN_CREDENTIALS_LONG_TERM, ioa_network_buffer_data(nbh),
-                                                      ioa_network_buffer_get_size(nbh), dot.enc_block.mac_key, pwdtmp,
-                                                      SHATYPE_DEFAULT) > 0) {
-
-            turn_time_t lifetime = (turn_time_t)(dot.enc_block.lifetime);
-            if (lifetime) {
-              turn_time_t ts = (turn_time_t)(dot.enc_block.timestamp >> 16);
-              turn_time_t to = ts + lifetime + OAUTH_TIME_DELTA;
-              turn_time_t ct = turn_time();
-              if (!turn_time_before(ct, to)) {
-                TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "oAuth token is too old\n");
-                return -1;
-              }
-              if (max_session_time) {
-                *max_session_time = to - ct;
-              }
-            }
-
-            memcpy(key, dot.enc_block.mac_key, dot.enc_block.key_length);
-
-            if (rawKey.realm[0]) {
-              memcpy(realm, rawKey.realm, sizeof(rawKey.realm));
-            }
-
-            ret = 0;
-          }
+          ret = get_oauth_user_key(&rawKey, max_session_time, realm, key, nbh);
         }
       }
     }
@@ -537,78 +650,11 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
   }
 
   if (turn_params.use_auth_secret_with_timestamp) {
-
-    turn_time_t ctime = (turn_time_t)time(NULL);
-    turn_time_t ts = 0;
     secrets_list_t sl;
-    size_t sll = 0;
-
     init_secrets_list(&sl);
 
-    if (get_auth_secrets(&sl, realm) < 0) {
-      return ret;
-    }
-
-    ts = get_rest_api_timestamp((char *)usname);
-
-    if (!turn_time_before(ts, ctime)) {
-
-      uint8_t hmac[MAXSHASIZE];
-      unsigned int hmac_len;
-      password_t pwdtmp;
-
-      hmac[0] = 0;
-
-      stun_attr_ref sar = stun_attr_get_first_by_type_str(
-          ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh), STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
-      if (!sar) {
-        return -1;
-      }
-
-      int sarlen = stun_attr_get_len(sar);
-      switch (sarlen) {
-      case SHA1SIZEBYTES:
-        hmac_len = SHA1SIZEBYTES;
-        break;
-      case SHA256SIZEBYTES:
-      case SHA384SIZEBYTES:
-      case SHA512SIZEBYTES:
-      default:
-        return -1;
-      };
-
-      for (sll = 0; sll < get_secrets_list_size(&sl); ++sll) {
-
-        const char *secret = get_secrets_list_elem(&sl, sll);
-
-        if (secret) {
-          if (stun_calculate_hmac(usname, strlen((char *)usname), (const uint8_t *)secret, strlen(secret), hmac,
-                                  &hmac_len, SHATYPE_DEFAULT)) {
-            size_t pwd_length = 0;
-            char *pwd = base64_encode(hmac, hmac_len, &pwd_length);
-
-            if (pwd) {
-              if (pwd_length < 1) {
-                free(pwd);
-              } else {
-                if (stun_produce_integrity_key_str((uint8_t *)usname, realm, (uint8_t *)pwd, key, SHATYPE_DEFAULT)) {
-                  if (stun_check_message_integrity_by_key_str(TURN_CREDENTIALS_LONG_TERM, ioa_network_buffer_data(nbh),
-                                                              ioa_network_buffer_get_size(nbh), key, pwdtmp,
-                                                              SHATYPE_DEFAULT) > 0) {
-
-                    ret = 0;
-                  }
-                }
-                free(pwd);
-
-                if (ret == 0) {
-                  break;
-                }
-              }
-            }
-          }
-        }
-      }
+    if (get_auth_secrets(&sl, realm) >= 0) {
+      ret = get_rest_api_user_key(&sl, usname, realm, key, nbh);
     }
 
     clean_secrets_list(&sl);
@@ -616,16 +662,7 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
     return ret;
   }
 
-  ur_string_map_value_type ukey = NULL;
-  ur_string_map_lock(turn_params.default_users_db.ram_db.static_accounts);
-  if (ur_string_map_get(turn_params.default_users_db.ram_db.static_accounts, (ur_string_map_key_type)usname, &ukey)) {
-    ret = 0;
-  }
-  ur_string_map_unlock(turn_params.default_users_db.ram_db.static_accounts);
-
-  if (ret == 0) {
-    size_t sz = get_hmackey_size(SHATYPE_DEFAULT);
-    memcpy(key, ukey, sz);
+  if (get_static_user_key(usname, key) >= 0) {
     return 0;
   }
 
@@ -637,9 +674,46 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
   return ret;
 }
 
+/*
+ * The session keys of oAuth come with the request itself: they are not
+ * cached.
+ */
+static int is_oauth_user_check(int in_oauth, int out_oauth, ioa_network_buffer_handle nbh) {
+  if (out_oauth) {
+    return 1;
+  }
+  if (in_oauth && stun_attr_get_first_by_type_str(ioa_network_buffer_data(nbh), ioa_network_buffer_get_size(nbh),
+                                                  STUN_ATTRIBUTE_OAUTH_ACCESS_TOKEN)) {
+    return 1;
+  }
+  return 0;
+}
+
 uint8_t *start_user_check(turnserver_id id, turn_credential_type ct, int in_oauth, int *out_oauth, uint8_t *usname,
                           uint8_t *realm, get_username_resume_cb resume, ioa_net_data *in_buffer, uint64_t ctxkey,
                           int *postpone_reply) {
+  auth_cache *ac = get_relay_auth_cache(id);
+  if (ac && !is_oauth_user_check(in_oauth, *out_oauth, in_buffer->nbh)) {
+    bool found = false;
+    const uint8_t *key = auth_cache_get(ac, realm, usname, &found);
+    if (found && !key) {
+      *postpone_reply = 0;
+      return NULL;
+    }
+    if (key) {
+      /* a cached key that does not match the request may be outdated: ask the auth server */
+      hmackey_t hmackey;
+      password_t pwdtmp;
+      memcpy(hmackey, key, sizeof(hmackey_t));
+      if (stun_check_message_integrity_by_key_str(ct, ioa_network_buffer_data(in_buffer->nbh),
+                                                  ioa_network_buffer_get_size(in_buffer->nbh), hmackey, pwdtmp,
+                                                  SHATYPE_DEFAULT) > 0) {
+        *postpone_reply = 0;
+        return (uint8_t *)key;
+      }
+    }
+  }
+
   *postpone_reply = 1;
 
   struct auth_message am;
@@ -654,12 +728,222 @@ uint8_t *start_user_check(turnserver_id id, turn_credential_type ct, int in_oaut
   memcpy(&(am.in_buffer), in_buffer, sizeof(ioa_net_data));
   in_buffer->nbh = NULL;
   am.ctxkey = ctxkey;
+  am.cache_generation = auth_cache_generation();
 
   send_auth_message_to_auth_server(&am);
 
   return NULL;
 }
 
+/*
+ * Asynchronous user check of an auth thread, when the database driver
+ * supports it: the message waits in a copy for the answer of the database.
+ */
+typedef struct _async_user_check {
+  struct auth_message am;
+  secrets_list_t sl;
+  oauth_key_data_raw oauth_key;
+  auth_message_answer_cb answer;
+} async_user_check;
+
+static void async_user_check_done(async_user_check *uc, int success) {
+  uc->am.success = success;
+  uc->answer(&(uc->am));
+  clean_secrets_list(&(uc->sl));
+  free(uc);
+}
+
+static void async_auth_secrets_cb(int ret, void *arg) {
+  async_user_check *uc = (async_user_check *)arg;
+  hmackey_t key;
+  int success = 0;
+  if ((ret >= 0) && (get_rest_api_user_key(&(uc->sl), uc->am.username, uc->am.realm, key, uc->am.in_buffer.nbh) >= 0)) {
+    memcpy(uc->am.key, key, sizeof(hmackey_t));
+    success = 1;
+  }
+  async_user_check_done(uc, success);
+}
+
+static void async_user_key_cb(int ret, void *arg) { async_user_check_done((async_user_check *)arg, ret >= 0); }
+
+static void async_oauth_key_cb(int ret, void *arg) {
+  async_user_check *uc = (async_user_check *)arg;
+  int success = 0;
+  if ((ret >= 0) && (get_oauth_user_key(&(uc->oauth_key), &(uc->am.max_session_time), uc->am.realm, uc->am.key,
+                                        uc->am.in_buffer.nbh) >= 0)) {
+    success = 1;
+  }
+  async_user_check_done(uc, success);
+}
+
+int start_async_user_check(struct event_base *base, struct auth_message *am, auth_message_answer_cb answer) {
+  const turn_dbdriver_t *dbd = get_dbdriver();
+  if (!dbd || !base) {
+    return 0;
+  }
+
+  int oauth = is_oauth_user_check(am->in_oauth, am->out_oauth, am->in_buffer.nbh);
+  if (oauth) {
+    /* the requests without a token take the synchronous path, which fails them */
+    if (!(dbd->get_oauth_key_async) || !(am->in_oauth) || !(am->username[0])) {
+      return 0;
+    }
+    stun_attr_ref sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(am->in_buffer.nbh),
+                                                        ioa_network_buffer_get_size(am->in_buffer.nbh),
+                                                        STUN_ATTRIBUTE_OAUTH_ACCESS_TOKEN);
+    if (!sar || (stun_attr_get_len(sar) <= 0)) {
+      return 0;
+    }
+  }
+
+  am->max_session_time = 0;
+
+  if (oauth) {
+    am->out_oauth = 1;
+  } else if (turn_params.use_auth_secret_with_timestamp) {
+    if (!(dbd->get_auth_secrets_async)) {
+      return 0;
+    }
+    if (turn_time_before(get_rest_api_timestamp((char *)am->username), turn_time())) {
+      /* expired credentials, whatever the secrets are */
+      am->success = 0;
+      answer(am);
+      return 1;
+    }
+  } else {
+    if (!(dbd->get_user_key_async)) {
+      return 0;
+    }
+    if (get_static_user_key(am->username, am->key) >= 0) {
+      am->success = 1;
+      answer(am);
+      return 1;
+    }
+  }
+
+  async_user_check *uc = (async_user_check *)calloc(1, sizeof(async_user_check));
+  if (!uc) {
+    return 0;
+  }
+  memcpy(&(uc->am), am, sizeof(struct auth_message));
+  init_secrets_list(&(uc->sl));
+  uc->answer = answer;
+
+  int ret = -1;
+  if (oauth) {
+    ret = (*(dbd->get_oauth_key_async))(base, uc->am.username, &(uc->oauth_key), async_oauth_key_cb, uc);
+  } else if (turn_params.use_auth_secret_with_timestamp) {
+    secrets_list_t *static_sl = &turn_params.default_users_db.ram_db.static_auth_secrets;
+    size_t i;
+    for (i = 0; i < get_secrets_list_size(static_sl); ++i) {
+      add_to_secrets_list(&(uc->sl), get_secrets_list_elem(static_sl, i));
+    }
+    ret = (*(dbd->get_auth_secrets_async))(base, &(uc->sl), uc->am.realm, async_auth_secrets_cb, uc);
+  } else {
+    ret = (*(dbd->get_user_key_async))(base, uc->am.username, uc->am.realm, uc->am.key, async_user_key_cb, uc);
+  }
+
+  if (ret < 0) {
+    clean_secrets_list(&(uc->sl));
+    free(uc);
+    return 0;
+  }
+
+  /* the network buffer belongs to the copy now */
+  am->in_buffer.nbh = NULL;
+  return 1;
+}
+
+void cache_user_check_result(auth_cache *ac, const struct auth_message *am) {
+  if (!ac || is_oauth_user_check(am->in_oauth, am->out_oauth, am->in_buffer.nbh)) {
+    return;
+  }
+
+  turn_time_t not_after = 0;
+  if (turn_params.use_auth_secret_with_timestamp) {
+    uint8_t usname[sizeof(am->username)];
+    memcpy(usname, am->username, sizeof(usname));
+    turn_time_t ts = get_rest_api_timestamp((char *)usname);
+    if (!turn_time_before(ts, turn_time())) {
+      if (!(am->success)) {
+        /* the request did not match any secret: that says nothing of the next requests */
+        return;
+      }
+      /* the TURN REST API credentials expire with the timestamp of the username */
+      not_after = ts;
+    }
+  }
+
+  auth_cache_put(ac, am->realm, am->username, am->success ? am->key : NULL, am->cache_generation, not_after);
+}
+
+/*
+ * The shared secrets of the TURN REST API may be changed in the database at
+ * any time: when they are, the keys derived from the former ones are
+ * dropped from the caches of the relay threads.
+ */
+static uint64_t auth_secrets_fingerprint = 0;
+
+static uint64_t fingerprint_auth_secrets(uint64_t fp, uint8_t *realm) {
+  secrets_list_t sl;
+  init_secrets_list(&sl);
+
+  if (get_auth_secrets(&sl, realm) >= 0) {
+    size_t i;
+    for (i = 0; i < get_secrets_list_size(&sl); ++i) {
+      const uint8_t *secret = (const uint8_t *)get_secrets_list_elem(&sl, i);
+      while (*secret) {
+        fp = (fp ^ *secret++) * 0x100000001b3ULL;
+      }
+      fp = (fp ^ 0xff) * 0x100000001b3ULL;
+    }
+  }
+  fp = (fp ^ 0xfe) * 0x100000001b3ULL;
+
+  clean_secrets_list(&sl);
+
+  return fp;
+}
+
+void check_auth_secrets_update(void) {
+  if (!turn_params.use_auth_secret_with_timestamp || (turn_params.auth_cache_size < 1)) {
+    return;
+  }
+
+  secrets_list_t realm_names;
+  init_secrets_list(&realm_names);
+
+  lock_realms();
+  {
+    size_t i;
+    for (i = 0; i < get_secrets_list_size(&realms_list); ++i) {
+      add_to_secrets_list(&realm_names, get_secrets_list_elem(&realms_list, i));
+    }
+  }
+  if (!get_secrets_list_size(&realm_names)) {
+    add_to_secrets_list(&realm_names, get_realm(NULL)->options.name);
+  }
+  unlock_realms();
+
+  uint64_t fp = 0xcbf29ce484222325ULL;
+  {
+    size_t i;
+    for (i = 0; i < get_secrets_list_size(&realm_names); ++i) {
+      fp = fingerprint_auth_secrets(fp, (uint8_t *)get_secrets_list_elem(&realm_names, i));
+    }
+  }
+
+  clean_secrets_list(&realm_names);
+
+  if (fp != auth_secrets_fingerprint) {
+    if (auth_secrets_fingerprint) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "TURN REST API secrets changed, the cached user keys are dropped\n");
+      auth_cache_invalidate_all();
+    }
+    auth_secrets_fingerprint = fp;
+  }
+}
+
 int check_new_allocation_quota(uint8_t *user, int oauth, uint8_t *realm) {
   int ret = 0;
   if (user || oauth) {
@@ -807,6 +1091,7 @@ int add_static_user_account(char *user) {
   ur_string_map_unlock(turn_params.default_users_db.ram_db.static_accounts);
 
   turn_params.default_users_db.ram_db.users_number++;
+  auth_cache_invalidate_all();
 
   free(usname);
   return 0;
@@ -1116,86 +1401,33 @@ void run_db_test(void) {
 
 ///////////////// WHITE/BLACK IP LISTS ///////////////////
 
-#if !defined(TURN_NO_RWLOCK)
-static pthread_rwlock_t *whitelist_rwlock = NULL;
-static pthread_rwlock_t *blacklist_rwlock = NULL;
-#else
-static TURN_MUTEX_DECLARE(whitelist_mutex);
-static TURN_MUTEX_DECLARE(blacklist_mutex);
-#endif
-
-static ip_range_list_t *ipwhitelist = NULL;
-static ip_range_list_t *ipblacklist = NULL;
+/*
+ * The dynamic lists are compiled into tries by the thread that rereads them
+ * and published with an atomic pointer store; the relay threads only load
+ * the pointer. A replaced trie is retired with a new quiescent epoch, and
+ * freed once all the relay engines have passed it (see
+ * ioa_engine_track_quiescence()), when no lookup can still be using it.
+ */
+static ip_range_trie_t *ipwhitelist = NULL;
+static ip_range_trie_t *ipblacklist = NULL;
 
-void init_dynamic_ip_lists(void) {
-#if !defined(TURN_NO_RWLOCK)
-  whitelist_rwlock = (pthread_rwlock_t *)malloc(sizeof(pthread_rwlock_t));
-  pthread_rwlock_init(whitelist_rwlock, NULL);
+typedef struct _ip_trie_retired {
+  ip_range_trie_t *t;
+  uint64_t epoch;
+  struct _ip_trie_retired *next;
+} ip_trie_retired;
 
-  blacklist_rwlock = (pthread_rwlock_t *)malloc(sizeof(pthread_rwlock_t));
-  pthread_rwlock_init(blacklist_rwlock, NULL);
-#else
-  TURN_MUTEX_INIT(&whitelist_mutex);
-  TURN_MUTEX_INIT(&blacklist_mutex);
-#endif
-}
+/* Only the thread that rereads the lists touches the retired tries */
+static ip_trie_retired *ip_tries_retired = NULL;
 
-void ioa_lock_whitelist(ioa_engine_handle e) {
+const ip_range_trie_t *ioa_get_whitelist(ioa_engine_handle e) {
   UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_rdlock(whitelist_rwlock);
-#else
-  TURN_MUTEX_LOCK(&whitelist_mutex);
-#endif
-}
-void ioa_unlock_whitelist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_unlock(whitelist_rwlock);
-#else
-  TURN_MUTEX_UNLOCK(&whitelist_mutex);
-#endif
-}
-static void ioa_wrlock_whitelist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_wrlock(whitelist_rwlock);
-#else
-  TURN_MUTEX_LOCK(&whitelist_mutex);
-#endif
-}
-const ip_range_list_t *ioa_get_whitelist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-  return ipwhitelist;
+  return __atomic_load_n(&ipwhitelist, __ATOMIC_ACQUIRE);
 }
 
-void ioa_lock_blacklist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_rdlock(blacklist_rwlock);
-#else
-  TURN_MUTEX_LOCK(&blacklist_mutex);
-#endif
-}
-void ioa_unlock_blacklist(ioa_engine_handle e) {
+const ip_range_trie_t *ioa_get_blacklist(ioa_engine_handle e) {
   UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_unlock(blacklist_rwlock);
-#else
-  TURN_MUTEX_UNLOCK(&blacklist_mutex);
-#endif
-}
-static void ioa_wrlock_blacklist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-#if !defined(TURN_NO_RWLOCK)
-  pthread_rwlock_wrlock(blacklist_rwlock);
-#else
-  TURN_MUTEX_LOCK(&blacklist_mutex);
-#endif
-}
-const ip_range_list_t *ioa_get_blacklist(ioa_engine_handle e) {
-  UNUSED_ARG(e);
-  return ipblacklist;
+  return __atomic_load_n(&ipblacklist, __ATOMIC_ACQUIRE);
 }
 
 ip_range_list_t *get_ip_list(const char *kind) {
@@ -1218,27 +1450,57 @@ void ip_list_free(ip_range_list_t *l) {
   }
 }
 
-void update_white_and_black_lists(void) {
-  {
-    ip_range_list_t *wl = get_ip_list("allowed");
-    ip_range_list_t *owl = NULL;
-    ioa_wrlock_whitelist(NULL);
-    owl = ipwhitelist;
-    ipwhitelist = wl;
-    ioa_unlock_whitelist(NULL);
-    ip_list_free(owl);
+static void ip_trie_retire(ip_range_trie_t *t) {
+  if (t) {
+    ip_trie_retired *r = (ip_trie_retired *)malloc(sizeof(ip_trie_retired));
+    if (!r) {
+      /* leaked: a relay thread may still read it */
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "%s: cannot retire an IP list trie\n", __FUNCTION__);
+      return;
+    }
+    r->t = t;
+    r->epoch = ioa_engines_next_epoch();
+    r->next = ip_tries_retired;
+    ip_tries_retired = r;
   }
-  {
-    ip_range_list_t *bl = get_ip_list("denied");
-    ip_range_list_t *obl = NULL;
-    ioa_wrlock_blacklist(NULL);
-    obl = ipblacklist;
-    ipblacklist = bl;
-    ioa_unlock_blacklist(NULL);
-    ip_list_free(obl);
+}
+
+static void ip_tries_reclaim(void) {
+  if (ip_tries_retired) {
+    uint64_t epoch = ioa_engines_quiescent_epoch();
+    ip_trie_retired **pr = &ip_tries_retired;
+    while (*pr) {
+      ip_trie_retired *r = *pr;
+      if (r->epoch <= epoch) {
+        *pr = r->next;
+        ip_range_trie_free(r->t);
+        free(r);
+      } else {
+        pr = &(r->next);
+      }
+    }
   }
 }
 
+static void update_ip_list(const char *kind, ip_range_trie_t **current) {
+  ip_range_list_t *l = get_ip_list(kind);
+  ip_range_trie_t *old = *current;
+
+  ip_tries_reclaim();
+
+  if (!ip_range_trie_same(old, l)) {
+    ip_range_trie_t *t = ip_range_trie_build(l);
+    if (!t && l->ranges_number) {
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot compile the %s IP list\n", kind);
+    } else {
+      __atomic_store_n(current, t, __ATOMIC_RELEASE);
+      ip_trie_retire(old);
+    }
+  }
+
+  ip_list_free(l);
+}
+
 /////////////// add ACL record ///////////////////
 
 int add_ip_list_range(const char *range0, const char *realm, ip_range_list_t *list) {
@@ -1342,4 +1604,23 @@ void reread_realms(void) {
   }
 }
 
+void reread_db_changes(unsigned int changes) {
+  if (changes & DBD_CHANGE_REALMS) {
+    reread_realms();
+  }
+  if (changes & DBD_CHANGE_ALLOWED_PEER_IP) {
+    update_ip_list("allowed", &ipwhitelist);
+  }
+  if (changes & DBD_CHANGE_DENIED_PEER_IP) {
+    update_ip_list("denied", &ipblacklist);
+  }
+  if (changes & (DBD_CHANGE_REALMS | DBD_CHANGE_SECRETS)) {
+    check_auth_secrets_update();
+  }
+  if ((changes & DBD_CHANGE_USERS) && (turn_params.auth_cache_size > 0)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_INFO, "TURN users changed in the DB, the cached user keys are dropped\n");
+    auth_cache_invalidate_all();
+  }
+}
+
 ///////////////////////////////
@@ -41,6 +41,7 @@
 #include "ns_turn_utils.h"
 
 #include "apputils.h"
+#include "ns_auth_cache.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -97,6 +98,7 @@ struct auth_message {
   ioa_net_data in_buffer;
   uint64_t ctxkey;
   int success;
+  unsigned int cache_generation;
 };
 
 enum _TURN_USERDB_TYPE {
@@ -176,8 +178,6 @@ int change_user_quota(char *realm, int value);
 /////////////////////////////////////////////
 
 void init_secrets_list(secrets_list_t *sl);
-void init_dynamic_ip_lists(void);
-void update_white_and_black_lists(void);
 void clean_secrets_list(secrets_list_t *sl);
 size_t get_secrets_list_size(secrets_list_t *sl);
 const char *get_secrets_list_elem(secrets_list_t *sl, size_t i);
@@ -190,6 +190,15 @@ int get_user_key(int in_oauth, int *out_oauth, int *max_session_time, uint8_t *u
 uint8_t *start_user_check(turnserver_id id, turn_credential_type ct, int in_oauth, int *out_oauth, uint8_t *uname,
                           uint8_t *realm, get_username_resume_cb resume, ioa_net_data *in_buffer, uint64_t ctxkey,
                           int *postpone_reply);
+void cache_user_check_result(auth_cache *ac, const struct auth_message *am);
+/*
+ * Start the check of the user of the message with the asynchronous lookups
+ * of the database driver; answer is called with the result from the event
+ * base. Return: 0 if the message has to be checked with get_user_key().
+ */
+typedef void (*auth_message_answer_cb)(struct auth_message *am);
+int start_async_user_check(struct event_base *base, struct auth_message *am, auth_message_answer_cb answer);
+void check_auth_secrets_update(void);
 int check_new_allocation_quota(uint8_t *username, int oauth, uint8_t *realm);
 void release_allocation_quota(uint8_t *username, int oauth, uint8_t *realm);
 
@@ -201,6 +210,8 @@ void run_db_test(void);
 
 void auth_ping(redis_context_handle rch);
 void reread_realms(void);
+/* Reread the DB data of the given DBD_CHANGE_* kinds */
+void reread_db_changes(unsigned int changes);
 int add_static_user_account(char *user);
 int adminuser(uint8_t *user, uint8_t *realm, uint8_t *pwd, uint8_t *secret, uint8_t *origin, TURNADMIN_COMMAND_TYPE ct,
               perf_options_t *po, int is_admin);
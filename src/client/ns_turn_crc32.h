@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __LIB_TURN_CRC32__
+#define __LIB_TURN_CRC32__
+
+#include "ns_turn_defs.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+///////////////////////////////////////////
+
+/*
+ * CRC-32 (IEEE 802.3 polynomial), as used by the STUN FINGERPRINT attribute.
+ */
+
+typedef enum {
+  NS_CRC32_TABLE = 0, /* byte-at-a-time table, the reference implementation */
+  NS_CRC32_SLICE8,    /* portable slicing-by-8 */
+  NS_CRC32_PCLMUL,    /* x86-64 PCLMULQDQ folding */
+  NS_CRC32_ARMV8,     /* ARMv8 CRC32 instructions */
+  NS_CRC32_IMPL_NUMBER
+} ns_crc32_impl;
+
+/* CRC of the buffer with the best implementation supported by the CPU */
+uint32_t ns_crc32(const uint8_t *buf, size_t len);
+
+/* Implementation selected by ns_crc32() */
+ns_crc32_impl ns_crc32_get_impl(void);
+
+bool ns_crc32_impl_available(ns_crc32_impl impl);
+const char *ns_crc32_impl_name(ns_crc32_impl impl);
+
+/* CRC with the given implementation; it must be available on this CPU */
+uint32_t ns_crc32_with(ns_crc32_impl impl, const uint8_t *buf, size_t len);
+
+///////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__LIB_TURN_CRC32__
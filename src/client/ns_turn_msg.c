@@ -29,6 +29,7 @@
  */
 
 #include "ns_turn_msg.h"
+#include "ns_turn_crc32.h"
 #include "ns_turn_msg_addr.h"
 
 ///////////// Security functions implementation from ns_turn_msg.h ///////////
@@ -36,6 +37,10 @@
 #include "ns_turn_openssl.h"
 #include "ns_turn_utils.h"
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+
 ///////////
 
 #include <ctype.h> // for tolower
@@ -164,6 +169,124 @@ bool stun_calculate_hmac(const uint8_t *buf, size_t len, const uint8_t *key, siz
   return true;
 }
 
+////////////// Cached HMAC state ////////////////////
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+static const char *stun_hmac_digest_name(SHATYPE shatype) {
+  switch (shatype) {
+  case SHATYPE_SHA256:
+    return "SHA256";
+  case SHATYPE_SHA384:
+    return "SHA384";
+  case SHATYPE_SHA512:
+    return "SHA512";
+  default:
+    return "SHA1";
+  }
+}
+
+#else
+
+static const EVP_MD *stun_hmac_md(SHATYPE shatype) {
+  switch (shatype) {
+  case SHATYPE_SHA256:
+    return EVP_sha256();
+  case SHATYPE_SHA384:
+    return EVP_sha384();
+  case SHATYPE_SHA512:
+    return EVP_sha512();
+  default:
+    return EVP_sha1();
+  }
+}
+
+#endif
+
+void stun_hmac_ctx_clean(stun_hmac_ctx *hc) {
+  if (hc) {
+    if (hc->ctx) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+      EVP_MAC_CTX_free((EVP_MAC_CTX *)hc->ctx);
+#else
+      HMAC_CTX_free((HMAC_CTX *)hc->ctx);
+#endif
+    }
+    memset(hc, 0, sizeof(stun_hmac_ctx));
+  }
+}
+
+bool stun_hmac_ctx_set_key(stun_hmac_ctx *hc, const uint8_t *key, size_t keylen, SHATYPE shatype) {
+  if (!hc || !key || (keylen > sizeof(hc->key))) {
+    return false;
+  }
+
+  if (hc->ctx && (hc->shatype == shatype) && (hc->keylen == keylen) && !memcmp(hc->key, key, keylen)) {
+    return true;
+  }
+
+  stun_hmac_ctx_clean(hc);
+  ERR_clear_error();
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  EVP_MAC *mac = EVP_MAC_fetch(NULL, OSSL_MAC_NAME_HMAC, NULL);
+  EVP_MAC_CTX *ctx = mac ? EVP_MAC_CTX_new(mac) : NULL;
+  EVP_MAC_free(mac);
+  OSSL_PARAM params[2] = {
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)stun_hmac_digest_name(shatype), 0),
+      OSSL_PARAM_construct_end()};
+  if (!ctx || !EVP_MAC_init(ctx, key, keylen, params)) {
+    EVP_MAC_CTX_free(ctx);
+    return false;
+  }
+#else
+  HMAC_CTX *ctx = HMAC_CTX_new();
+  if (!ctx || !HMAC_Init_ex(ctx, key, (int)keylen, stun_hmac_md(shatype), NULL)) {
+    HMAC_CTX_free(ctx);
+    return false;
+  }
+#endif
+
+  hc->ctx = ctx;
+  hc->shatype = shatype;
+  hc->keylen = keylen;
+  memcpy(hc->key, key, keylen);
+
+  return true;
+}
+
+bool stun_hmac_ctx_calculate(stun_hmac_ctx *hc, const uint8_t *buf, size_t len, uint8_t *hmac, unsigned int *hmac_len) {
+  if (!hc || !(hc->ctx)) {
+    return false;
+  }
+
+  /* Re-initialization without a key restarts from the keyed state */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  EVP_MAC_CTX *ctx = (EVP_MAC_CTX *)hc->ctx;
+  size_t outl = 0;
+  if (!EVP_MAC_init(ctx, NULL, 0, NULL) || !EVP_MAC_update(ctx, buf, len) ||
+      !EVP_MAC_final(ctx, hmac, &outl, MAXSHASIZE)) {
+    return false;
+  }
+  *hmac_len = (unsigned int)outl;
+#else
+  HMAC_CTX *ctx = (HMAC_CTX *)hc->ctx;
+  if (!HMAC_Init_ex(ctx, NULL, 0, NULL, NULL) || !HMAC_Update(ctx, buf, len) || !HMAC_Final(ctx, hmac, hmac_len)) {
+    return false;
+  }
+#endif
+
+  return true;
+}
+
+static bool stun_calculate_hmac_cached(const uint8_t *buf, size_t len, const uint8_t *key, size_t keylen,
+                                       uint8_t *hmac, unsigned int *hmac_len, SHATYPE shatype, stun_hmac_ctx *hc) {
+  if (hc && stun_hmac_ctx_set_key(hc, key, keylen, shatype)) {
+    return stun_hmac_ctx_calculate(hc, buf, len, hmac, hmac_len);
+  }
+  return stun_calculate_hmac(buf, len, key, keylen, hmac, hmac_len, shatype);
+}
+
 bool stun_produce_integrity_key_str(const uint8_t *uname, const uint8_t *realm, const uint8_t *upwd, hmackey_t key,
                                     SHATYPE shatype) {
   bool ret;
@@ -333,8 +456,6 @@ bool check_password_equal(const char *pin, const char *pwd) {
 
 /////////////////////////////////////////////////////////////////
 
-static uint32_t ns_crc32(const uint8_t *buffer, uint32_t len);
-
 /////////////////////////////////////////////////////////////////
 
 int stun_get_command_message_len_str(const uint8_t *buf, size_t len) {
@@ -426,12 +547,8 @@ bool old_stun_is_command_message_str(const uint8_t *buf, size_t blen, uint32_t *
   return false;
 }
 
-bool stun_is_command_message_full_check_str(const uint8_t *buf, size_t blen, int must_check_fingerprint,
-                                            int *fingerprint_present) {
-  if (!stun_is_command_message_str(buf, blen)) {
-    return false;
-  }
-  stun_attr_ref sar = stun_attr_get_first_by_type_str(buf, blen, STUN_ATTRIBUTE_FINGERPRINT);
+static bool stun_check_fingerprint_str(const uint8_t *buf, size_t blen, stun_attr_ref sar, int must_check_fingerprint,
+                                      int *fingerprint_present) {
   if (!sar) {
     if (fingerprint_present) {
       *fingerprint_present = 0;
@@ -456,6 +573,24 @@ bool stun_is_command_message_full_check_str(const uint8_t *buf, size_t blen, int
   return ret;
 }
 
+bool stun_is_command_message_full_check_str(const uint8_t *buf, size_t blen, int must_check_fingerprint,
+                                            int *fingerprint_present) {
+  if (!stun_is_command_message_str(buf, blen)) {
+    return false;
+  }
+  return stun_check_fingerprint_str(buf, blen, stun_attr_get_first_by_type_str(buf, blen, STUN_ATTRIBUTE_FINGERPRINT),
+                                    must_check_fingerprint, fingerprint_present);
+}
+
+bool stun_is_command_message_full_check_idx(const stun_attr_index *idx, int must_check_fingerprint,
+                                            int *fingerprint_present) {
+  if (!stun_is_command_message_str(idx->buf, idx->len)) {
+    return false;
+  }
+  return stun_check_fingerprint_str(idx->buf, idx->len, stun_attr_index_get(idx, STUN_ATTRIBUTE_FINGERPRINT),
+                                    must_check_fingerprint, fingerprint_present);
+}
+
 bool stun_is_request_str(const uint8_t *buf, size_t len) {
   if (is_channel_msg_str(buf, len)) {
     return false;
@@ -1434,6 +1569,105 @@ stun_attr_ref stun_attr_get_next_str(const uint8_t *buf, size_t len, stun_attr_r
   }
 }
 
+///////////// Attribute index ////////////////////////////////////
+
+static int stun_attr_index_slot(uint16_t attr_type) {
+  switch (attr_type) {
+  case STUN_ATTRIBUTE_USERNAME:
+    return 0;
+  case STUN_ATTRIBUTE_MESSAGE_INTEGRITY:
+    return 1;
+  case STUN_ATTRIBUTE_REALM:
+    return 2;
+  case STUN_ATTRIBUTE_NONCE:
+    return 3;
+  case STUN_ATTRIBUTE_FINGERPRINT:
+    return 4;
+  case STUN_ATTRIBUTE_LIFETIME:
+    return 5;
+  case STUN_ATTRIBUTE_XOR_PEER_ADDRESS:
+    return 6;
+  case STUN_ATTRIBUTE_CHANNEL_NUMBER:
+    return 7;
+  case STUN_ATTRIBUTE_DATA:
+    return 8;
+  case STUN_ATTRIBUTE_REQUESTED_TRANSPORT:
+    return 9;
+  case STUN_ATTRIBUTE_ORIGIN:
+    return 10;
+  case STUN_ATTRIBUTE_THIRD_PARTY_AUTHORIZATION:
+    return 11;
+  default:
+    return -1;
+  }
+}
+
+static inline size_t stun_attr_padded_len(stun_attr_ref attr) {
+  return ((size_t)stun_attr_get_len(attr) + 3) & ~((size_t)3);
+}
+
+/* Same validation as stun_attr_get_first_str() / stun_attr_get_next_str(): the walk stops at a truncated attribute */
+bool stun_attr_index_init(stun_attr_index *idx, const uint8_t *buf, size_t len) {
+  memset(idx, 0, sizeof(stun_attr_index));
+  idx->buf = buf;
+  idx->len = len;
+  idx->end = buf;
+
+  int bufLen = buf ? stun_get_command_message_len_str(buf, len) : -1;
+  if (bufLen < STUN_HEADER_LENGTH) {
+    return false;
+  }
+
+  const uint8_t *end = buf + bufLen;
+  const uint8_t *attr = buf + STUN_HEADER_LENGTH;
+
+  while (end - attr >= 4) {
+    size_t attrlen = stun_attr_padded_len(attr);
+    if (attrlen > (size_t)(end - attr - 4)) {
+      break;
+    }
+    int slot = stun_attr_index_slot((uint16_t)stun_attr_get_type(attr));
+    if ((slot >= 0) && !(idx->first[slot])) {
+      idx->first[slot] = (uint32_t)(attr - buf);
+    }
+    attr += 4 + attrlen;
+  }
+
+  idx->end = attr;
+
+  return true;
+}
+
+stun_attr_ref stun_attr_index_get(const stun_attr_index *idx, uint16_t attr_type) {
+  int slot = stun_attr_index_slot(attr_type);
+  if (slot >= 0) {
+    return idx->first[slot] ? (stun_attr_ref)(idx->buf + idx->first[slot]) : NULL;
+  }
+
+  for (stun_attr_ref attr = stun_attr_index_first(idx); attr; attr = stun_attr_index_next(idx, attr)) {
+    if (stun_attr_get_type(attr) == attr_type) {
+      return attr;
+    }
+  }
+
+  return NULL;
+}
+
+stun_attr_ref stun_attr_index_first(const stun_attr_index *idx) {
+  const uint8_t *attr = idx->buf + STUN_HEADER_LENGTH;
+  return (attr < idx->end) ? (stun_attr_ref)attr : NULL;
+}
+
+stun_attr_ref stun_attr_index_next(const stun_attr_index *idx, stun_attr_ref prev) {
+  if (!prev) {
+    return stun_attr_index_first(idx);
+  }
+  const uint8_t *attr = (const uint8_t *)prev + 4 + stun_attr_padded_len(prev);
+  return (attr < idx->end) ? (stun_attr_ref)attr : NULL;
+}
+
+//////////////////////////////////////////////////////////////////
+
 bool stun_attr_add_str(uint8_t *buf, size_t *len, uint16_t attr, const uint8_t *avalue, int alen) {
   if (alen < 0) {
     alen = 0;
@@ -1634,52 +1868,6 @@ bool stun_attr_add_fingerprint_str(uint8_t *buf, size_t *len) {
   *((uint32_t *)(buf + *len - 4)) = nswap32(crc32 ^ ((uint32_t)FINGERPRINT_XOR));
   return true;
 }
-////////////// CRC ///////////////////////////////////////////////
-
-#define CRC_MASK 0xFFFFFFFFUL
-
-#define UPDATE_CRC(crc, c) crc = crctable[(uint8_t)crc ^ (uint8_t)(c)] ^ (crc >> 8)
-
-static const uint32_t crctable[256] = {
-    0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3, 0x0edb8832,
-    0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2,
-    0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7, 0x136c9856, 0x646ba8c0, 0xfd62f97a,
-    0x8a65c9ec, 0x14015c4f, 0x63066cd9, 0xfa0f3d63, 0x8d080df5, 0x3b6e20c8, 0x4c69105e, 0xd56041e4, 0xa2677172,
-    0x3c03e4d1, 0x4b04d447, 0xd20d85fd, 0xa50ab56b, 0x35b5a8fa, 0x42b2986c, 0xdbbbc9d6, 0xacbcf940, 0x32d86ce3,
-    0x45df5c75, 0xdcd60dcf, 0xabd13d59, 0x26d930ac, 0x51de003a, 0xc8d75180, 0xbfd06116, 0x21b4f4b5, 0x56b3c423,
-    0xcfba9599, 0xb8bda50f, 0x2802b89e, 0x5f058808, 0xc60cd9b2, 0xb10be924, 0x2f6f7c87, 0x58684c11, 0xc1611dab,
-    0xb6662d3d, 0x76dc4190, 0x01db7106, 0x98d220bc, 0xefd5102a, 0x71b18589, 0x06b6b51f, 0x9fbfe4a5, 0xe8b8d433,
-    0x7807c9a2, 0x0f00f934, 0x9609a88e, 0xe10e9818, 0x7f6a0dbb, 0x086d3d2d, 0x91646c97, 0xe6635c01, 0x6b6b51f4,
-    0x1c6c6162, 0x856530d8, 0xf262004e, 0x6c0695ed, 0x1b01a57b, 0x8208f4c1, 0xf50fc457, 0x65b0d9c6, 0x12b7e950,
-    0x8bbeb8ea, 0xfcb9887c, 0x62dd1ddf, 0x15da2d49, 0x8cd37cf3, 0xfbd44c65, 0x4db26158, 0x3ab551ce, 0xa3bc0074,
-    0xd4bb30e2, 0x4adfa541, 0x3dd895d7, 0xa4d1c46d, 0xd3d6f4fb, 0x4369e96a, 0x346ed9fc, 0xad678846, 0xda60b8d0,
-    0x44042d73, 0x33031de5, 0xaa0a4c5f, 0xdd0d7cc9, 0x5005713c, 0x270241aa, 0xbe0b1010, 0xc90c2086, 0x5768b525,
-    0x206f85b3, 0xb966d409, 0xce61e49f, 0x5edef90e, 0x29d9c998, 0xb0d09822, 0xc7d7a8b4, 0x59b33d17, 0x2eb40d81,
-    0xb7bd5c3b, 0xc0ba6cad, 0xedb88320, 0x9abfb3b6, 0x03b6e20c, 0x74b1d29a, 0xead54739, 0x9dd277af, 0x04db2615,
-    0x73dc1683, 0xe3630b12, 0x94643b84, 0x0d6d6a3e, 0x7a6a5aa8, 0xe40ecf0b, 0x9309ff9d, 0x0a00ae27, 0x7d079eb1,
-    0xf00f9344, 0x8708a3d2, 0x1e01f268, 0x6906c2fe, 0xf762575d, 0x806567cb, 0x196c3671, 0x6e6b06e7, 0xfed41b76,
-    0x89d32be0, 0x10da7a5a, 0x67dd4acc, 0xf9b9df6f, 0x8ebeeff9, 0x17b7be43, 0x60b08ed5, 0xd6d6a3e8, 0xa1d1937e,
-    0x38d8c2c4, 0x4fdff252, 0xd1bb67f1, 0xa6bc5767, 0x3fb506dd, 0x48b2364b, 0xd80d2bda, 0xaf0a1b4c, 0x36034af6,
-    0x41047a60, 0xdf60efc3, 0xa867df55, 0x316e8eef, 0x4669be79, 0xcb61b38c, 0xbc66831a, 0x256fd2a0, 0x5268e236,
-    0xcc0c7795, 0xbb0b4703, 0x220216b9, 0x5505262f, 0xc5ba3bbe, 0xb2bd0b28, 0x2bb45a92, 0x5cb36a04, 0xc2d7ffa7,
-    0xb5d0cf31, 0x2cd99e8b, 0x5bdeae1d, 0x9b64c2b0, 0xec63f226, 0x756aa39c, 0x026d930a, 0x9c0906a9, 0xeb0e363f,
-    0x72076785, 0x05005713, 0x95bf4a82, 0xe2b87a14, 0x7bb12bae, 0x0cb61b38, 0x92d28e9b, 0xe5d5be0d, 0x7cdcefb7,
-    0x0bdbdf21, 0x86d3d2d4, 0xf1d4e242, 0x68ddb3f8, 0x1fda836e, 0x81be16cd, 0xf6b9265b, 0x6fb077e1, 0x18b74777,
-    0x88085ae6, 0xff0f6a70, 0x66063bca, 0x11010b5c, 0x8f659eff, 0xf862ae69, 0x616bffd3, 0x166ccf45, 0xa00ae278,
-    0xd70dd2ee, 0x4e048354, 0x3903b3c2, 0xa7672661, 0xd06016f7, 0x4969474d, 0x3e6e77db, 0xaed16a4a, 0xd9d65adc,
-    0x40df0b66, 0x37d83bf0, 0xa9bcae53, 0xdebb9ec5, 0x47b2cf7f, 0x30b5ffe9, 0xbdbdf21c, 0xcabac28a, 0x53b39330,
-    0x24b4a3a6, 0xbad03605, 0xcdd70693, 0x54de5729, 0x23d967bf, 0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94,
-    0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d,
-};
-
-static uint32_t ns_crc32(const uint8_t *buffer, uint32_t len) {
-  uint32_t crc = CRC_MASK;
-  while (len--) {
-    UPDATE_CRC(crc, *buffer++);
-  }
-  return (~crc);
-}
-
 //////////// SASLprep RFC 4013 /////////////////////////////////////////
 
 /* We support only basic ASCII table */
@@ -1749,6 +1937,11 @@ void print_bin_func(const char *name, size_t len, const void *s, const char *fun
 
 bool stun_attr_add_integrity_str(turn_credential_type ct, uint8_t *buf, size_t *len, hmackey_t key, password_t pwd,
                                  SHATYPE shatype) {
+  return stun_attr_add_integrity_ctx_str(ct, buf, len, key, pwd, shatype, NULL);
+}
+
+bool stun_attr_add_integrity_ctx_str(turn_credential_type ct, uint8_t *buf, size_t *len, hmackey_t key, password_t pwd,
+                                     SHATYPE shatype, stun_hmac_ctx *hc) {
   uint8_t hmac[MAXSHASIZE];
 
   unsigned int shasize;
@@ -1772,11 +1965,11 @@ bool stun_attr_add_integrity_str(turn_credential_type ct, uint8_t *buf, size_t *
   }
 
   if (ct == TURN_CREDENTIALS_SHORT_TERM) {
-    return stun_calculate_hmac(buf, *len - 4 - shasize, pwd, strlen((char *)pwd), buf + *len - shasize, &shasize,
-                               shatype);
+    return stun_calculate_hmac_cached(buf, *len - 4 - shasize, pwd, strlen((char *)pwd), buf + *len - shasize,
+                                      &shasize, shatype, hc);
   } else {
-    return stun_calculate_hmac(buf, *len - 4 - shasize, key, get_hmackey_size(shatype), buf + *len - shasize, &shasize,
-                               shatype);
+    return stun_calculate_hmac_cached(buf, *len - 4 - shasize, key, get_hmackey_size(shatype), buf + *len - shasize,
+                                      &shasize, shatype, hc);
   }
 }
 
@@ -1825,6 +2018,11 @@ bool stun_attr_add_integrity_by_user_short_term_str(uint8_t *buf, size_t *len, c
 int stun_check_message_integrity_by_key_str(turn_credential_type ct, uint8_t *buf, size_t len, hmackey_t key,
                                             password_t pwd, SHATYPE shatype) {
   stun_attr_ref sar = stun_attr_get_first_by_type_str(buf, len, STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+  return stun_check_message_integrity_by_key_attr_str(ct, buf, len, sar, key, pwd, shatype, NULL);
+}
+
+int stun_check_message_integrity_by_key_attr_str(turn_credential_type ct, uint8_t *buf, size_t len, stun_attr_ref sar,
+                                                 hmackey_t key, password_t pwd, SHATYPE shatype, stun_hmac_ctx *hc) {
   if (!sar) {
     return -1;
   }
@@ -1876,15 +2074,15 @@ int stun_check_message_integrity_by_key_str(turn_credential_type ct, uint8_t *bu
   int res = 0;
   uint8_t new_hmac[MAXSHASIZE] = {0};
   if (ct == TURN_CREDENTIALS_SHORT_TERM) {
-    if (!stun_calculate_hmac(buf, (size_t)new_len - 4 - shasize, pwd, strlen((char *)pwd), new_hmac, &shasize,
-                             shatype)) {
+    if (!stun_calculate_hmac_cached(buf, (size_t)new_len - 4 - shasize, pwd, strlen((char *)pwd), new_hmac, &shasize,
+                                    shatype, hc)) {
       res = -1;
     } else {
       res = 0;
     }
   } else {
-    if (!stun_calculate_hmac(buf, (size_t)new_len - 4 - shasize, key, get_hmackey_size(shatype), new_hmac, &shasize,
-                             shatype)) {
+    if (!stun_calculate_hmac_cached(buf, (size_t)new_len - 4 - shasize, key, get_hmackey_size(shatype), new_hmac,
+                                    &shasize, shatype, hc)) {
       res = -1;
     } else {
       res = 0;
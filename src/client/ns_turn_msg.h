@@ -69,10 +69,37 @@ typedef uint8_t hmackey_t[64];
 typedef uint8_t password_t[STUN_MAX_PWD_SIZE + 1];
 typedef unsigned long band_limit_t;
 
+/**
+ * Keyed HMAC state, computed once per key: every message restarts the MAC
+ * from the precomputed inner/outer pads instead of deriving them again.
+ * Not thread-safe; a session owns its own context.
+ */
+typedef struct _stun_hmac_ctx {
+  void *ctx;
+  SHATYPE shatype;
+  size_t keylen;
+  hmackey_t key;
+} stun_hmac_ctx;
+
 ///////////////////////////////////
 
 typedef const void *stun_attr_ref;
 
+/*
+ * Attribute index: the attributes of a message are walked and validated
+ * once, and the first attribute of each type in stun_attr_index_slot() is
+ * recorded, so the lookups by type do not rescan the message.
+ * The index points into the message buffer.
+ */
+#define STUN_ATTR_INDEX_SLOTS (12)
+
+typedef struct _stun_attr_index {
+  const uint8_t *buf;
+  size_t len;
+  const uint8_t *end; /* end of the last well-formed attribute */
+  uint32_t first[STUN_ATTR_INDEX_SLOTS]; /* attribute offset, 0 - none */
+} stun_attr_index;
+
 //////////////////////////////////////////////////////////////
 
 bool stun_tid_equals(const stun_tid *id1, const stun_tid *id2);
@@ -115,6 +142,8 @@ bool stun_is_command_message_str(const uint8_t *buf, size_t blen);
 bool old_stun_is_command_message_str(const uint8_t *buf, size_t blen, uint32_t *cookie);
 bool stun_is_command_message_full_check_str(const uint8_t *buf, size_t blen, int must_check_fingerprint,
                                             int *fingerprint_present);
+bool stun_is_command_message_full_check_idx(const stun_attr_index *idx, int must_check_fingerprint,
+                                            int *fingerprint_present);
 bool stun_is_request_str(const uint8_t *buf, size_t len);
 bool stun_is_success_response_str(const uint8_t *buf, size_t len);
 bool stun_is_error_response_str(const uint8_t *buf, size_t len, int *err_code, uint8_t *err_msg, size_t err_msg_size);
@@ -154,6 +183,11 @@ uint64_t stun_attr_get_reservation_token_value(stun_attr_ref attr);
 stun_attr_ref stun_attr_get_first_by_type_str(const uint8_t *buf, size_t len, uint16_t attr_type);
 stun_attr_ref stun_attr_get_first_str(const uint8_t *buf, size_t len);
 stun_attr_ref stun_attr_get_next_str(const uint8_t *buf, size_t len, stun_attr_ref prev);
+/* Return false if the buffer does not hold a whole STUN message */
+bool stun_attr_index_init(stun_attr_index *idx, const uint8_t *buf, size_t len);
+stun_attr_ref stun_attr_index_get(const stun_attr_index *idx, uint16_t attr_type);
+stun_attr_ref stun_attr_index_first(const stun_attr_index *idx);
+stun_attr_ref stun_attr_index_next(const stun_attr_index *idx, stun_attr_ref prev);
 bool stun_attr_add_str(uint8_t *buf, size_t *len, uint16_t attr, const uint8_t *avalue, int alen);
 bool stun_attr_add_addr_str(uint8_t *buf, size_t *len, uint16_t attr_type, const ioa_addr *ca);
 bool stun_attr_get_addr_str(const uint8_t *buf, size_t len, stun_attr_ref attr, ioa_addr *ca,
@@ -191,10 +225,18 @@ void print_bin_func(const char *name, size_t len, const void *s, const char *fun
  */
 int stun_check_message_integrity_by_key_str(turn_credential_type ct, uint8_t *buf, size_t len, hmackey_t key,
                                             password_t pwd, SHATYPE shatype);
+/*
+ * The same, with the MESSAGE-INTEGRITY attribute already found.
+ * hc (may be NULL) caches the keyed HMAC state between the calls.
+ */
+int stun_check_message_integrity_by_key_attr_str(turn_credential_type ct, uint8_t *buf, size_t len, stun_attr_ref sar,
+                                                 hmackey_t key, password_t pwd, SHATYPE shatype, stun_hmac_ctx *hc);
 int stun_check_message_integrity_str(turn_credential_type ct, uint8_t *buf, size_t len, const uint8_t *uname,
                                      const uint8_t *realm, const uint8_t *upwd, SHATYPE shatype);
 bool stun_attr_add_integrity_str(turn_credential_type ct, uint8_t *buf, size_t *len, hmackey_t key, password_t pwd,
                                  SHATYPE shatype);
+bool stun_attr_add_integrity_ctx_str(turn_credential_type ct, uint8_t *buf, size_t *len, hmackey_t key, password_t pwd,
+                                     SHATYPE shatype, stun_hmac_ctx *hc);
 bool stun_attr_add_integrity_by_key_str(uint8_t *buf, size_t *len, const uint8_t *uname, const uint8_t *realm,
                                         hmackey_t key, const uint8_t *nonce, SHATYPE shatype);
 bool stun_attr_add_integrity_by_user_str(uint8_t *buf, size_t *len, const uint8_t *uname, const uint8_t *realm,
@@ -216,6 +258,11 @@ bool stun_produce_integrity_key_str(const uint8_t *uname, const uint8_t *realm,
 bool stun_calculate_hmac(const uint8_t *buf, size_t len, const uint8_t *key, size_t sz, uint8_t *hmac,
                          unsigned int *hmac_len, SHATYPE shatype);
 
+/* (Re)key the context; does nothing when the key and the SHA type are unchanged */
+bool stun_hmac_ctx_set_key(stun_hmac_ctx *hc, const uint8_t *key, size_t keylen, SHATYPE shatype);
+bool stun_hmac_ctx_calculate(stun_hmac_ctx *hc, const uint8_t *buf, size_t len, uint8_t *hmac, unsigned int *hmac_len);
+void stun_hmac_ctx_clean(stun_hmac_ctx *hc);
+
 /* RFC 5780 */
 bool stun_attr_get_change_request_str(stun_attr_ref attr, bool *change_ip, bool *change_port);
 bool stun_attr_add_change_request_str(uint8_t *buf, size_t *len, bool change_ip, bool change_port);
@@ -36,11 +36,16 @@
 #include <stdlib.h> // for NULL, size_t, free, realloc, calloc
 #include <string.h> // for memset, memcpy
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /////////////// Permission forward declarations /////////////////
 
-static void init_turn_permission_hashtable(turn_permission_hashtable *map);
-static void free_turn_permission_hashtable(turn_permission_hashtable *map);
-static turn_permission_info *get_from_turn_permission_hashtable(turn_permission_hashtable *map, const ioa_addr *addr);
+static void init_turn_permission_table(turn_permission_table *map);
+static void free_turn_permission_table(turn_permission_table *map);
+static turn_permission_info *get_from_turn_permission_table(const turn_permission_table *map, const ioa_addr *addr);
+static void del_from_turn_permission_table(turn_permission_table *map, turn_permission_info *tinfo);
 
 /////////////// ALLOCATION //////////////////////////////////////
 
@@ -49,7 +54,7 @@ void init_allocation(void *owner, allocation *a, ur_map *tcp_connections) {
     memset(a, 0, sizeof(allocation));
     a->owner = owner;
     a->tcp_connections = tcp_connections;
-    init_turn_permission_hashtable(&(a->addr_to_perm));
+    init_turn_permission_table(&(a->addr_to_perm));
   }
 }
 
@@ -82,7 +87,7 @@ void clear_allocation(allocation *a, SOCKET_TYPE socket_type) {
   }
 
   /* The order is important here: */
-  free_turn_permission_hashtable(&(a->addr_to_perm));
+  free_turn_permission_table(&(a->addr_to_perm));
   ch_map_clean(&(a->chns));
 
   a->is_valid = 0;
@@ -163,7 +168,7 @@ void set_allocation_valid(allocation *a, bool value) {
 
 turn_permission_info *allocation_get_permission(allocation *a, const ioa_addr *addr) {
   if (a) {
-    return get_from_turn_permission_hashtable(&(a->addr_to_perm), addr);
+    return get_from_turn_permission_table(&(a->addr_to_perm), addr);
   }
   return NULL;
 }
@@ -172,11 +177,7 @@ turn_permission_info *allocation_get_permission(allocation *a, const ioa_addr *a
 
 static bool delete_channel_info_from_allocation_map(ur_map_key_type key, ur_map_value_type value);
 
-void turn_permission_clean(turn_permission_info *tinfo) {
-  if (!tinfo || !tinfo->allocated) {
-    return;
-  }
-
+static void turn_permission_info_clean(turn_permission_info *tinfo) {
   if (tinfo->verbose) {
     char s[257] = "\0";
     addr_to_string(&(tinfo->addr), (uint8_t *)s);
@@ -190,74 +191,170 @@ void turn_permission_clean(turn_permission_info *tinfo) {
   IOA_EVENT_DEL(tinfo->lifetime_ev);
   lm_map_foreach(&(tinfo->chns), (foreachcb_type)delete_channel_info_from_allocation_map);
   lm_map_clean(&(tinfo->chns));
-  memset(tinfo, 0, sizeof(turn_permission_info));
 }
 
-static void init_turn_permission_hashtable(turn_permission_hashtable *map) {
+/* Deletes the permission with its channels; tinfo is freed */
+void turn_permission_clean(turn_permission_info *tinfo) {
+  if (!tinfo || !tinfo->allocated) {
+    return;
+  }
+
+  turn_permission_info_clean(tinfo);
+
+  allocation *a = (allocation *)tinfo->owner;
+  if (a) {
+    del_from_turn_permission_table(&(a->addr_to_perm), tinfo);
+  } else {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "!!! %s: strange (2) permission to be cleaned: no allocation\n", __FUNCTION__);
+    memset(tinfo, 0, sizeof(turn_permission_info));
+  }
+}
+
+static void init_turn_permission_table(turn_permission_table *map) {
   if (map) {
-    memset(map, 0, sizeof(turn_permission_hashtable));
+    memset(map, 0, sizeof(turn_permission_table));
   }
 }
 
-static void free_turn_permission_hashtable(turn_permission_hashtable *map) {
+static void free_turn_permission_table(turn_permission_table *map) {
   if (!map) {
     return;
   }
 
-  for (size_t i = 0; i < TURN_PERMISSION_HASHTABLE_SIZE; ++i) {
+  for (size_t i = 0; i < map->sz4; ++i) {
+    turn_permission_info_clean(map->infos4[i]);
+    free(map->infos4[i]);
+  }
+  for (size_t i = 0; i < map->sz6; ++i) {
+    turn_permission_info_clean(map->infos6[i]);
+    free(map->infos6[i]);
+  }
 
-    turn_permission_array *parray = &(map->table[i]);
+  free(map->keys4);
+  free(map->keys6);
+  free(map->infos4);
+  free(map->infos6);
+  init_turn_permission_table(map);
+}
 
-    for (size_t j = 0; j < TURN_PERMISSION_ARRAY_SIZE; ++j) {
-      turn_permission_slot *slot = &(parray->main_slots[j]);
-      if (slot->info.allocated) {
-        turn_permission_clean(&(slot->info));
-      }
+size_t turn_permission_table_size(const turn_permission_table *map) { return map ? (map->sz4 + map->sz6) : 0; }
+
+turn_permission_info *turn_permission_table_get(const turn_permission_table *map, size_t i) {
+  if (map) {
+    if (i < map->sz4) {
+      return map->infos4[i];
+    }
+    i -= map->sz4;
+    if (i < map->sz6) {
+      return map->infos6[i];
     }
+  }
+  return NULL;
+}
 
-    if (parray->extra_slots) {
-      for (size_t j = 0; j < parray->extra_sz; ++j) {
-        turn_permission_slot *slot = parray->extra_slots[j];
-        if (slot) {
-          if (slot->info.allocated) {
-            turn_permission_clean(&(slot->info));
-          }
-          free(slot);
-          parray->extra_slots[j] = NULL;
-        }
-      }
-      free(parray->extra_slots);
-      parray->extra_slots = NULL;
+static inline turn_permission_key6 turn_permission_key6_from_addr(const ioa_addr *addr) {
+  turn_permission_key6 key;
+  memcpy(&key, &(addr->s6.sin6_addr), sizeof(key));
+  return key;
+}
+
+/* Index of the IPv4 key in keys, or -1 */
+static inline ssize_t turn_permission_find4(const uint32_t *keys, size_t sz, uint32_t key) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i k = _mm_set1_epi32((int)key);
+  for (; i + 4 <= sz; i += 4) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)(keys + i));
+    const int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, k)));
+    if (m) {
+      return (ssize_t)(i + (size_t)__builtin_ctz((unsigned int)m));
     }
-    parray->extra_sz = 0;
   }
+#endif
+  for (; i < sz; ++i) {
+    if (keys[i] == key) {
+      return (ssize_t)i;
+    }
+  }
+  return -1;
+}
+
+/* Index of the IPv6 key in keys, or -1; a key is compared as two 64-bit words */
+static inline ssize_t turn_permission_find6(const turn_permission_key6 *keys, size_t sz, turn_permission_key6 key) {
+  for (size_t i = 0; i < sz; ++i) {
+    if (((keys[i].w[0] ^ key.w[0]) | (keys[i].w[1] ^ key.w[1])) == 0) {
+      return (ssize_t)i;
+    }
+  }
+  return -1;
 }
 
-static turn_permission_info *get_from_turn_permission_hashtable(turn_permission_hashtable *map, const ioa_addr *addr) {
+static turn_permission_info *get_from_turn_permission_table(const turn_permission_table *map, const ioa_addr *addr) {
   if (!addr || !map) {
     return NULL;
   }
 
-  uint32_t index = addr_hash_no_port(addr) & (TURN_PERMISSION_HASHTABLE_SIZE - 1);
-  turn_permission_array *parray = &(map->table[index]);
+  if (addr->ss.sa_family == AF_INET) {
+    const ssize_t i = turn_permission_find4(map->keys4, map->sz4, addr->s4.sin_addr.s_addr);
+    return (i < 0) ? NULL : map->infos4[i];
+  } else if (addr->ss.sa_family == AF_INET6) {
+    const ssize_t i = turn_permission_find6(map->keys6, map->sz6, turn_permission_key6_from_addr(addr));
+    return (i < 0) ? NULL : map->infos6[i];
+  }
+
+  return NULL;
+}
+
+/* Makes room for one more entry in the family arrays */
+static bool turn_permission_table_reserve(void **keys, turn_permission_info ***infos, size_t *capacity, size_t sz,
+                                          size_t key_size) {
+  if (sz < *capacity) {
+    return true;
+  }
+
+  const size_t new_capacity = *capacity ? (*capacity << 1) : TURN_PERMISSION_TABLE_MIN_SIZE;
 
-  for (size_t i = 0; i < TURN_PERMISSION_ARRAY_SIZE; ++i) {
-    turn_permission_slot *slot = &(parray->main_slots[i]);
-    if (slot->info.allocated && addr_eq_no_port(&(slot->info.addr), addr)) {
-      return &(slot->info);
+  void *new_keys = realloc(*keys, new_capacity * key_size);
+  if (!new_keys) {
+    return false;
+  }
+  *keys = new_keys;
+
+  turn_permission_info **new_infos =
+      (turn_permission_info **)realloc(*infos, new_capacity * sizeof(turn_permission_info *));
+  if (!new_infos) {
+    return false;
+  }
+  *infos = new_infos;
+
+  *capacity = new_capacity;
+  return true;
+}
+
+/* Removes the permission from the table and frees it */
+static void del_from_turn_permission_table(turn_permission_table *map, turn_permission_info *tinfo) {
+  for (size_t i = 0; i < map->sz4; ++i) {
+    if (map->infos4[i] == tinfo) {
+      --(map->sz4);
+      map->keys4[i] = map->keys4[map->sz4];
+      map->infos4[i] = map->infos4[map->sz4];
+      free(tinfo);
+      return;
     }
   }
 
-  if (parray->extra_slots) {
-    for (size_t i = 0; i < parray->extra_sz; ++i) {
-      turn_permission_slot *slot = parray->extra_slots[i];
-      if (slot->info.allocated && addr_eq_no_port(&(slot->info.addr), addr)) {
-        return &(slot->info);
-      }
+  for (size_t i = 0; i < map->sz6; ++i) {
+    if (map->infos6[i] == tinfo) {
+      --(map->sz6);
+      map->keys6[i] = map->keys6[map->sz6];
+      map->infos6[i] = map->infos6[map->sz6];
+      free(tinfo);
+      return;
     }
   }
 
-  return NULL;
+  TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "!!! %s: permission to be cleaned is not in the table\n", __FUNCTION__);
+  memset(tinfo, 0, sizeof(turn_permission_info));
 }
 
 static void ch_info_clean(ch_info *c) {
@@ -281,6 +378,11 @@ static bool delete_channel_info_from_allocation_map(ur_map_key_type key, ur_map_
       TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "!!! %s: strange (0) channel to be cleaned: chnum<1\n", __FUNCTION__);
     }
 
+    turn_permission_info *tinfo = (turn_permission_info *)chn->owner;
+    if (tinfo && tinfo->owner) {
+      ch_map_del(&(((allocation *)tinfo->owner)->chns), chn);
+    }
+
     ch_info_clean(chn);
   }
 
@@ -316,7 +418,7 @@ ch_info *allocation_get_new_ch_info(allocation *a, uint16_t chnum, ioa_addr *pee
     return NULL;
   }
 
-  turn_permission_info *tinfo = get_from_turn_permission_hashtable(&(a->addr_to_perm), peer_addr);
+  turn_permission_info *tinfo = get_from_turn_permission_table(&(a->addr_to_perm), peer_addr);
   if (!tinfo) {
     tinfo = allocation_add_permission(a, peer_addr);
     if (!tinfo) {
@@ -324,15 +426,11 @@ ch_info *allocation_get_new_ch_info(allocation *a, uint16_t chnum, ioa_addr *pee
     }
   }
 
-  ch_info *chn = ch_map_get(&(a->chns), chnum, 1);
+  ch_info *chn = ch_map_add(&(a->chns), chnum, peer_addr);
   if (!chn) {
     return NULL;
   }
 
-  chn->allocated = true;
-  chn->chnum = chnum;
-  chn->port = addr_get_port(peer_addr);
-  addr_cpy(&(chn->peer_addr), peer_addr);
   chn->owner = tinfo;
 
   lm_map_put(&(tinfo->chns), (ur_map_key_type)addr_get_port(peer_addr), (ur_map_value_type)chn);
@@ -340,14 +438,10 @@ ch_info *allocation_get_new_ch_info(allocation *a, uint16_t chnum, ioa_addr *pee
   return chn;
 }
 
-ch_info *allocation_get_ch_info(allocation *a, uint16_t chnum) { return ch_map_get(&(a->chns), chnum, 0); }
+ch_info *allocation_get_ch_info(allocation *a, uint16_t chnum) { return ch_map_get(&(a->chns), chnum); }
 
 ch_info *allocation_get_ch_info_by_peer_addr(allocation *a, ioa_addr *peer_addr) {
-  turn_permission_info *tinfo = get_from_turn_permission_hashtable(&(a->addr_to_perm), peer_addr);
-  if (tinfo) {
-    return get_turn_channel(tinfo, peer_addr);
-  }
-  return NULL;
+  return ch_map_get_by_peer(&(a->chns), peer_addr);
 }
 
 uint16_t get_turn_channel_number(turn_permission_info *tinfo, ioa_addr *addr) {
@@ -378,160 +472,309 @@ ch_info *get_turn_channel(turn_permission_info *tinfo, ioa_addr *addr) {
   return NULL;
 }
 
-turn_permission_hashtable *allocation_get_turn_permission_hashtable(allocation *a) { return &(a->addr_to_perm); }
+turn_permission_table *allocation_get_turn_permission_table(allocation *a) { return &(a->addr_to_perm); }
 
 turn_permission_info *allocation_add_permission(allocation *a, const ioa_addr *addr) {
   if (!a || !addr) {
     return NULL;
   }
 
-  turn_permission_hashtable *map = &(a->addr_to_perm);
-  uint32_t hash = addr_hash_no_port(addr);
-  size_t fds = (size_t)(hash & (TURN_PERMISSION_HASHTABLE_SIZE - 1));
+  turn_permission_table *map = &(a->addr_to_perm);
+
+  if (addr->ss.sa_family == AF_INET) {
+    if (!turn_permission_table_reserve((void **)&(map->keys4), &(map->infos4), &(map->capacity4), map->sz4,
+                                       sizeof(uint32_t))) {
+      return NULL;
+    }
+  } else if (addr->ss.sa_family == AF_INET6) {
+    if (!turn_permission_table_reserve((void **)&(map->keys6), &(map->infos6), &(map->capacity6), map->sz6,
+                                       sizeof(turn_permission_key6))) {
+      return NULL;
+    }
+  } else {
+    return NULL;
+  }
+
+  turn_permission_info *elem = (turn_permission_info *)calloc(1, sizeof(turn_permission_info));
+  if (!elem) {
+    return NULL;
+  }
+  elem->allocated = true;
+  addr_cpy(&(elem->addr), addr);
+  elem->owner = a;
+
+  if (addr->ss.sa_family == AF_INET) {
+    map->keys4[map->sz4] = addr->s4.sin_addr.s_addr;
+    map->infos4[map->sz4] = elem;
+    ++(map->sz4);
+  } else {
+    map->keys6[map->sz6] = turn_permission_key6_from_addr(addr);
+    map->infos6[map->sz6] = elem;
+    ++(map->sz6);
+  }
 
-  turn_permission_array *parray = &(map->table[fds]);
+  return elem;
+}
 
-  turn_permission_slot *slot = NULL;
+static inline bool ch_map_is_inline(const ch_map *map, const ch_info *chn) {
+  return (chn >= map->main_chns) && (chn < map->main_chns + CH_MAP_INLINE_SIZE);
+}
 
-  for (size_t i = 0; i < TURN_PERMISSION_ARRAY_SIZE; ++i) {
-    slot = &(parray->main_slots[i]);
-    if (!(slot->info.allocated)) {
-      break;
-    } else {
-      slot = NULL;
+static inline ch_info **ch_map_slot(const ch_map *map, uint16_t chnum) {
+  const size_t index = (size_t)(chnum - CH_MAP_MIN_CHANNEL);
+  ch_info **page = map->pages[index >> CH_MAP_PAGE_BITS];
+  return page ? &(page[index & (CH_MAP_PAGE_SIZE - 1)]) : NULL;
+}
+
+static inline size_t ch_map_peer_bucket(const ch_map *map, const ioa_addr *peer_addr) {
+  return (size_t)addr_hash(peer_addr) & (map->peer_buckets_sz - 1);
+}
+
+static bool ch_map_resize_peer_buckets(ch_map *map, size_t sz) {
+  ch_info **buckets = (ch_info **)calloc(sz, sizeof(ch_info *));
+  if (!buckets) {
+    return false;
+  }
+
+  for (size_t i = 0; i < map->peer_buckets_sz; ++i) {
+    ch_info *chn = map->peer_buckets[i];
+    while (chn) {
+      ch_info *next = chn->peer_next;
+      const size_t b = (size_t)addr_hash(&(chn->peer_addr)) & (sz - 1);
+      chn->peer_next = buckets[b];
+      buckets[b] = chn;
+      chn = next;
     }
   }
 
-  if (!slot) {
-    size_t old_sz = parray->extra_sz;
-    turn_permission_slot **slots = parray->extra_slots;
+  free(map->peer_buckets);
+  map->peer_buckets = buckets;
+  map->peer_buckets_sz = sz;
+  return true;
+}
 
-    if (slots) {
-      for (size_t i = 0; i < old_sz; ++i) {
-        slot = slots[i];
-        if (!(slot->info.allocated)) {
-          break;
-        } else {
-          slot = NULL;
+static void ch_map_link_peer(ch_map *map, ch_info *chn) {
+  if ((map->peer_sz >= map->peer_buckets_sz) && !ch_map_resize_peer_buckets(map, map->peer_buckets_sz << 1)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_WARNING, "%s: cannot grow channel peer index\n", __FUNCTION__);
+  }
+
+  const size_t b = ch_map_peer_bucket(map, &(chn->peer_addr));
+  chn->peer_next = map->peer_buckets[b];
+  map->peer_buckets[b] = chn;
+  ++(map->peer_sz);
+}
+
+static bool ch_map_put_slot(ch_map *map, ch_info *chn, uint16_t chnum) {
+  const size_t index = (size_t)(chnum - CH_MAP_MIN_CHANNEL);
+  ch_info ***page = &(map->pages[index >> CH_MAP_PAGE_BITS]);
+  if (!(*page)) {
+    *page = (ch_info **)calloc(CH_MAP_PAGE_SIZE, sizeof(ch_info *));
+    if (!(*page)) {
+      return false;
+    }
+  }
+  (*page)[index & (CH_MAP_PAGE_SIZE - 1)] = chn;
+  return true;
+}
+
+/* Frees the direct-indexed table with the channels allocated beyond main_chns */
+static void ch_map_free_index(ch_map *map) {
+  if (map->pages) {
+    for (size_t p = 0; p < CH_MAP_PAGES_NUMBER; ++p) {
+      ch_info **page = map->pages[p];
+      if (page) {
+        for (size_t i = 0; i < CH_MAP_PAGE_SIZE; ++i) {
+          ch_info *chi = page[i];
+          if (chi && !ch_map_is_inline(map, chi)) {
+            if (chi->allocated) {
+              ch_info_clean(chi);
+            }
+            free(chi);
+          }
         }
+        free(page);
       }
     }
+    free(map->pages);
+    map->pages = NULL;
+  }
 
-    if (!slot) {
-      size_t old_sz_mem = old_sz * sizeof(turn_permission_slot *);
-      turn_permission_slot **new_slots =
-          (turn_permission_slot **)realloc(parray->extra_slots, old_sz_mem + sizeof(turn_permission_slot *));
-      if (!new_slots) {
-        return NULL;
-      }
-      parray->extra_slots = new_slots;
-      slots = parray->extra_slots;
-      parray->extra_sz = old_sz + 1;
-      slot = (turn_permission_slot *)malloc(sizeof(turn_permission_slot));
-      if (!slot) {
-        return NULL;
+  free(map->peer_buckets);
+  map->peer_buckets = NULL;
+  map->peer_buckets_sz = 0;
+  map->peer_sz = 0;
+}
+
+/* Switches the map from the inline scan to the direct-indexed table */
+static bool ch_map_upgrade(ch_map *map) {
+  map->pages = (ch_info ***)calloc(CH_MAP_PAGES_NUMBER, sizeof(ch_info **));
+  if (!map->pages) {
+    return false;
+  }
+
+  map->peer_buckets_sz = 0;
+  map->peer_sz = 0;
+  if (!ch_map_resize_peer_buckets(map, CH_MAP_PEER_BUCKETS_MIN)) {
+    ch_map_free_index(map);
+    return false;
+  }
+
+  for (size_t i = 0; i < CH_MAP_INLINE_SIZE; ++i) {
+    ch_info *chi = &(map->main_chns[i]);
+    if (chi->allocated) {
+      if (!ch_map_put_slot(map, chi, chi->chnum)) {
+        ch_map_free_index(map);
+        return false;
       }
-      slots[old_sz] = slot;
+      ch_map_link_peer(map, chi);
     }
   }
 
-  memset(slot, 0, sizeof(turn_permission_slot));
-  slot->info.allocated = true;
-  turn_permission_info *elem = &(slot->info);
-  addr_cpy(&(elem->addr), addr);
-  elem->owner = a;
-
-  return elem;
+  return true;
 }
 
-ch_info *ch_map_get(ch_map *const map, const uint16_t chnum, const int new_chn) {
+ch_info *ch_map_get(const ch_map *map, const uint16_t chnum) {
   if (!map) {
     return NULL;
   }
 
-  const size_t index = (size_t)(chnum & (CH_MAP_HASH_SIZE - 1));
-  ch_map_array *const a = &(map->table[index]);
+  if (map->pages) {
+    if (!STUN_VALID_CHANNEL(chnum)) {
+      return NULL;
+    }
+    ch_info **slot = ch_map_slot(map, chnum);
+    ch_info *chi = slot ? *slot : NULL;
+    return (chi && chi->allocated && (chi->chnum == chnum)) ? chi : NULL;
+  }
 
-  for (size_t i = 0; i < CH_MAP_ARRAY_SIZE; ++i) {
-    ch_info *const chi = &(a->main_chns[i]);
-    if (chi->allocated) {
-      if (!new_chn && (chi->chnum == chnum)) {
+  for (size_t i = 0; i < CH_MAP_INLINE_SIZE; ++i) {
+    const ch_info *chi = &(map->main_chns[i]);
+    if (chi->allocated && (chi->chnum == chnum)) {
+      return (ch_info *)chi;
+    }
+  }
+
+  return NULL;
+}
+
+ch_info *ch_map_get_by_peer(const ch_map *map, const ioa_addr *peer_addr) {
+  if (!map || !peer_addr) {
+    return NULL;
+  }
+
+  if (map->pages) {
+    for (ch_info *chi = map->peer_buckets[ch_map_peer_bucket(map, peer_addr)]; chi; chi = chi->peer_next) {
+      if (addr_eq(&(chi->peer_addr), peer_addr)) {
         return chi;
       }
-    } else if (new_chn) {
-      return chi;
     }
+    return NULL;
   }
 
-  const size_t old_sz = a->extra_sz;
-  if (old_sz && a->extra_chns) {
-    for (size_t i = 0; i < old_sz; ++i) {
-      ch_info *const chi = a->extra_chns[i];
-      if (chi) {
-        if (chi->allocated) {
-          if (!new_chn && (chi->chnum == chnum)) {
-            return chi;
-          }
-        } else if (new_chn) {
-          return chi;
-        }
-      }
+  for (size_t i = 0; i < CH_MAP_INLINE_SIZE; ++i) {
+    const ch_info *chi = &(map->main_chns[i]);
+    if (chi->allocated && addr_eq(&(chi->peer_addr), peer_addr)) {
+      return (ch_info *)chi;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Adds a channel that is not in the map yet. The returned ch_info is
+ * allocated and bound to chnum and peer_addr; the rest is zeroed.
+ */
+ch_info *ch_map_add(ch_map *const map, const uint16_t chnum, const ioa_addr *peer_addr) {
+  if (!map || !peer_addr || !STUN_VALID_CHANNEL(chnum)) {
+    return NULL;
+  }
+
+  ch_info *chn = NULL;
+
+  if (map->pages) {
+    /* A channel number that was used before keeps its ch_info */
+    ch_info **slot = ch_map_slot(map, chnum);
+    if (slot && *slot && !((*slot)->allocated)) {
+      chn = *slot;
+    }
+  }
+
+  for (size_t i = 0; !chn && (i < CH_MAP_INLINE_SIZE); ++i) {
+    if (!(map->main_chns[i].allocated)) {
+      chn = &(map->main_chns[i]);
     }
   }
 
-  if (new_chn) {
-    const size_t old_sz_mem = old_sz * sizeof(ch_info *);
-    ch_info **const pTmp = (ch_info **)realloc(a->extra_chns, old_sz_mem + sizeof(ch_info *));
-    if (!pTmp) {
+  if (!chn) {
+    if (!(map->pages) && !ch_map_upgrade(map)) {
       return NULL;
     }
-    a->extra_chns = pTmp;
-    a->extra_chns[old_sz] = (ch_info *)calloc(1, sizeof(ch_info));
-    if (!a->extra_chns[old_sz]) {
-      // if the realloc succeeds, but the calloc fails, we don't attempt to shrink the realloc back down
-      // by not recording the change to the size, we allow the next call to this function to realloc the
-      // block to presumably the same size it already is, which should be fine and not result in any leaks.
+    chn = (ch_info *)calloc(1, sizeof(ch_info));
+    if (!chn) {
       return NULL;
     }
+  }
 
-    a->extra_sz += 1;
-    return a->extra_chns[old_sz];
+  if (map->pages && !ch_map_put_slot(map, chn, chnum)) {
+    if (!ch_map_is_inline(map, chn)) {
+      free(chn);
+    }
+    return NULL;
   }
 
-  return NULL;
+  memset(chn, 0, sizeof(ch_info));
+  chn->allocated = true;
+  chn->chnum = chnum;
+  chn->port = addr_get_port(peer_addr);
+  addr_cpy(&(chn->peer_addr), peer_addr);
+
+  if (map->pages) {
+    ch_map_link_peer(map, chn);
+  }
+
+  return chn;
 }
 
-void ch_map_clean(ch_map *map) {
-  if (!map) {
+/* Removes the channel from the indexes; must be called before it is cleaned */
+void ch_map_del(ch_map *map, ch_info *chn) {
+  if (!map || !chn || !(chn->allocated) || !(map->pages)) {
     return;
   }
 
-  for (size_t index = 0; index < CH_MAP_HASH_SIZE; ++index) {
-    ch_map_array *a = &(map->table[index]);
+  ch_info **pchi = &(map->peer_buckets[ch_map_peer_bucket(map, &(chn->peer_addr))]);
+  while (*pchi) {
+    if (*pchi == chn) {
+      *pchi = chn->peer_next;
+      chn->peer_next = NULL;
+      --(map->peer_sz);
+      break;
+    }
+    pchi = &((*pchi)->peer_next);
+  }
 
-    for (size_t i = 0; i < CH_MAP_ARRAY_SIZE; ++i) {
-      ch_info *chi = &(a->main_chns[i]);
-      if (chi->allocated) {
-        ch_info_clean(chi);
-      }
+  /* main_chns entries can be reused for another channel number */
+  if (ch_map_is_inline(map, chn)) {
+    ch_info **slot = ch_map_slot(map, chn->chnum);
+    if (slot && (*slot == chn)) {
+      *slot = NULL;
     }
+  }
+}
 
-    if (a->extra_chns) {
-      for (size_t i = 0; i < a->extra_sz; ++i) {
-        ch_info *chi = a->extra_chns[i];
-        if (chi) {
-          if (chi->allocated) {
-            ch_info_clean(chi);
-          }
-          free(chi);
-          a->extra_chns[i] = NULL;
-        }
-      }
-      free(a->extra_chns);
-      a->extra_chns = NULL;
+void ch_map_clean(ch_map *map) {
+  if (!map) {
+    return;
+  }
+
+  for (size_t i = 0; i < CH_MAP_INLINE_SIZE; ++i) {
+    ch_info *chi = &(map->main_chns[i]);
+    if (chi->allocated) {
+      ch_info_clean(chi);
     }
-    a->extra_sz = 0;
   }
+
+  ch_map_free_index(map);
 }
 
 ////////////////// TCP connections ///////////////////////////////
@@ -691,7 +934,7 @@ bool can_accept_tcp_connection_from_peer(allocation *a, ioa_addr *peer_addr, int
   }
 
   if (a && peer_addr) {
-    return get_from_turn_permission_hashtable(&(a->addr_to_perm), peer_addr) != NULL;
+    return get_from_turn_permission_table(&(a->addr_to_perm), peer_addr) != NULL;
   }
 
   return false;
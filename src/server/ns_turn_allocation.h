@@ -105,9 +105,6 @@ typedef struct _tcp_connection_list {
 
 ////////////////////////////////
 
-#define TURN_PERMISSION_HASHTABLE_SIZE (0x8)
-#define TURN_PERMISSION_ARRAY_SIZE (0x3)
-
 typedef struct _ch_info {
   uint16_t chnum;
   bool allocated;
@@ -117,24 +114,39 @@ typedef struct _ch_info {
   ioa_timer_handle lifetime_ev;
   void *owner; // perm
   TURN_CHANNEL_HANDLER_KERNEL kernel_channel;
+  struct _ch_info *peer_next; // peer address bucket chain
 } ch_info;
 
 ///////////// "channel" map /////////////////////
 
-#define CH_MAP_HASH_SIZE (0x8)
-#define CH_MAP_ARRAY_SIZE (0x3)
+/*
+ * The first CH_MAP_INLINE_SIZE channels of an allocation live in main_chns
+ * and are found by a linear scan. Once they overflow, the map switches to a
+ * two-level table indexed directly by the channel number, plus a hash of the
+ * peer addresses; both then cover all channels. Channels beyond main_chns are
+ * allocated on demand and kept for reuse until the map is cleaned.
+ */
 
-typedef struct _chn_map_array {
-  ch_info main_chns[CH_MAP_ARRAY_SIZE];
-  size_t extra_sz;
-  ch_info **extra_chns;
-} ch_map_array;
+#define CH_MAP_INLINE_SIZE (0x4)
+#define CH_MAP_MIN_CHANNEL (0x4000)
+#define CH_MAP_MAX_CHANNEL (0x7FFF)
+#define CH_MAP_PAGE_BITS (7)
+#define CH_MAP_PAGE_SIZE (1 << CH_MAP_PAGE_BITS)
+#define CH_MAP_PAGES_NUMBER ((CH_MAP_MAX_CHANNEL - CH_MAP_MIN_CHANNEL + 1) >> CH_MAP_PAGE_BITS)
+#define CH_MAP_PEER_BUCKETS_MIN (0x10)
 
 typedef struct _ch_map {
-  ch_map_array table[CH_MAP_HASH_SIZE];
+  ch_info main_chns[CH_MAP_INLINE_SIZE];
+  ch_info ***pages; // NULL while main_chns is enough
+  ch_info **peer_buckets;
+  size_t peer_buckets_sz;
+  size_t peer_sz;
 } ch_map;
 
-ch_info *ch_map_get(ch_map *map, uint16_t chnum, int new_chn);
+ch_info *ch_map_get(const ch_map *map, uint16_t chnum);
+ch_info *ch_map_get_by_peer(const ch_map *map, const ioa_addr *peer_addr);
+ch_info *ch_map_add(ch_map *map, uint16_t chnum, const ioa_addr *peer_addr);
+void ch_map_del(ch_map *map, ch_info *chn);
 void ch_map_clean(ch_map *map);
 
 ////////////////////////////
@@ -150,19 +162,34 @@ typedef struct _turn_permission_info {
   unsigned long long session_id;
 } turn_permission_info;
 
-typedef struct _turn_permission_slot {
-  turn_permission_info info;
-} turn_permission_slot;
+///////////// permission table /////////////////////
+
+/*
+ * Permissions of an allocation, found by the peer address (without port).
+ * The lookup only scans the packed addresses, one flat array per family,
+ * several entries per compare; the permissions themselves (timers, channels,
+ * expiration time) are allocated separately and referenced at the same index.
+ */
+
+#define TURN_PERMISSION_TABLE_MIN_SIZE (0x4)
+
+typedef struct _turn_permission_key6 {
+  uint64_t w[2];
+} turn_permission_key6;
 
-typedef struct _turn_permission_array {
-  turn_permission_slot main_slots[TURN_PERMISSION_ARRAY_SIZE];
-  size_t extra_sz;
-  turn_permission_slot **extra_slots;
-} turn_permission_array;
+typedef struct _turn_permission_table {
+  uint32_t *keys4;             // IPv4 addresses, network byte order
+  turn_permission_key6 *keys6; // IPv6 addresses
+  turn_permission_info **infos4;
+  turn_permission_info **infos6;
+  size_t sz4;
+  size_t sz6;
+  size_t capacity4;
+  size_t capacity6;
+} turn_permission_table;
 
-typedef struct _turn_permission_hashtable {
-  turn_permission_array table[TURN_PERMISSION_HASHTABLE_SIZE];
-} turn_permission_hashtable;
+size_t turn_permission_table_size(const turn_permission_table *map);
+turn_permission_info *turn_permission_table_get(const turn_permission_table *map, size_t i);
 
 //////////////// ALLOCATION //////////////////////
 
@@ -175,7 +202,7 @@ typedef struct _turn_permission_hashtable {
 typedef struct _allocation {
   bool is_valid;
   stun_tid tid;
-  turn_permission_hashtable addr_to_perm;
+  turn_permission_table addr_to_perm;
   relay_endpoint_session relay_sessions[ALLOC_PROTOCOLS_NUMBER];
   int relay_sessions_failure[ALLOC_PROTOCOLS_NUMBER];
   ch_map chns;             /* chnum-to-ch_info* */
@@ -202,7 +229,7 @@ void set_allocation_lifetime_ev(allocation *a, turn_time_t exp_time, ioa_timer_h
 bool is_allocation_valid(const allocation *a);
 void set_allocation_valid(allocation *a, bool value);
 turn_permission_info *allocation_get_permission(allocation *a, const ioa_addr *addr);
-turn_permission_hashtable *allocation_get_turn_permission_hashtable(allocation *a);
+turn_permission_table *allocation_get_turn_permission_table(allocation *a);
 turn_permission_info *allocation_add_permission(allocation *a, const ioa_addr *addr);
 
 ch_info *allocation_get_new_ch_info(allocation *a, uint16_t chnum, ioa_addr *peer_addr);
@@ -180,13 +180,15 @@ struct _ip_range_list {
 
 typedef struct _ip_range_list ip_range_list_t;
 
-void ioa_lock_whitelist(ioa_engine_handle e);
-void ioa_unlock_whitelist(ioa_engine_handle e);
-const ip_range_list_t *ioa_get_whitelist(ioa_engine_handle e);
+struct _ip_range_trie;
+typedef struct _ip_range_trie ip_range_trie_t;
 
-void ioa_lock_blacklist(ioa_engine_handle e);
-void ioa_unlock_blacklist(ioa_engine_handle e);
-const ip_range_list_t *ioa_get_blacklist(ioa_engine_handle e);
+/*
+ * Dynamic lists, compiled (see ns_turn_ip_trie.h). The tries are immutable
+ * and replaced as a whole, so no locking is needed for the lookups.
+ */
+const ip_range_trie_t *ioa_get_whitelist(ioa_engine_handle e);
+const ip_range_trie_t *ioa_get_blacklist(ioa_engine_handle e);
 
 ////////////////////////////////////////////
 
@@ -240,6 +242,8 @@ typedef void (*ioa_timer_event_handler)(ioa_engine_handle e, void *ctx);
 
 ioa_timer_handle set_ioa_timer(ioa_engine_handle e, int secs, int ms, ioa_timer_event_handler cb, void *ctx,
                                int persist, const char *txt);
+/* Re-arm the timer to expire in secs seconds from now */
+void restart_ioa_timer(ioa_timer_handle th, int secs);
 void stop_ioa_timer(ioa_timer_handle th);
 void delete_ioa_timer(ioa_timer_handle th);
 #define IOA_EVENT_DEL(E)                                                                                               \
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "ns_turn_ip_trie.h"
+
+#include <stdlib.h> // for free, calloc, realloc, NULL
+#include <string.h> // for memcpy, strcmp
+
+//////////////// IP range trie //////////////////
+
+/* Nodes 0 and 1 are the family roots; as they are never children, 0 is "no child" */
+#define IP_TRIE_V4_ROOT (0)
+#define IP_TRIE_V6_ROOT (1)
+
+typedef struct {
+  uint32_t child[2];
+  uint32_t link; /* 1 + index of the first range link of the prefix, 0 - none */
+} ip_trie_node;
+
+/* A range covers several prefixes, so the per-prefix range lists are kept apart */
+typedef struct {
+  uint32_t range;
+  uint32_t next; /* 1 + index of the next link of the same prefix, 0 - none */
+} ip_trie_link;
+
+struct _ip_range_trie {
+  ip_trie_node *nodes;
+  size_t nodes_number;
+  size_t nodes_capacity;
+  ip_trie_link *links;
+  size_t links_number;
+  size_t links_capacity;
+  ip_range_t *rs;
+  size_t ranges_number;
+};
+
+static int key_bit(const uint8_t *key, int depth) { return (key[depth >> 3] >> (7 - (depth & 7))) & 1; }
+
+/* Whether all the key bits starting from depth are equal to the value */
+static bool key_bits_are(const uint8_t *key, int depth, int bits, int value) {
+  for (; depth < bits; ++depth) {
+    if (key_bit(key, depth) != value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Return the address bits number, and set the key and the family root */
+static int addr_key(const ioa_addr *addr, const uint8_t **key, uint32_t *root) {
+  if (addr->ss.sa_family == AF_INET) {
+    *key = (const uint8_t *)&(addr->s4.sin_addr);
+    *root = IP_TRIE_V4_ROOT;
+    return 32;
+  } else if (addr->ss.sa_family == AF_INET6) {
+    *key = (const uint8_t *)&(addr->s6.sin6_addr);
+    *root = IP_TRIE_V6_ROOT;
+    return 128;
+  }
+  return 0;
+}
+
+static uint32_t trie_node_new(ip_range_trie_t *t) {
+  if (t->nodes_number == t->nodes_capacity) {
+    size_t capacity = t->nodes_capacity ? (t->nodes_capacity << 1) : 64;
+    ip_trie_node *nodes = (ip_trie_node *)realloc(t->nodes, capacity * sizeof(ip_trie_node));
+    if (!nodes) {
+      return 0;
+    }
+    t->nodes = nodes;
+    t->nodes_capacity = capacity;
+  }
+  memset(&(t->nodes[t->nodes_number]), 0, sizeof(ip_trie_node));
+  return (uint32_t)(t->nodes_number++);
+}
+
+static bool trie_attach(ip_range_trie_t *t, uint32_t n, uint32_t range) {
+  if (t->links_number == t->links_capacity) {
+    size_t capacity = t->links_capacity ? (t->links_capacity << 1) : 64;
+    ip_trie_link *links = (ip_trie_link *)realloc(t->links, capacity * sizeof(ip_trie_link));
+    if (!links) {
+      return false;
+    }
+    t->links = links;
+    t->links_capacity = capacity;
+  }
+  t->links[t->links_number].range = range;
+  t->links[t->links_number].next = t->nodes[n].link;
+  t->nodes[n].link = (uint32_t)(++(t->links_number));
+  return true;
+}
+
+/*
+ * Attach the range to the prefixes under node n that it covers completely.
+ * lo and hi are the range bounds, NULL when the range does not cut the
+ * node prefix on that side.
+ */
+static bool trie_insert(ip_range_trie_t *t, uint32_t n, int depth, int bits, const uint8_t *lo, const uint8_t *hi,
+                        uint32_t range) {
+  if ((!lo || key_bits_are(lo, depth, bits, 0)) && (!hi || key_bits_are(hi, depth, bits, 1))) {
+    return trie_attach(t, n, range);
+  }
+
+  int blo = lo ? key_bit(lo, depth) : 0;
+  int bhi = hi ? key_bit(hi, depth) : 1;
+
+  for (int b = blo; b <= bhi; ++b) {
+    uint32_t c = t->nodes[n].child[b];
+    if (!c) {
+      c = trie_node_new(t);
+      if (!c) {
+        return false;
+      }
+      t->nodes[n].child[b] = c;
+    }
+    if (!trie_insert(t, c, depth + 1, bits, (b == blo) ? lo : NULL, (b == bhi) ? hi : NULL, range)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+ * ioa_addr_in_range() orders the addresses by family first (IPv4 before
+ * IPv6), and an "any" bound leaves the range open on that side; so a range
+ * may span both families.
+ */
+static bool trie_insert_range(ip_range_trie_t *t, const ioa_addr_range *enc, uint32_t range) {
+  const uint8_t *lo = NULL, *hi = NULL;
+  uint32_t lo_root = IP_TRIE_V4_ROOT, hi_root = IP_TRIE_V6_ROOT;
+  int lo_bits = 32, hi_bits = 128;
+
+  if (!addr_any(&(enc->min))) {
+    lo_bits = addr_key(&(enc->min), &lo, &lo_root);
+  }
+  if (!addr_any(&(enc->max))) {
+    hi_bits = addr_key(&(enc->max), &hi, &hi_root);
+  }
+  if (!lo_bits || !hi_bits || (lo_root > hi_root)) {
+    return true;
+  }
+
+  if (lo_root == hi_root) {
+    if (lo && hi && (memcmp(lo, hi, (size_t)lo_bits >> 3) > 0)) {
+      return true;
+    }
+    return trie_insert(t, lo_root, 0, lo_bits, lo, hi, range);
+  }
+
+  return trie_insert(t, lo_root, 0, lo_bits, lo, NULL, range) && trie_insert(t, hi_root, 0, hi_bits, NULL, hi, range);
+}
+
+ip_range_trie_t *ip_range_trie_build(const ip_range_list_t *list) {
+  if (!list || !list->ranges_number) {
+    return NULL;
+  }
+
+  ip_range_trie_t *t = (ip_range_trie_t *)calloc(sizeof(ip_range_trie_t), 1);
+  if (!t) {
+    return NULL;
+  }
+
+  t->rs = (ip_range_t *)malloc(sizeof(ip_range_t) * list->ranges_number);
+  if (!t->rs) {
+    ip_range_trie_free(t);
+    return NULL;
+  }
+  memcpy(t->rs, list->rs, sizeof(ip_range_t) * list->ranges_number);
+  t->ranges_number = list->ranges_number;
+
+  trie_node_new(t);
+  trie_node_new(t);
+  if (t->nodes_number != 2) {
+    ip_range_trie_free(t);
+    return NULL;
+  }
+
+  /* Links are prepended, so the later ranges of a prefix are checked first, as the list walk did */
+  for (size_t i = 0; i < t->ranges_number; ++i) {
+    if (!trie_insert_range(t, &(t->rs[i].enc), (uint32_t)i)) {
+      ip_range_trie_free(t);
+      return NULL;
+    }
+  }
+
+  return t;
+}
+
+void ip_range_trie_free(ip_range_trie_t *t) {
+  if (t) {
+    free(t->nodes);
+    free(t->links);
+    free(t->rs);
+    free(t);
+  }
+}
+
+bool ip_range_trie_same(const ip_range_trie_t *t, const ip_range_list_t *list) {
+  size_t ranges_number = list ? list->ranges_number : 0;
+
+  if (!t) {
+    return !ranges_number;
+  }
+  if (t->ranges_number != ranges_number) {
+    return false;
+  }
+  for (size_t i = 0; i < ranges_number; ++i) {
+    if (strcmp(t->rs[i].str, list->rs[i].str) || strcmp(t->rs[i].realm, list->rs[i].realm)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const ip_range_t *ip_range_trie_lookup(const ip_range_trie_t *t, const ioa_addr *addr, const char *realm) {
+  if (!t || !addr) {
+    return NULL;
+  }
+
+  const uint8_t *key = NULL;
+  uint32_t n = 0;
+  int bits = addr_key(addr, &key, &n);
+  if (!bits) {
+    return NULL;
+  }
+
+  for (int depth = 0;; ++depth) {
+    for (uint32_t l = t->nodes[n].link; l; l = t->links[l - 1].next) {
+      const ip_range_t *r = &(t->rs[t->links[l - 1].range]);
+      if (!r->realm[0] || !realm || !realm[0] || !strcmp(r->realm, realm)) {
+        return r;
+      }
+    }
+    if (depth == bits) {
+      break;
+    }
+    n = t->nodes[n].child[key_bit(key, depth)];
+    if (!n) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+////////////////////////////////////////////////
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2011, 2012, 2013 Citrix Systems
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __TURN_IP_TRIE__
+#define __TURN_IP_TRIE__
+
+#include "ns_turn_ioalib.h"
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//////////////// IP range trie //////////////////
+
+/*
+ * Compiled, immutable form of an ip_range_list_t: a binary trie per address
+ * family where every range is split into the prefixes that cover it. A lookup
+ * walks the peer address bits once and checks the ranges attached to the
+ * prefixes on the way, so its cost does not depend on the number of ranges.
+ */
+
+struct _ip_range_trie; // IWYU pragma: keep
+typedef struct _ip_range_trie ip_range_trie_t;
+
+/* Build the trie; the ranges are copied. Return NULL for an empty list */
+ip_range_trie_t *ip_range_trie_build(const ip_range_list_t *list);
+void ip_range_trie_free(ip_range_trie_t *t);
+
+/* Whether the trie has been built from the same ranges as the list */
+bool ip_range_trie_same(const ip_range_trie_t *t, const ip_range_list_t *list);
+
+/*
+ * Find a range containing the address. A range with a realm only matches
+ * when realm is empty or the same realm.
+ * Return: the range, or NULL if there is no match.
+ */
+const ip_range_t *ip_range_trie_lookup(const ip_range_trie_t *t, const ioa_addr *addr, const char *realm);
+
+////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //__TURN_IP_TRIE__
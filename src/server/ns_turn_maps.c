@@ -34,9 +34,15 @@
 
 #include "ns_turn_khash.h"
 
+#include "apputils.h" // for turn_random
+
 #include <stdlib.h> // for size_t, free, malloc, NULL, realloc
 #include <string.h> // for memset, strcmp, memcpy, strlen
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 KHASH_MAP_INIT_INT64(3, ur_map_value_type)
 
 #define MAGIC_HASH ((uint64_t)(0x90ABCDEFL))
@@ -486,223 +492,197 @@ bool lm_map_foreach_arg(lm_map *map, foreachcb_arg_type func, void *arg) {
   return false;
 }
 
-////////////////////  ADDR LISTS ///////////////////////////////////
+////////// ADDR MAPS ////////////////////////////////////////////
 
-static void addr_list_free(addr_list_header *slh) {
-  if (slh) {
-    if (slh->extra_list) {
-      free(slh->extra_list);
-    }
-    memset(slh, 0, sizeof(addr_list_header));
-  }
-}
+/*
+ * Control bytes: a full slot holds the low 7 bits of the key hash, the free
+ * slots have the high bit set. The probe sequence goes over whole groups
+ * (triangular steps), and a lookup stops at the first group that has an
+ * empty slot; so a slot is only marked empty again on delete if its group
+ * has an empty slot already, and deleted otherwise.
+ */
 
-static void addr_list_add(addr_list_header *slh, const ioa_addr *key, ur_addr_map_value_type value) {
-  if (!key || !value) {
-    return;
-  }
+#define ADDR_CTRL_EMPTY ((int8_t)-128)
+#define ADDR_CTRL_DELETED ((int8_t)-2)
 
-  addr_elem *elem = NULL;
+#define ADDR_MAP_GROUPS_MASK(map) (((map)->capacity / ADDR_MAP_GROUP_SIZE) - 1)
 
-  for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-    if (!(slh->main_list[i].value)) {
-      elem = &(slh->main_list[i]);
-      break;
-    }
-  }
+#define ur_addr_map_valid(map) ((map) && ((map)->magic == MAGIC_HASH))
 
-  if (!elem && slh->extra_list) {
-    for (size_t i = 0; i < slh->extra_sz; ++i) {
-      if (!(slh->extra_list[i].value)) {
-        elem = &(slh->extra_list[i]);
-        break;
-      }
+/* Bit i is set when the control byte i of the group is equal to c */
+static inline uint32_t addr_ctrl_match(const int8_t *group, int8_t c) {
+#if defined(__SSE2__)
+  __m128i g = _mm_loadu_si128((const __m128i *)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+#else
+  uint32_t m = 0;
+  for (int i = 0; i < ADDR_MAP_GROUP_SIZE; ++i) {
+    if (group[i] == c) {
+      m |= (1U << i);
     }
   }
+  return m;
+#endif
+}
 
-  if (!elem) {
-    size_t old_sz = slh->extra_sz;
-    size_t old_sz_mem = old_sz * sizeof(addr_elem);
-    slh->extra_list = (addr_elem *)realloc(slh->extra_list, old_sz_mem + sizeof(addr_elem));
-    elem = &(slh->extra_list[old_sz]);
-    slh->extra_sz += 1;
+/* Bit i is set when the slot i of the group is empty or deleted */
+static inline uint32_t addr_ctrl_match_free(const int8_t *group) {
+#if defined(__SSE2__)
+  return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+  uint32_t m = 0;
+  for (int i = 0; i < ADDR_MAP_GROUP_SIZE; ++i) {
+    if (group[i] < 0) {
+      m |= (1U << i);
+    }
   }
+  return m;
+#endif
+}
 
-  addr_cpy(&(elem->key), key);
-  elem->value = value;
+static inline int addr_mask_first(uint32_t m) {
+#if defined(__GNUC__)
+  return __builtin_ctz(m);
+#else
+  int i = 0;
+  while (!(m & 1)) {
+    m >>= 1;
+    ++i;
+  }
+  return i;
+#endif
 }
 
-static void addr_list_remove(addr_list_header *slh, const ioa_addr *key, ur_addr_map_func delfunc, int *counter) {
-  if (!slh || !key) {
-    return;
-  }
+static inline uint64_t addr_map_mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
 
-  if (counter) {
-    *counter = 0;
+static bool addr_map_key_set(addr_map_key *k, const ioa_addr *addr) {
+  memset(k, 0, sizeof(addr_map_key));
+  if (!addr) {
+    return false;
+  } else if (addr->ss.sa_family == AF_INET) {
+    memcpy(k->addr, &(addr->s4.sin_addr), sizeof(addr->s4.sin_addr));
+    k->port = addr->s4.sin_port;
+  } else if (addr->ss.sa_family == AF_INET6) {
+    memcpy(k->addr, &(addr->s6.sin6_addr), sizeof(addr->s6.sin6_addr));
+    k->port = addr->s6.sin6_port;
+  } else {
+    return false;
   }
+  k->family = addr->ss.sa_family;
+  return true;
+}
 
-  for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-    addr_elem *elem = &(slh->main_list[i]);
-    if (elem->value) {
-      if (addr_eq(&(elem->key), key)) {
-        if (delfunc && elem->value) {
-          delfunc(elem->value);
-        }
-        elem->value = 0;
-        if (counter) {
-          *counter += 1;
-        }
-      }
-    }
-  }
+/* The seed is random per map, so that the remote peers cannot choose colliding addresses */
+static inline uint64_t addr_map_hash(const ur_addr_map *map, const addr_map_key *k) {
+  uint64_t a[2];
+  memcpy(a, k->addr, sizeof(a));
+  return addr_map_mix(a[0] ^ addr_map_mix(a[1] ^ map->seed ^ (((uint64_t)k->family << 16) | k->port)));
+}
 
-  if (slh->extra_list) {
-    for (size_t i = 0; i < slh->extra_sz; ++i) {
-      addr_elem *elem = &(slh->extra_list[i]);
-      if (elem->value) {
-        if (addr_eq(&(elem->key), key)) {
-          if (delfunc && elem->value) {
-            delfunc(elem->value);
-          }
-          elem->value = 0;
-          if (counter) {
-            *counter += 1;
-          }
-        }
-      }
-    }
+static addr_elem *addr_map_find(const ur_addr_map *map, const addr_map_key *k, uint64_t h) {
+  if (!(map->capacity)) {
+    return NULL;
   }
-}
 
-static void addr_list_foreach(addr_list_header *slh, ur_addr_map_func func) {
-  if (slh && func) {
+  size_t groups_mask = ADDR_MAP_GROUPS_MASK(map);
+  size_t g = (size_t)(h >> 7) & groups_mask;
+  int8_t h2 = (int8_t)(h & 0x7f);
 
-    for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-      addr_elem *elem = &(slh->main_list[i]);
-      if (elem->value) {
-        func(elem->value);
+  for (size_t step = 1;; ++step) {
+    const int8_t *group = map->ctrl + g * ADDR_MAP_GROUP_SIZE;
+    for (uint32_t m = addr_ctrl_match(group, h2); m; m &= m - 1) {
+      addr_elem *elem = &(map->slots[g * ADDR_MAP_GROUP_SIZE + addr_mask_first(m)]);
+      if (!memcmp(&(elem->key), k, sizeof(addr_map_key))) {
+        return elem;
       }
     }
-
-    if (slh->extra_list) {
-      for (size_t i = 0; i < slh->extra_sz; ++i) {
-        addr_elem *elem = &(slh->extra_list[i]);
-        if (elem->value) {
-          func(elem->value);
-        }
-      }
+    if (addr_ctrl_match(group, ADDR_CTRL_EMPTY) || (step > groups_mask)) {
+      return NULL;
     }
+    g = (g + step) & groups_mask;
   }
 }
 
-static size_t addr_list_num_elements(const addr_list_header *slh) {
-  size_t ret = 0;
-
-  if (slh) {
-    for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-      const addr_elem *elem = &(slh->main_list[i]);
-      if (elem->value) {
-        ++ret;
-      }
-    }
+/* There is always a free slot: the table is never more than 7/8 full */
+static size_t addr_map_find_free(const ur_addr_map *map, uint64_t h) {
+  size_t groups_mask = ADDR_MAP_GROUPS_MASK(map);
+  size_t g = (size_t)(h >> 7) & groups_mask;
 
-    if (slh->extra_list) {
-      for (size_t i = 0; i < slh->extra_sz; ++i) {
-        addr_elem *elem = &(slh->extra_list[i]);
-        if (elem->value) {
-          ++ret;
-        }
-      }
+  for (size_t step = 1;; ++step) {
+    uint32_t m = addr_ctrl_match_free(map->ctrl + g * ADDR_MAP_GROUP_SIZE);
+    if (m) {
+      return g * ADDR_MAP_GROUP_SIZE + addr_mask_first(m);
     }
+    g = (g + step) & groups_mask;
   }
-
-  return ret;
 }
 
-static size_t addr_list_size(const addr_list_header *slh) {
-  if (slh) {
-    return ADDR_ARRAY_SIZE + slh->extra_sz;
+static bool addr_map_resize(ur_addr_map *map, size_t capacity) {
+  int8_t *ctrl = (int8_t *)malloc(capacity);
+  addr_elem *slots = (addr_elem *)malloc(capacity * sizeof(addr_elem));
+  if (!ctrl || !slots) {
+    free(ctrl);
+    free(slots);
+    return false;
   }
+  memset(ctrl, ADDR_CTRL_EMPTY, capacity);
 
-  return 0;
-}
+  int8_t *old_ctrl = map->ctrl;
+  addr_elem *old_slots = map->slots;
+  size_t old_capacity = map->capacity;
 
-static addr_elem *addr_list_get(addr_list_header *slh, const ioa_addr *key) {
-  if (!slh || !key) {
-    return NULL;
-  }
+  map->ctrl = ctrl;
+  map->slots = slots;
+  map->capacity = capacity;
+  map->growth_left = capacity - (capacity >> 3) - map->elements;
 
-  for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-    addr_elem *elem = &(slh->main_list[i]);
-    if (elem->value) {
-      if (addr_eq(&(elem->key), key)) {
-        return elem;
-      }
+  for (size_t i = 0; i < old_capacity; ++i) {
+    if (old_ctrl[i] >= 0) {
+      uint64_t h = addr_map_hash(map, &(old_slots[i].key));
+      size_t j = addr_map_find_free(map, h);
+      ctrl[j] = (int8_t)(h & 0x7f);
+      slots[j] = old_slots[i];
     }
   }
 
-  if (slh->extra_list) {
-    for (size_t i = 0; i < slh->extra_sz; ++i) {
-      addr_elem *elem = &(slh->extra_list[i]);
-      if (elem->value) {
-        if (addr_eq(&(elem->key), key)) {
-          return elem;
-        }
-      }
-    }
-  }
+  free(old_ctrl);
+  free(old_slots);
 
-  return NULL;
+  return true;
 }
 
-static const addr_elem *addr_list_get_const(const addr_list_header *slh, const ioa_addr *key) {
-  if (!slh || !key) {
-    return NULL;
-  }
-
-  for (size_t i = 0; i < ADDR_ARRAY_SIZE; ++i) {
-    const addr_elem *elem = &(slh->main_list[i]);
-    if (elem->value) {
-      if (addr_eq(&(elem->key), key)) {
-        return elem;
-      }
-    }
-  }
+static void addr_map_erase(ur_addr_map *map, addr_elem *elem) {
+  size_t i = (size_t)(elem - map->slots);
+  const int8_t *group = map->ctrl + (i & ~((size_t)ADDR_MAP_GROUP_SIZE - 1));
 
-  if (slh->extra_list) {
-    for (size_t i = 0; i < slh->extra_sz; ++i) {
-      const addr_elem *elem = &(slh->extra_list[i]);
-      if (elem->value) {
-        if (addr_eq(&(elem->key), key)) {
-          return elem;
-        }
-      }
-    }
+  if (addr_ctrl_match(group, ADDR_CTRL_EMPTY)) {
+    map->ctrl[i] = ADDR_CTRL_EMPTY;
+    ++(map->growth_left);
+  } else {
+    map->ctrl[i] = ADDR_CTRL_DELETED;
   }
-
-  return NULL;
+  --(map->elements);
 }
 
-////////// ADDR MAPS ////////////////////////////////////////////
-
-#define addr_map_index(key) (addr_hash((key)) & (ADDR_MAP_SIZE - 1))
-
-#define get_addr_list_header(map, key) (&((map)->lists[addr_map_index((key))]))
-
-#define ur_addr_map_valid(map) ((map) && ((map)->magic == MAGIC_HASH))
-
 void ur_addr_map_init(ur_addr_map *map) {
   if (map) {
     memset(map, 0, sizeof(ur_addr_map));
+    map->seed = ((uint64_t)turn_random() << 32) ^ (uint64_t)turn_random();
     map->magic = MAGIC_HASH;
   }
 }
 
 void ur_addr_map_clean(ur_addr_map *map) {
   if (map && ur_addr_map_valid(map)) {
-    for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-      addr_list_free(&(map->lists[i]));
-    }
+    free(map->ctrl);
+    free(map->slots);
     memset(map, 0, sizeof(ur_addr_map));
   }
 }
@@ -712,19 +692,43 @@ bool ur_addr_map_put(ur_addr_map *map, ioa_addr *key, ur_addr_map_value_type val
     return false;
   }
 
-  else {
+  addr_map_key k;
+  if (!addr_map_key_set(&k, key)) {
+    return false;
+  }
 
-    addr_list_header *slh = get_addr_list_header(map, key);
+  uint64_t h = addr_map_hash(map, &k);
+  addr_elem *elem = addr_map_find(map, &k, h);
 
-    addr_elem *elem = addr_list_get(slh, key);
-    if (elem) {
+  if (elem) {
+    if (value) {
       elem->value = value;
     } else {
-      addr_list_add(slh, key, value);
+      addr_map_erase(map, elem);
+    }
+  } else if (value) {
+    if (!(map->growth_left)) {
+      /* grow, or only drop the deleted slots if they take most of the room */
+      size_t capacity = map->capacity ? map->capacity : ADDR_MAP_GROUP_SIZE;
+      if (map->elements >= (map->capacity >> 2) + (map->capacity >> 3)) {
+        capacity = map->capacity ? (map->capacity << 1) : ADDR_MAP_GROUP_SIZE;
+      }
+      if (!addr_map_resize(map, capacity)) {
+        return false;
+      }
     }
 
-    return true;
+    size_t i = addr_map_find_free(map, h);
+    if (map->ctrl[i] == ADDR_CTRL_EMPTY) {
+      --(map->growth_left);
+    }
+    map->ctrl[i] = (int8_t)(h & 0x7f);
+    map->slots[i].key = k;
+    map->slots[i].value = value;
+    ++(map->elements);
   }
+
+  return true;
 }
 
 bool ur_addr_map_get(const ur_addr_map *map, ioa_addr *key, ur_addr_map_value_type *value) {
@@ -732,8 +736,12 @@ bool ur_addr_map_get(const ur_addr_map *map, ioa_addr *key, ur_addr_map_value_ty
     return false;
   }
 
-  const addr_list_header *slh = get_addr_list_header(map, key);
-  const addr_elem *elem = addr_list_get_const(slh, key);
+  addr_map_key k;
+  if (!addr_map_key_set(&k, key)) {
+    return false;
+  }
+
+  const addr_elem *elem = addr_map_find(map, &k, addr_map_hash(map, &k));
   if (elem) {
     if (value) {
       *value = elem->value;
@@ -748,35 +756,54 @@ bool ur_addr_map_del(ur_addr_map *map, ioa_addr *key, ur_addr_map_func delfunc)
     return false;
   }
 
-  addr_list_header *slh = get_addr_list_header(map, key);
+  addr_map_key k;
+  if (!addr_map_key_set(&k, key)) {
+    return false;
+  }
 
-  int counter = 0;
-  addr_list_remove(slh, key, delfunc, &counter);
+  addr_elem *elem = addr_map_find(map, &k, addr_map_hash(map, &k));
+  if (!elem) {
+    return false;
+  }
 
-  return (counter > 0);
+  ur_addr_map_value_type value = elem->value;
+  addr_map_erase(map, elem);
+  if (delfunc) {
+    delfunc(value);
+  }
+
+  return true;
 }
 
 void ur_addr_map_foreach(ur_addr_map *map, ur_addr_map_func func) {
-  if (ur_addr_map_valid(map)) {
-    for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-      addr_list_header *slh = &(map->lists[i]);
-      addr_list_foreach(slh, func);
+  if (ur_addr_map_valid(map) && func) {
+    for (size_t i = 0; i < map->capacity; i++) {
+      if (map->ctrl[i] >= 0) {
+        func(map->slots[i].value);
+      }
     }
   }
 }
 
+bool ur_addr_map_foreach_arg(const ur_addr_map *map, ur_addr_map_func_arg func, void *arg) {
+  if (ur_addr_map_valid(map) && func) {
+    for (size_t i = 0; i < map->capacity; i++) {
+      if (map->ctrl[i] >= 0) {
+        if (func(map->slots[i].value, arg)) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
 size_t ur_addr_map_num_elements(const ur_addr_map *map) {
   if (!ur_addr_map_valid(map)) {
     return 0;
   }
 
-  size_t ret = 0;
-  for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-    const addr_list_header *slh = &(map->lists[i]);
-    ret += addr_list_num_elements(slh);
-  }
-
-  return ret;
+  return map->elements;
 }
 
 size_t ur_addr_map_size(const ur_addr_map *map) {
@@ -784,13 +811,7 @@ size_t ur_addr_map_size(const ur_addr_map *map) {
     return 0;
   }
 
-  size_t ret = 0;
-  for (size_t i = 0; i < ADDR_MAP_SIZE; i++) {
-    const addr_list_header *slh = &(map->lists[i]);
-    ret += addr_list_size(slh);
-  }
-
-  return ret;
+  return map->capacity;
 }
 
 ////////////////////  STRING LISTS ///////////////////////////////////
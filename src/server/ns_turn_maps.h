@@ -188,28 +188,41 @@ bool lm_map_foreach_arg(lm_map *map, foreachcb_arg_type func, void *arg);
 
 typedef uintptr_t ur_addr_map_value_type;
 
-#define ADDR_MAP_SIZE (1024)
-#define ADDR_ARRAY_SIZE (4)
+/*
+ * Open addressing hash table (Swiss table layout): one control byte per
+ * slot holds 7 bits of the key hash, and the control bytes of a 16-slot
+ * group are matched all at once, so a lookup usually touches one control
+ * group and one slot. The table grows by doubling at 7/8 load.
+ */
+
+#define ADDR_MAP_GROUP_SIZE (16)
+
+/* Normalized remote address: the IPv4 address is stored in addr[0..3] */
+typedef struct _addr_map_key {
+  uint8_t addr[16];
+  uint16_t port;
+  uint16_t family;
+} addr_map_key;
 
 typedef struct _addr_elem {
-  ioa_addr key;
+  addr_map_key key;
   ur_addr_map_value_type value;
 } addr_elem;
 
-typedef struct _addr_list_header {
-  addr_elem main_list[ADDR_ARRAY_SIZE];
-  addr_elem *extra_list;
-  size_t extra_sz;
-} addr_list_header;
-
 struct _ur_addr_map {
-  addr_list_header lists[ADDR_MAP_SIZE];
+  int8_t *ctrl;
+  addr_elem *slots;
+  size_t capacity; /* slots number: 0, or a power of 2, not less than ADDR_MAP_GROUP_SIZE */
+  size_t elements;
+  size_t growth_left; /* inserts into empty slots until a rehash */
+  uint64_t seed;
   uint64_t magic;
 };
 
 typedef struct _ur_addr_map ur_addr_map;
 
 typedef void (*ur_addr_map_func)(ur_addr_map_value_type);
+typedef bool (*ur_addr_map_func_arg)(ur_addr_map_value_type, void *);
 
 void ur_addr_map_init(ur_addr_map *map);
 void ur_addr_map_clean(ur_addr_map *map);
@@ -238,7 +251,15 @@ bool ur_addr_map_del(ur_addr_map *map, ioa_addr *key, ur_addr_map_func func);
 
 void ur_addr_map_foreach(ur_addr_map *map, ur_addr_map_func func);
 
+/**
+ * @ret:
+ * true - func is called and returns true
+ * false - func is not called, or is called and returns false
+ */
+bool ur_addr_map_foreach_arg(const ur_addr_map *map, ur_addr_map_func_arg func, void *arg);
+
 size_t ur_addr_map_num_elements(const ur_addr_map *map);
+/* Slots number */
 size_t ur_addr_map_size(const ur_addr_map *map);
 
 //////////////// UR STRING MAP //////////////////
@@ -33,6 +33,7 @@
 #include "../apps/relay/ns_ioalib_impl.h"
 #include "ns_turn_allocation.h"
 #include "ns_turn_ioalib.h"
+#include "ns_turn_ip_trie.h"
 #include "ns_turn_msg_defs.h" // for STUN_ATTRIBUTE_NONCE
 #include "ns_turn_utils.h"
 
@@ -137,7 +138,7 @@ static inline void log_method(ts_ur_super_session *ss, const char *method, int e
 static int attach_socket_to_session(turn_turnserver *server, ioa_socket_handle s, ts_ur_super_session *ss);
 
 static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *resp_constructed,
-                           int *err_code, const uint8_t **reason, ioa_net_data *in_buffer,
+                           int *err_code, const uint8_t **reason, ioa_net_data *in_buffer, const stun_attr_index *attrs,
                            ioa_network_buffer_handle nbh, uint16_t method, int *message_integrity, int *postpone_reply,
                            int can_resume);
 
@@ -279,10 +280,6 @@ static int send_turn_message_to(turn_turnserver *server, ioa_network_buffer_hand
 /////////////////// Peer addr check /////////////////////////////
 
 static int good_peer_addr(turn_turnserver *server, const char *realm, ioa_addr *peer_addr, turnsession_id session_id) {
-#define CHECK_REALM(r)                                                                                                 \
-  if ((r)[0] && realm && realm[0] && strcmp((r), realm))                                                               \
-  continue
-
   turnserver_id server_id = (turnserver_id)(session_id / TURN_SESSION_ID_FACTOR);
   if (server && peer_addr) {
     if (*(server->no_multicast_peers) && ioa_addr_is_multicast(peer_addr)) {
@@ -295,78 +292,26 @@ static int good_peer_addr(turn_turnserver *server, const char *realm, ioa_addr *
       return 0;
     }
 
-    {
-      int i;
-
-      if (server->ip_whitelist) {
-        // White listing of addr ranges
-        for (i = server->ip_whitelist->ranges_number - 1; i >= 0; --i) {
-          CHECK_REALM(server->ip_whitelist->rs[i].realm);
-          if (ioa_addr_in_range(&(server->ip_whitelist->rs[i].enc), peer_addr)) {
-            return 1;
-          }
-        }
-      }
-
-      {
-        ioa_lock_whitelist(server->e);
-
-        const ip_range_list_t *wl = ioa_get_whitelist(server->e);
-        if (wl) {
-          // White listing of addr ranges
-          for (i = wl->ranges_number - 1; i >= 0; --i) {
-            CHECK_REALM(wl->rs[i].realm);
-            if (ioa_addr_in_range(&(wl->rs[i].enc), peer_addr)) {
-              ioa_unlock_whitelist(server->e);
-              return 1;
-            }
-          }
-        }
-
-        ioa_unlock_whitelist(server->e);
-      }
-
-      if (server->ip_blacklist) {
-        // Black listing of addr ranges
-        for (i = server->ip_blacklist->ranges_number - 1; i >= 0; --i) {
-          CHECK_REALM(server->ip_blacklist->rs[i].realm);
-          if (ioa_addr_in_range(&(server->ip_blacklist->rs[i].enc), peer_addr)) {
-            char saddr[129];
-            addr_to_string_no_port(peer_addr, (uint8_t *)saddr);
-            TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "session %018llu: A peer IP %s denied in the range: %s in server %d \n",
-                          (unsigned long long)session_id, saddr, server->ip_blacklist->rs[i].str, server_id);
-            return 0;
-          }
-        }
-      }
-
-      {
-        ioa_lock_blacklist(server->e);
-
-        const ip_range_list_t *bl = ioa_get_blacklist(server->e);
-        if (bl) {
-          // Black listing of addr ranges
-          for (i = bl->ranges_number - 1; i >= 0; --i) {
-            CHECK_REALM(bl->rs[i].realm);
-            if (ioa_addr_in_range(&(bl->rs[i].enc), peer_addr)) {
-              ioa_unlock_blacklist(server->e);
-              char saddr[129];
-              addr_to_string_no_port(peer_addr, (uint8_t *)saddr);
-              TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR,
-                            "session %018llu: A peer IP %s denied in the range= %s in server %d \n",
-                            (unsigned long long)session_id, saddr, bl->rs[i].str, server_id);
-              return 0;
-            }
-          }
-        }
+    // White listing of addr ranges
+    if (ip_range_trie_lookup(server->ip_whitelist, peer_addr, realm) ||
+        ip_range_trie_lookup(ioa_get_whitelist(server->e), peer_addr, realm)) {
+      return 1;
+    }
 
-        ioa_unlock_blacklist(server->e);
-      }
+    // Black listing of addr ranges
+    const ip_range_t *r = ip_range_trie_lookup(server->ip_blacklist, peer_addr, realm);
+    if (!r) {
+      r = ip_range_trie_lookup(ioa_get_blacklist(server->e), peer_addr, realm);
+    }
+    if (r) {
+      char saddr[129];
+      addr_to_string_no_port(peer_addr, (uint8_t *)saddr);
+      TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "session %018llu: A peer IP %s denied in the range: %s in server %d \n",
+                    (unsigned long long)session_id, saddr, r->str, server_id);
+      return 0;
     }
   }
 
-#undef CHECK_REALM
-
   return 1;
 }
 
@@ -562,38 +507,13 @@ int turn_session_info_copy_from(struct turn_session_info *tsi, ts_ur_super_sessi
       tsi->is_mobile = ss->is_mobile;
 
       {
-        size_t i;
-        for (i = 0; i < TURN_PERMISSION_HASHTABLE_SIZE; ++i) {
-
-          turn_permission_array *parray = &(ss->alloc.addr_to_perm.table[i]);
-
-          {
-            size_t j;
-            for (j = 0; j < TURN_PERMISSION_ARRAY_SIZE; ++j) {
-              turn_permission_slot *slot = &(parray->main_slots[j]);
-              if (slot->info.allocated) {
-                turn_session_info_add_peer(tsi, &(slot->info.addr));
-                struct tsi_arg arg = {tsi, &(slot->info.addr)};
-                lm_map_foreach_arg(&(slot->info.chns), turn_session_info_foreachcb, &arg);
-              }
-            }
-          }
-
-          {
-            turn_permission_slot **slots = parray->extra_slots;
-            if (slots) {
-              size_t sz = parray->extra_sz;
-              size_t j;
-              for (j = 0; j < sz; ++j) {
-                turn_permission_slot *slot = slots[j];
-                if (slot && slot->info.allocated) {
-                  turn_session_info_add_peer(tsi, &(slot->info.addr));
-                  struct tsi_arg arg = {tsi, &(slot->info.addr)};
-                  lm_map_foreach_arg(&(slot->info.chns), turn_session_info_foreachcb, &arg);
-                }
-              }
-            }
-          }
+        const turn_permission_table *map = &(ss->alloc.addr_to_perm);
+        const size_t sz = turn_permission_table_size(map);
+        for (size_t i = 0; i < sz; ++i) {
+          turn_permission_info *tinfo = turn_permission_table_get(map, i);
+          turn_session_info_add_peer(tsi, &(tinfo->addr));
+          struct tsi_arg arg = {tsi, &(tinfo->addr)};
+          lm_map_foreach_arg(&(tinfo->chns), turn_session_info_foreachcb, &arg);
         }
       }
 
@@ -820,6 +740,7 @@ static void delete_ur_map_ss(void *p, SOCKET_TYPE socket_type) {
     IOA_CLOSE_SOCKET(ss->client_socket);
     clear_allocation(get_allocation_ss(ss), socket_type);
     IOA_EVENT_DEL(ss->to_be_allocated_timeout_ev);
+    stun_hmac_ctx_clean(&(ss->hmac_ctx));
     free(p);
   }
 }
@@ -903,9 +824,12 @@ static int update_turn_permission_lifetime(ts_ur_super_session *ss, turn_permiss
       }
       tinfo->expiration_time = server->ctime + time_delta;
 
-      IOA_EVENT_DEL(tinfo->lifetime_ev);
-      tinfo->lifetime_ev = set_ioa_timer(server->e, time_delta, 0, client_ss_perm_timeout_handler, tinfo, 0,
-                                         "client_ss_channel_timeout_handler");
+      if (tinfo->lifetime_ev) {
+        restart_ioa_timer(tinfo->lifetime_ev, time_delta);
+      } else {
+        tinfo->lifetime_ev = set_ioa_timer(server->e, time_delta, 0, client_ss_perm_timeout_handler, tinfo, 0,
+                                           "client_ss_channel_timeout_handler");
+      }
 
       if (server->verbose) {
         tinfo->verbose = 1;
@@ -940,9 +864,13 @@ static int update_channel_lifetime(ts_ur_super_session *ss, ch_info *chn) {
 
         chn->expiration_time = server->ctime + *(server->channel_lifetime);
 
-        IOA_EVENT_DEL(chn->lifetime_ev);
-        chn->lifetime_ev = set_ioa_timer(server->e, *(server->channel_lifetime), 0, client_ss_channel_timeout_handler,
-                                         chn, 0, "client_ss_channel_timeout_handler");
+        if (chn->lifetime_ev) {
+          restart_ioa_timer(chn->lifetime_ev, *(server->channel_lifetime));
+        } else {
+          chn->lifetime_ev = set_ioa_timer(server->e, *(server->channel_lifetime), 0,
+                                           client_ss_channel_timeout_handler, chn, 0,
+                                           "client_ss_channel_timeout_handler");
+        }
 
         return 0;
       }
@@ -963,8 +891,7 @@ static int update_channel_lifetime(ts_ur_super_session *ss, ch_info *chn) {
   case STUN_ATTRIBUTE_REALM:                                                                                           \
   case STUN_ATTRIBUTE_NONCE:                                                                                           \
   case STUN_ATTRIBUTE_ORIGIN:                                                                                          \
-    sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh), \
-                                 sar);                                                                                 \
+    sar = stun_attr_index_next(attrs, sar);                                                                            \
     continue
 
 static uint8_t get_transport_value(const uint8_t *value) {
@@ -976,7 +903,7 @@ static uint8_t get_transport_value(const uint8_t *value) {
 
 static int handle_turn_allocate(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *resp_constructed,
                                 int *err_code, const uint8_t **reason, uint16_t *unknown_attrs, uint16_t *ua_num,
-                                ioa_net_data *in_buffer, ioa_network_buffer_handle nbh) {
+                                const stun_attr_index *attrs, ioa_network_buffer_handle nbh) {
 
   int err_code4 = 0;
   int err_code6 = 0;
@@ -1050,8 +977,7 @@ static int handle_turn_allocate(turn_turnserver *server, ts_ur_super_session *ss
     band_limit_t bps = 0;
     band_limit_t max_bps = 0;
 
-    stun_attr_ref sar =
-        stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+    stun_attr_ref sar = stun_attr_index_first(attrs);
     while (sar && (!(*err_code)) && (*ua_num < MAX_NUMBER_OF_UNKNOWN_ATTRS)) {
 
       int attr_type = stun_attr_get_type(sar);
@@ -1222,8 +1148,7 @@ static int handle_turn_allocate(turn_turnserver *server, ts_ur_super_session *ss
           unknown_attrs[(*ua_num)++] = nswap16(attr_type);
         }
       };
-      sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh),
-                                   sar);
+      sar = stun_attr_index_next(attrs, sar);
     }
 
     if (!transport) {
@@ -1505,8 +1430,8 @@ static void copy_auth_parameters(ts_ur_super_session *orig_ss, ts_ur_super_sessi
 
 static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *resp_constructed,
                                int *err_code, const uint8_t **reason, uint16_t *unknown_attrs, uint16_t *ua_num,
-                               ioa_net_data *in_buffer, ioa_network_buffer_handle nbh, int message_integrity,
-                               int *no_response, int can_resume) {
+                               ioa_net_data *in_buffer, const stun_attr_index *attrs, ioa_network_buffer_handle nbh,
+                               int message_integrity, int *no_response, int can_resume) {
 
   allocation *a = get_allocation_ss(ss);
   int af4c = 0;
@@ -1539,8 +1464,7 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
     mobile_id_t mid = 0;
     char smid[sizeof(ss->s_mobile_id)] = "\0";
 
-    stun_attr_ref sar =
-        stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+    stun_attr_ref sar = stun_attr_index_first(attrs);
     while (sar && (!(*err_code)) && (*ua_num < MAX_NUMBER_OF_UNKNOWN_ATTRS)) {
       int attr_type = stun_attr_get_type(sar);
       switch (attr_type) {
@@ -1621,8 +1545,7 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
           unknown_attrs[(*ua_num)++] = nswap16(attr_type);
         }
       };
-      sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh),
-                                   sar);
+      sar = stun_attr_index_next(attrs, sar);
     }
 
     if (*ua_num > 0) {
@@ -1692,7 +1615,7 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
               copy_auth_parameters(orig_ss, ss);
             }
 
-            if (check_stun_auth(server, ss, tid, resp_constructed, err_code, reason, in_buffer, nbh,
+            if (check_stun_auth(server, ss, tid, resp_constructed, err_code, reason, in_buffer, attrs, nbh,
                                 STUN_METHOD_REFRESH, &message_integrity, &postpone_reply, can_resume) < 0) {
               if (!(*err_code)) {
                 *err_code = 401;
@@ -1782,8 +1705,8 @@ static int handle_turn_refresh(turn_turnserver *server, ts_ur_super_session *ss,
 
                     if (message_integrity) {
                       size_t len = ioa_network_buffer_get_size(nbh);
-                      stun_attr_add_integrity_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
-                                                  SHATYPE_DEFAULT);
+                      stun_attr_add_integrity_ctx_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey,
+                                                      ss->pwd, SHATYPE_DEFAULT, &(ss->hmac_ctx));
                       ioa_network_buffer_set_size(nbh, len);
                     }
 
@@ -2061,8 +1984,8 @@ static void tcp_peer_connection_completed_callback(int success, void *arg) {
     ioa_network_buffer_set_size(nbh, len);
 
     if (need_stun_authentication(server, ss)) {
-      stun_attr_add_integrity_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
-                                  SHATYPE_DEFAULT);
+      stun_attr_add_integrity_ctx_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
+                                      SHATYPE_DEFAULT, &(ss->hmac_ctx));
       ioa_network_buffer_set_size(nbh, len);
     }
 
@@ -2272,7 +2195,7 @@ static void tcp_peer_accept_connection(ioa_socket_handle s, void *arg) {
 
 static int handle_turn_connect(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *err_code,
                                const uint8_t **reason, uint16_t *unknown_attrs, uint16_t *ua_num,
-                               ioa_net_data *in_buffer) {
+                               ioa_net_data *in_buffer, const stun_attr_index *attrs) {
 
   FUNCSTART;
   ioa_addr peer_addr;
@@ -2287,8 +2210,7 @@ static int handle_turn_connect(turn_turnserver *server, ts_ur_super_session *ss,
     *err_code = 437;
   } else {
 
-    stun_attr_ref sar =
-        stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+    stun_attr_ref sar = stun_attr_index_first(attrs);
     while (sar && (!(*err_code)) && (*ua_num < MAX_NUMBER_OF_UNKNOWN_ATTRS)) {
       int attr_type = stun_attr_get_type(sar);
       switch (attr_type) {
@@ -2313,8 +2235,7 @@ static int handle_turn_connect(turn_turnserver *server, ts_ur_super_session *ss,
           unknown_attrs[(*ua_num)++] = nswap16(attr_type);
         }
       };
-      sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh),
-                                   sar);
+      sar = stun_attr_index_next(attrs, sar);
     }
 
     if (*ua_num > 0) {
@@ -2347,7 +2268,8 @@ static int handle_turn_connect(turn_turnserver *server, ts_ur_super_session *ss,
 static int handle_turn_connection_bind(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid,
                                        int *resp_constructed, int *err_code, const uint8_t **reason,
                                        uint16_t *unknown_attrs, uint16_t *ua_num, ioa_net_data *in_buffer,
-                                       ioa_network_buffer_handle nbh, int message_integrity, int can_resume) {
+                                       const stun_attr_index *attrs, ioa_network_buffer_handle nbh,
+                                       int message_integrity, int can_resume) {
 
   allocation *a = get_allocation_ss(ss);
 
@@ -2370,8 +2292,7 @@ static int handle_turn_connection_bind(turn_turnserver *server, ts_ur_super_sess
   } else {
     tcp_connection_id id = 0;
 
-    stun_attr_ref sar =
-        stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+    stun_attr_ref sar = stun_attr_index_first(attrs);
     while (sar && (!(*err_code)) && (*ua_num < MAX_NUMBER_OF_UNKNOWN_ATTRS)) {
       int attr_type = stun_attr_get_type(sar);
       switch (attr_type) {
@@ -2395,8 +2316,7 @@ static int handle_turn_connection_bind(turn_turnserver *server, ts_ur_super_sess
           unknown_attrs[(*ua_num)++] = nswap16(attr_type);
         }
       };
-      sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh),
-                                   sar);
+      sar = stun_attr_index_next(attrs, sar);
     }
 
     if (*ua_num > 0) {
@@ -2484,7 +2404,10 @@ int turnserver_accept_tcp_client_data_connection(turn_turnserver *server, tcp_co
         } else {
           // Check security:
           int postpone_reply = 0;
-          check_stun_auth(server, ss, tid, &resp_constructed, &err_code, &reason, in_buffer, nbh,
+          stun_attr_index attrs;
+          stun_attr_index_init(&attrs, ioa_network_buffer_data(in_buffer->nbh),
+                               ioa_network_buffer_get_size(in_buffer->nbh));
+          check_stun_auth(server, ss, tid, &resp_constructed, &err_code, &reason, in_buffer, &attrs, nbh,
                           STUN_METHOD_CONNECTION_BIND, &message_integrity, &postpone_reply, can_resume);
 
           if (postpone_reply) {
@@ -2532,8 +2455,8 @@ int turnserver_accept_tcp_client_data_connection(turn_turnserver *server, tcp_co
 
     if (message_integrity && ss) {
       size_t len = ioa_network_buffer_get_size(nbh);
-      stun_attr_add_integrity_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
-                                  SHATYPE_DEFAULT);
+      stun_attr_add_integrity_ctx_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
+                                      SHATYPE_DEFAULT, &(ss->hmac_ctx));
       ioa_network_buffer_set_size(nbh, len);
     }
 
@@ -2575,7 +2498,7 @@ int turnserver_accept_tcp_client_data_connection(turn_turnserver *server, tcp_co
 static int handle_turn_channel_bind(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid,
                                     int *resp_constructed, int *err_code, const uint8_t **reason,
                                     uint16_t *unknown_attrs, uint16_t *ua_num, ioa_net_data *in_buffer,
-                                    ioa_network_buffer_handle nbh) {
+                                    const stun_attr_index *attrs, ioa_network_buffer_handle nbh) {
 
   FUNCSTART;
   uint16_t chnum = 0;
@@ -2589,8 +2512,7 @@ static int handle_turn_channel_bind(turn_turnserver *server, ts_ur_super_session
     *reason = (const uint8_t *)"Channel bind cannot be used with TCP relay";
   } else if (is_allocation_valid(a)) {
 
-    stun_attr_ref sar =
-        stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+    stun_attr_ref sar = stun_attr_index_first(attrs);
     while (sar && (!(*err_code)) && (*ua_num < MAX_NUMBER_OF_UNKNOWN_ATTRS)) {
       int attr_type = stun_attr_get_type(sar);
       switch (attr_type) {
@@ -2632,8 +2554,7 @@ static int handle_turn_channel_bind(turn_turnserver *server, ts_ur_super_session
           unknown_attrs[(*ua_num)++] = nswap16(attr_type);
         }
       };
-      sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh),
-                                   sar);
+      sar = stun_attr_index_next(attrs, sar);
     }
 
     if (*ua_num > 0) {
@@ -2742,9 +2663,9 @@ static int handle_turn_channel_bind(turn_turnserver *server, ts_ur_super_session
 
 static int handle_turn_binding(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *resp_constructed,
                                int *err_code, const uint8_t **reason, uint16_t *unknown_attrs, uint16_t *ua_num,
-                               ioa_net_data *in_buffer, ioa_network_buffer_handle nbh, int *origin_changed,
-                               ioa_addr *response_origin, int *dest_changed, ioa_addr *response_destination,
-                               uint32_t cookie, int old_stun) {
+                               ioa_net_data *in_buffer, const stun_attr_index *attrs, ioa_network_buffer_handle nbh,
+                               int *origin_changed, ioa_addr *response_origin, int *dest_changed,
+                               ioa_addr *response_destination, uint32_t cookie, int old_stun) {
 
   FUNCSTART;
   bool change_ip = false;
@@ -2762,8 +2683,7 @@ static int handle_turn_binding(turn_turnserver *server, ts_ur_super_session *ss,
   *origin_changed = 0;
   *dest_changed = 0;
 
-  stun_attr_ref sar =
-      stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+  stun_attr_ref sar = stun_attr_index_first(attrs);
   while (sar && (!(*err_code)) && (*ua_num < MAX_NUMBER_OF_UNKNOWN_ATTRS)) {
     int attr_type = stun_attr_get_type(sar);
     switch (attr_type) {
@@ -2840,8 +2760,7 @@ static int handle_turn_binding(turn_turnserver *server, ts_ur_super_session *ss,
         unknown_attrs[(*ua_num)++] = nswap16(attr_type);
       }
     };
-    sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh),
-                                 sar);
+    sar = stun_attr_index_next(attrs, sar);
   }
 
   if (*ua_num > 0) {
@@ -2937,7 +2856,8 @@ static int handle_turn_binding(turn_turnserver *server, ts_ur_super_session *ss,
 }
 
 static int handle_turn_send(turn_turnserver *server, ts_ur_super_session *ss, int *err_code, const uint8_t **reason,
-                            uint16_t *unknown_attrs, uint16_t *ua_num, ioa_net_data *in_buffer) {
+                            uint16_t *unknown_attrs, uint16_t *ua_num, ioa_net_data *in_buffer,
+                            const stun_attr_index *attrs) {
 
   FUNCSTART;
 
@@ -2955,8 +2875,7 @@ static int handle_turn_send(turn_turnserver *server, ts_ur_super_session *ss, in
     *reason = (const uint8_t *)"Send cannot be used with TCP relay";
   } else if (is_allocation_valid(a) && (in_buffer->recv_ttl != 0)) {
 
-    stun_attr_ref sar =
-        stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+    stun_attr_ref sar = stun_attr_index_first(attrs);
     while (sar && (!(*err_code)) && (*ua_num < MAX_NUMBER_OF_UNKNOWN_ATTRS)) {
       int attr_type = stun_attr_get_type(sar);
       switch (attr_type) {
@@ -2991,8 +2910,7 @@ static int handle_turn_send(turn_turnserver *server, ts_ur_super_session *ss, in
           unknown_attrs[(*ua_num)++] = nswap16(attr_type);
         }
       };
-      sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh),
-                                   sar);
+      sar = stun_attr_index_next(attrs, sar);
     }
 
     if (*err_code) {
@@ -3078,7 +2996,7 @@ static int update_permission(ts_ur_super_session *ss, ioa_addr *peer_addr) {
 static int handle_turn_create_permission(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid,
                                          int *resp_constructed, int *err_code, const uint8_t **reason,
                                          uint16_t *unknown_attrs, uint16_t *ua_num, ioa_net_data *in_buffer,
-                                         ioa_network_buffer_handle nbh) {
+                                         const stun_attr_index *attrs, ioa_network_buffer_handle nbh) {
 
   int ret = -1;
 
@@ -3091,8 +3009,7 @@ static int handle_turn_create_permission(turn_turnserver *server, ts_ur_super_se
   if (is_allocation_valid(a)) {
 
     {
-      stun_attr_ref sar =
-          stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+      stun_attr_ref sar = stun_attr_index_first(attrs);
 
       while (sar && (!(*err_code)) && (*ua_num < MAX_NUMBER_OF_UNKNOWN_ATTRS)) {
 
@@ -3125,8 +3042,7 @@ static int handle_turn_create_permission(turn_turnserver *server, ts_ur_super_se
             unknown_attrs[(*ua_num)++] = nswap16(attr_type);
           }
         };
-        sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh),
-                                     ioa_network_buffer_get_size(in_buffer->nbh), sar);
+        sar = stun_attr_index_next(attrs, sar);
       }
     }
 
@@ -3145,8 +3061,7 @@ static int handle_turn_create_permission(turn_turnserver *server, ts_ur_super_se
 
     } else {
 
-      stun_attr_ref sar =
-          stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+      stun_attr_ref sar = stun_attr_index_first(attrs);
 
       while (sar) {
 
@@ -3173,8 +3088,7 @@ static int handle_turn_create_permission(turn_turnserver *server, ts_ur_super_se
         default:;
         }
 
-        sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh),
-                                     ioa_network_buffer_get_size(in_buffer->nbh), sar);
+        sar = stun_attr_index_next(attrs, sar);
       }
 
       if (*err_code == 0) {
@@ -3267,7 +3181,7 @@ static void resume_processing_after_username_check(int success, int oauth, int m
 }
 
 static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stun_tid *tid, int *resp_constructed,
-                           int *err_code, const uint8_t **reason, ioa_net_data *in_buffer,
+                           int *err_code, const uint8_t **reason, ioa_net_data *in_buffer, const stun_attr_index *attrs,
                            ioa_network_buffer_handle nbh, uint16_t method, int *message_integrity, int *postpone_reply,
                            int can_resume) {
   uint8_t usname[STUN_MAX_USERNAME_SIZE + 1];
@@ -3317,9 +3231,7 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
 
   /* MESSAGE_INTEGRITY ATTR: */
 
-  stun_attr_ref sar =
-      stun_attr_get_first_by_type_str(ioa_network_buffer_data(in_buffer->nbh),
-                                      ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
+  stun_attr_ref sar = stun_attr_index_get(attrs, STUN_ATTRIBUTE_MESSAGE_INTEGRITY);
 
   if (!sar) {
     *err_code = 401;
@@ -3345,8 +3257,7 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
 
     /* REALM ATTR: */
 
-    sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(in_buffer->nbh),
-                                          ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_REALM);
+    sar = stun_attr_index_get(attrs, STUN_ATTRIBUTE_REALM);
 
     if (!sar) {
       *err_code = 400;
@@ -3387,8 +3298,7 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
 
   /* USERNAME ATTR: */
 
-  sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(in_buffer->nbh),
-                                        ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_USERNAME);
+  sar = stun_attr_index_get(attrs, STUN_ATTRIBUTE_USERNAME);
 
   if (!sar) {
     *err_code = 400;
@@ -3427,8 +3337,7 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
   {
     /* NONCE ATTR: */
 
-    sar = stun_attr_get_first_by_type_str(ioa_network_buffer_data(in_buffer->nbh),
-                                          ioa_network_buffer_get_size(in_buffer->nbh), STUN_ATTRIBUTE_NONCE);
+    sar = stun_attr_index_get(attrs, STUN_ATTRIBUTE_NONCE);
 
     if (!sar) {
       *err_code = 400;
@@ -3457,13 +3366,20 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
   /* Password */
   if (!(ss->hmackey_set) && (ss->pwd[0] == 0)) {
     if (can_resume) {
-      (server->userkeycb)(server->id, server->ct, server->oauth, &(ss->oauth), usname, realm,
-                          resume_processing_after_username_check, in_buffer, ss->id, postpone_reply);
+      const uint8_t *key = (server->userkeycb)(server->id, server->ct, server->oauth, &(ss->oauth), usname, realm,
+                                               resume_processing_after_username_check, in_buffer, ss->id,
+                                               postpone_reply);
       if (*postpone_reply) {
         return 0;
       }
+      if (key) {
+        memcpy(ss->hmackey, key, sizeof(hmackey_t));
+        ss->hmackey_set = 1;
+      }
     }
+  }
 
+  if (!(ss->hmackey_set) && (ss->pwd[0] == 0)) {
     TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "session %018llu: %s: Cannot find credentials of user <%s>\n",
                   (unsigned long long)(ss->id), __FUNCTION__, (char *)usname);
     *err_code = 401;
@@ -3471,16 +3387,25 @@ static int check_stun_auth(turn_turnserver *server, ts_ur_super_session *ss, stu
   }
 
   /* Check integrity */
-  if (stun_check_message_integrity_by_key_str(server->ct, ioa_network_buffer_data(in_buffer->nbh),
-                                              ioa_network_buffer_get_size(in_buffer->nbh), ss->hmackey, ss->pwd,
-                                              SHATYPE_DEFAULT) < 1) {
+  if (stun_check_message_integrity_by_key_attr_str(server->ct, ioa_network_buffer_data(in_buffer->nbh),
+                                                   ioa_network_buffer_get_size(in_buffer->nbh),
+                                                   stun_attr_index_get(attrs, STUN_ATTRIBUTE_MESSAGE_INTEGRITY),
+                                                   ss->hmackey, ss->pwd, SHATYPE_DEFAULT, &(ss->hmac_ctx)) < 1) {
 
     if (can_resume) {
-      (server->userkeycb)(server->id, server->ct, server->oauth, &(ss->oauth), usname, realm,
-                          resume_processing_after_username_check, in_buffer, ss->id, postpone_reply);
+      const uint8_t *key = (server->userkeycb)(server->id, server->ct, server->oauth, &(ss->oauth), usname, realm,
+                                               resume_processing_after_username_check, in_buffer, ss->id,
+                                               postpone_reply);
       if (*postpone_reply) {
         return 0;
       }
+      if (key) {
+        /* the key has been checked against this request already */
+        memcpy(ss->hmackey, key, sizeof(hmackey_t));
+        ss->hmackey_set = 1;
+        *message_integrity = 1;
+        return 0;
+      }
     }
 
     TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "session %018llu: %s: user %s credentials are incorrect\n",
@@ -3535,7 +3460,8 @@ static void set_alternate_server(turn_server_addrs_list_t *asl, const ioa_addr *
 }
 
 static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss, ioa_net_data *in_buffer,
-                               ioa_network_buffer_handle nbh, int *resp_constructed, int can_resume) {
+                               const stun_attr_index *attrs, ioa_network_buffer_handle nbh, int *resp_constructed,
+                               int can_resume) {
 
   stun_tid tid;
   int err_code = 0;
@@ -3609,8 +3535,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
 
       /* check that the realm is the same as in the original request */
       if (ss->origin_set) {
-        stun_attr_ref sar = stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh),
-                                                    ioa_network_buffer_get_size(in_buffer->nbh));
+        stun_attr_ref sar = stun_attr_index_first(attrs);
 
         int origin_found = 0;
         int norigins = 0;
@@ -3636,8 +3561,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
               free(o);
             }
           }
-          sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh),
-                                       ioa_network_buffer_get_size(in_buffer->nbh), sar);
+          sar = stun_attr_index_next(attrs, sar);
         }
 
         if (server->check_origin && *(server->check_origin)) {
@@ -3666,8 +3590,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       /* get the initial origin value */
       if (!err_code && !(ss->origin_set) && (method == STUN_METHOD_ALLOCATE)) {
 
-        stun_attr_ref sar = stun_attr_get_first_str(ioa_network_buffer_data(in_buffer->nbh),
-                                                    ioa_network_buffer_get_size(in_buffer->nbh));
+        stun_attr_ref sar = stun_attr_index_first(attrs);
 
         int origin_found = 0;
 
@@ -3690,8 +3613,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
               origin_found = get_realm_options_by_origin(ss->origin, &(ss->realm_options));
             }
           }
-          sar = stun_attr_get_next_str(ioa_network_buffer_data(in_buffer->nbh),
-                                       ioa_network_buffer_get_size(in_buffer->nbh), sar);
+          sar = stun_attr_index_next(attrs, sar);
         }
 
         ss->origin_set = 1;
@@ -3703,7 +3625,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
         } else if (!(*(server->mobility)) || (method != STUN_METHOD_REFRESH) ||
                    is_allocation_valid(get_allocation_ss(ss))) {
           int postpone_reply = 0;
-          check_stun_auth(server, ss, &tid, resp_constructed, &err_code, &reason, in_buffer, nbh, method,
+          check_stun_auth(server, ss, &tid, resp_constructed, &err_code, &reason, in_buffer, attrs, nbh, method,
                           &message_integrity, &postpone_reply, can_resume);
           if (postpone_reply) {
             no_response = 1;
@@ -3719,7 +3641,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       case STUN_METHOD_ALLOCATE:
 
       {
-        handle_turn_allocate(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num, in_buffer,
+        handle_turn_allocate(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num, attrs,
                              nbh);
 
         if (server->verbose) {
@@ -3731,7 +3653,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
 
       case STUN_METHOD_CONNECT:
 
-        handle_turn_connect(server, ss, &tid, &err_code, &reason, unknown_attrs, &ua_num, in_buffer);
+        handle_turn_connect(server, ss, &tid, &err_code, &reason, unknown_attrs, &ua_num, in_buffer, attrs);
 
         if (server->verbose) {
           log_method(ss, "CONNECT", err_code, reason);
@@ -3746,7 +3668,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       case STUN_METHOD_CONNECTION_BIND:
 
         handle_turn_connection_bind(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num,
-                                    in_buffer, nbh, message_integrity, can_resume);
+                                    in_buffer, attrs, nbh, message_integrity, can_resume);
 
         if (server->verbose && err_code) {
           log_method(ss, "CONNECTION_BIND", err_code, reason);
@@ -3757,7 +3679,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       case STUN_METHOD_REFRESH:
 
         handle_turn_refresh(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num, in_buffer,
-                            nbh, message_integrity, &no_response, can_resume);
+                            attrs, nbh, message_integrity, &no_response, can_resume);
 
         if (server->verbose) {
           log_method(ss, "REFRESH", err_code, reason);
@@ -3767,7 +3689,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       case STUN_METHOD_CHANNEL_BIND:
 
         handle_turn_channel_bind(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num,
-                                 in_buffer, nbh);
+                                 in_buffer, attrs, nbh);
 
         if (server->verbose) {
           log_method(ss, "CHANNEL_BIND", err_code, reason);
@@ -3777,7 +3699,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
       case STUN_METHOD_CREATE_PERMISSION:
 
         handle_turn_create_permission(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num,
-                                      in_buffer, nbh);
+                                      in_buffer, attrs, nbh);
 
         if (server->verbose) {
           log_method(ss, "CREATE_PERMISSION", err_code, reason);
@@ -3793,7 +3715,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
         ioa_addr response_destination;
 
         handle_turn_binding(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num, in_buffer,
-                            nbh, &origin_changed, &response_origin, &dest_changed, &response_destination, 0, 0);
+                            attrs, nbh, &origin_changed, &response_origin, &dest_changed, &response_destination, 0, 0);
 
         if (server->verbose && *(server->log_binding)) {
           log_method(ss, "BINDING", err_code, reason);
@@ -3837,7 +3759,7 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
 
       case STUN_METHOD_SEND:
 
-        handle_turn_send(server, ss, &err_code, &reason, unknown_attrs, &ua_num, in_buffer);
+        handle_turn_send(server, ss, &err_code, &reason, unknown_attrs, &ua_num, in_buffer, attrs);
 
         if (eve(server->verbose)) {
           log_method(ss, "SEND", err_code, reason);
@@ -3910,8 +3832,8 @@ static int handle_turn_command(turn_turnserver *server, ts_ur_super_session *ss,
 
     if (message_integrity) {
       size_t len = ioa_network_buffer_get_size(nbh);
-      stun_attr_add_integrity_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
-                                  SHATYPE_DEFAULT);
+      stun_attr_add_integrity_ctx_str(server->ct, ioa_network_buffer_data(nbh), &len, ss->hmackey, ss->pwd,
+                                      SHATYPE_DEFAULT, &(ss->hmac_ctx));
       ioa_network_buffer_set_size(nbh, len);
     }
 
@@ -3945,6 +3867,9 @@ static int handle_old_stun_command(turn_turnserver *server, ts_ur_super_session
 
   stun_tid_from_message_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh), &tid);
 
+  stun_attr_index attrs;
+  stun_attr_index_init(&attrs, ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
+
   if (stun_is_request_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh))) {
 
     if (method != STUN_METHOD_BINDING) {
@@ -3962,7 +3887,8 @@ static int handle_old_stun_command(turn_turnserver *server, ts_ur_super_session
       ioa_addr response_destination;
 
       handle_turn_binding(server, ss, &tid, resp_constructed, &err_code, &reason, unknown_attrs, &ua_num, in_buffer,
-                          nbh, &origin_changed, &response_origin, &dest_changed, &response_destination, cookie, 1);
+                          &attrs, nbh, &origin_changed, &response_origin, &dest_changed, &response_destination, cookie,
+                          1);
 
       if (server->verbose && *(server->log_binding)) {
         log_method(ss, "OLD BINDING", err_code, reason);
@@ -4058,6 +3984,35 @@ static int handle_old_stun_command(turn_turnserver *server, ts_ur_super_session
 
 //////////////////////////////////////////////////////////////////
 
+static int send_channel_data_to_peer(ts_ur_super_session *ss, ch_info *chn, ioa_net_data *in_buffer) {
+
+  ioa_socket_handle relay_s = get_relay_socket_ss(ss, chn->peer_addr.ss.sa_family);
+
+  /* Channel packets are always sent with DF=0: */
+  set_df_on_ioa_socket(relay_s, 0);
+
+  ioa_network_buffer_handle nbh = in_buffer->nbh;
+
+  ioa_network_buffer_add_offset_size(nbh, STUN_CHANNEL_HEADER_LENGTH, 0,
+                                     ioa_network_buffer_get_size(nbh) - STUN_CHANNEL_HEADER_LENGTH);
+
+  ioa_network_buffer_header_init(nbh);
+
+  int skip = 0;
+  int rc = send_data_from_ioa_socket_nbh(relay_s, &(chn->peer_addr), nbh, in_buffer->recv_ttl - 1,
+                                         in_buffer->recv_tos, &skip);
+
+  if (!skip && rc > -1) {
+    ++(ss->peer_sent_packets);
+    ss->peer_sent_bytes += (uint32_t)ioa_network_buffer_get_size(nbh);
+    turn_report_session_usage(ss, 0);
+  }
+
+  in_buffer->nbh = NULL;
+
+  return rc;
+}
+
 static int write_to_peerchannel(ts_ur_super_session *ss, uint16_t chnum, ioa_net_data *in_buffer) {
 
   int rc = 0;
@@ -4074,31 +4029,64 @@ static int write_to_peerchannel(ts_ur_super_session *ss, uint16_t chnum, ioa_net
         return -1;
       }
 
-      /* Channel packets are always sent with DF=0: */
-      set_df_on_ioa_socket(get_relay_socket_ss(ss, chn->peer_addr.ss.sa_family), 0);
+      ++(((turn_turnserver *)ss->server)->channel_data_slow);
 
-      ioa_network_buffer_handle nbh = in_buffer->nbh;
+      rc = send_channel_data_to_peer(ss, chn, in_buffer);
+    }
+  }
 
-      ioa_network_buffer_add_offset_size(in_buffer->nbh, STUN_CHANNEL_HEADER_LENGTH, 0,
-                                         ioa_network_buffer_get_size(in_buffer->nbh) - STUN_CHANNEL_HEADER_LENGTH);
+  return rc;
+}
 
-      ioa_network_buffer_header_init(nbh);
+/*
+ * ChannelData fast path: the data of a bound channel goes to the peer
+ * without the generic client read path.
+ * Return false to leave the packet to read_client_connection().
+ */
+static bool client_channel_data_fast_path(turn_turnserver *server, ts_ur_super_session *ss, ioa_net_data *in_buffer) {
 
-      int skip = 0;
-      rc = send_data_from_ioa_socket_nbh(get_relay_socket_ss(ss, chn->peer_addr.ss.sa_family), &(chn->peer_addr), nbh,
-                                         in_buffer->recv_ttl - 1, in_buffer->recv_tos, &skip);
+  ioa_network_buffer_handle nbh = in_buffer->nbh;
+  const uint8_t *data = ioa_network_buffer_data(nbh);
+  size_t orig_blen = ioa_network_buffer_get_size(nbh);
 
-      if (!skip && rc > -1) {
-        ++(ss->peer_sent_packets);
-        ss->peer_sent_bytes += (uint32_t)ioa_network_buffer_get_size(in_buffer->nbh);
-        turn_report_session_usage(ss, 0);
-      }
+  /* The first two bits of a ChannelData message are 01 */
+  if ((orig_blen < STUN_CHANNEL_HEADER_LENGTH) || ((data[0] & 0xC0) != 0x40) || !(in_buffer->recv_ttl) ||
+      ss->to_be_closed || ss->is_tcp_relay) {
+    return false;
+  }
 
-      in_buffer->nbh = NULL;
-    }
+  allocation *a = get_allocation_ss(ss);
+  if (!is_allocation_valid(a)) {
+    return false;
   }
 
-  return rc;
+  uint16_t chnum = 0;
+  size_t blen = orig_blen;
+  ioa_socket_handle s = ss->client_socket;
+  if (!stun_is_channel_message_str(data, &blen, &chnum, is_stream_socket(get_ioa_socket_type(s))) ||
+      (blen > orig_blen)) {
+    return false;
+  }
+
+  ch_info *chn = allocation_get_ch_info(a, chnum);
+  if (!chn || ioa_socket_tobeclosed(s)) {
+    return false;
+  }
+
+  SOCKET_APP_TYPE sat = get_ioa_socket_app_type(s);
+  if ((sat == HTTP_CLIENT_SOCKET) || (sat == HTTPS_CLIENT_SOCKET)) {
+    return false;
+  }
+
+  ++(server->channel_data_fast);
+  ++(ss->received_packets);
+  ss->received_bytes += (uint32_t)orig_blen;
+  turn_report_session_usage(ss, 0);
+
+  ioa_network_buffer_set_size(nbh, blen);
+  send_channel_data_to_peer(ss, chn, in_buffer);
+
+  return true;
 }
 
 static void client_input_handler(ioa_socket_handle s, int event_type, ioa_net_data *data, void *arg, int can_resume);
@@ -4433,11 +4421,16 @@ static int refresh_relay_connection(turn_turnserver *server, ts_ur_super_session
       lifetime = 1;
     }
 
-    ioa_timer_handle ev =
-        set_ioa_timer(server->e, lifetime, 0, client_ss_allocation_timeout_handler, get_relay_session(a, family), 0,
-                      "refresh_client_ss_allocation_timeout_handler");
+    relay_endpoint_session *rsession = get_relay_session(a, family);
 
-    set_allocation_lifetime_ev(a, server->ctime + lifetime, ev, family);
+    if (rsession->lifetime_ev) {
+      restart_ioa_timer(rsession->lifetime_ev, lifetime);
+      rsession->expiration_time = server->ctime + lifetime;
+    } else {
+      ioa_timer_handle ev = set_ioa_timer(server->e, lifetime, 0, client_ss_allocation_timeout_handler, rsession, 0,
+                                          "refresh_client_ss_allocation_timeout_handler");
+      set_allocation_lifetime_ev(a, server->ctime + lifetime, ev, family);
+    }
 
     return 0;
 
@@ -4476,6 +4469,7 @@ static int read_client_connection(turn_turnserver *server, ts_ur_super_session *
 
   uint16_t chnum = 0;
   uint32_t old_stun_cookie = 0;
+  stun_attr_index attrs;
 
   size_t blen = ioa_network_buffer_get_size(in_buffer->nbh);
   size_t orig_blen = blen;
@@ -4519,9 +4513,9 @@ static int read_client_connection(turn_turnserver *server, ts_ur_super_session *
     FUNCEND;
     return 0;
 
-  } else if (stun_is_command_message_full_check_str(ioa_network_buffer_data(in_buffer->nbh),
-                                                    ioa_network_buffer_get_size(in_buffer->nbh), 0,
-                                                    &(ss->enforce_fingerprints))) {
+  } else if (stun_attr_index_init(&attrs, ioa_network_buffer_data(in_buffer->nbh),
+                                  ioa_network_buffer_get_size(in_buffer->nbh)) &&
+             stun_is_command_message_full_check_idx(&attrs, 0, &(ss->enforce_fingerprints))) {
 
     ioa_network_buffer_handle nbh = ioa_network_buffer_allocate(server->e);
     int resp_constructed = 0;
@@ -4529,7 +4523,7 @@ static int read_client_connection(turn_turnserver *server, ts_ur_super_session *
     uint16_t method =
         stun_get_method_str(ioa_network_buffer_data(in_buffer->nbh), ioa_network_buffer_get_size(in_buffer->nbh));
 
-    handle_turn_command(server, ss, in_buffer, nbh, &resp_constructed, can_resume);
+    handle_turn_command(server, ss, in_buffer, &attrs, nbh, &resp_constructed, can_resume);
 
     if ((method != STUN_METHOD_BINDING) && (method != STUN_METHOD_SEND)) {
       report_turn_session_info(server, ss, 0);
@@ -4797,10 +4791,12 @@ static void peer_input_handler(ioa_socket_handle s, int event_type, ioa_net_data
 
   ioa_network_buffer_handle nbh = NULL;
 
-  turn_permission_info *tinfo = allocation_get_permission(a, &(in_buffer->src_addr));
-  if (tinfo) {
-    chnum = get_turn_channel_number(tinfo, &(in_buffer->src_addr));
-  } else if (!(server->server_relay)) {
+  ch_info *chn = allocation_get_ch_info_by_peer_addr(a, &(in_buffer->src_addr));
+  if (chn) {
+    /* A channel implies the permission */
+    chnum = chn->chnum;
+    ++(server->channel_data_fast);
+  } else if (!(server->server_relay) && !allocation_get_permission(a, &(in_buffer->src_addr))) {
     return;
   }
 
@@ -4872,6 +4868,10 @@ static void client_input_handler(ioa_socket_handle s, int event_type, ioa_net_da
     return;
   }
 
+  if (client_channel_data_fast_path(server, ss, data)) {
+    return;
+  }
+
   read_client_connection(server, ss, data, can_resume, 1);
 
   if (ss->to_be_closed) {
@@ -4963,8 +4963,12 @@ void init_turn_server(turn_turnserver *server, turnserver_id id, int verbose, io
 
   server->verbose = verbose;
 
-  server->ip_whitelist = ip_whitelist;
-  server->ip_blacklist = ip_blacklist;
+  server->ip_whitelist = ip_range_trie_build(ip_whitelist);
+  server->ip_blacklist = ip_range_trie_build(ip_blacklist);
+  if ((!server->ip_whitelist && ip_whitelist && ip_whitelist->ranges_number) ||
+      (!server->ip_blacklist && ip_blacklist && ip_blacklist->ranges_number)) {
+    TURN_LOG_FUNC(TURN_LOG_LEVEL_ERROR, "Cannot compile the IP white/black lists\n");
+  }
 
   server->send_socket_to_relay = send_socket_to_relay;
 
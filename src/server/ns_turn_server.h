@@ -101,6 +101,11 @@ typedef struct _turn_turnserver turn_turnserver;
 typedef void (*get_username_resume_cb)(int success, int oauth, int max_session_time, hmackey_t hmackey, password_t pwd,
                                        turn_turnserver *server, uint64_t ctxkey, ioa_net_data *in_buffer,
                                        uint8_t *realm);
+/*
+ * Either postpones the reply until resume is called with the result, or
+ * answers at once with *postpone_reply cleared: the key of the user, already
+ * checked against in_buffer, or NULL if the user is rejected.
+ */
 typedef uint8_t *(*get_user_key_cb)(turnserver_id id, turn_credential_type ct, int in_oauth, int *out_oauth,
                                     uint8_t *uname, uint8_t *realm, get_username_resume_cb resume,
                                     ioa_net_data *in_buffer, uint64_t ctxkey, int *postpone_reply);
@@ -168,8 +173,8 @@ struct _turn_turnserver {
   int self_udp_balance;
 
   /* White/black listing of address ranges */
-  ip_range_list_t *ip_whitelist;
-  ip_range_list_t *ip_blacklist;
+  ip_range_trie_t *ip_whitelist;
+  ip_range_trie_t *ip_blacklist;
 
   /* Mobility */
   vintp mobility;
@@ -206,6 +211,10 @@ struct _turn_turnserver {
 
   /* Set to true on SIGUSR1 */
   bool is_draining;
+
+  /* ChannelData packets relayed by the fast paths or through the generic client read path */
+  uint64_t channel_data_fast;
+  uint64_t channel_data_slow;
 };
 
 const char *get_version(turn_turnserver *server);
@@ -82,6 +82,7 @@ struct _ts_ur_super_session {
   hmackey_t hmackey;
   int hmackey_set;
   password_t pwd;
+  stun_hmac_ctx hmac_ctx;
   int quota_used;
   int oauth;
   turn_time_t max_session_time_auth;